@@ -7,7 +7,10 @@ ciphers="salsa20
          aes256_chacha20
          aes256_salsa20
          chacha20_aes256
-         salsa20_aes256"
+         salsa20_aes256
+         aes256gcm
+         aegis256
+         xchacha20poly1305"
 infiles="testfiles/1bv1
          testfiles/1kv1
          testfiles/10kv1"
@@ -0,0 +1,41 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/cpu_tokens_test
+
+rm -fr $base
+mkdir -p $base/src
+
+for i in 1 2 3 4; do
+    dd if=/dev/urandom of=$base/src/$i.bin bs=1000 count=$((i * 50)) 2>/dev/null
+done
+
+usable() {
+    "$@" --cpu-info | sed -n 's/^CPUs usable: \([0-9]*\).*/\1/p'
+}
+
+# -----------------------------------------------------------------------
+echo "=== Test: the CPU budget follows the affinity mask ==="
+n=$(usable ./vsencrypt)
+[ -n "$n" ] && [ "$n" -ge 1 ] && [ "$n" -le "$(nproc --all)" ] || { echo "FAIL: CPUs usable: '$n'"; exit 1; }
+if command -v taskset > /dev/null; then
+    [ "$(usable taskset -c 0 ./vsencrypt)" = "1" ] || { echo "FAIL: taskset -c 0 not honoured"; exit 1; }
+fi
+
+# -----------------------------------------------------------------------
+echo "=== Test: keys do not depend on how many Argon2 threads ran ==="
+# One CPU: every KDF runs its lanes on the caller's thread alone.
+if command -v taskset > /dev/null; then
+    taskset -c 0 ./vsencrypt -e -i $base/src -o $base/enc -p $password
+else
+    ./vsencrypt -e -i $base/src -o $base/enc -p $password -j 1
+fi
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 3
+if [ $? -ne 0 ]; then echo "FAIL: decrypt returned error"; exit 1; fi
+for i in 1 2 3 4; do
+    cmp -s $base/src/$i.bin $base/dec/$i.bin || { echo "FAIL: $i.bin differs"; exit 1; }
+done
+
+echo "=== All CPU token tests passed ==="
+rm -fr $base
@@ -7,7 +7,10 @@ ciphers="salsa20
          aes256_chacha20
          aes256_salsa20
          chacha20_aes256
-         salsa20_aes256"
+         salsa20_aes256
+         aes256gcm
+         aegis256
+         xchacha20poly1305"
 infiles="tmp/1b
          tmp/1k
          tmp/10k
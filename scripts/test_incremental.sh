@@ -0,0 +1,67 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/incremental_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=300 2>/dev/null
+dd if=/dev/urandom of=$base/src/b.bin bs=1000 count=7 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/c.bin bs=1 count=333 2>/dev/null
+
+# -----------------------------------------------------------------------
+echo "=== Test: the first --incremental run processes every file ==="
+out=$(./vsencrypt -e -i $base/src -o $base/enc -p $password --incremental $base/manifest.db)
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+[ "$out" = "0 unchanged, 3 changed, 0 pruned" ] || { echo "FAIL: got \"$out\""; exit 1; }
+[ -f $base/manifest.db ] || { echo "FAIL: no manifest written"; exit 1; }
+[ ! -f $base/manifest.db.tmp ] || { echo "FAIL: temp manifest left behind"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: a second run skips unchanged files ==="
+cp $base/enc/a.bin.vse $base/a.before
+out=$(./vsencrypt -e -i $base/src -o $base/enc -p $password --incremental $base/manifest.db)
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+[ "$out" = "3 unchanged, 0 changed, 0 pruned" ] || { echo "FAIL: got \"$out\""; exit 1; }
+cmp -s $base/enc/a.bin.vse $base/a.before || { echo "FAIL: a.bin.vse was rewritten"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: changed, new and same-mtime files are picked up ==="
+dd if=/dev/urandom of=$base/src/b.bin bs=1000 count=8 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/d.bin bs=1 count=100 2>/dev/null
+# Same size and mtime, different content: only the fingerprint tells.
+touch -r $base/src/a.bin $base/a.stamp
+printf 'x' | dd of=$base/src/a.bin bs=1 seek=10 conv=notrunc 2>/dev/null
+touch -r $base/a.stamp $base/src/a.bin
+out=$(./vsencrypt -e -i $base/src -o $base/enc -p $password --incremental $base/manifest.db)
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+[ "$out" = "1 unchanged, 3 changed, 0 pruned" ] || { echo "FAIL: got \"$out\""; exit 1; }
+./vsencrypt -d -i $base/enc -o $base/dec -p $password
+for f in a.bin b.bin sub/c.bin sub/d.bin; do
+    cmp -s $base/src/$f $base/dec/$f || { echo "FAIL: $f differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: --prune removes the outputs of deleted sources ==="
+rm $base/src/sub/c.bin
+out=$(./vsencrypt -e -i $base/src -o $base/enc -p $password --incremental $base/manifest.db)
+[ "$out" = "3 unchanged, 0 changed, 0 pruned" ] || { echo "FAIL: got \"$out\""; exit 1; }
+[ -f $base/enc/sub/c.bin.vse ] || { echo "FAIL: pruned without --prune"; exit 1; }
+# The manifest forgot c.bin on the last run, so delete another one.
+rm $base/src/b.bin
+out=$(./vsencrypt -e -i $base/src -o $base/enc -p $password --incremental $base/manifest.db --prune)
+[ "$out" = "2 unchanged, 0 changed, 1 pruned" ] || { echo "FAIL: got \"$out\""; exit 1; }
+[ ! -f $base/enc/b.bin.vse ] || { echo "FAIL: b.bin.vse not pruned"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: a corrupt manifest and bad combinations are refused ==="
+echo garbage > $base/bad.db
+./vsencrypt -e -i $base/src -o $base/enc -p $password --incremental $base/bad.db -q > /dev/null
+if [ $? -eq 0 ]; then echo "FAIL: corrupt manifest accepted"; exit 1; fi
+./vsencrypt -e -i $base/src -p $password --incremental $base/manifest.db -q
+if [ $? -eq 0 ]; then echo "FAIL: --incremental without -o accepted"; exit 1; fi
+./vsencrypt -e -i $base/src -o $base/enc -p $password --prune -q
+if [ $? -eq 0 ]; then echo "FAIL: --prune without --incremental accepted"; exit 1; fi
+
+echo "=== All incremental tests passed ==="
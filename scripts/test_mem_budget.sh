@@ -0,0 +1,50 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/mem_budget_test
+
+rm -fr $base
+mkdir -p $base/src
+
+for i in 1 2 3 4 5 6; do
+    dd if=/dev/urandom of=$base/src/$i.bin bs=1000 count=$((i * 20)) 2>/dev/null
+done
+
+# Prints the number of files that queued for the budget, and checks the rest.
+kdf_waits() {
+    python3 - "$1" <<'PY'
+import json, sys
+files = [json.loads(l) for l in open(sys.argv[1])]
+files = [r for r in files if r["type"] == "file"]
+assert len(files) == 6 and all(r["status"] == 0 for r in files), files
+print(sum(1 for r in files if r["kdf_wait_calls"] > 0 and r["kdf_wait_ns"] > 0))
+PY
+}
+
+# -----------------------------------------------------------------------
+echo "=== Test: KDFs queue for a one-KDF budget ==="
+./vsencrypt -e -i $base/src -o $base/enc -p $password -j 4 --mem-budget 64M --stats-json $base/enc.json
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+[ "$(kdf_waits $base/enc.json)" -gt 0 ] || { echo "FAIL: no KDF waited"; cat $base/enc.json; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: a budget below one KDF still lets them run, one at a time ==="
+./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 3 --mem-budget 1K --stats-json $base/dec.json
+if [ $? -ne 0 ]; then echo "FAIL: decrypt returned error"; exit 1; fi
+for i in 1 2 3 4 5 6; do
+    cmp -s $base/src/$i.bin $base/dec/$i.bin || { echo "FAIL: $i.bin differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: --mem-budget 0 turns the governor off ==="
+./vsencrypt -t -i $base/enc -p $password -j 4 --mem-budget 0 --stats-json $base/verify.json > /dev/null
+if [ $? -ne 0 ]; then echo "FAIL: verify returned error"; exit 1; fi
+[ "$(kdf_waits $base/verify.json)" = "0" ] || { echo "FAIL: KDFs waited without a budget"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: invalid sizes are rejected ==="
+./vsencrypt -t -i $base/enc -p $password -q --mem-budget 12X
+if [ $? -eq 0 ]; then echo "FAIL: --mem-budget 12X accepted"; exit 1; fi
+
+echo "=== All memory budget tests passed ==="
+rm -fr $base
@@ -0,0 +1,44 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/metrics_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=100 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/b.bin bs=1024 count=3 2>/dev/null
+
+# -----------------------------------------------------------------------
+echo "=== Test: --metrics-file counts files, bytes, errors and KDF latency ==="
+./vsencrypt -e -i $base/src -o $base/enc -p $password -c aes256 --metrics-file $base/enc.prom
+if [ $? -ne 0 ]; then echo "FAIL: encrypt with --metrics-file returned error"; exit 1; fi
+./vsencrypt -d -i $base/enc -o $base/dec -p wrong -q --metrics-file $base/dec.prom
+if [ -e $base/dec.prom.tmp ]; then echo "FAIL: temp file left behind"; exit 1; fi
+
+python3 - $base/enc.prom $base/dec.prom <<'PY' || exit 1
+import sys
+
+def parse(path):
+    metrics = {}
+    for line in open(path):
+        if line.startswith("#") or not line.strip():
+            continue
+        name, value = line.rsplit(" ", 1)
+        metrics[name] = float(value)
+    return metrics
+
+enc = parse(sys.argv[1])
+assert enc['vsencrypt_files_total{mode="encrypt",cipher="aes256"}'] == 2, enc
+assert enc['vsencrypt_bytes_total{mode="encrypt",cipher="aes256"}'] == 103 * 1024, enc
+assert enc['vsencrypt_kdf_seconds_count'] == 2 and enc['vsencrypt_kdf_seconds_bucket{le="+Inf"}'] == 2, enc
+assert enc['vsencrypt_kdf_seconds_sum'] > 0, enc
+assert enc['vsencrypt_peak_rss_bytes'] > 0 and enc['vsencrypt_throughput_bytes_per_second'] > 0, enc
+assert not any(k.startswith("vsencrypt_errors_total") for k in enc), enc
+
+dec = parse(sys.argv[2])
+assert dec['vsencrypt_files_total{mode="decrypt",cipher="aes256"}'] == 2, dec
+assert dec['vsencrypt_errors_total{code="67",name="ERR_DECRYPT_V1_INVALID_PASSWORD"}'] == 2, dec
+PY
+
+echo "=== All metrics tests passed ==="
@@ -0,0 +1,58 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/numa_test
+
+rm -fr $base
+mkdir -p $base/src
+
+# Split anything of 1 MiB and more, so that ranges use node-local buffers.
+VSE_SPLIT_MIN_BYTES=1048576
+export VSE_SPLIT_MIN_BYTES
+
+dd if=/dev/urandom of=$base/src/big.bin bs=1000 count=3000 2>/dev/null
+for i in 1 2 3; do
+    dd if=/dev/urandom of=$base/src/$i.bin bs=1000 count=$((i * 40)) 2>/dev/null
+done
+
+info() {
+    ./vsencrypt "$@" --cpu-info | sed -n "s/^$key: \([0-9]*\).*/\1/p"
+}
+
+# -----------------------------------------------------------------------
+echo "=== Test: --cpus restricts the CPU budget ==="
+key="CPUs usable"
+[ "$(info --cpus 0)" = "1" ] || { echo "FAIL: --cpus 0 not honoured"; exit 1; }
+n=$(info)
+[ "$(info --cpus 0-$((n - 1)))" = "$n" ] || { echo "FAIL: --cpus 0-$((n - 1)) not honoured"; exit 1; }
+key="NUMA nodes"
+[ -n "$(info)" ] || { echo "FAIL: no NUMA node count"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: invalid --cpus lists are refused ==="
+for list in "" abc 3-1 0- 1,,2 -1 99999; do
+    ./vsencrypt --cpus "$list" -q --cpu-info > /dev/null
+    if [ $? -eq 0 ]; then echo "FAIL: --cpus '$list' accepted"; exit 1; fi
+done
+
+# -----------------------------------------------------------------------
+if [ -d /sys/devices/system/node/node0 ]; then
+    echo "=== Test: --numa round trip ==="
+    ./vsencrypt -e -i $base/src -o $base/enc -p $password -j 3 --numa --cpus 0
+    if [ $? -ne 0 ]; then echo "FAIL: --numa encrypt returned error"; exit 1; fi
+    ./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 1
+    if [ $? -ne 0 ]; then echo "FAIL: decrypt returned error"; exit 1; fi
+    for f in big 1 2 3; do
+        cmp -s $base/src/$f.bin $base/dec/$f.bin || { echo "FAIL: $f.bin differs"; exit 1; }
+    done
+
+    rm -fr $base/dec
+    ./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 2 --numa
+    if [ $? -ne 0 ]; then echo "FAIL: --numa decrypt returned error"; exit 1; fi
+    for f in big 1 2 3; do
+        cmp -s $base/src/$f.bin $base/dec/$f.bin || { echo "FAIL: $f.bin differs after --numa decrypt"; exit 1; }
+    done
+fi
+
+echo "=== All NUMA tests passed ==="
+rm -fr $base
@@ -0,0 +1,76 @@
+#!/bin/sh
+
+password=secret123
+new_password=n3wsecret
+base=tmp/reencrypt_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=300 2>/dev/null
+dd if=/dev/urandom of=$base/src/b.bin bs=1000 count=7 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/c.bin bs=1 count=333 2>/dev/null
+./vsencrypt -e -i $base/src -o $base/enc -p $password -c aes256
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+
+cipher_of() {
+    od -An -tx1 -j1 -N1 "$1" | tr -d ' '
+}
+
+# Run vsencrypt on a pty, typing the given passwords at its prompts.
+. ./scripts/typed.sh
+
+# -----------------------------------------------------------------------
+echo "=== Test: -R with a wrong password leaves the files alone ==="
+cp $base/enc/a.bin.vse $base/a.before
+./vsencrypt -R -i $base/enc -p wrong -P $new_password -q
+if [ $? -eq 0 ]; then echo "FAIL: re-encrypt with a wrong password succeeded"; exit 1; fi
+cmp -s $base/enc/a.bin.vse $base/a.before || { echo "FAIL: a.bin.vse was modified"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: -R re-encrypts a folder in place with a new password and cipher ==="
+./vsencrypt -R -i $base/enc -p $password -P $new_password -c aes256_chacha20 -j 3
+if [ $? -ne 0 ]; then echo "FAIL: re-encrypt returned error"; exit 1; fi
+[ "$(find $base/enc -type f | wc -l)" -eq 3 ] || { echo "FAIL: files left behind"; find $base/enc; exit 1; }
+[ "$(cipher_of $base/enc/a.bin.vse)" = "32" ] || { echo "FAIL: cipher not changed"; exit 1; }
+
+./vsencrypt -t -i $base/enc -p $password -q > /dev/null
+if [ $? -eq 0 ]; then echo "FAIL: old password still works"; exit 1; fi
+./vsencrypt -d -i $base/enc -o $base/dec -p $new_password
+if [ $? -ne 0 ]; then echo "FAIL: decrypt with the new password returned error"; exit 1; fi
+for f in a.bin b.bin sub/c.bin; do
+    cmp -s $base/src/$f $base/dec/$f || { echo "FAIL: $f differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: -R without -c keeps the cipher; -o writes elsewhere ==="
+./vsencrypt -R -i $base/enc/b.bin.vse -o $base/b.bin.vse -p $new_password -P $password
+if [ $? -ne 0 ]; then echo "FAIL: single-file re-encrypt returned error"; exit 1; fi
+[ "$(cipher_of $base/b.bin.vse)" = "32" ] || { echo "FAIL: cipher changed"; exit 1; }
+./vsencrypt -d -i $base/b.bin.vse -o $base/b.bin -p $password
+cmp -s $base/src/b.bin $base/b.bin || { echo "FAIL: b.bin differs"; exit 1; }
+./vsencrypt -t -i $base/enc/b.bin.vse -p $new_password > /dev/null || { echo "FAIL: input was changed"; exit 1; }
+
+# -----------------------------------------------------------------------
+for aead in aes256gcm:04 aegis256:05 xchacha20poly1305:06; do
+    cipher=${aead%:*}
+    echo "=== Test: -R to $cipher and back ==="
+    ./vsencrypt -R -i $base/b.bin.vse -p $password -P $new_password -c $cipher
+    if [ $? -ne 0 ]; then echo "FAIL: re-encrypt to $cipher returned error"; exit 1; fi
+    [ "$(cipher_of $base/b.bin.vse)" = "${aead#*:}" ] || { echo "FAIL: cipher not changed"; exit 1; }
+    ./vsencrypt -d -i $base/b.bin.vse -o $base/b.bin -p $new_password -f
+    cmp -s $base/src/b.bin $base/b.bin || { echo "FAIL: b.bin differs under $cipher"; exit 1; }
+    ./vsencrypt -R -i $base/b.bin.vse -p $new_password -P $password -c salsa20
+    if [ $? -ne 0 ]; then echo "FAIL: re-encrypt from $cipher returned error"; exit 1; fi
+    ./vsencrypt -d -i $base/b.bin.vse -o $base/b.bin -p $password -f
+    cmp -s $base/src/b.bin $base/b.bin || { echo "FAIL: b.bin differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: -R prompts for both passwords ==="
+typed $password $new_password -R -i $base/b.bin.vse
+if [ $? -ne 0 ]; then echo "FAIL: re-encrypt with prompted passwords returned error"; exit 1; fi
+./vsencrypt -d -i $base/b.bin.vse -o $base/b.bin -p $new_password -f
+cmp -s $base/src/b.bin $base/b.bin || { echo "FAIL: b.bin differs"; exit 1; }
+
+echo "=== All re-encrypt tests passed ==="
@@ -0,0 +1,80 @@
+#!/bin/sh
+
+password=secret123
+new_password=n3wsecret
+base=tmp/rekey_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=300 2>/dev/null
+dd if=/dev/urandom of=$base/src/b.bin bs=1000 count=7 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/c.bin bs=1 count=333 2>/dev/null
+./vsencrypt -e --format 2 -i $base/src -o $base/enc -p $password
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+
+# The data starts after the version byte and the 421-byte v2 header.
+data_of() {
+    tail -c +423 "$1"
+}
+
+# Run vsencrypt on a pty, typing the given passwords at its prompts.
+. ./scripts/typed.sh
+
+# -----------------------------------------------------------------------
+echo "=== Test: --format 2 files decrypt and verify ==="
+[ "$(od -An -tx1 -N1 $base/enc/a.bin.vse | tr -d ' ')" = "02" ] || { echo "FAIL: not version 2"; exit 1; }
+./vsencrypt -t -i $base/enc -p $password > /dev/null
+if [ $? -ne 0 ]; then echo "FAIL: verify returned error"; exit 1; fi
+./vsencrypt -d -i $base/enc -o $base/dec -p $password
+if [ $? -ne 0 ]; then echo "FAIL: decrypt returned error"; exit 1; fi
+for f in a.bin b.bin sub/c.bin; do
+    cmp -s $base/src/$f $base/dec/$f || { echo "FAIL: $f differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: --rekey with a wrong password leaves the file alone ==="
+cp $base/enc/a.bin.vse $base/a.before
+./vsencrypt --rekey -i $base/enc/a.bin.vse -p wrong -P $new_password -q
+if [ $? -eq 0 ]; then echo "FAIL: rekey with a wrong password succeeded"; exit 1; fi
+cmp -s $base/enc/a.bin.vse $base/a.before || { echo "FAIL: a.bin.vse was modified"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: --rekey changes the password of a folder, header only ==="
+./vsencrypt --rekey -i $base/enc -p $password -P $new_password -j 3
+if [ $? -ne 0 ]; then echo "FAIL: rekey returned error"; exit 1; fi
+[ "$(find $base/enc -type f | wc -l)" -eq 3 ] || { echo "FAIL: files left behind"; find $base/enc; exit 1; }
+data_of $base/a.before > $base/a.data.before
+data_of $base/enc/a.bin.vse > $base/a.data.after
+cmp -s $base/a.data.before $base/a.data.after || { echo "FAIL: data was rewritten"; exit 1; }
+
+./vsencrypt -t -i $base/enc -p $password -q > /dev/null
+if [ $? -eq 0 ]; then echo "FAIL: old password still works"; exit 1; fi
+rm -fr $base/dec
+./vsencrypt -d -i $base/enc -o $base/dec -p $new_password
+if [ $? -ne 0 ]; then echo "FAIL: decrypt with the new password returned error"; exit 1; fi
+for f in a.bin b.bin sub/c.bin; do
+    cmp -s $base/src/$f $base/dec/$f || { echo "FAIL: $f differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: a modified v2 file fails verification ==="
+cp $base/enc/b.bin.vse $base/b.bin.vse
+printf 'x' | dd of=$base/b.bin.vse bs=1 seek=500 conv=notrunc 2>/dev/null
+./vsencrypt -t -i $base/b.bin.vse -p $new_password -q > /dev/null
+if [ $? -eq 0 ]; then echo "FAIL: modified file verified"; exit 1; fi
+
+# -----------------------------------------------------------------------
+echo "=== Test: --rekey refuses version 1 files ==="
+./vsencrypt -e -i $base/src/b.bin -o $base/b1.bin.vse -p $password
+./vsencrypt --rekey -i $base/b1.bin.vse -p $password -P $new_password -q
+if [ $? -eq 0 ]; then echo "FAIL: rekey of a v1 file succeeded"; exit 1; fi
+./vsencrypt -t -i $base/b1.bin.vse -p $password > /dev/null || { echo "FAIL: v1 file was changed"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: --rekey prompts for both passwords ==="
+typed $new_password $password --rekey -i $base/enc/a.bin.vse
+if [ $? -ne 0 ]; then echo "FAIL: rekey with prompted passwords returned error"; exit 1; fi
+./vsencrypt -t -i $base/enc/a.bin.vse -p $password > /dev/null || { echo "FAIL: new password does not work"; exit 1; }
+
+echo "=== All rekey tests passed ==="
@@ -0,0 +1,59 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/resume_test
+
+rm -fr $base
+mkdir -p $base/src/sub/deep
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=300 2>/dev/null
+dd if=/dev/urandom of=$base/src/b.bin bs=1000 count=7 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/c.bin bs=1 count=333 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/deep/d.bin bs=1 count=444 2>/dev/null
+./vsencrypt -e -i $base/src -o $base/enc -p $password
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+
+files_in() {
+    grep -c '"type":"file"' "$1"
+}
+
+# -----------------------------------------------------------------------
+echo "=== Test: a failed run keeps its journal ==="
+cp $base/enc/b.bin.vse $base/b.bin.vse
+printf 'x' | dd of=$base/enc/b.bin.vse bs=1 seek=100 conv=notrunc 2>/dev/null
+./vsencrypt -d -i $base/enc -o $base/dec -p $password --journal $base/journal -q
+if [ $? -eq 0 ]; then echo "FAIL: decrypt of a corrupt file succeeded"; exit 1; fi
+[ -f $base/journal ] || { echo "FAIL: journal deleted"; exit 1; }
+grep -q '^F a.bin.vse$' $base/journal || { echo "FAIL: a.bin.vse not journaled"; cat $base/journal; exit 1; }
+grep -q '^D sub$' $base/journal || { echo "FAIL: sub not journaled"; cat $base/journal; exit 1; }
+grep -q 'b.bin.vse' $base/journal && { echo "FAIL: failed file journaled"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: --resume only redoes what did not finish ==="
+cp $base/b.bin.vse $base/enc/b.bin.vse
+./vsencrypt -d -i $base/enc -o $base/dec -p $password --journal $base/journal --resume --stats-json $base/stats.json
+if [ $? -ne 0 ]; then echo "FAIL: resumed decrypt returned error"; exit 1; fi
+[ "$(files_in $base/stats.json)" = "1" ] || { echo "FAIL: expected 1 file processed"; cat $base/stats.json; exit 1; }
+[ ! -f $base/journal ] || { echo "FAIL: journal left after a complete run"; exit 1; }
+for f in a.bin b.bin sub/c.bin sub/deep/d.bin; do
+    cmp -s $base/src/$f $base/dec/$f || { echo "FAIL: $f differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: a torn last line is not trusted ==="
+rm -fr $base/dec $base/stats.json
+printf 'vsencrypt-journal 1 2\nF a.bin.vse\nF b.bin.vse\nD sub' > $base/journal
+./vsencrypt -d -i $base/enc -o $base/dec -p $password --journal $base/journal --resume --stats-json $base/stats.json
+if [ $? -ne 0 ]; then echo "FAIL: resumed decrypt returned error"; exit 1; fi
+[ "$(files_in $base/stats.json)" = "2" ] || { echo "FAIL: expected 2 files processed"; cat $base/stats.json; exit 1; }
+[ -f $base/dec/sub/c.bin ] || { echo "FAIL: sub skipped"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: a journal from another mode is refused ==="
+printf 'vsencrypt-journal 1 2\nF a.bin\n' > $base/journal
+./vsencrypt -e -i $base/src -o $base/enc2 -p $password --journal $base/journal --resume -q
+if [ $? -eq 0 ]; then echo "FAIL: journal of a decrypt run accepted"; exit 1; fi
+./vsencrypt -d -i $base/enc -o $base/dec -p $password --resume -q
+if [ $? -eq 0 ]; then echo "FAIL: --resume without --journal accepted"; exit 1; fi
+
+echo "=== All resume tests passed ==="
@@ -0,0 +1,83 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/resume_file_test
+
+rm -fr $base
+mkdir -p $base
+
+# Checkpoint every 64 KiB instead of 256 MiB.
+VSE_CHECKPOINT_BYTES=65536
+export VSE_CHECKPOINT_BYTES
+
+dd if=/dev/urandom of=$base/src.bin bs=1000 count=1000 2>/dev/null
+printf 'tail' >> $base/src.bin
+
+# Run "$@" with output files capped at $1 512-byte blocks, so that it dies
+# of SIGXFSZ part way through.
+interrupt() {
+    blocks=$1
+    shift
+    (ulimit -f $blocks; "$@" -q)
+} 2>/dev/null
+
+for cipher in chacha20 salsa20 aes256 aes256_chacha20 salsa20_aes256; do
+    echo "=== Test: interrupted $cipher run resumes to the same file ==="
+    out=$base/$cipher.vse
+    interrupt 600 ./vsencrypt -e -c $cipher -i $base/src.bin -o $out -p $password --checkpoint
+    if [ $? -eq 0 ]; then echo "FAIL: capped run succeeded"; exit 1; fi
+    [ -f $out.part ] || { echo "FAIL: no $out.part"; exit 1; }
+    [ -f $out.ckpt ] || { echo "FAIL: no $out.ckpt"; exit 1; }
+    [ ! -f $out ] || { echo "FAIL: $out in place after an interrupted run"; exit 1; }
+
+    # Interrupt a copy once more, further on, to resume from a resume.
+    cp $out.part $base/again.vse.part
+    cp $out.ckpt $base/again.vse.ckpt
+    interrupt 1200 ./vsencrypt -e -c $cipher -i $base/src.bin -o $base/again.vse -p $password --checkpoint --resume
+
+    ./vsencrypt -e -c $cipher -i $base/src.bin -o $out -p $password --checkpoint --resume
+    if [ $? -ne 0 ]; then echo "FAIL: resume returned error"; exit 1; fi
+    [ ! -f $out.part ] && [ ! -f $out.ckpt ] || { echo "FAIL: leftovers after resume"; exit 1; }
+
+    ./vsencrypt -e -c $cipher -i $base/src.bin -o $base/again.vse -p $password --resume --checkpoint
+    if [ $? -ne 0 ]; then echo "FAIL: second resume returned error"; exit 1; fi
+    cmp -s $out $base/again.vse || { echo "FAIL: resumed outputs differ"; exit 1; }
+    rm -f $base/again.vse
+
+    ./vsencrypt -d -i $out -o $base/dec.bin -p $password -f
+    if [ $? -ne 0 ]; then echo "FAIL: decrypt of resumed output returned error"; exit 1; fi
+    cmp -s $base/src.bin $base/dec.bin || { echo "FAIL: decrypted output differs"; exit 1; }
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: uninterrupted --checkpoint run ==="
+./vsencrypt -e -i $base/src.bin -o $base/whole.vse -p $password --checkpoint
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+[ ! -f $base/whole.vse.ckpt ] || { echo "FAIL: checkpoint left after success"; exit 1; }
+./vsencrypt -t -i $base/whole.vse -p $password > /dev/null
+if [ $? -ne 0 ]; then echo "FAIL: MAC check of output failed"; exit 1; fi
+
+# -----------------------------------------------------------------------
+echo "=== Test: resume with a wrong password or a changed input ==="
+out=$base/bad.vse
+interrupt 600 ./vsencrypt -e -i $base/src.bin -o $out -p $password --checkpoint
+./vsencrypt -e -i $base/src.bin -o $out -p wrong --checkpoint --resume -q
+if [ $? -eq 0 ]; then echo "FAIL: resume with a wrong password succeeded"; exit 1; fi
+[ -f $out.ckpt ] || { echo "FAIL: checkpoint lost by a failed resume"; exit 1; }
+printf 'more' >> $base/src.bin
+./vsencrypt -e -i $base/src.bin -o $out -p $password --checkpoint --resume -q
+if [ $? -eq 0 ]; then echo "FAIL: resume of a changed input succeeded"; exit 1; fi
+
+# -----------------------------------------------------------------------
+echo "=== Test: --checkpoint option checks ==="
+./vsencrypt -e -i $base/src.bin -o $base/v2.vse -p $password --checkpoint --format 2 -q
+if [ $? -eq 0 ]; then echo "FAIL: --checkpoint with --format 2 accepted"; exit 1; fi
+./vsencrypt -d -i $base/whole.vse -o $base/x.bin -p $password --checkpoint -q
+if [ $? -eq 0 ]; then echo "FAIL: --checkpoint with -d accepted"; exit 1; fi
+for cipher in aes256gcm aegis256 xchacha20poly1305; do
+    ./vsencrypt -e -c $cipher -i $base/src.bin -o $base/aead.vse -p $password --checkpoint -q
+    if [ $? -eq 0 ]; then echo "FAIL: --checkpoint with $cipher accepted"; exit 1; fi
+done
+
+echo "All resumable file tests passed."
+rm -fr $base
@@ -0,0 +1,72 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/schedule_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+# Split anything of 1 MiB and more, instead of 64 MiB.
+VSE_SPLIT_MIN_BYTES=1048576
+export VSE_SPLIT_MIN_BYTES
+
+dd if=/dev/urandom of=$base/src/huge.bin bs=1000 count=21000 2>/dev/null
+printf 'odd tail' >> $base/src/huge.bin
+dd if=/dev/urandom of=$base/src/sub/big.bin bs=4096 count=1024 2>/dev/null
+dd if=/dev/urandom of=$base/src/mid.bin bs=1000 count=700 2>/dev/null
+i=0
+while [ $i -lt 20 ]; do
+    dd if=/dev/urandom of=$base/src/sub/small_$i.bin bs=1 count=$((i * 37 + 1)) 2>/dev/null
+    i=$((i + 1))
+done
+
+files_in() {
+    grep -c '"type":"file"' "$1"
+}
+
+check_tree() {
+    for f in $(cd $base/src && find . -type f); do
+        cmp -s $base/src/$f $1/$f || { echo "FAIL: $f differs"; exit 1; }
+    done
+}
+
+for cipher in aes256_chacha20 salsa20 aes256gcm aegis256 xchacha20poly1305; do
+    echo "=== Test: $cipher split encrypt, one-thread decrypt ==="
+    rm -fr $base/enc $base/dec
+    ./vsencrypt -e -c $cipher -i $base/src -o $base/enc -p $password -j 4 --stats-json $base/stats.json
+    if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+    [ "$(files_in $base/stats.json)" = "23" ] || { echo "FAIL: expected 23 files"; exit 1; }
+    rm -f $base/stats.json
+    ./vsencrypt -t -i $base/enc -p $password -j 1 > /dev/null
+    if [ $? -ne 0 ]; then echo "FAIL: MAC check of split output failed"; exit 1; fi
+    ./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 1
+    if [ $? -ne 0 ]; then echo "FAIL: one-thread decrypt returned error"; exit 1; fi
+    check_tree $base/dec
+
+    echo "=== Test: $cipher one-thread encrypt, split decrypt ==="
+    rm -fr $base/enc $base/dec
+    ./vsencrypt -e -c $cipher -i $base/src -o $base/enc -p $password -j 1
+    if [ $? -ne 0 ]; then echo "FAIL: one-thread encrypt returned error"; exit 1; fi
+    ./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 3
+    if [ $? -ne 0 ]; then echo "FAIL: split decrypt returned error"; exit 1; fi
+    check_tree $base/dec
+done
+
+# -----------------------------------------------------------------------
+echo "=== Test: split version 2 round trip ==="
+rm -fr $base/enc $base/dec
+./vsencrypt -e --format 2 -i $base/src -o $base/enc -p $password -j 4
+if [ $? -ne 0 ]; then echo "FAIL: v2 encrypt returned error"; exit 1; fi
+./vsencrypt -d -i $base/enc -o $base/dec -p $password -j 4
+if [ $? -ne 0 ]; then echo "FAIL: v2 decrypt returned error"; exit 1; fi
+check_tree $base/dec
+
+# -----------------------------------------------------------------------
+echo "=== Test: wrong password fails before writing ==="
+rm -fr $base/dec
+./vsencrypt -d -i $base/enc -o $base/dec -p wrong -j 4 -q
+if [ $? -eq 0 ]; then echo "FAIL: decrypt with a wrong password succeeded"; exit 1; fi
+[ -z "$(find $base/dec -type f 2>/dev/null)" ] || { echo "FAIL: output written"; exit 1; }
+
+echo "=== All schedule tests passed ==="
+rm -fr $base
@@ -0,0 +1,110 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/serve_test
+sock=$base/vse.sock
+
+if ! command -v python3 >/dev/null 2>&1; then
+    echo "python3 not found, skip --serve test"
+    exit 0
+fi
+
+rm -fr $base
+mkdir -p $base
+
+dd if=/dev/urandom of=$base/plain bs=1024 count=100 2>/dev/null
+sha1_expected=$(shasum $base/plain | cut -d' ' -f1)
+
+./vsencrypt --serve $sock -j 2 &
+server_pid=$!
+
+i=0
+while [ ! -S $sock ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+[ -S $sock ] || { echo "FAIL: server socket not created"; kill $server_pid; exit 1; }
+
+python3 - "$sock" "$base" "$password" <<'PY'
+import os, socket, struct, sys
+
+sock_path, base, password = sys.argv[1], sys.argv[2], sys.argv[3].encode()
+MAGIC = 0x31455356
+ENCRYPT, DECRYPT, VERIFY = 1, 2, 3
+FLAG_FORCE, FLAG_FDS = 0x1, 0x2
+
+def request(s, op, infile=b"", outfile=b"", flags=0, fds=(), pw=password):
+    hdr = struct.pack("=IBBHIII", MAGIC, op, 0, flags, len(pw), len(infile), len(outfile))
+    if fds:
+        socket.send_fds(s, [hdr], list(fds))
+        s.sendall(pw + infile + outfile)
+    else:
+        s.sendall(hdr + pw + infile + outfile)
+    msg, rfds, _, _ = socket.recv_fds(s, 8, 1)
+    magic, status = struct.unpack("=Ii", msg)
+    assert magic == MAGIC
+    return status, (rfds[0] if rfds else None)
+
+def check(cond, what):
+    if not cond:
+        print("FAIL: " + what)
+        sys.exit(1)
+
+# More idle clients than workers (-j 2): they must not hold them.
+idle = []
+for _ in range(3):
+    c = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    c.connect(sock_path)
+    idle.append(c)
+
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect(sock_path)
+s.settimeout(30)
+
+plain = os.path.join(base, "plain").encode()
+enc = os.path.join(base, "plain.vse").encode()
+dec = os.path.join(base, "plain.dec").encode()
+
+print("=== Test: encrypt/verify/decrypt by path ===")
+status, _ = request(s, ENCRYPT, plain, enc)
+check(status == 0, "path encrypt returned %d" % status)
+status, _ = request(s, ENCRYPT, plain, enc)
+check(status != 0, "path encrypt should refuse to override without force")
+status, _ = request(s, VERIFY, enc)
+check(status == 0, "path verify returned %d" % status)
+status, _ = request(s, VERIFY, enc, pw=b"wrong")
+check(status != 0, "path verify with wrong password should fail")
+status, _ = request(s, DECRYPT, enc, dec, FLAG_FORCE)
+check(status == 0, "path decrypt returned %d" % status)
+
+print("=== Test: encrypt/decrypt with fd passing ===")
+with open(plain, "rb") as f:
+    status, enc_fd = request(s, ENCRYPT, flags=FLAG_FDS, fds=[f.fileno()])
+check(status == 0 and enc_fd is not None, "fd encrypt returned %d" % status)
+status, dec_fd = request(s, DECRYPT, flags=FLAG_FDS, fds=[enc_fd])
+check(status == 0 and dec_fd is not None, "fd decrypt returned %d" % status)
+with os.fdopen(dec_fd, "rb") as f, open(plain, "rb") as g:
+    check(f.read() == g.read(), "fd round trip does not match")
+os.lseek(enc_fd, 0, os.SEEK_SET)
+status, _ = request(s, VERIFY, flags=FLAG_FDS, fds=[enc_fd])
+check(status == 0, "fd verify returned %d" % status)
+os.close(enc_fd)
+
+print("=== Test: connections idle between requests ===")
+status, _ = request(idle[0], VERIFY, enc)
+check(status == 0, "verify on a connection idle so far returned %d" % status)
+idle[1].close()
+status, _ = request(s, VERIFY, enc)
+check(status == 0, "verify after another client hung up returned %d" % status)
+for c in idle:
+    c.close()
+
+s.close()
+PY
+ret=$?
+
+kill $server_pid
+wait $server_pid
+[ $ret -eq 0 ] || exit 1
+[ ! -S $sock ] || { echo "FAIL: socket not removed on shutdown"; exit 1; }
+
+[ "$(shasum $base/plain.dec | cut -d' ' -f1)" = "$sha1_expected" ] || { echo "FAIL: decrypted file mismatch"; exit 1; }
+
+echo "=== All serve tests passed ==="
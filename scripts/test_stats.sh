@@ -0,0 +1,42 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/stats_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=100 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/b.bin bs=1024 count=3 2>/dev/null
+
+# -----------------------------------------------------------------------
+echo "=== Test: --stats prints per-file and total breakdowns ==="
+./vsencrypt -e -i $base/src -o $base/enc -p $password --stats 2> $base/stats.txt
+if [ $? -ne 0 ]; then echo "FAIL: encrypt with --stats returned error"; exit 1; fi
+if [ "$(grep -c '^stats: .* encrypt .* kdf ' $base/stats.txt)" != "2" ]; then
+    echo "FAIL: expected 2 per-file lines"; cat $base/stats.txt; exit 1
+fi
+grep -q '^stats: 2 files (0 failed)' $base/stats.txt || { echo "FAIL: missing total"; cat $base/stats.txt; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: --stats-json writes NDJSON ==="
+./vsencrypt -d -i $base/enc -o $base/dec -p $password --stats-json $base/stats.json
+if [ $? -ne 0 ]; then echo "FAIL: decrypt with --stats-json returned error"; exit 1; fi
+./vsencrypt -d -f -i $base/enc/a.bin.vse -o $base/a.bin -p wrong --stats-json $base/stats.json -q
+
+python3 - $base/stats.json <<'PY' || exit 1
+import json, sys
+records = [json.loads(line) for line in open(sys.argv[1])]
+files = [r for r in records if r["type"] == "file"]
+totals = [r for r in records if r["type"] == "total"]
+assert len(files) == 3 and len(totals) == 2, records
+for r in files[:2]:
+    assert r["mode"] == "decrypt" and r["status"] == 0
+    assert r["kdf_calls"] == 1 and r["verify_calls"] == 1 and r["rename_calls"] == 1
+    assert r["read_calls"] > 0 and r["cipher_calls"] > 0 and r["write_calls"] > 0
+    assert sum(r[k] for k in r if k.endswith("_ns") and k != "total_ns") <= r["total_ns"]
+assert files[2]["status"] != 0 and files[2]["cipher_calls"] == 0
+assert totals[0]["files"] == 2 and totals[1]["failed"] == 1
+PY
+
+echo "=== All stats tests passed ==="
@@ -0,0 +1,42 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/trace_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=100 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/b.bin bs=1024 count=3 2>/dev/null
+
+# -----------------------------------------------------------------------
+echo "=== Test: --trace writes per-thread spans for every file ==="
+./vsencrypt -e -i $base/src -o $base/enc -p $password -j 2 --trace $base/enc.json
+if [ $? -ne 0 ]; then echo "FAIL: encrypt with --trace returned error"; exit 1; fi
+./vsencrypt -d -i $base/enc/a.bin.vse -o $base/a.bin -p $password --trace $base/dec.json
+if [ $? -ne 0 ]; then echo "FAIL: decrypt with --trace returned error"; exit 1; fi
+cmp -s $base/src/a.bin $base/a.bin || { echo "FAIL: decrypted file differs"; exit 1; }
+
+python3 - $base/enc.json $base/dec.json <<'PY' || exit 1
+import json, sys
+enc = json.load(open(sys.argv[1]))["traceEvents"]
+dec = json.load(open(sys.argv[2]))["traceEvents"]
+
+spans = [e for e in enc if e["ph"] == "X"]
+files = [e for e in spans if e["name"] == "file"]
+assert sorted(e["args"]["file"].split("/")[-1] for e in files) == ["a.bin", "b.bin"], files
+for f in files:
+    inner = [e for e in spans if e["tid"] == f["tid"] and e["name"] != "file"
+             and e["args"]["file"] == f["args"]["file"]]
+    names = set(e["name"] for e in inner)
+    assert {"kdf", "read", "cipher", "hash", "write", "rename"} <= names, names
+    for e in inner:
+        assert f["ts"] <= e["ts"] + 1 and e["ts"] + e["dur"] <= f["ts"] + f["dur"] + 1, (f, e)
+threads = set(e["tid"] for e in enc if e["ph"] == "M" and e["name"] == "thread_name")
+assert set(e["tid"] for e in spans) <= threads
+
+names = set(e["name"] for e in dec if e["ph"] == "X")
+assert {"file", "kdf", "verify", "cipher", "write", "rename"} <= names, names
+PY
+
+echo "=== All trace tests passed ==="
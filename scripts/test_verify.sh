@@ -0,0 +1,46 @@
+#!/bin/sh
+
+password=secret123
+base=tmp/verify_test
+
+rm -fr $base
+mkdir -p $base/src/sub
+
+dd if=/dev/urandom of=$base/src/a.bin bs=1024 count=2000 2>/dev/null
+dd if=/dev/urandom of=$base/src/b.bin bs=1024 count=5 2>/dev/null
+dd if=/dev/urandom of=$base/src/sub/c.bin bs=1024 count=3 2>/dev/null
+./vsencrypt -e -i $base/src -o $base/enc -p $password
+if [ $? -ne 0 ]; then echo "FAIL: encrypt returned error"; exit 1; fi
+echo "not encrypted" > $base/enc/notes.txt
+
+# -----------------------------------------------------------------------
+echo "=== Test: -t on a folder checks every .vse file in parallel ==="
+ls -R $base/enc > $base/before.txt
+./vsencrypt -t -i $base/enc -p $password -j 3 > $base/report.txt
+if [ $? -ne 0 ]; then echo "FAIL: verify returned error"; cat $base/report.txt; exit 1; fi
+[ "$(grep -c '^OK ' $base/report.txt)" = "3" ] || { echo "FAIL: expected 3 OK lines"; cat $base/report.txt; exit 1; }
+grep -q '^3 OK, 0 FAIL$' $base/report.txt || { echo "FAIL: missing summary"; cat $base/report.txt; exit 1; }
+ls -R $base/enc > $base/after.txt
+cmp -s $base/before.txt $base/after.txt || { echo "FAIL: -t created or removed files"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: -t reports a corrupted file and a wrong password ==="
+printf 'X' | dd of=$base/enc/sub/c.bin.vse bs=1 seek=100 conv=notrunc 2>/dev/null
+./vsencrypt -t -i $base/enc -p $password -q > $base/report.txt
+if [ $? -eq 0 ]; then echo "FAIL: verify of a corrupted file succeeded"; exit 1; fi
+grep -q "^FAIL .*c.bin.vse (error 67)$" $base/report.txt || { echo "FAIL: corrupted file not reported"; cat $base/report.txt; exit 1; }
+grep -q '^2 OK, 1 FAIL$' $base/report.txt || { echo "FAIL: wrong summary"; cat $base/report.txt; exit 1; }
+
+./vsencrypt -t -i $base/enc/a.bin.vse -p wrong -q > $base/report.txt
+if [ $? -eq 0 ]; then echo "FAIL: verify with a wrong password succeeded"; exit 1; fi
+grep -q "^FAIL .*a.bin.vse" $base/report.txt || { echo "FAIL: wrong password not reported"; exit 1; }
+
+./vsencrypt -t -i $base/enc/a.bin.vse -p $password | grep -q "^OK .*a.bin.vse" || { echo "FAIL: single file not OK"; exit 1; }
+
+# -----------------------------------------------------------------------
+echo "=== Test: -t refuses -o ==="
+./vsencrypt -t -i $base/enc -o $base/out -p $password -q
+if [ $? -eq 0 ]; then echo "FAIL: -t with -o succeeded"; exit 1; fi
+[ ! -e $base/out ] || { echo "FAIL: -t created $base/out"; exit 1; }
+
+echo "=== All verify tests passed ==="
@@ -0,0 +1,30 @@
+# Sourced by the tests that answer the password prompts of vsencrypt.
+
+# Run vsencrypt on a pty, typing the given passwords at its prompts:
+# typed password new_password args...
+typed() {
+    python3 - "$@" <<'PY'
+import os, pty, select, sys
+
+answers = sys.argv[1:3]
+pid, fd = pty.fork()
+if pid == 0:
+    os.execv("./vsencrypt", ["./vsencrypt"] + sys.argv[3:])
+out = b""
+while True:
+    if not select.select([fd], [], [], 30)[0]:
+        os.kill(pid, 9)
+        break
+    try:
+        data = os.read(fd, 1024)
+    except OSError:
+        break
+    if not data:
+        break
+    out += data
+    if out.endswith(b"assword: ") and answers:
+        os.write(fd, answers.pop(0).encode() + b"\n")
+        out = b""
+sys.exit(os.waitstatus_to_exitcode(os.waitpid(pid, 0)[1]))
+PY
+}
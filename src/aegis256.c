@@ -0,0 +1,290 @@
+#include <string.h>
+#include "aegis256.h"
+#include "aes/aes.h"
+#include "cpu_features.h"
+
+static const uint8_t g_c0[16] = {0x00, 0x01, 0x01, 0x02, 0x03, 0x05, 0x08, 0x0d,
+                                 0x15, 0x22, 0x37, 0x59, 0x90, 0xe9, 0x79, 0x62};
+static const uint8_t g_c1[16] = {0xdb, 0x3d, 0x18, 0x55, 0x6d, 0xc2, 0x2f, 0xf1,
+                                 0x20, 0x11, 0x31, 0x42, 0x73, 0xb5, 0x28, 0xdd};
+
+static void xor16(uint8_t *out, const uint8_t *a, const uint8_t *b)
+{
+    for (int i = 0; i < 16; i++)
+        out[i] = a[i] ^ b[i];
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/*
+ * Portable kernels.
+ */
+
+// z = S1 ^ S4 ^ S5 ^ (S2 & S3), what the next message block is xored with.
+static void vse_aegis256_z(const vse_aegis256_t *st, uint8_t *z)
+{
+    for (int i = 0; i < 16; i++)
+        z[i] = st->s[1][i] ^ st->s[4][i] ^ st->s[5][i] ^ (st->s[2][i] & st->s[3][i]);
+}
+
+// S'i = AESRound(S(i-1), Si), S'0 = AESRound(S5, S0 ^ m).
+static void vse_aegis256_update(vse_aegis256_t *st, const uint8_t *m)
+{
+    uint8_t s5[16];
+    uint8_t k[16];
+
+    memcpy(s5, st->s[5], 16);
+    for (int i = 5; i > 0; i--)
+    {
+        uint8_t r[16];
+        memcpy(r, st->s[i - 1], 16);
+        AES_round(r, st->s[i]);
+        memcpy(st->s[i], r, 16);
+    }
+    xor16(k, st->s[0], m);
+    AES_round(s5, k);
+    memcpy(st->s[0], s5, 16);
+}
+
+void vse_aegis256_encrypt_blocks(vse_aegis256_t *st, uint8_t *buf, size_t nblocks)
+{
+    uint8_t z[16];
+    uint8_t m[16];
+    for (; nblocks > 0; nblocks--, buf += 16)
+    {
+        vse_aegis256_z(st, z);
+        memcpy(m, buf, 16);
+        xor16(buf, m, z);
+        vse_aegis256_update(st, m);
+    }
+    memset(m, 0, sizeof(m));
+}
+
+void vse_aegis256_decrypt_blocks(vse_aegis256_t *st, uint8_t *buf, size_t nblocks)
+{
+    uint8_t z[16];
+    for (; nblocks > 0; nblocks--, buf += 16)
+    {
+        vse_aegis256_z(st, z);
+        xor16(buf, buf, z);
+        vse_aegis256_update(st, buf);
+    }
+}
+
+/*
+ * Messages.
+ */
+
+// Update with a block whose ciphertext is not wanted.
+static void vse_aegis256_absorb(vse_aegis256_t *st, const uint8_t *block)
+{
+    uint8_t tmp[16];
+    memcpy(tmp, block, 16);
+    vse_cpu_dispatch()->aegis256_encrypt_blocks(st, tmp, 1);
+    memset(tmp, 0, sizeof(tmp));
+}
+
+// Up to the end of the partial block: the state only moves once it is full.
+static size_t vse_aegis256_partial(vse_aegis256_t *st, uint8_t *buf, size_t nbytes, int decrypt)
+{
+    uint8_t z[16];
+    size_t n = 16 - st->buf_len;
+    if (n > nbytes)
+        n = nbytes;
+
+    vse_aegis256_z(st, z);
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t j = st->buf_len + i;
+        if (decrypt)
+            buf[i] ^= z[j];
+        st->buf[j] = buf[i];
+        if (!decrypt)
+            buf[i] ^= z[j];
+    }
+    st->buf_len += n;
+    if (st->buf_len == 16)
+    {
+        vse_aegis256_absorb(st, st->buf);
+        st->buf_len = 0;
+    }
+    return n;
+}
+
+static void vse_aegis256_crypt(vse_aegis256_t *st, uint8_t *buf, size_t nbytes, int decrypt)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+
+    st->nbytes += nbytes;
+    if (st->buf_len > 0)
+    {
+        size_t n = vse_aegis256_partial(st, buf, nbytes, decrypt);
+        buf += n;
+        nbytes -= n;
+    }
+
+    size_t nblocks = nbytes / 16;
+    if (decrypt)
+        kern->aegis256_decrypt_blocks(st, buf, nblocks);
+    else
+        kern->aegis256_encrypt_blocks(st, buf, nblocks);
+    buf += nblocks * 16;
+    nbytes -= nblocks * 16;
+
+    if (nbytes > 0)
+        vse_aegis256_partial(st, buf, nbytes, decrypt);
+}
+
+void vse_aegis256_init(vse_aegis256_t *st,
+                       const uint8_t *key,
+                       const uint8_t *nonce,
+                       const uint8_t *ad, size_t ad_nbytes)
+{
+    const uint8_t *k0 = key;
+    const uint8_t *k1 = key + 16;
+    uint8_t m[16][16];
+
+    memset(st, 0, sizeof(vse_aegis256_t));
+    xor16(st->s[0], k0, nonce);
+    xor16(st->s[1], k1, nonce + 16);
+    memcpy(st->s[2], g_c1, 16);
+    memcpy(st->s[3], g_c0, 16);
+    xor16(st->s[4], k0, g_c0);
+    xor16(st->s[5], k1, g_c1);
+
+    for (int r = 0; r < 4; r++)
+    {
+        memcpy(m[4 * r], k0, 16);
+        memcpy(m[4 * r + 1], k1, 16);
+        xor16(m[4 * r + 2], k0, nonce);
+        xor16(m[4 * r + 3], k1, nonce + 16);
+    }
+    vse_cpu_dispatch()->aegis256_encrypt_blocks(st, m[0], 16);
+    memset(m, 0, sizeof(m));
+
+    for (size_t i = 0; i < ad_nbytes; i += 16)
+    {
+        uint8_t block[16] = {0};
+        memcpy(block, ad + i, ad_nbytes - i < 16 ? ad_nbytes - i : 16);
+        vse_aegis256_absorb(st, block);
+    }
+    st->ad_nbytes = ad_nbytes;
+}
+
+void vse_aegis256_encrypt(vse_aegis256_t *st, uint8_t *buf, size_t nbytes)
+{
+    vse_aegis256_crypt(st, buf, nbytes, 0);
+}
+
+void vse_aegis256_decrypt(vse_aegis256_t *st, uint8_t *buf, size_t nbytes)
+{
+    vse_aegis256_crypt(st, buf, nbytes, 1);
+}
+
+void vse_aegis256_final(vse_aegis256_t *st, uint8_t *tag)
+{
+    uint8_t t[7][16];
+
+    // A partial last block goes in zero-padded.
+    if (st->buf_len > 0)
+    {
+        memset(st->buf + st->buf_len, 0, 16 - st->buf_len);
+        vse_aegis256_absorb(st, st->buf);
+    }
+
+    put_le64(t[0], st->ad_nbytes * 8);
+    put_le64(t[0] + 8, st->nbytes * 8);
+    xor16(t[0], t[0], st->s[3]);
+    for (int i = 1; i < 7; i++)
+        memcpy(t[i], t[0], 16);
+    vse_cpu_dispatch()->aegis256_encrypt_blocks(st, t[0], 7);
+
+    for (int i = 0; i < 16; i++)
+    {
+        tag[i] = st->s[0][i] ^ st->s[1][i] ^ st->s[2][i];
+        tag[16 + i] = st->s[3][i] ^ st->s[4][i] ^ st->s[5][i];
+    }
+    memset(st, 0, sizeof(vse_aegis256_t));
+}
+
+/*
+ * AES-NI: the state stays in registers for a whole call.
+ */
+
+#if VSE_X86
+#include <immintrin.h>
+
+#define AEGIS_LOAD(st, s)                                        \
+    for (int i = 0; i < 6; i++)                                  \
+    s[i] = _mm_loadu_si128((const __m128i *)(st)->s[i])
+
+#define AEGIS_STORE(st, s)                                       \
+    for (int i = 0; i < 6; i++)                                  \
+    _mm_storeu_si128((__m128i *)(st)->s[i], s[i])
+
+VSE_TARGET("sse2,aes")
+static inline __m128i vse_aegis256_z_aesni(const __m128i *s)
+{
+    return _mm_xor_si128(_mm_xor_si128(s[1], s[4]), _mm_xor_si128(s[5], _mm_and_si128(s[2], s[3])));
+}
+
+VSE_TARGET("sse2,aes")
+static inline void vse_aegis256_update_aesni(__m128i *s, __m128i m)
+{
+    __m128i s5 = s[5];
+    s[5] = _mm_aesenc_si128(s[4], s[5]);
+    s[4] = _mm_aesenc_si128(s[3], s[4]);
+    s[3] = _mm_aesenc_si128(s[2], s[3]);
+    s[2] = _mm_aesenc_si128(s[1], s[2]);
+    s[1] = _mm_aesenc_si128(s[0], s[1]);
+    s[0] = _mm_aesenc_si128(s5, _mm_xor_si128(s[0], m));
+}
+
+VSE_TARGET("sse2,aes")
+void vse_aegis256_encrypt_blocks_aesni(vse_aegis256_t *st, uint8_t *buf, size_t nblocks)
+{
+    __m128i s[6];
+    AEGIS_LOAD(st, s);
+    for (; nblocks > 0; nblocks--, buf += 16)
+    {
+        __m128i m = _mm_loadu_si128((const __m128i *)buf);
+        _mm_storeu_si128((__m128i *)buf, _mm_xor_si128(m, vse_aegis256_z_aesni(s)));
+        vse_aegis256_update_aesni(s, m);
+    }
+    AEGIS_STORE(st, s);
+}
+
+VSE_TARGET("sse2,aes")
+void vse_aegis256_decrypt_blocks_aesni(vse_aegis256_t *st, uint8_t *buf, size_t nblocks)
+{
+    __m128i s[6];
+    AEGIS_LOAD(st, s);
+    for (; nblocks > 0; nblocks--, buf += 16)
+    {
+        __m128i m = _mm_xor_si128(_mm_loadu_si128((const __m128i *)buf), vse_aegis256_z_aesni(s));
+        _mm_storeu_si128((__m128i *)buf, m);
+        vse_aegis256_update_aesni(s, m);
+    }
+    AEGIS_STORE(st, s);
+}
+
+#else
+
+void vse_aegis256_encrypt_blocks_aesni(vse_aegis256_t *st, uint8_t *buf, size_t nblocks)
+{
+    vse_aegis256_encrypt_blocks(st, buf, nblocks);
+}
+
+void vse_aegis256_decrypt_blocks_aesni(vse_aegis256_t *st, uint8_t *buf, size_t nblocks)
+{
+    vse_aegis256_decrypt_blocks(st, buf, nblocks);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef AEGIS256_3C9A5E71_B6D2_4F08_9E43_7A1D0C58F2B6_H
+#define AEGIS256_3C9A5E71_B6D2_4F08_9E43_7A1D0C58F2B6_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * AEGIS-256 (draft-irtf-cfrg-aegis-aead), 256-bit key and nonce, 256-bit
+ * tag.
+ *
+ * Six 16-byte state blocks go through one AES round each per 16 bytes of
+ * message, which absorbs the plaintext: there is no keystream apart from
+ * the message, so a stream cannot be seeked and encryption and decryption
+ * differ. Both take any length in any number of calls.
+ *
+ * The rounds are AES-NI when the CPU has it, else AES_round() of src/aes.
+ */
+
+#define VSE_AEGIS256_KEY_LEN 32
+#define VSE_AEGIS256_NONCE_LEN 32
+#define VSE_AEGIS256_TAG_LEN 32
+
+typedef struct vse_aegis256
+{
+    uint8_t s[6][16];
+    uint8_t buf[16]; // plaintext of the partial block
+    size_t buf_len;
+    uint64_t ad_nbytes;
+    uint64_t nbytes; // message
+} vse_aegis256_t;
+
+/**
+ * Start a message under key and nonce, absorbing ad.
+ */
+void vse_aegis256_init(vse_aegis256_t *st,
+                       const uint8_t *key,   // VSE_AEGIS256_KEY_LEN bytes
+                       const uint8_t *nonce, // VSE_AEGIS256_NONCE_LEN bytes
+                       const uint8_t *ad, size_t ad_nbytes);
+
+/**
+ * En/decrypt buf in place.
+ */
+void vse_aegis256_encrypt(vse_aegis256_t *st, uint8_t *buf, size_t nbytes);
+void vse_aegis256_decrypt(vse_aegis256_t *st, uint8_t *buf, size_t nbytes);
+
+/**
+ * Finish the message. The tag is the same after encryption and after
+ * decryption of its ciphertext.
+ */
+void vse_aegis256_final(vse_aegis256_t *st, uint8_t *tag); // VSE_AEGIS256_TAG_LEN bytes
+
+/*
+ * Kernels, picked by vse_cpu_dispatch(): whole 16-byte blocks, with no
+ * partial block pending.
+ */
+void vse_aegis256_encrypt_blocks(vse_aegis256_t *st, uint8_t *buf, size_t nblocks);
+void vse_aegis256_decrypt_blocks(vse_aegis256_t *st, uint8_t *buf, size_t nblocks);
+
+// Only call them when vse_cpu_features() has VSE_CPU_AESNI.
+void vse_aegis256_encrypt_blocks_aesni(vse_aegis256_t *st, uint8_t *buf, size_t nblocks);
+void vse_aegis256_decrypt_blocks_aesni(vse_aegis256_t *st, uint8_t *buf, size_t nblocks);
+
+#endif
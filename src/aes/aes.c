@@ -406,6 +406,21 @@ static void InvShiftRows(state_t* state)
 }
 
 
+// One full encryption round: SubBytes, ShiftRows, MixColumns, then the
+// given round key. Same as the AESENC instruction.
+void AES_round(uint8_t* block, const uint8_t* round_key)
+{
+  uint8_t i;
+  state_t* state = (state_t*)block;
+  SubBytes(state);
+  ShiftRows(state);
+  MixColumns(state);
+  for (i = 0; i < AES_BLOCKLEN; ++i)
+  {
+    block[i] ^= round_key[i];
+  }
+}
+
 // Cipher is the main function that encrypts the PlainText.
 static void Cipher(state_t* state, uint8_t* RoundKey)
 {
@@ -495,9 +510,9 @@ static void XorWithIv(uint8_t* buf, uint8_t* Iv)
   }
 }
 
-void AES_CBC_encrypt_buffer(aes_ctx_t *ctx,uint8_t* buf, uint32_t length)
+void AES_CBC_encrypt_buffer(aes_ctx_t *ctx,uint8_t* buf, size_t length)
 {
-  uintptr_t i;
+  size_t i;
   uint8_t *Iv = ctx->Iv;
   for (i = 0; i < length; i += AES_BLOCKLEN)
   {
@@ -511,9 +526,9 @@ void AES_CBC_encrypt_buffer(aes_ctx_t *ctx,uint8_t* buf, uint32_t length)
   memcpy(ctx->Iv, Iv, AES_BLOCKLEN);
 }
 
-void AES_CBC_decrypt_buffer(aes_ctx_t* ctx, uint8_t* buf,  uint32_t length)
+void AES_CBC_decrypt_buffer(aes_ctx_t* ctx, uint8_t* buf,  size_t length)
 {
-  uintptr_t i;
+  size_t i;
   uint8_t storeNextIv[AES_BLOCKLEN];
   for (i = 0; i < length; i += AES_BLOCKLEN)
   {
@@ -533,11 +548,11 @@ void AES_CBC_decrypt_buffer(aes_ctx_t* ctx, uint8_t* buf,  uint32_t length)
 #if defined(CTR) && (CTR == 1)
 
 /* Symmetrical operation: same function for encrypting as for decrypting. Note any IV/nonce should never be reused with the same key */
-void AES_CTR_xcrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, uint32_t length)
+void AES_CTR_xcrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, size_t length)
 {
   uint8_t buffer[AES_BLOCKLEN];
 
-  unsigned i;
+  size_t i;
   int bi;
   for (i = 0, bi = AES_BLOCKLEN; i < length; ++i, ++bi)
   {
@@ -1,6 +1,7 @@
 #ifndef _AES_H_
 #define _AES_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 // #define the macros below to 1/0 to enable/disable the mode of operation.
@@ -49,6 +50,10 @@ typedef struct AES_ctx
 } aes_ctx_t;
 
 void AES_init_ctx(aes_ctx_t* ctx, const uint8_t* key);
+
+// One AES encryption round on a 16-byte block, with round_key as its round
+// key; the building block of AEGIS.
+void AES_round(uint8_t* block, const uint8_t* round_key);
 #if (defined(CBC) && (CBC == 1)) || (defined(CTR) && (CTR == 1))
 void AES_init_ctx_iv(aes_ctx_t* ctx, const uint8_t* key, const uint8_t* iv);
 void AES_ctx_set_iv(aes_ctx_t* ctx, const uint8_t* iv);
@@ -69,8 +74,8 @@ void AES_ECB_decrypt(aes_ctx_t* ctx, uint8_t* buf);
 // Suggest https://en.wikipedia.org/wiki/Padding_(cryptography)#PKCS7 for padding scheme
 // NOTES: you need to set IV in ctx via AES_init_ctx_iv() or AES_ctx_set_iv()
 //        no IV should ever be reused with the same key
-void AES_CBC_encrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, uint32_t length);
-void AES_CBC_decrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, uint32_t length);
+void AES_CBC_encrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, size_t length);
+void AES_CBC_decrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, size_t length);
 
 #endif // #if defined(CBC) && (CBC == 1)
 
@@ -82,7 +87,7 @@ void AES_CBC_decrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, uint32_t length);
 // Suggesting https://en.wikipedia.org/wiki/Padding_(cryptography)#PKCS7 for padding scheme
 // NOTES: you need to set IV in ctx with AES_init_ctx_iv() or AES_ctx_set_iv()
 //        no IV should ever be reused with the same key
-void AES_CTR_xcrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, uint32_t length);
+void AES_CTR_xcrypt_buffer(aes_ctx_t* ctx, uint8_t* buf, size_t length);
 
 #endif // #if defined(CTR) && (CTR == 1)
 
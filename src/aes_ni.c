@@ -0,0 +1,98 @@
+#include <string.h>
+#include "aes_ni.h"
+#include "cpu_features.h"
+
+#if VSE_X86
+#include <immintrin.h>
+
+#if _MSC_VER
+#include <stdlib.h>
+#define vse_bswap64(x) _byteswap_uint64(x)
+#else
+#define vse_bswap64(x) __builtin_bswap64(x)
+#endif
+
+#define AES_NI_ROUNDS 14 // AES-256
+#define AES_NI_LANES 8
+
+static uint64_t load_be64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return vse_bswap64(v);
+}
+
+static void store_be64(uint8_t *p, uint64_t v)
+{
+    v = vse_bswap64(v);
+    memcpy(p, &v, 8);
+}
+
+/*
+ * The counter is the whole 16-byte Iv taken as one big-endian number, as
+ * in tiny-AES, kept here as two native halves.
+ */
+VSE_TARGET("sse2,aes")
+static __m128i next_counter(uint64_t *hi, uint64_t *lo)
+{
+    __m128i block = _mm_set_epi64x((long long)vse_bswap64(*lo), (long long)vse_bswap64(*hi));
+    if (++*lo == 0)
+        ++*hi;
+    return block;
+}
+
+VSE_TARGET("sse2,aes")
+void vse_aes_ctr_xcrypt_aesni(aes_ctx_t *ctx, uint8_t *buf, size_t nbytes)
+{
+    __m128i rk[AES_NI_ROUNDS + 1];
+    __m128i b[AES_NI_LANES];
+    uint64_t hi = load_be64(ctx->Iv);
+    uint64_t lo = load_be64(ctx->Iv + 8);
+
+    // tiny-AES keeps the expanded key in the byte order AES-NI expects.
+    for (int r = 0; r <= AES_NI_ROUNDS; r++)
+        rk[r] = _mm_loadu_si128((const __m128i *)(ctx->RoundKey + r * AES_BLOCKLEN));
+
+    while (nbytes >= AES_NI_LANES * AES_BLOCKLEN)
+    {
+        for (int i = 0; i < AES_NI_LANES; i++)
+            b[i] = _mm_xor_si128(next_counter(&hi, &lo), rk[0]);
+        for (int r = 1; r < AES_NI_ROUNDS; r++)
+            for (int i = 0; i < AES_NI_LANES; i++)
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+        for (int i = 0; i < AES_NI_LANES; i++)
+        {
+            __m128i *p = (__m128i *)(buf + i * AES_BLOCKLEN);
+            b[i] = _mm_aesenclast_si128(b[i], rk[AES_NI_ROUNDS]);
+            _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), b[i]));
+        }
+        buf += AES_NI_LANES * AES_BLOCKLEN;
+        nbytes -= AES_NI_LANES * AES_BLOCKLEN;
+    }
+
+    while (nbytes > 0)
+    {
+        uint8_t ks[AES_BLOCKLEN];
+        size_t n = nbytes < AES_BLOCKLEN ? nbytes : AES_BLOCKLEN;
+        __m128i k = _mm_xor_si128(next_counter(&hi, &lo), rk[0]);
+        for (int r = 1; r < AES_NI_ROUNDS; r++)
+            k = _mm_aesenc_si128(k, rk[r]);
+        _mm_storeu_si128((__m128i *)ks, _mm_aesenclast_si128(k, rk[AES_NI_ROUNDS]));
+        for (size_t i = 0; i < n; i++)
+            buf[i] ^= ks[i];
+        buf += n;
+        nbytes -= n;
+    }
+
+    store_be64(ctx->Iv, hi);
+    store_be64(ctx->Iv + 8, lo);
+}
+
+#else
+
+void vse_aes_ctr_xcrypt_aesni(aes_ctx_t *ctx, uint8_t *buf, size_t nbytes)
+{
+    AES_CTR_xcrypt_buffer(ctx, buf, nbytes);
+}
+
+#endif
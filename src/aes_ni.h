@@ -0,0 +1,16 @@
+#ifndef AES_NI_4F2C8B61_7D3E_4A05_B9E8_1C6A0F5D2E73_H
+#define AES_NI_4F2C8B61_7D3E_4A05_B9E8_1C6A0F5D2E73_H
+
+#include <stdint.h>
+#include "aes/aes.h"
+
+/**
+ * AES_CTR_xcrypt_buffer() using AES-NI, 8 blocks at a time.
+ *
+ * Same output and same ctx->Iv afterwards as the portable version,
+ * including the counter step taken by a trailing partial block.
+ * Only call it when vse_cpu_features() has VSE_CPU_AESNI.
+ */
+void vse_aes_ctr_xcrypt_aesni(aes_ctx_t *ctx, uint8_t *buf, size_t nbytes);
+
+#endif
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cgroup.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+#if defined(__linux__)
+/* The path of our cgroup v2 relative to CGROUP_ROOT, "/" for the root. */
+static int vse_cgroup_path(char *path, size_t nbytes)
+{
+    FILE *fp = fopen("/proc/self/cgroup", "r");
+    if (fp == NULL)
+        return -1;
+
+    char line[4096];
+    int ret = -1;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if (strncmp(line, "0::", 3) != 0)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+        if (strlen(line + 3) < nbytes)
+        {
+            strcpy(path, line + 3);
+            ret = 0;
+        }
+        break;
+    }
+    fclose(fp);
+    return ret;
+}
+#endif
+
+void vse_cgroup_for_each(const char *name, void (*fn)(const char *line, void *arg), void *arg)
+{
+#if defined(__linux__)
+    char path[4096];
+    if (vse_cgroup_path(path, sizeof(path)) != 0)
+        return;
+
+    for (;;)
+    {
+        char file[4096 + 256];
+        snprintf(file, sizeof(file), CGROUP_ROOT "%s%s%s",
+                 path, strcmp(path, "/") == 0 ? "" : "/", name);
+        FILE *fp = fopen(file, "r");
+        if (fp != NULL)
+        {
+            char line[256];
+            if (fgets(line, sizeof(line), fp) != NULL)
+            {
+                line[strcspn(line, "\n")] = '\0';
+                fn(line, arg);
+            }
+            fclose(fp);
+        }
+
+        char *slash = strrchr(path, '/');
+        if (slash == NULL || strcmp(path, "/") == 0)
+            break;
+        if (slash == path)
+            slash[1] = '\0'; // up to the root
+        else
+            *slash = '\0';
+    }
+#else
+    (void)name;
+    (void)fn;
+    (void)arg;
+#endif
+}
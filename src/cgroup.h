@@ -0,0 +1,19 @@
+#ifndef CGROUP_3F8D2A61_B7C4_4E19_9A05_D61E7C2B48F3_H
+#define CGROUP_3F8D2A61_B7C4_4E19_9A05_D61E7C2B48F3_H
+
+/*
+ * Limits of the cgroup v2 this process runs in (Linux only).
+ *
+ * The cgroup is the "0::" line of /proc/self/cgroup, under /sys/fs/cgroup.
+ * A limit set on an ancestor applies as well, so controller files are read
+ * from the process's cgroup up to the root.
+ */
+
+/**
+ * Call fn with the first line, without the newline, of the controller file
+ * name (e.g. "memory.max") of our cgroup and of every ancestor that has it,
+ * innermost first. Nothing is called without cgroup v2.
+ */
+void vse_cgroup_for_each(const char *name, void (*fn)(const char *line, void *arg), void *arg);
+
+#endif
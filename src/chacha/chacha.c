@@ -80,7 +80,7 @@ void chacha_ivsetup(chacha_ctx_t *x, const u8 *iv, const u8 *counter) {
   x->input[15] = U8TO32_LITTLE(iv + 4);
 }
 
-void chacha_xcrypt_bytes(chacha_ctx_t *x, const u8 *m, u8 *c, u32 bytes) {
+void chacha_xcrypt_bytes(chacha_ctx_t *x, const u8 *m, u8 *c, size_t bytes) {
   u32 x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
   u32 j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
   u8 *ctarget = NULL;
@@ -9,6 +9,7 @@ Public domain.
 #ifndef CHACHA_H
 #define CHACHA_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #if _MSC_VER
@@ -42,7 +43,7 @@ void chacha_ivsetup(chacha_ctx_t *x,
 void chacha_xcrypt_bytes(chacha_ctx_t *x,
                           const uint8_t *m,
                           uint8_t *c,
-                          uint32_t bytes)
+                          size_t bytes)
     __attribute__((__bounded__(__buffer__, 2, 4)))
     __attribute__((__bounded__(__buffer__, 3, 4)));
 
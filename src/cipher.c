@@ -0,0 +1,595 @@
+#include <string.h>
+#include "cipher.h"
+#include "crypt_v1.h"
+#include "timing.h"
+#include "probes.h"
+
+/*
+ * Steps.
+ *
+ * Each step derives its own IV from the file iv, labelled with the step
+ * name ("aes", "chacha", "salsa20"), so ciphers sharing a step stay
+ * compatible with each other and with existing files.
+ */
+
+static int vse_setup_aes(vse_cipher_ctx_t *ctx,
+                         const uint8_t *iv, size_t iv_nbytes,
+                         const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t iv_aes[IV_LEN] = {0};
+    (void)key_nbytes;
+    ctx->kern = vse_cpu_dispatch();
+    if (vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"aes", 3, IV_LEN, iv_aes) != 0)
+        return ERR_LIB_KDF_FAILED;
+    AES_init_ctx_iv(&ctx->aes, key, iv_aes);
+    return 0;
+}
+
+static int vse_setup_chacha20(vse_cipher_ctx_t *ctx,
+                             const uint8_t *iv, size_t iv_nbytes,
+                             const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t iv_chacha[IV_LEN] = {0};
+    (void)key_nbytes;
+    ctx->kern = vse_cpu_dispatch();
+    if (vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"chacha", 6, IV_LEN, iv_chacha) != 0)
+        return ERR_LIB_KDF_FAILED;
+    chacha_ivsetup(&ctx->chacha, iv_chacha, NULL);
+    chacha_keysetup(&ctx->chacha, key, 256);
+    return 0;
+}
+
+static int vse_setup_salsa20(vse_cipher_ctx_t *ctx,
+                              const uint8_t *iv, size_t iv_nbytes,
+                              const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t iv_salsa20[IV_LEN] = {0};
+    (void)key_nbytes;
+    ctx->kern = vse_cpu_dispatch();
+    if (vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"salsa20", 7, IV_LEN, iv_salsa20) != 0)
+        return ERR_LIB_KDF_FAILED;
+    salsa20_keysetup(&ctx->salsa20, key, 256, IV_LEN * 8);
+    salsa20_ivsetup(&ctx->salsa20, iv_salsa20);
+    return 0;
+}
+
+static void vse_seek_aes(vse_cipher_ctx_t *ctx, uint64_t offset)
+{
+    // The counter block is a 128-bit big-endian integer.
+    uint64_t carry = offset / AES_BLOCKLEN;
+    for (int i = AES_BLOCKLEN - 1; i >= 0 && carry != 0; i--)
+    {
+        carry += ctx->aes.Iv[i];
+        ctx->aes.Iv[i] = (uint8_t)carry;
+        carry >>= 8;
+    }
+}
+
+static void vse_seek_chacha20(vse_cipher_ctx_t *ctx, uint64_t offset)
+{
+    uint64_t block = offset / CHACHA_BLOCKLEN;
+    ctx->chacha.input[12] = (uint32_t)block;
+    ctx->chacha.input[13] = (uint32_t)(block >> 32);
+}
+
+static void vse_seek_salsa20(vse_cipher_ctx_t *ctx, uint64_t offset)
+{
+    uint64_t block = offset / 64;
+    ctx->salsa20.input[8] = (uint32_t)block;
+    ctx->salsa20.input[9] = (uint32_t)(block >> 32);
+}
+
+/*
+ * GCM keystream: AES CTR from J0 + 1, J0 = nonce || 1, the 96-bit nonce
+ * derived like the IVs of the other steps. It seeks as the aes step does.
+ */
+static int vse_gcm_nonce(const uint8_t *iv, size_t iv_nbytes, uint8_t *nonce)
+{
+    if (vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"gcm", 3, VSE_GCM_NONCE_LEN, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    return 0;
+}
+
+static int vse_setup_gcm(vse_cipher_ctx_t *ctx,
+                         const uint8_t *iv, size_t iv_nbytes,
+                         const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t counter[AES_BLOCKLEN] = {0};
+    (void)key_nbytes;
+    ctx->kern = vse_cpu_dispatch();
+    if (vse_gcm_nonce(iv, iv_nbytes, counter) != 0)
+        return ERR_LIB_KDF_FAILED;
+    counter[AES_BLOCKLEN - 1] = 2;
+    AES_init_ctx_iv(&ctx->aes, key, counter);
+    return 0;
+}
+
+/*
+ * XChaCha20 keystream: ChaCha20 under the HChaCha20 subkey from block 1,
+ * block 0 keying Poly1305. The 192-bit nonce is derived like the IVs of the
+ * other steps.
+ */
+static int vse_xchacha20_nonce(const uint8_t *iv, size_t iv_nbytes, uint8_t *nonce)
+{
+    if (vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"xchacha20", 9, VSE_XCHACHA20_NONCE_LEN, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    return 0;
+}
+
+static int vse_setup_xchacha20(vse_cipher_ctx_t *ctx,
+                              const uint8_t *iv, size_t iv_nbytes,
+                              const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t nonce[VSE_XCHACHA20_NONCE_LEN];
+    (void)key_nbytes;
+    ctx->kern = vse_cpu_dispatch();
+    if (vse_xchacha20_nonce(iv, iv_nbytes, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    vse_xchacha20_init(&ctx->chacha, key, nonce);
+    return 0;
+}
+
+static void vse_seek_xchacha20(vse_cipher_ctx_t *ctx, uint64_t offset)
+{
+    vse_seek_chacha20(ctx, offset + CHACHA_BLOCKLEN);
+}
+
+/*
+ * AEGIS-256 has no keystream: its state, which the plaintext runs through,
+ * is the whole cipher. The 256-bit nonce is derived like the IVs of the
+ * steps.
+ */
+static int vse_aegis256_nonce(const uint8_t *iv, size_t iv_nbytes, uint8_t *nonce)
+{
+    if (vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"aegis256", 8, VSE_AEGIS256_NONCE_LEN, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    return 0;
+}
+
+static int vse_setup_aegis256(vse_cipher_ctx_t *ctx,
+                               const uint8_t *iv, size_t iv_nbytes,
+                               const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t nonce[VSE_AEGIS256_NONCE_LEN];
+    (void)key_nbytes;
+    ctx->kern = vse_cpu_dispatch();
+    if (vse_aegis256_nonce(iv, iv_nbytes, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    vse_aegis256_init(&ctx->aegis, key, nonce, NULL, 0);
+    return 0;
+}
+
+/*
+ * Step bodies, expanded inline into every cipher. The kernels come from the
+ * CPU dispatch table picked at setup.
+ */
+#define VSE_STEP_AES(ctx, buf, len) (ctx)->kern->aes_ctr_xcrypt(&(ctx)->aes, (buf), (len))
+#define VSE_STEP_CHACHA20(ctx, buf, len) (ctx)->kern->chacha20_xcrypt(&(ctx)->chacha, (buf), (buf), (len))
+#define VSE_STEP_SALSA20(ctx, buf, len) (ctx)->kern->salsa20_xcrypt(&(ctx)->salsa20, (buf), (buf), (len))
+#define VSE_STEP_GCM VSE_STEP_AES
+#define VSE_STEP_XCHACHA20 VSE_STEP_CHACHA20
+#define VSE_STEP_AEGIS256(ctx, buf, len) vse_aegis256_decrypt(&(ctx)->aegis, (buf), (len))
+#define VSE_STEP_NONE(ctx, buf, len)
+
+#define VSE_SETUP_AES vse_setup_aes
+#define VSE_SETUP_CHACHA20 vse_setup_chacha20
+#define VSE_SETUP_SALSA20 vse_setup_salsa20
+#define VSE_SETUP_GCM vse_setup_gcm
+#define VSE_SETUP_XCHACHA20 vse_setup_xchacha20
+#define VSE_SETUP_AEGIS256 vse_setup_aegis256
+#define VSE_SETUP_NONE(ctx, iv, iv_nbytes, key, key_nbytes) 0
+
+#define VSE_SEEK_AES vse_seek_aes
+#define VSE_SEEK_CHACHA20 vse_seek_chacha20
+#define VSE_SEEK_SALSA20 vse_seek_salsa20
+#define VSE_SEEK_GCM vse_seek_aes
+#define VSE_SEEK_XCHACHA20 vse_seek_xchacha20
+#define VSE_SEEK_NONE(ctx, offset)
+
+// Two-step ciphers run both steps over this much, a multiple of 64, at a
+// time, so that the second finds the data still in cache.
+#define VSE_XCRYPT_CHUNK (64 * 1024)
+
+#define VSE_DEFINE_STEP(fn, STEP, BLOCK_LEN, LABEL)                                    \
+    static void fn##_xcrypt(vse_cipher_ctx_t *ctx, uint8_t *buf, size_t nbytes)        \
+    {                                                                                  \
+        VSE_STEP_##STEP(ctx, buf, nbytes);                                             \
+    }                                                                                  \
+    static const vse_cipher_step_t fn = {LABEL, BLOCK_LEN, VSE_SETUP_##STEP, fn##_xcrypt, VSE_SEEK_##STEP};
+
+VSE_DEFINE_STEP(vse_step_aes, AES, AES_BLOCKLEN, "aes")
+VSE_DEFINE_STEP(vse_step_chacha20, CHACHA20, CHACHA_BLOCKLEN, "chacha20")
+VSE_DEFINE_STEP(vse_step_salsa20, SALSA20, 64, "salsa20")
+VSE_DEFINE_STEP(vse_step_gcm, GCM, AES_BLOCKLEN, "gcm")
+VSE_DEFINE_STEP(vse_step_xchacha20, XCHACHA20, CHACHA_BLOCKLEN, "xchacha20")
+
+/*
+ * Steps over lanes of whole streams. AES-NI already keeps 8 blocks of one
+ * stream in flight, so AES lanes simply take turns.
+ */
+static void vse_lanes_aes(vse_cipher_ctx_t *const *ctx, uint8_t *const *buf,
+                          const size_t *nbytes, int nlanes)
+{
+    for (int i = 0; i < nlanes; i++)
+        vse_step_aes_xcrypt(ctx[i], buf[i], nbytes[i]);
+}
+
+static void vse_lanes_chacha20(vse_cipher_ctx_t *const *ctx, uint8_t *const *buf,
+                               const size_t *nbytes, int nlanes)
+{
+    chacha_ctx_t *chacha[VSE_LANES_MAX] = {NULL};
+    for (int i = 0; i < nlanes; i++)
+        chacha[i] = &ctx[i]->chacha;
+    ctx[0]->kern->chacha20_xcrypt_lanes(chacha, buf, nbytes, nlanes);
+}
+
+static void vse_lanes_salsa20(vse_cipher_ctx_t *const *ctx, uint8_t *const *buf,
+                              const size_t *nbytes, int nlanes)
+{
+    salsa20_ctx_t *salsa20[VSE_LANES_MAX] = {NULL};
+    for (int i = 0; i < nlanes; i++)
+        salsa20[i] = &ctx[i]->salsa20;
+    ctx[0]->kern->salsa20_xcrypt_lanes(salsa20, buf, nbytes, nlanes);
+}
+
+#define VSE_LANES_AES vse_lanes_aes
+#define VSE_LANES_CHACHA20 vse_lanes_chacha20
+#define VSE_LANES_SALSA20 vse_lanes_salsa20
+#define VSE_LANES_NONE(ctx, buf, nbytes, nlanes)
+
+/*
+ * File hashes. The stream ciphers hash their ciphertext with BLAKE2b keyed
+ * with the file iv.
+ */
+static int vse_blake2b_hash_init(vse_file_hash_t *hash,
+                                 const uint8_t *iv, size_t iv_nbytes,
+                                 const uint8_t *key, size_t key_nbytes)
+{
+    (void)key;
+    (void)key_nbytes;
+    blake2b_init_key(&hash->blake2b, FILE_HASH_LEN, iv, iv_nbytes);
+    return 0;
+}
+
+static void vse_blake2b_hash_update(vse_file_hash_t *hash, const uint8_t *buf, size_t nbytes)
+{
+    blake2b_update(&hash->blake2b, buf, nbytes);
+}
+
+static void vse_blake2b_hash_final(vse_file_hash_t *hash, uint8_t *file_hash)
+{
+    blake2b_final(&hash->blake2b, file_hash, FILE_HASH_LEN);
+}
+
+/*
+ * Cipher template. Expands to the setup, bulk xcrypt and stream loops of a
+ * cipher made of STEP1 then STEP2 (NONE for single ciphers).
+ * VSE_DEFINE_CIPHER_CORE leaves out the loops that hash: AEAD ciphers bring
+ * their own, VSE_DEFINE_SEAL_STREAM for the encrypt loop.
+ * VSE_DEFINE_CIPHER_BASE leaves out seek as well, for AEGIS-256.
+ */
+#define VSE_DEFINE_CIPHER_BASE(fn, STEP1, STEP2)                                       \
+    static int fn##_setup(vse_cipher_ctx_t *ctx,                                       \
+                          const uint8_t *iv, size_t iv_nbytes,                         \
+                          const uint8_t *key, size_t key_nbytes)                       \
+    {                                                                                  \
+        if (VSE_SETUP_##STEP1(ctx, iv, iv_nbytes, key, key_nbytes) != 0)               \
+            return ERR_LIB_KDF_FAILED;                                                 \
+        return VSE_SETUP_##STEP2(ctx, iv, iv_nbytes, key, key_nbytes);                 \
+    }                                                                                  \
+                                                                                       \
+    static void fn##_xcrypt(vse_cipher_ctx_t *ctx, uint8_t *buf, size_t nbytes)        \
+    {                                                                                  \
+        while (nbytes > VSE_XCRYPT_CHUNK)                                              \
+        {                                                                              \
+            VSE_STEP_##STEP1(ctx, buf, VSE_XCRYPT_CHUNK);                              \
+            VSE_STEP_##STEP2(ctx, buf, VSE_XCRYPT_CHUNK);                              \
+            buf += VSE_XCRYPT_CHUNK;                                                   \
+            nbytes -= VSE_XCRYPT_CHUNK;                                                \
+        }                                                                              \
+        VSE_STEP_##STEP1(ctx, buf, nbytes);                                            \
+        VSE_STEP_##STEP2(ctx, buf, nbytes);                                            \
+    }                                                                                  \
+                                                                                       \
+    static int fn##_decrypt_stream(vse_cipher_ctx_t *ctx, FILE *fp_in, FILE *fp_out)   \
+    {                                                                                  \
+        uint8_t buf[VSE_STREAM_BUF_LEN];                                               \
+        size_t len;                                                                    \
+        uint64_t t = VSE_TIMING_NOW();                                                 \
+        while ((len = fread(buf, 1, VSE_STREAM_BUF_LEN, fp_in)) > 0)                   \
+        {                                                                              \
+            VSE_TIMING_LAP(VSE_PHASE_READ, t);                                         \
+            VSE_PROBE1(chunk__read, len);                                              \
+            VSE_STEP_##STEP1(ctx, buf, len);                                           \
+            VSE_STEP_##STEP2(ctx, buf, len);                                           \
+            VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);                                       \
+            if (fwrite(buf, 1, len, fp_out) != len)                                    \
+                return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;            \
+            VSE_TIMING_LAP(VSE_PHASE_WRITE, t);                                        \
+            VSE_PROBE1(chunk__write, len);                                             \
+        }                                                                              \
+        VSE_TIMING_LAP(VSE_PHASE_READ, t);                                             \
+        return feof(fp_in) ? 0 : ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;    \
+    }
+
+#define VSE_DEFINE_CIPHER_CORE(fn, STEP1, STEP2)                                       \
+    VSE_DEFINE_CIPHER_BASE(fn, STEP1, STEP2)                                           \
+                                                                                       \
+    static void fn##_seek(vse_cipher_ctx_t *ctx, uint64_t offset)                      \
+    {                                                                                  \
+        VSE_SEEK_##STEP1(ctx, offset);                                                 \
+        VSE_SEEK_##STEP2(ctx, offset);                                                 \
+    }
+
+// Encrypt loop of AEAD ciphers: fn##_seal encrypts and hashes in one call.
+#define VSE_DEFINE_SEAL_STREAM(fn)                                                     \
+    static int fn##_encrypt_stream(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash,      \
+                                   FILE *fp_in, FILE *fp_out)                          \
+    {                                                                                  \
+        uint8_t buf[VSE_STREAM_BUF_LEN];                                               \
+        size_t len;                                                                    \
+        uint64_t t = VSE_TIMING_NOW();                                                 \
+        while ((len = fread(buf, 1, VSE_STREAM_BUF_LEN, fp_in)) > 0)                   \
+        {                                                                              \
+            VSE_TIMING_LAP(VSE_PHASE_READ, t);                                         \
+            VSE_PROBE1(chunk__read, len);                                              \
+            fn##_seal(ctx, hash, buf, len);                                            \
+            VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);                                       \
+            if (fwrite(buf, 1, len, fp_out) != len)                                    \
+                return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;            \
+            VSE_TIMING_LAP(VSE_PHASE_WRITE, t);                                        \
+            VSE_PROBE1(chunk__write, len);                                             \
+        }                                                                              \
+        VSE_TIMING_LAP(VSE_PHASE_READ, t);                                             \
+        return feof(fp_in) ? 0 : ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;    \
+    }
+
+#define VSE_DEFINE_CIPHER(fn, STEP1, STEP2)                                            \
+    VSE_DEFINE_CIPHER_CORE(fn, STEP1, STEP2)                                           \
+                                                                                       \
+    static void fn##_seal(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash,               \
+                          uint8_t *buf, size_t nbytes)                                 \
+    {                                                                                  \
+        fn##_xcrypt(ctx, buf, nbytes);                                                 \
+        blake2b_update(&hash->blake2b, buf, nbytes);                                   \
+    }                                                                                  \
+                                                                                       \
+    static int fn##_encrypt_stream(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash,      \
+                                   FILE *fp_in, FILE *fp_out)                          \
+    {                                                                                  \
+        uint8_t buf[VSE_STREAM_BUF_LEN];                                               \
+        size_t len;                                                                    \
+        uint64_t t = VSE_TIMING_NOW();                                                 \
+        while ((len = fread(buf, 1, VSE_STREAM_BUF_LEN, fp_in)) > 0)                   \
+        {                                                                              \
+            VSE_TIMING_LAP(VSE_PHASE_READ, t);                                         \
+            VSE_PROBE1(chunk__read, len);                                              \
+            VSE_STEP_##STEP1(ctx, buf, len);                                           \
+            VSE_STEP_##STEP2(ctx, buf, len);                                           \
+            VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);                                       \
+            blake2b_update(&hash->blake2b, buf, len);                                  \
+            VSE_TIMING_LAP(VSE_PHASE_HASH, t);                                         \
+            if (fwrite(buf, 1, len, fp_out) != len)                                    \
+                return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;            \
+            VSE_TIMING_LAP(VSE_PHASE_WRITE, t);                                        \
+            VSE_PROBE1(chunk__write, len);                                             \
+        }                                                                              \
+        VSE_TIMING_LAP(VSE_PHASE_READ, t);                                             \
+        return feof(fp_in) ? 0 : ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;    \
+    }                                                                                  \
+                                                                                       \
+    static void fn##_lanes(vse_cipher_ctx_t *const *ctx, uint8_t *const *buf,          \
+                           const size_t *nbytes, int nlanes)                           \
+    {                                                                                  \
+        if (nlanes == 0)                                                               \
+            return;                                                                    \
+        VSE_LANES_##STEP1(ctx, buf, nbytes, nlanes);                                   \
+        VSE_LANES_##STEP2(ctx, buf, nbytes, nlanes);                                   \
+    }
+
+#define VSE_CIPHER_ENTRY(id, name, alias, description, fn, nsteps, ...)                \
+    {                                                                                  \
+        id, name, alias, description, nsteps, {__VA_ARGS__},                           \
+            fn##_setup, fn##_xcrypt, fn##_seek, fn##_seal, fn##_encrypt_stream,        \
+            fn##_decrypt_stream, fn##_lanes, 0, vse_blake2b_hash_init,                 \
+            vse_blake2b_hash_update, vse_blake2b_hash_final                            \
+    }
+
+// AEAD ciphers: their own hash and encrypt loop, no lanes.
+#define VSE_AEAD_ENTRY(id, name, alias, description, fn, seek, nsteps, ...)            \
+    {                                                                                  \
+        id, name, alias, description, nsteps, {__VA_ARGS__},                           \
+            fn##_setup, fn##_xcrypt, seek, fn##_seal, fn##_encrypt_stream,             \
+            fn##_decrypt_stream, NULL, 1, fn##_hash_init,                              \
+            fn##_hash_update, fn##_hash_final                                          \
+    }
+
+VSE_DEFINE_CIPHER(vse_chacha20, CHACHA20, NONE)
+VSE_DEFINE_CIPHER(vse_salsa20, SALSA20, NONE)
+VSE_DEFINE_CIPHER(vse_aes256, AES, NONE)
+VSE_DEFINE_CIPHER(vse_aes256_chacha20, AES, CHACHA20)
+VSE_DEFINE_CIPHER(vse_aes256_salsa20, AES, SALSA20)
+VSE_DEFINE_CIPHER(vse_chacha20_aes256, CHACHA20, AES)
+VSE_DEFINE_CIPHER(vse_salsa20_aes256, SALSA20, AES)
+VSE_DEFINE_CIPHER_CORE(vse_aes256gcm, GCM, NONE)
+
+/*
+ * aes256gcm: the file hash is the GCM tag of the ciphertext, zero-padded to
+ * FILE_HASH_LEN. With AES-NI and PCLMUL, encryption and tag are one pass.
+ */
+static int vse_aes256gcm_hash_init(vse_file_hash_t *hash,
+                                   const uint8_t *iv, size_t iv_nbytes,
+                                   const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t nonce[VSE_GCM_NONCE_LEN];
+    (void)key_nbytes;
+    if (vse_gcm_nonce(iv, iv_nbytes, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    vse_gcm_init(&hash->gcm, NULL, key, nonce, NULL, 0);
+    return 0;
+}
+
+static void vse_aes256gcm_hash_update(vse_file_hash_t *hash, const uint8_t *buf, size_t nbytes)
+{
+    vse_gcm_update(&hash->gcm, buf, nbytes);
+}
+
+static void vse_aes256gcm_hash_final(vse_file_hash_t *hash, uint8_t *file_hash)
+{
+    memset(file_hash, 0, FILE_HASH_LEN);
+    vse_gcm_final(&hash->gcm, file_hash);
+}
+
+static void vse_aes256gcm_seal(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash,
+                               uint8_t *buf, size_t nbytes)
+{
+    vse_gcm_encrypt(&hash->gcm, &ctx->aes, buf, nbytes);
+}
+
+VSE_DEFINE_SEAL_STREAM(vse_aes256gcm)
+
+VSE_DEFINE_CIPHER_BASE(vse_aegis256, AEGIS256, NONE)
+
+/*
+ * aegis256: the file hash is the AEGIS-256 tag. xcrypt decrypts: only seal
+ * encrypts, and the tag of a ciphertext needs its plaintext, so hash_update
+ * decrypts a copy with a state of its own.
+ */
+static int vse_aegis256_hash_init(vse_file_hash_t *hash,
+                                  const uint8_t *iv, size_t iv_nbytes,
+                                  const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t nonce[VSE_AEGIS256_NONCE_LEN];
+    (void)key_nbytes;
+    if (vse_aegis256_nonce(iv, iv_nbytes, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    vse_aegis256_init(&hash->aegis, key, nonce, NULL, 0);
+    return 0;
+}
+
+static void vse_aegis256_hash_update(vse_file_hash_t *hash, const uint8_t *buf, size_t nbytes)
+{
+    uint8_t tmp[VSE_STREAM_BUF_LEN];
+    while (nbytes > 0)
+    {
+        size_t len = nbytes < VSE_STREAM_BUF_LEN ? nbytes : VSE_STREAM_BUF_LEN;
+        memcpy(tmp, buf, len);
+        vse_aegis256_decrypt(&hash->aegis, tmp, len);
+        buf += len;
+        nbytes -= len;
+    }
+    memset(tmp, 0, sizeof(tmp));
+}
+
+static void vse_aegis256_hash_final(vse_file_hash_t *hash, uint8_t *file_hash)
+{
+    vse_aegis256_final(&hash->aegis, file_hash);
+}
+
+static void vse_aegis256_seal(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash,
+                              uint8_t *buf, size_t nbytes)
+{
+    (void)ctx;
+    vse_aegis256_encrypt(&hash->aegis, buf, nbytes);
+}
+
+VSE_DEFINE_SEAL_STREAM(vse_aegis256)
+
+VSE_DEFINE_CIPHER_CORE(vse_xchacha20poly1305, XCHACHA20, NONE)
+
+/*
+ * xchacha20poly1305: the file hash is the Poly1305 tag of the ciphertext,
+ * zero-padded to FILE_HASH_LEN, computed as the ciphertext is produced.
+ */
+static int vse_xchacha20poly1305_hash_init(vse_file_hash_t *hash,
+                                           const uint8_t *iv, size_t iv_nbytes,
+                                           const uint8_t *key, size_t key_nbytes)
+{
+    uint8_t nonce[VSE_XCHACHA20_NONCE_LEN];
+    (void)key_nbytes;
+    if (vse_xchacha20_nonce(iv, iv_nbytes, nonce) != 0)
+        return ERR_LIB_KDF_FAILED;
+    vse_xchacha20poly1305_init(&hash->xchacha, key, nonce, NULL, 0);
+    return 0;
+}
+
+static void vse_xchacha20poly1305_hash_update(vse_file_hash_t *hash, const uint8_t *buf, size_t nbytes)
+{
+    vse_xchacha20poly1305_update(&hash->xchacha, buf, nbytes);
+}
+
+static void vse_xchacha20poly1305_hash_final(vse_file_hash_t *hash, uint8_t *file_hash)
+{
+    memset(file_hash, 0, FILE_HASH_LEN);
+    vse_xchacha20poly1305_final(&hash->xchacha, file_hash);
+}
+
+static void vse_xchacha20poly1305_seal(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash,
+                                       uint8_t *buf, size_t nbytes)
+{
+    vse_xchacha20poly1305_encrypt(&hash->xchacha, &ctx->chacha, buf, nbytes);
+}
+
+VSE_DEFINE_SEAL_STREAM(vse_xchacha20poly1305)
+
+// In the order shown by the usage.
+static const vse_cipher_t g_ciphers[] = {
+    VSE_CIPHER_ENTRY(CIPHER_CHACHA20, "chacha20", "chacha",
+                     "256bit, faster than AES 256.",
+                     vse_chacha20, 1, &vse_step_chacha20),
+    VSE_CIPHER_ENTRY(CIPHER_SALSA20, "salsa20", NULL,
+                     "256bit, faster than AES 256.",
+                     vse_salsa20, 1, &vse_step_salsa20),
+    VSE_CIPHER_ENTRY(CIPHER_AES_256_CTR, "aes256", "aes",
+                     "AES 256bit in CTR mode.",
+                     vse_aes256, 1, &vse_step_aes),
+    VSE_CIPHER_ENTRY(CIPHER_AES_256_CTR_CHACHA20, "aes256_chacha20", NULL,
+                     "aes256 then chacha20 (default cipher).",
+                     vse_aes256_chacha20, 2, &vse_step_aes, &vse_step_chacha20),
+    VSE_CIPHER_ENTRY(CIPHER_AES_256_CTR_SALSA20, "aes256_salsa20", NULL,
+                     "aes256 then salsa20.",
+                     vse_aes256_salsa20, 2, &vse_step_aes, &vse_step_salsa20),
+    VSE_CIPHER_ENTRY(CIPHER_CHACHA20_AES_256_CTR, "chacha20_aes256", NULL,
+                     "chacha20 then aes256.",
+                     vse_chacha20_aes256, 2, &vse_step_chacha20, &vse_step_aes),
+    VSE_CIPHER_ENTRY(CIPHER_SALSA20_AES_256_CTR, "salsa20_aes256", NULL,
+                     "salsa20 then aes256.",
+                     vse_salsa20_aes256, 2, &vse_step_salsa20, &vse_step_aes),
+    VSE_AEAD_ENTRY(CIPHER_AES_256_GCM, "aes256gcm", "gcm",
+                   "AES 256bit GCM, one pass with AES-NI and PCLMUL.",
+                   vse_aes256gcm, vse_aes256gcm_seek, 1, &vse_step_gcm),
+    VSE_AEAD_ENTRY(CIPHER_AEGIS_256, "aegis256", "aegis",
+                   "AEGIS-256, one pass on AES rounds, faster than aes256gcm.",
+                   vse_aegis256, NULL, 0, NULL),
+    VSE_AEAD_ENTRY(CIPHER_XCHACHA20_POLY1305, "xchacha20poly1305", "xchacha",
+                   "XChaCha20-Poly1305, one pass, the fastest without AES-NI.",
+                   vse_xchacha20poly1305, vse_xchacha20poly1305_seek, 1, &vse_step_xchacha20),
+};
+
+#define VSE_CIPHER_COUNT (sizeof(g_ciphers) / sizeof(g_ciphers[0]))
+
+const vse_cipher_t *vse_cipher_find(int id)
+{
+    for (size_t i = 0; i < VSE_CIPHER_COUNT; i++)
+    {
+        if (g_ciphers[i].id == id)
+            return &g_ciphers[i];
+    }
+    return NULL;
+}
+
+const vse_cipher_t *vse_cipher_find_by_name(const char *name)
+{
+    for (size_t i = 0; i < VSE_CIPHER_COUNT; i++)
+    {
+        if (strcmp(g_ciphers[i].name, name) == 0 ||
+            (g_ciphers[i].alias != NULL && strcmp(g_ciphers[i].alias, name) == 0))
+            return &g_ciphers[i];
+    }
+    return NULL;
+}
+
+const vse_cipher_t *vse_cipher_at(size_t i)
+{
+    return i < VSE_CIPHER_COUNT ? &g_ciphers[i] : NULL;
+}
@@ -0,0 +1,176 @@
+#ifndef CIPHER_0B7E4C92_3A1D_4F58_96E2_D85A1C7F0B34_H
+#define CIPHER_0B7E4C92_3A1D_4F58_96E2_D85A1C7F0B34_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "vse.h"
+#include "aes/aes.h"
+#include "chacha/chacha.h"
+#include "salsa20/salsa20.h"
+#include "argon2/src/blake2/blake2.h"
+#include "cpu_features.h"
+#include "lanes.h"
+#include "gcm.h"
+#include "aegis256.h"
+#include "xchacha20poly1305.h"
+
+/*
+ * Cipher registry.
+ *
+ * Every CIPHER_* id maps to a vse_cipher_t descriptor. A cipher is one or
+ * more steps (aes, chacha20, salsa20) applied in order; each cipher gets its
+ * own xcrypt and stream loops, generated at compile time, so the per-block
+ * work is straight-line calls with no dispatch.
+ *
+ * To add a cipher: add its CIPHER_* id to vse.h and one VSE_DEFINE_CIPHER()
+ * plus one table entry to cipher.c.
+ *
+ * The file hash the MAC covers is the cipher's too: BLAKE2b keyed with the
+ * iv for the stream ciphers, the tag of the mode for AEAD ones (aead set),
+ * which compute it in the same pass as the keystream.
+ *
+ * aegis256 has no steps (nsteps 0) and no keystream: xcrypt decrypts, any
+ * length per call, seek is NULL and only seal encrypts.
+ */
+
+#define VSE_CIPHER_MAX_STEPS 2
+
+// Size of the buffer used by the stream loops. Multiple of every block size.
+#define VSE_STREAM_BUF_LEN 4096
+
+/*
+ * State of every primitive. A cipher only sets up, and touches, the ones
+ * its steps use.
+ */
+typedef struct vse_cipher_ctx
+{
+    const vse_dispatch_t *kern; // kernels for this CPU, see cpu_features.h
+    aes_ctx_t aes;
+    chacha_ctx_t chacha;
+    salsa20_ctx_t salsa20;
+    vse_aegis256_t aegis;
+} vse_cipher_ctx_t;
+
+/*
+ * State of the file hash, see vse_cipher_t.hash_init.
+ */
+typedef union vse_file_hash
+{
+    blake2b_state blake2b;
+    vse_gcm_t gcm;
+    vse_aegis256_t aegis;
+    vse_xchacha20poly1305_t xchacha;
+} vse_file_hash_t;
+
+typedef int (*vse_cipher_setup_fn)(vse_cipher_ctx_t *ctx,
+                                   const uint8_t *iv, size_t iv_nbytes,
+                                   const uint8_t *key, size_t key_nbytes);
+
+typedef void (*vse_cipher_xcrypt_fn)(vse_cipher_ctx_t *ctx, uint8_t *buf, size_t nbytes);
+
+typedef void (*vse_cipher_seek_fn)(vse_cipher_ctx_t *ctx, uint64_t offset);
+
+typedef void (*vse_cipher_xcrypt_lanes_fn)(vse_cipher_ctx_t *const *ctx, uint8_t *const *buf,
+                                           const size_t *nbytes, int nlanes);
+
+typedef struct vse_cipher_step
+{
+    const char *name;
+    size_t block_len; // keystream granularity in bytes
+    vse_cipher_setup_fn setup;
+    vse_cipher_xcrypt_fn xcrypt;
+    vse_cipher_seek_fn seek;
+} vse_cipher_step_t;
+
+typedef struct vse_cipher
+{
+    int id;
+    const char *name;
+    const char *alias;       // accepted by -c as well, may be NULL
+    const char *description; // one line for the usage
+    int nsteps;
+    const vse_cipher_step_t *steps[VSE_CIPHER_MAX_STEPS];
+
+    /**
+     * Set up the steps of this cipher only.
+     *
+     * @return 0 or ERR_LIB_KDF_FAILED if a step IV could not be derived.
+     */
+    vse_cipher_setup_fn setup;
+
+    /**
+     * En/decrypt buf in place. Every call but the last of a stream must be
+     * a multiple of 64 bytes.
+     */
+    vse_cipher_xcrypt_fn xcrypt;
+
+    /**
+     * Move the keystream of a ctx fresh from setup to byte offset of the
+     * stream, a multiple of 64: every step is a counter mode.
+     */
+    vse_cipher_seek_fn seek;
+
+    /**
+     * xcrypt() buf and add the result to the file hash hash: in one pass
+     * for AEAD ciphers.
+     */
+    void (*seal)(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash, uint8_t *buf, size_t nbytes);
+
+    /**
+     * Encrypt fp_in to fp_out, hashing the ciphertext into hash.
+     *
+     * @return 0 or ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_{READ_INFILE,WRITE_OUTFILE}.
+     */
+    int (*encrypt_stream)(vse_cipher_ctx_t *ctx, vse_file_hash_t *hash, FILE *fp_in, FILE *fp_out);
+
+    /**
+     * Decrypt fp_in to fp_out.
+     */
+    int (*decrypt_stream)(vse_cipher_ctx_t *ctx, FILE *fp_in, FILE *fp_out);
+
+    /**
+     * xcrypt() whole streams buf[i] with ctx[i], for up to VSE_LANES_MAX
+     * lanes: ChaCha20 and Salsa20 steps run side by side in SIMD lanes (see
+     * lanes.h), AES steps one stream after the other.
+     */
+    vse_cipher_xcrypt_lanes_fn xcrypt_lanes;
+
+    int aead; // the file hash is the tag of the mode: no lanes, no checkpoints
+
+    /**
+     * Start the file hash of a stream set up with the same iv and key.
+     *
+     * @return 0 or ERR_LIB_KDF_FAILED if the nonce could not be derived.
+     */
+    int (*hash_init)(vse_file_hash_t *hash,
+                     const uint8_t *iv, size_t iv_nbytes,
+                     const uint8_t *key, size_t key_nbytes);
+
+    /**
+     * Add ciphertext to the file hash, in any number of calls.
+     */
+    void (*hash_update)(vse_file_hash_t *hash, const uint8_t *buf, size_t nbytes);
+
+    /**
+     * Finish the file hash into file_hash, FILE_HASH_LEN bytes.
+     */
+    void (*hash_final)(vse_file_hash_t *hash, uint8_t *file_hash);
+} vse_cipher_t;
+
+/**
+ * @return the descriptor for a CIPHER_* id, or NULL if unknown.
+ */
+const vse_cipher_t *vse_cipher_find(int id);
+
+/**
+ * @return the descriptor whose name or alias is name, or NULL if unknown.
+ */
+const vse_cipher_t *vse_cipher_find_by_name(const char *name);
+
+/**
+ * @return the i-th registered cipher, or NULL past the end.
+ */
+const vse_cipher_t *vse_cipher_at(size_t i);
+
+#endif
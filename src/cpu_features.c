@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu_features.h"
+#include "aes_ni.h"
+#include "gcm.h"
+#include "aegis256.h"
+#include "xchacha20poly1305.h"
+#include "lanes.h"
+
+#if _MSC_VER
+#include <Windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#if VSE_X86
+#include <cpuid.h>
+#endif
+#endif
+
+static const char *g_feature_names[VSE_CPU_FEATURE_COUNT] = {
+    "sse2", "ssse3", "sse4.1", "avx", "avx2", "avx512f", "aesni", "vaes", "pclmul", "sha"};
+
+static const char *g_tier_names[VSE_CPU_TIER_COUNT] = {
+    "generic", "sse2", "ssse3", "avx2", "avx512"};
+
+static const char *g_primitive_names[VSE_PRIM_COUNT] = {
+    "aes256", "chacha20", "salsa20", "blake2b", "poly1305", "argon2",
+    "chacha20x8", "salsa20x8", "blake2bx4", "ghash", "aes256gcm", "aegis256"};
+
+// Features a tier is defined by.
+static const uint32_t g_tier_requires[VSE_CPU_TIER_COUNT] = {
+    0,
+    VSE_CPU_SSE2,
+    VSE_CPU_SSE2 | VSE_CPU_SSSE3 | VSE_CPU_SSE41,
+    VSE_CPU_SSE2 | VSE_CPU_SSSE3 | VSE_CPU_SSE41 | VSE_CPU_AVX | VSE_CPU_AVX2,
+    VSE_CPU_SSE2 | VSE_CPU_SSSE3 | VSE_CPU_SSE41 | VSE_CPU_AVX | VSE_CPU_AVX2 | VSE_CPU_AVX512F,
+};
+
+// Features left on when VSE_CPU_TIER caps at a tier.
+static const uint32_t g_tier_allows[VSE_CPU_TIER_COUNT] = {
+    0,
+    VSE_CPU_SSE2,
+    VSE_CPU_SSE2 | VSE_CPU_SSSE3 | VSE_CPU_SSE41 | VSE_CPU_AESNI | VSE_CPU_PCLMUL | VSE_CPU_SHA,
+    VSE_CPU_SSE2 | VSE_CPU_SSSE3 | VSE_CPU_SSE41 | VSE_CPU_AESNI | VSE_CPU_PCLMUL | VSE_CPU_SHA |
+        VSE_CPU_AVX | VSE_CPU_AVX2 | VSE_CPU_VAES,
+    0xffffffffu,
+};
+
+static uint32_t g_detected;
+static uint32_t g_features;
+static vse_dispatch_t g_dispatch;
+
+#if VSE_X86
+
+static void vse_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if _MSC_VER
+    __cpuidex((int *)regs, (int)leaf, (int)subleaf);
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+        memset(regs, 0, 4 * sizeof(uint32_t));
+#endif
+}
+
+static uint64_t vse_xgetbv(void)
+{
+#if _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t vse_cpu_detect(void)
+{
+    uint32_t f = 0;
+    uint32_t r[4];
+
+    vse_cpuid(0, 0, r);
+    uint32_t max_leaf = r[0];
+    if (max_leaf < 1)
+        return 0;
+
+    vse_cpuid(1, 0, r);
+    uint32_t ecx1 = r[2];
+    uint32_t edx1 = r[3];
+    if (edx1 & (1u << 26))
+        f |= VSE_CPU_SSE2;
+    if (ecx1 & (1u << 9))
+        f |= VSE_CPU_SSSE3;
+    if (ecx1 & (1u << 19))
+        f |= VSE_CPU_SSE41;
+    if (ecx1 & (1u << 25))
+        f |= VSE_CPU_AESNI;
+    if (ecx1 & (1u << 1))
+        f |= VSE_CPU_PCLMUL;
+
+    // AVX state must also be enabled by the OS (OSXSAVE + XCR0).
+    uint64_t xcr0 = (ecx1 & (1u << 27)) ? vse_xgetbv() : 0;
+    int os_avx = (xcr0 & 0x6) == 0x6;
+    int os_avx512 = os_avx && (xcr0 & 0xe0) == 0xe0;
+    if (os_avx && (ecx1 & (1u << 28)))
+        f |= VSE_CPU_AVX;
+
+    if (max_leaf >= 7)
+    {
+        vse_cpuid(7, 0, r);
+        if ((f & VSE_CPU_AVX) && (r[1] & (1u << 5)))
+            f |= VSE_CPU_AVX2;
+        if (os_avx512 && (r[1] & (1u << 16)))
+            f |= VSE_CPU_AVX512F;
+        if (r[1] & (1u << 29))
+            f |= VSE_CPU_SHA;
+        if ((f & VSE_CPU_AVX) && (r[2] & (1u << 9)))
+            f |= VSE_CPU_VAES;
+    }
+
+    return f;
+}
+
+#else
+
+static uint32_t vse_cpu_detect(void)
+{
+    return 0;
+}
+
+#endif
+
+static uint32_t vse_cpu_tier_mask(void)
+{
+    const char *tier = getenv("VSE_CPU_TIER");
+    if (tier == NULL)
+        return 0xffffffffu;
+
+    for (int i = 0; i < VSE_CPU_TIER_COUNT; i++)
+    {
+        if (strcmp(tier, g_tier_names[i]) == 0)
+            return g_tier_allows[i];
+    }
+    fprintf(stderr, "Warning: Ignoring unknown VSE_CPU_TIER %s\n", tier);
+    return 0xffffffffu;
+}
+
+static void vse_cpu_init(void)
+{
+    g_detected = vse_cpu_detect();
+    g_features = g_detected & vse_cpu_tier_mask();
+
+    g_dispatch.aes_ctr_xcrypt = AES_CTR_xcrypt_buffer;
+    g_dispatch.impl[VSE_PRIM_AES] = "portable";
+#if VSE_X86
+    if (g_features & VSE_CPU_AESNI)
+    {
+        g_dispatch.aes_ctr_xcrypt = vse_aes_ctr_xcrypt_aesni;
+        g_dispatch.impl[VSE_PRIM_AES] = "aesni";
+    }
+#endif
+
+    g_dispatch.chacha20_xcrypt = chacha_xcrypt_bytes;
+    g_dispatch.impl[VSE_PRIM_CHACHA20] = "portable";
+#if VSE_X86
+    if (g_features & VSE_CPU_AVX2)
+    {
+        g_dispatch.chacha20_xcrypt = vse_chacha20_xcrypt_avx2;
+        g_dispatch.impl[VSE_PRIM_CHACHA20] = "avx2";
+    }
+#endif
+
+    g_dispatch.salsa20_xcrypt = salsa20_xcrypt_bytes;
+    g_dispatch.impl[VSE_PRIM_SALSA20] = "portable";
+
+    g_dispatch.chacha20_xcrypt_lanes = vse_chacha20_xcrypt_lanes;
+    g_dispatch.salsa20_xcrypt_lanes = vse_salsa20_xcrypt_lanes;
+    g_dispatch.blake2b_lanes = vse_blake2b_lanes;
+    g_dispatch.impl[VSE_PRIM_CHACHA20_LANES] = "portable";
+    g_dispatch.impl[VSE_PRIM_SALSA20_LANES] = "portable";
+    g_dispatch.impl[VSE_PRIM_BLAKE2B_LANES] = "portable";
+#if VSE_X86
+    if (g_features & VSE_CPU_AVX2)
+    {
+        g_dispatch.chacha20_xcrypt_lanes = vse_chacha20_xcrypt_lanes_avx2;
+        g_dispatch.salsa20_xcrypt_lanes = vse_salsa20_xcrypt_lanes_avx2;
+        g_dispatch.blake2b_lanes = vse_blake2b_lanes_avx2;
+        g_dispatch.impl[VSE_PRIM_CHACHA20_LANES] = "avx2";
+        g_dispatch.impl[VSE_PRIM_SALSA20_LANES] = "avx2";
+        g_dispatch.impl[VSE_PRIM_BLAKE2B_LANES] = "avx2";
+    }
+#endif
+
+    g_dispatch.ghash_blocks = vse_ghash_blocks;
+    g_dispatch.gcm_encrypt_blocks = vse_gcm_encrypt_blocks;
+    g_dispatch.impl[VSE_PRIM_GHASH] = "table4";
+    g_dispatch.impl[VSE_PRIM_AES_GCM] = "ctr+ghash";
+#if VSE_X86
+    if ((g_features & VSE_CPU_SSSE3) && (g_features & VSE_CPU_PCLMUL))
+    {
+        g_dispatch.ghash_blocks = vse_ghash_blocks_clmul;
+        g_dispatch.impl[VSE_PRIM_GHASH] = "clmul";
+        if (g_features & VSE_CPU_AESNI)
+        {
+            g_dispatch.gcm_encrypt_blocks = vse_gcm_encrypt_blocks_aesni;
+            g_dispatch.impl[VSE_PRIM_AES_GCM] = "aesni+clmul";
+        }
+    }
+#endif
+
+    g_dispatch.aegis256_encrypt_blocks = vse_aegis256_encrypt_blocks;
+    g_dispatch.aegis256_decrypt_blocks = vse_aegis256_decrypt_blocks;
+    g_dispatch.impl[VSE_PRIM_AEGIS256] = "portable";
+#if VSE_X86
+    if (g_features & VSE_CPU_AESNI)
+    {
+        g_dispatch.aegis256_encrypt_blocks = vse_aegis256_encrypt_blocks_aesni;
+        g_dispatch.aegis256_decrypt_blocks = vse_aegis256_decrypt_blocks_aesni;
+        g_dispatch.impl[VSE_PRIM_AEGIS256] = "aesni";
+    }
+#endif
+
+    g_dispatch.poly1305_blocks = vse_poly1305_blocks;
+    g_dispatch.impl[VSE_PRIM_POLY1305] = "donna";
+#if VSE_X86
+    if (g_features & VSE_CPU_AVX2)
+    {
+        g_dispatch.poly1305_blocks = vse_poly1305_blocks_avx2;
+        g_dispatch.impl[VSE_PRIM_POLY1305] = "avx2";
+    }
+#endif
+
+    // Not dispatched yet: always the bundled C code.
+    g_dispatch.impl[VSE_PRIM_BLAKE2B] = "portable";
+    g_dispatch.impl[VSE_PRIM_ARGON2] = "ref";
+}
+
+#if _MSC_VER
+static INIT_ONCE g_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK vse_cpu_init_once(PINIT_ONCE once, PVOID param, PVOID *ctx)
+{
+    (void)once;
+    (void)param;
+    (void)ctx;
+    vse_cpu_init();
+    return TRUE;
+}
+
+static void vse_cpu_ensure_init(void)
+{
+    InitOnceExecuteOnce(&g_once, vse_cpu_init_once, NULL, NULL);
+}
+#else
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static void vse_cpu_ensure_init(void)
+{
+    pthread_once(&g_once, vse_cpu_init);
+}
+#endif
+
+uint32_t vse_cpu_features(void)
+{
+    vse_cpu_ensure_init();
+    return g_features;
+}
+
+uint32_t vse_cpu_features_detected(void)
+{
+    vse_cpu_ensure_init();
+    return g_detected;
+}
+
+vse_cpu_tier_t vse_cpu_tier(void)
+{
+    uint32_t f = vse_cpu_features();
+    int tier = VSE_CPU_TIER_GENERIC;
+    for (int i = 0; i < VSE_CPU_TIER_COUNT; i++)
+    {
+        if ((f & g_tier_requires[i]) == g_tier_requires[i])
+            tier = i;
+    }
+    return (vse_cpu_tier_t)tier;
+}
+
+const char *vse_cpu_tier_name(vse_cpu_tier_t tier)
+{
+    return tier >= 0 && tier < VSE_CPU_TIER_COUNT ? g_tier_names[tier] : "unknown";
+}
+
+const char *vse_cpu_feature_name(int i)
+{
+    return i >= 0 && i < VSE_CPU_FEATURE_COUNT ? g_feature_names[i] : NULL;
+}
+
+const char *vse_primitive_name(vse_primitive_t prim)
+{
+    return prim >= 0 && prim < VSE_PRIM_COUNT ? g_primitive_names[prim] : "unknown";
+}
+
+const vse_dispatch_t *vse_cpu_dispatch(void)
+{
+    vse_cpu_ensure_init();
+    return &g_dispatch;
+}
@@ -0,0 +1,139 @@
+#ifndef CPU_FEATURES_6E1A3D58_C2B7_4A90_8F14_93D7E0B2A5C6_H
+#define CPU_FEATURES_6E1A3D58_C2B7_4A90_8F14_93D7E0B2A5C6_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "aes/aes.h"
+#include "chacha/chacha.h"
+#include "salsa20/salsa20.h"
+
+struct vse_gcm;
+struct vse_aegis256;
+struct vse_poly1305;
+
+/*
+ * Runtime CPU feature detection and kernel dispatch.
+ *
+ * Features are detected once, on first use. Setting VSE_CPU_TIER in the
+ * environment caps them at a lower tier, so the portable code paths can be
+ * tested on any machine:
+ *
+ *     VSE_CPU_TIER=generic|sse2|ssse3|avx2|avx512
+ *
+ * Every primitive with more than one implementation goes through the
+ * dispatch table returned by vse_cpu_dispatch(); fast kernels register
+ * themselves there with the features they need.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VSE_X86 1
+#endif
+
+// Lets a function use instructions the rest of the file is not built for.
+#if defined(__GNUC__) || defined(__clang__)
+#define VSE_TARGET(features) __attribute__((target(features)))
+#else
+#define VSE_TARGET(features)
+#endif
+
+#define VSE_CPU_SSE2 (1u << 0)
+#define VSE_CPU_SSSE3 (1u << 1)
+#define VSE_CPU_SSE41 (1u << 2)
+#define VSE_CPU_AVX (1u << 3)
+#define VSE_CPU_AVX2 (1u << 4)
+#define VSE_CPU_AVX512F (1u << 5)
+#define VSE_CPU_AESNI (1u << 6)
+#define VSE_CPU_VAES (1u << 7)
+#define VSE_CPU_PCLMUL (1u << 8)
+#define VSE_CPU_SHA (1u << 9)
+#define VSE_CPU_FEATURE_COUNT 10
+
+typedef enum vse_cpu_tier
+{
+    VSE_CPU_TIER_GENERIC,
+    VSE_CPU_TIER_SSE2,
+    VSE_CPU_TIER_SSSE3, // + SSE4.1, AES-NI, PCLMUL, SHA
+    VSE_CPU_TIER_AVX2,  // + AVX, VAES
+    VSE_CPU_TIER_AVX512,
+    VSE_CPU_TIER_COUNT
+} vse_cpu_tier_t;
+
+/*
+ * Primitives listed by --cpu-info.
+ */
+typedef enum vse_primitive
+{
+    VSE_PRIM_AES,
+    VSE_PRIM_CHACHA20,
+    VSE_PRIM_SALSA20,
+    VSE_PRIM_BLAKE2B,
+    VSE_PRIM_POLY1305,
+    VSE_PRIM_ARGON2,
+    VSE_PRIM_CHACHA20_LANES, // multi-buffer, see lanes.h
+    VSE_PRIM_SALSA20_LANES,
+    VSE_PRIM_BLAKE2B_LANES,
+    VSE_PRIM_GHASH, // see gcm.h
+    VSE_PRIM_AES_GCM,
+    VSE_PRIM_AEGIS256, // see aegis256.h
+    VSE_PRIM_COUNT
+} vse_primitive_t;
+
+typedef struct vse_dispatch
+{
+    void (*aes_ctr_xcrypt)(aes_ctx_t *ctx, uint8_t *buf, size_t nbytes);
+    void (*chacha20_xcrypt)(chacha_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes);
+    void (*salsa20_xcrypt)(salsa20_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes);
+
+    // Up to VSE_LANES_MAX independent streams per call, see lanes.h.
+    void (*chacha20_xcrypt_lanes)(chacha_ctx_t *const *ctx, uint8_t *const *buf,
+                                  const size_t *nbytes, int nlanes);
+    void (*salsa20_xcrypt_lanes)(salsa20_ctx_t *const *ctx, uint8_t *const *buf,
+                                 const size_t *nbytes, int nlanes);
+    void (*blake2b_lanes)(uint8_t *const *out, size_t outlen,
+                          const uint8_t *const *key, size_t keylen,
+                          const uint8_t *const *in, const size_t *nbytes, int nlanes);
+
+    // Whole 16-byte blocks, see gcm.h.
+    void (*ghash_blocks)(struct vse_gcm *gcm, const uint8_t *in, size_t nblocks);
+    void (*gcm_encrypt_blocks)(struct vse_gcm *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nblocks);
+
+    // Whole 16-byte blocks, see aegis256.h.
+    void (*aegis256_encrypt_blocks)(struct vse_aegis256 *st, uint8_t *buf, size_t nblocks);
+    void (*aegis256_decrypt_blocks)(struct vse_aegis256 *st, uint8_t *buf, size_t nblocks);
+
+    // Whole 16-byte blocks, see xchacha20poly1305.h.
+    void (*poly1305_blocks)(struct vse_poly1305 *st, const uint8_t *in, size_t nblocks);
+
+    const char *impl[VSE_PRIM_COUNT]; // name of the implementation in use
+} vse_dispatch_t;
+
+/**
+ * @return VSE_CPU_* bits usable on this machine, after VSE_CPU_TIER.
+ */
+uint32_t vse_cpu_features(void);
+
+/**
+ * @return VSE_CPU_* bits the CPU and OS support, ignoring VSE_CPU_TIER.
+ */
+uint32_t vse_cpu_features_detected(void);
+
+/**
+ * @return the highest tier whose base features vse_cpu_features() has.
+ */
+vse_cpu_tier_t vse_cpu_tier(void);
+
+const char *vse_cpu_tier_name(vse_cpu_tier_t tier);
+
+/**
+ * @return the name of the i-th VSE_CPU_* bit, e.g. "aesni".
+ */
+const char *vse_cpu_feature_name(int i);
+
+const char *vse_primitive_name(vse_primitive_t prim);
+
+/**
+ * @return the kernels picked for this machine. Never NULL.
+ */
+const vse_dispatch_t *vse_cpu_dispatch(void);
+
+#endif
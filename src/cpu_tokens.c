@@ -0,0 +1,112 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vse.h"
+#include "cpu_tokens.h"
+#include "cgroup.h"
+#include "sync.h"
+#if _MSC_VER
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static struct
+{
+    int enabled;
+    vse_mutex_t lock; // guards available
+    vse_cond_t returned;
+    int available;
+} g_tokens;
+
+static VSE_THREAD_LOCAL int t_depth; // vse_cpu_enter() calls on this thread
+
+static void vse_cpu_max(const char *line, void *arg)
+{
+    int *min = arg;
+    char quota[32];
+    unsigned long long period = 0;
+    if (sscanf(line, "%31s %llu", quota, &period) != 2 || strcmp(quota, "max") == 0 || period == 0)
+        return;
+    int cpus = (int)((strtoull(quota, NULL, 10) + period - 1) / period);
+    if (cpus > 0 && (*min == 0 || cpus < *min))
+        *min = cpus;
+}
+
+int vse_cpu_budget(void)
+{
+    int cpus;
+#if _MSC_VER
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    cpus = (int)info.dwNumberOfProcessors;
+#elif defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        cpus = CPU_COUNT(&set);
+    else
+        cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    int quota = 0;
+    vse_cgroup_for_each("cpu.max", vse_cpu_max, &quota);
+    if (quota != 0 && quota < cpus)
+        cpus = quota;
+    return cpus > 0 ? cpus : 1;
+}
+
+void vse_cpu_tokens_init(int ntokens)
+{
+    vse_mutex_init(&g_tokens.lock);
+    vse_cond_init(&g_tokens.returned);
+    g_tokens.available = ntokens > 0 ? ntokens : 1;
+    g_tokens.enabled = 1;
+}
+
+void vse_cpu_enter(void)
+{
+    if (!g_tokens.enabled || t_depth++ != 0)
+        return;
+
+    vse_mutex_lock(&g_tokens.lock);
+    while (g_tokens.available == 0)
+        vse_cond_wait(&g_tokens.returned, &g_tokens.lock);
+    g_tokens.available--;
+    vse_mutex_unlock(&g_tokens.lock);
+}
+
+void vse_cpu_leave(void)
+{
+    if (!g_tokens.enabled || --t_depth != 0)
+        return;
+    vse_cpu_return(1);
+}
+
+int vse_cpu_borrow(int max)
+{
+    if (!g_tokens.enabled)
+        return max;
+
+    vse_mutex_lock(&g_tokens.lock);
+    int n = g_tokens.available < max ? g_tokens.available : max;
+    g_tokens.available -= n;
+    vse_mutex_unlock(&g_tokens.lock);
+    return n;
+}
+
+void vse_cpu_return(int ntokens)
+{
+    if (!g_tokens.enabled || ntokens == 0)
+        return;
+
+    vse_mutex_lock(&g_tokens.lock);
+    g_tokens.available += ntokens;
+    vse_cond_broadcast(&g_tokens.returned);
+    vse_mutex_unlock(&g_tokens.lock);
+}
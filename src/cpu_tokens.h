@@ -0,0 +1,54 @@
+#ifndef CPU_TOKENS_4D9B2E17_6A3C_4F80_B5E1_92C7A0D8F346_H
+#define CPU_TOKENS_4D9B2E17_6A3C_4F80_B5E1_92C7A0D8F346_H
+
+/*
+ * Process-wide CPU tokens: one per CPU the process may use, so that file
+ * workers, split-file ranges and Argon2 lanes together never run more
+ * threads than that.
+ *
+ * A thread doing CPU work holds one token (vse_cpu_enter()); the thread
+ * pool takes it around every job. Argon2 borrows up to lanes - 1 more for
+ * the threads it starts, without waiting: with every worker busy, KDFs run
+ * on their caller's thread alone, and with workers idle they get the idle
+ * CPUs. Lanes stay the same, so keys do not change.
+ *
+ * Until vse_cpu_tokens_init() is called nothing is counted, and Argon2 uses
+ * a thread per lane as before.
+ */
+
+/**
+ * The number of CPUs the process may use: those in its affinity mask, capped
+ * by the lowest cgroup v2 cpu.max quota (rounded up) from its cgroup up to
+ * the root. At least 1.
+ */
+int vse_cpu_budget(void);
+
+/**
+ * Start counting, with ntokens tokens. Call it before starting threads.
+ */
+void vse_cpu_tokens_init(int ntokens);
+
+/**
+ * Take a token for this thread, waiting for one if needed. Nested calls on
+ * a thread that already holds one only count.
+ */
+void vse_cpu_enter(void);
+
+/**
+ * Give back the token of the matching vse_cpu_enter().
+ */
+void vse_cpu_leave(void);
+
+/**
+ * Take up to max more tokens, without waiting.
+ *
+ * @return how many were taken; max if tokens are not counted.
+ */
+int vse_cpu_borrow(int max);
+
+/**
+ * Give back what vse_cpu_borrow() took.
+ */
+void vse_cpu_return(int ntokens);
+
+#endif
@@ -0,0 +1,115 @@
+#include <string.h>
+#include "crypt_v1.h"
+#include "argon2/include/argon2.h"
+#include "kdf_arena.h"
+#include "mem_budget.h"
+#include "cpu_tokens.h"
+#include "timing.h"
+#include "probes.h"
+#include "chacha/poly1305.h"
+
+/**
+ * argon2i_hash_raw() with our own allocator hooked in, so that long-lived
+ * workers can keep the Argon2 memory warm (see kdf_arena.h), admitted by
+ * the memory budget if there is one (see mem_budget.h) and run on as many
+ * threads as there are CPU tokens for. The time goes to phase.
+ */
+static int vse_argon2i_v1(uint32_t time_cost, uint32_t memory_cost, uint32_t parallelism,
+                          const void *password, size_t password_nbytes,
+                          const uint8_t *salt, size_t salt_nbytes,
+                          uint8_t *out, size_t out_nbytes,
+                          vse_phase_t phase)
+{
+    argon2_context context;
+
+    context.out = out;
+    context.outlen = (uint32_t)out_nbytes;
+    context.pwd = (uint8_t *)password;
+    context.pwdlen = (uint32_t)password_nbytes;
+    context.salt = (uint8_t *)salt;
+    context.saltlen = (uint32_t)salt_nbytes;
+    context.secret = NULL;
+    context.secretlen = 0;
+    context.ad = NULL;
+    context.adlen = 0;
+    context.t_cost = time_cost;
+    context.m_cost = memory_cost;
+    context.lanes = parallelism;
+    context.allocate_cbk = vse_kdf_alloc;
+    context.free_cbk = vse_kdf_free;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    context.version = ARGON2_VERSION_NUMBER;
+
+    uint64_t nbytes = (uint64_t)memory_cost * 1024; // m_cost is in KiB
+    uint64_t t = VSE_TIMING_NOW();
+    int budgeted = vse_mem_budget_acquire(nbytes);
+    if (budgeted)
+        VSE_TIMING_LAP(VSE_PHASE_KDF_WAIT, t);
+
+    // The caller's thread counts as one; lanes, and so the output, do not
+    // depend on how many run at once (see cpu_tokens.h).
+    int borrowed = vse_cpu_borrow((int)parallelism - 1);
+    context.threads = 1 + (uint32_t)borrowed;
+
+    int ret = argon2_ctx(&context, Argon2_i);
+    VSE_TIMING_LAP(phase, t);
+
+    vse_cpu_return(borrowed);
+
+    if (budgeted)
+        vse_mem_budget_release(nbytes);
+    return ret;
+}
+
+int vse_gen_key_v1(const uint8_t *salt, size_t salt_nbytes,
+                   const char *password, size_t password_nbytes,
+                   size_t key_nbytes, uint8_t *key)
+{
+    uint32_t time_cost = 2;           // 2-pass computation
+    uint32_t memory_cost = (1 << 16); // 64 MB memory vse_usage
+    uint32_t parallelism = 4;         // number of threads and lanes
+
+    VSE_PROBE1(kdf__begin, password_nbytes);
+    int ret = vse_argon2i_v1(time_cost, memory_cost, parallelism,
+                             password, password_nbytes,
+                             salt, salt_nbytes,
+                             key, key_nbytes,
+                             VSE_PHASE_KDF);
+    VSE_PROBE1(kdf__end, ret);
+    return ret;
+}
+
+/**
+ * Generate IV based on salt and input.
+ *
+ * Faster than vse_gen_key_v1().
+ */
+int vse_gen_iv_v1(const uint8_t *salt, size_t salt_nbytes,
+                  const uint8_t *password, size_t password_nbytes,
+                  size_t iv_nbytes, uint8_t *iv)
+{
+    uint32_t time_cost = 1;          // 1-pass computation
+    uint32_t memory_cost = (1 << 8); // 32 MB memory vse_usage
+    uint32_t parallelism = 1;        // number of threads and lanes
+
+    return vse_argon2i_v1(time_cost, memory_cost, parallelism,
+                          password, password_nbytes,
+                          salt, salt_nbytes,
+                          iv, iv_nbytes,
+                          VSE_PHASE_IV);
+}
+
+void vse_calculate_mac_v1(const vse_header_v1_t *header,
+                          const uint8_t *file_hash,
+                          const uint8_t *key, // 32 bytes
+                          uint8_t *mac)       // 16 bytes. out
+{
+    uint8_t message[SALT_LEN + IV_LEN + FILE_HASH_LEN] = {0};
+    memcpy(message, header->salt, SALT_LEN);
+    memcpy(message + SALT_LEN, header->iv, IV_LEN);
+    memcpy(message + SALT_LEN + IV_LEN, file_hash, FILE_HASH_LEN);
+
+    poly1305_auth(mac,
+                  message, sizeof(message) / sizeof(uint8_t),
+                  key);
+}
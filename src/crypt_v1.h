@@ -0,0 +1,27 @@
+#ifndef CRYPT_V1_C4A81F3E_5B92_47D6_8E0B_6D2F9A13C758_H
+#define CRYPT_V1_C4A81F3E_5B92_47D6_8E0B_6D2F9A13C758_H
+
+#include <stdlib.h>
+#include "vse.h"
+
+/*
+ * Version 1 crypto building blocks, shared by the CLI and libvsencrypt.
+ *
+ * Nothing in here prints or touches global state: failures are reported
+ * through the return value only.
+ */
+
+int vse_gen_key_v1(const uint8_t *salt, size_t salt_nbytes,
+                   const char *password, size_t password_nbytes,
+                   size_t key_nbytes, uint8_t *key);
+
+int vse_gen_iv_v1(const uint8_t *salt, size_t salt_nbytes,
+                  const uint8_t *password, size_t password_nbytes,
+                  size_t iv_nbytes, uint8_t *iv);
+
+void vse_calculate_mac_v1(const vse_header_v1_t *header,
+                          const uint8_t *file_hash, // size: FILE_HASH_LEN
+                          const uint8_t *key,       // size: KEY_LEN
+                          uint8_t *mac);            // output
+
+#endif
@@ -0,0 +1,102 @@
+#include <string.h>
+#include "crypt_v2.h"
+#include "crypt_v1.h"
+#include "crypto_random.h"
+#include "chacha/chacha.h"
+#include "chacha/poly1305.h"
+
+#define SLOT_KEY_LEN (KEY_LEN + POLY1305_KEYLEN)
+
+static void vse_slot_xcrypt_v2(const uint8_t *slot_key, const uint8_t *in, uint8_t *out)
+{
+    static const uint8_t zero[CHACHA_STATELEN] = {0};
+    chacha_ctx_t chacha;
+
+    // Every slot key is used for one message only, so the nonce can be fixed.
+    chacha_keysetup(&chacha, slot_key, KEY_LEN * 8);
+    chacha_ivsetup(&chacha, zero, zero + CHACHA_NONCELEN);
+    chacha_xcrypt_bytes(&chacha, in, out, DATA_KEY_LEN);
+    memset(&chacha, 0, sizeof(chacha));
+}
+
+static void vse_slot_tag_v2(const vse_header_v2_t *header, const vse_key_slot_v2_t *slot,
+                            const uint8_t *slot_key, uint8_t *tag)
+{
+    uint8_t message[1 + SALT_LEN + DATA_KEY_LEN + IV_LEN];
+    message[0] = slot->flags;
+    memcpy(message + 1, slot->salt, SALT_LEN);
+    memcpy(message + 1 + SALT_LEN, slot->wrapped_key, DATA_KEY_LEN);
+    memcpy(message + 1 + SALT_LEN + DATA_KEY_LEN, header->iv, IV_LEN);
+
+    poly1305_auth(tag, message, sizeof(message), slot_key + KEY_LEN);
+}
+
+int vse_wrap_key_v2(const vse_header_v2_t *header, vse_key_slot_v2_t *slot,
+                    const char *password, size_t password_nbytes,
+                    const uint8_t *data_key)
+{
+    uint8_t slot_key[SLOT_KEY_LEN];
+
+    slot->flags = KEY_SLOT_USED;
+    crypto_random(slot->salt, SALT_LEN);
+    if (vse_gen_key_v1(slot->salt, SALT_LEN, password, password_nbytes,
+                       SLOT_KEY_LEN, slot_key) != 0)
+    {
+        memset(slot, 0, sizeof(vse_key_slot_v2_t));
+        return ERR_LIB_KDF_FAILED;
+    }
+
+    vse_slot_xcrypt_v2(slot_key, data_key, slot->wrapped_key);
+    vse_slot_tag_v2(header, slot, slot_key, slot->tag);
+    memset(slot_key, 0, sizeof(slot_key));
+    return 0;
+}
+
+int vse_unwrap_key_v2(const vse_header_v2_t *header, const vse_key_slot_v2_t *slot,
+                      const char *password, size_t password_nbytes,
+                      uint8_t *data_key)
+{
+    uint8_t slot_key[SLOT_KEY_LEN];
+    uint8_t tag[MAC_LEN];
+    int ret = ERR_DECRYPT_V2_INVALID_PASSWORD;
+
+    if ((slot->flags & KEY_SLOT_USED) &&
+        vse_gen_key_v1(slot->salt, SALT_LEN, password, password_nbytes,
+                       SLOT_KEY_LEN, slot_key) == 0)
+    {
+        vse_slot_tag_v2(header, slot, slot_key, tag);
+        if (memcmp(tag, slot->tag, MAC_LEN) == 0)
+        {
+            vse_slot_xcrypt_v2(slot_key, slot->wrapped_key, data_key);
+            ret = 0;
+        }
+    }
+
+    memset(slot_key, 0, sizeof(slot_key));
+    return ret;
+}
+
+int vse_open_key_slots_v2(const vse_header_v2_t *header,
+                          const char *password, size_t password_nbytes,
+                          uint8_t *data_key)
+{
+    for (int i = 0; i < KEY_SLOTS_V2; i++)
+    {
+        if (vse_unwrap_key_v2(header, &header->slots[i], password, password_nbytes, data_key) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void vse_calculate_mac_v2(const vse_header_v2_t *header,
+                          const uint8_t *file_hash,
+                          const uint8_t *data_key,
+                          uint8_t *mac)
+{
+    uint8_t message[1 + IV_LEN + FILE_HASH_LEN];
+    message[0] = header->cipher;
+    memcpy(message + 1, header->iv, IV_LEN);
+    memcpy(message + 1 + IV_LEN, file_hash, FILE_HASH_LEN);
+
+    poly1305_auth(mac, message, sizeof(message), data_key + KEY_LEN);
+}
@@ -0,0 +1,50 @@
+#ifndef CRYPT_V2_8D3B6F1A_2E74_4C59_A6B0_F41C9E7D2853_H
+#define CRYPT_V2_8D3B6F1A_2E74_4C59_A6B0_F41C9E7D2853_H
+
+#include <stdlib.h>
+#include "vse.h"
+
+/*
+ * Version 2 key slots and MAC, shared by the CLI and libvsencrypt.
+ *
+ * A slot's key comes from vse_gen_key_v1() over the password and the slot
+ * salt: its first half encrypts the data key (ChaCha20), the second half
+ * authenticates the slot and the file iv (Poly1305).
+ *
+ * Like crypt_v1, nothing in here prints.
+ */
+
+/**
+ * Fill slot with data_key wrapped under password, with a fresh salt.
+ * header->iv must already be set.
+ *
+ * @return 0 or ERR_LIB_KDF_FAILED.
+ */
+int vse_wrap_key_v2(const vse_header_v2_t *header, vse_key_slot_v2_t *slot,
+                    const char *password, size_t password_nbytes,
+                    const uint8_t *data_key);
+
+/**
+ * Unwrap the data key of one used slot.
+ *
+ * @return 0, or ERR_DECRYPT_V2_INVALID_PASSWORD if password does not open it.
+ */
+int vse_unwrap_key_v2(const vse_header_v2_t *header, const vse_key_slot_v2_t *slot,
+                      const char *password, size_t password_nbytes,
+                      uint8_t *data_key);
+
+/**
+ * Try every used slot; one key derivation per slot tried.
+ *
+ * @return the index of the slot password opened, or -1.
+ */
+int vse_open_key_slots_v2(const vse_header_v2_t *header,
+                          const char *password, size_t password_nbytes,
+                          uint8_t *data_key);
+
+void vse_calculate_mac_v2(const vse_header_v2_t *header,
+                          const uint8_t *file_hash, // size: FILE_HASH_LEN
+                          const uint8_t *data_key,  // size: DATA_KEY_LEN
+                          uint8_t *mac);            // output
+
+#endif
@@ -1,24 +1,168 @@
-#include <stdio.h>
+#include <string.h>
 #include "crypto_random.h"
 
+#if __APPLE__
+
 void crypto_random(void *buf, size_t nbytes)
 {
-// use a cryptographic pseudo-random number
-// generator to generate high quality random
-// bytes very quickly.
-#if __APPLE__
     arc4random_buf(buf, nbytes);
-#elif __linux
-    FILE *fp = fopen("/dev/random", "r");
-    if (fp == NULL)
+}
+
+#else
+
+#include <stdint.h>
+#include "vse.h"
+#include "chacha/chacha.h"
+
+#if _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+
+#define VSE_RANDOM_KEY_LEN 32
+#define VSE_RANDOM_BUF_LEN (8 * CHACHA_BLOCKLEN)
+
+typedef struct vse_random
+{
+    uint8_t key[VSE_RANDOM_KEY_LEN];
+    uint8_t buf[VSE_RANDOM_BUF_LEN]; // unread output is the tail
+    size_t avail;
+    size_t since_seed;
+    unsigned int fork_gen;
+    int seeded;
+} vse_random_t;
+
+static VSE_THREAD_LOCAL vse_random_t t_random;
+
+// Bumped in a forked child, whose copy of the state must not be replayed.
+static volatile unsigned int g_fork_gen;
+
+#if !_WIN32
+static pthread_once_t g_fork_once = PTHREAD_ONCE_INIT;
+
+static void vse_random_forked(void)
+{
+    g_fork_gen++;
+}
+
+static void vse_random_watch_fork(void)
+{
+    pthread_atfork(NULL, NULL, vse_random_forked);
+}
+#endif
+
+/* Fill buf from the kernel; -1 if it has none to give. */
+static int vse_random_entropy(uint8_t *buf, size_t nbytes)
+{
+#if _WIN32
+    return BCRYPT_SUCCESS(BCryptGenRandom(NULL, buf, (ULONG)nbytes, BCRYPT_USE_SYSTEM_PREFERRED_RNG)) ? 0 : -1;
+#else
+    size_t done = 0;
+#ifdef SYS_getrandom
+    while (done < nbytes)
+    {
+        long n = syscall(SYS_getrandom, buf + done, nbytes - done, 0);
+        if (n > 0)
+            done += (size_t)n;
+        else if (errno != EINTR)
+            break; // ENOSYS: an old kernel
+    }
+    if (done == nbytes)
+        return 0;
+#endif
+
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    while (done < nbytes)
+    {
+        ssize_t n = read(fd, buf + done, nbytes - done);
+        if (n > 0)
+            done += (size_t)n;
+        else if (n == 0 || errno != EINTR)
+            break;
+    }
+    close(fd);
+    return done == nbytes ? 0 : -1;
+#endif
+}
+
+/* Mix fresh entropy into the key and drop what the buffer still holds. */
+static void vse_random_seed(vse_random_t *r)
+{
+#if !_WIN32
+    pthread_once(&g_fork_once, vse_random_watch_fork);
+#endif
+    r->fork_gen = g_fork_gen;
+
+    uint8_t seed[VSE_RANDOM_KEY_LEN];
+    if (vse_random_entropy(seed, sizeof(seed)) != 0)
+        abort(); // no salt, IV or data key is safe without it
+
+    for (size_t i = 0; i < sizeof(seed); i++)
+        r->key[i] ^= seed[i];
+    memset(seed, 0, sizeof(seed));
+    memset(r->buf, 0, sizeof(r->buf));
+    r->avail = 0;
+    r->since_seed = 0;
+    r->seeded = 1;
+}
+
+/* Write nbytes of keystream to out, and replace the key that made it. */
+static void vse_random_generate(vse_random_t *r, uint8_t *out, size_t nbytes)
+{
+    static const uint8_t zero[CHACHA_STATELEN];
+    chacha_ctx_t ctx;
+    chacha_keysetup(&ctx, r->key, VSE_RANDOM_KEY_LEN * 8);
+    chacha_ivsetup(&ctx, zero, zero + CHACHA_NONCELEN);
+
+    // The next key takes the first block, so out starts at the second.
+    uint8_t block[CHACHA_BLOCKLEN] = {0};
+    chacha_xcrypt_bytes(&ctx, block, block, sizeof(block));
+    memcpy(r->key, block, VSE_RANDOM_KEY_LEN);
+    memset(block, 0, sizeof(block));
+
+    memset(out, 0, nbytes);
+    chacha_xcrypt_bytes(&ctx, out, out, nbytes);
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+void crypto_random(void *buf, size_t nbytes)
+{
+    vse_random_t *r = &t_random;
+    if (!r->seeded || r->fork_gen != g_fork_gen || r->since_seed >= VSE_RANDOM_RESEED_BYTES)
+        vse_random_seed(r);
+    r->since_seed += nbytes;
+
+    uint8_t *out = buf;
+    if (nbytes > sizeof(r->buf))
     {
+        vse_random_generate(r, out, nbytes);
         return;
     }
-    fread(buf, 1, nbytes, fp);
-    fclose(fp);
-#elif __WIN32
-#error "TODO"
-#elif __WIN64
-#error "TODO"
+
+    while (nbytes > 0)
+    {
+        if (r->avail == 0)
+        {
+            vse_random_generate(r, r->buf, sizeof(r->buf));
+            r->avail = sizeof(r->buf);
+        }
+        size_t n = nbytes < r->avail ? nbytes : r->avail;
+        uint8_t *p = r->buf + sizeof(r->buf) - r->avail;
+        memcpy(out, p, n);
+        memset(p, 0, n);
+        r->avail -= n;
+        out += n;
+        nbytes -= n;
+    }
+}
+
 #endif
-}
\ No newline at end of file
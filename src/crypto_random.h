@@ -3,10 +3,23 @@
 
 #include <stdlib.h>
 
+/*
+ * Per-thread ChaCha20 DRBG with fast key erasure: each refill runs the
+ * keystream of the current key, whose first 32 bytes become the next key
+ * and the rest is handed out, wiped as it goes. A thread seeds from the
+ * kernel (getrandom(2), else /dev/urandom; BCryptGenRandom on Windows) on
+ * first use, after every VSE_RANDOM_RESEED_BYTES of output and in a forked
+ * child. macOS uses arc4random_buf(), which works the same way.
+ */
+
+// Output between two reseeds of a thread.
+#define VSE_RANDOM_RESEED_BYTES (1 << 20)
+
 /**
  * Generate crypto random.
  *
- * used this function to generate iv, salt etc.
+ * used this function to generate iv, salt etc. Never blocks once the
+ * kernel pool is initialised; aborts if the kernel gives no entropy.
  */
 void crypto_random(void *buf, size_t nbytes);
 
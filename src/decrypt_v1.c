@@ -1,36 +1,58 @@
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "vse.h"
 #include "decrypt_v1.h"
 #include "encrypt_v1.h"
-#include "argon2/src/blake2/blake2.h"
+#include "cipher.h"
 #include "hexdump.h"
 #include "chacha/poly1305.h"
-#define BUF_SIZE 4096
+#include "timing.h"
+#include "probes.h"
+// The MAC pass only hashes, so it reads in large sequential chunks.
+#define VERIFY_BUF_SIZE (1 << 20)
 
-static int vse_verify_mac(const vse_header_v1_t *header,
-                          const uint8_t *key,
-                          FILE *fp)
+/**
+ * Hash the rest of fp as vse_stream_crypt_v1() does when encrypting, then
+ * seek back to where it was.
+ */
+int vse_hash_ciphertext(FILE *fp, int cipher, const uint8_t *iv, const uint8_t *key,
+                        uint8_t *file_hash)
 {
-    int ret = 0;
-    uint8_t mac[MAC_LEN] = {0};
-    long pos = ftell(fp);
-    if (pos == -1L)
+    const vse_cipher_t *desc = vse_cipher_find(cipher);
+    if (desc == NULL)
+    {
+        vse_print_error("Error: Invalid cipher %d\n", cipher);
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER;
+    }
+
+    int64_t pos = vse_ftell64(fp);
+    if (pos == -1)
     {
         vse_print_error("Error: Failed to get file position: %s\n", strerror(errno));
         return ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
     }
 
-    uint8_t file_hash[FILE_HASH_LEN] = {0};
-    blake2b_state blake2b;
-    blake2b_init_key(&blake2b, FILE_HASH_LEN, header->iv, IV_LEN);
+    vse_file_hash_t hash;
+    if (desc->hash_init(&hash, iv, IV_LEN, key, KEY_LEN) != 0)
+    {
+        vse_print_error("Error: Failed to derive iv\n");
+        return ERR_LIB_KDF_FAILED;
+    }
+
+    uint8_t *buf = malloc(VERIFY_BUF_SIZE);
+    if (buf == NULL)
+    {
+        vse_print_error("Error: Out of memory\n");
+        return ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
+    }
 
-    uint8_t buf[BUF_SIZE];
     size_t len;
-    while ((len = fread(buf, 1, BUF_SIZE, fp)) > 0)
+    while ((len = fread(buf, 1, VERIFY_BUF_SIZE, fp)) > 0)
     {
-        blake2b_update(&blake2b, buf, len);
+        desc->hash_update(&hash, buf, len);
     }
+    free(buf);
 
     if (!feof(fp))
     {
@@ -38,7 +60,28 @@ static int vse_verify_mac(const vse_header_v1_t *header,
         return ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
     }
 
-    blake2b_final(&blake2b, file_hash, FILE_HASH_LEN);
+    desc->hash_final(&hash, file_hash);
+
+    if (vse_fseek64(fp, pos, SEEK_SET) != 0)
+    {
+        vse_print_error("Error: Failed to seek in file: %s\n", strerror(errno));
+        return ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
+    }
+    return 0;
+}
+
+static int vse_verify_mac(const vse_header_v1_t *header,
+                          const uint8_t *key,
+                          FILE *fp)
+{
+    uint8_t mac[MAC_LEN] = {0};
+    uint8_t file_hash[FILE_HASH_LEN] = {0};
+
+    int ret = vse_hash_ciphertext(fp, header->cipher, header->iv, key, file_hash);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
     vse_calculate_mac_v1(header, file_hash, key, mac);
 
@@ -47,18 +90,15 @@ static int vse_verify_mac(const vse_header_v1_t *header,
     // printf("dec: header.mac: %s\n", hexdump(header->mac, 16, hex_out));
     // printf("dec: mac: %s\n", hexdump(mac, 16, hex_out));
 
-    if (memcmp(mac, header->mac, MAC_LEN) != 0)
+    int mac_ok = memcmp(mac, header->mac, MAC_LEN) == 0;
+    VSE_PROBE1(mac__verify, mac_ok ? 0 : ERR_DECRYPT_V1_INVALID_PASSWORD);
+    if (!mac_ok)
     {
         vse_print_error("Error: Invalid password\n");
         return ERR_DECRYPT_V1_INVALID_PASSWORD;
     }
 
-    if (fseek(fp, pos, SEEK_SET) != 0)
-    {
-        vse_print_error("Error: Failed to seek in file: %s\n", strerror(errno));
-        return ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
-    }
-    return ret;
+    return 0;
 }
 
 int vse_decrypt_file_v1(const char *password, size_t password_nbytes,
@@ -74,12 +114,19 @@ int vse_decrypt_file_v1(const char *password, size_t password_nbytes,
         vse_print_error("Error: Failed to read file header.\n");
         return ERR_DECRYPT_V1_FAIL_TO_READ_FILE_HEADER;
     }
+    VSE_TIMING_CIPHER(header.cipher);
 
-    vse_gen_key_v1(header.salt, SALT_LEN,
-                   password, password_nbytes,
-                   KEY_LEN, key);
+    if (vse_gen_key_v1(header.salt, SALT_LEN,
+                       password, password_nbytes,
+                       KEY_LEN, key) != 0)
+    {
+        vse_print_error("Error: Failed to derive key\n");
+        return ERR_LIB_KDF_FAILED;
+    }
 
+    uint64_t t = VSE_TIMING_NOW();
     ret = vse_verify_mac(&header, key, fp_in);
+    VSE_TIMING_LAP(VSE_PHASE_VERIFY, t);
     if (ret != 0)
     {
         return ret;
@@ -94,3 +141,33 @@ int vse_decrypt_file_v1(const char *password, size_t password_nbytes,
 
     return ret;
 }
+
+/**
+ * Check the MAC of fp_in without producing any plaintext.
+ */
+int vse_verify_file_v1(const char *password, size_t password_nbytes,
+                       FILE *fp_in)
+{
+    uint8_t key[KEY_LEN] = {0};
+
+    vse_header_v1_t header = {0};
+    if ((fread(&header, sizeof(vse_header_v1_t), 1, fp_in)) != 1)
+    {
+        vse_print_error("Error: Failed to read file header.\n");
+        return ERR_DECRYPT_V1_FAIL_TO_READ_FILE_HEADER;
+    }
+    VSE_TIMING_CIPHER(header.cipher);
+
+    if (vse_gen_key_v1(header.salt, SALT_LEN,
+                       password, password_nbytes,
+                       KEY_LEN, key) != 0)
+    {
+        vse_print_error("Error: Failed to derive key\n");
+        return ERR_LIB_KDF_FAILED;
+    }
+
+    uint64_t t = VSE_TIMING_NOW();
+    int ret = vse_verify_mac(&header, key, fp_in);
+    VSE_TIMING_LAP(VSE_PHASE_VERIFY, t);
+    return ret;
+}
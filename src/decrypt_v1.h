@@ -1,10 +1,17 @@
 #ifndef DECRYPT_V1_477D227B_E1BF_483D_A931_A17721B35150_H
 #define DECRYPT_V1_477D227B_E1BF_483D_A931_A17721B35150_H
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+int vse_hash_ciphertext(FILE *fp, int cipher, const uint8_t *iv, const uint8_t *key,
+                        uint8_t *file_hash);
+
 int vse_decrypt_file_v1(const char *password, size_t password_nbytes,
                         FILE *fp_in, FILE *fp_out);
 
+int vse_verify_file_v1(const char *password, size_t password_nbytes,
+                       FILE *fp_in);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+#include "vse.h"
+#include "encrypt_v1.h"
+#include "decrypt_v1.h"
+#include "decrypt_v2.h"
+#include "crypt_v2.h"
+#include "timing.h"
+#include "probes.h"
+
+/**
+ * Read the header of fp_in and unwrap the data key with password.
+ */
+static int vse_open_header_v2(const char *password, size_t password_nbytes,
+                              FILE *fp_in, vse_header_v2_t *header, uint8_t *data_key)
+{
+    if ((fread(header, sizeof(vse_header_v2_t), 1, fp_in)) != 1)
+    {
+        vse_print_error("Error: Failed to read file header.\n");
+        return ERR_DECRYPT_V2_FAIL_TO_READ_FILE_HEADER;
+    }
+    VSE_TIMING_CIPHER(header->cipher);
+
+    if (vse_open_key_slots_v2(header, password, password_nbytes, data_key) < 0)
+    {
+        vse_print_error("Error: Invalid password\n");
+        return ERR_DECRYPT_V2_INVALID_PASSWORD;
+    }
+
+    return 0;
+}
+
+static int vse_verify_mac_v2(const vse_header_v2_t *header,
+                             const uint8_t *data_key,
+                             FILE *fp)
+{
+    uint8_t mac[MAC_LEN] = {0};
+    uint8_t file_hash[FILE_HASH_LEN] = {0};
+
+    int ret = vse_hash_ciphertext(fp, header->cipher, header->iv, data_key, file_hash);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    vse_calculate_mac_v2(header, file_hash, data_key, mac);
+
+    // The password was right, so a mismatch means the data was modified.
+    int mac_ok = memcmp(mac, header->mac, MAC_LEN) == 0;
+    VSE_PROBE1(mac__verify, mac_ok ? 0 : ERR_DECRYPT_V2_INVALID_MAC);
+    if (!mac_ok)
+    {
+        vse_print_error("Error: Invalid MAC, file is corrupted\n");
+        return ERR_DECRYPT_V2_INVALID_MAC;
+    }
+
+    return 0;
+}
+
+int vse_decrypt_file_v2(const char *password, size_t password_nbytes,
+                        FILE *fp_in, FILE *fp_out)
+{
+    uint8_t data_key[DATA_KEY_LEN] = {0};
+    uint8_t file_hash[FILE_HASH_LEN];
+    vse_header_v2_t header;
+
+    int ret = vse_open_header_v2(password, password_nbytes, fp_in, &header, data_key);
+    if (ret == 0)
+    {
+        uint64_t t = VSE_TIMING_NOW();
+        ret = vse_verify_mac_v2(&header, data_key, fp_in);
+        VSE_TIMING_LAP(VSE_PHASE_VERIFY, t);
+    }
+
+    if (ret == 0)
+    {
+        ret = vse_stream_crypt_v1(MODE_DECRYPT,
+                                  header.cipher,
+                                  header.iv, IV_LEN,
+                                  data_key, KEY_LEN,
+                                  fp_in, fp_out,
+                                  file_hash, FILE_HASH_LEN);
+    }
+
+    memset(data_key, 0, sizeof(data_key));
+    return ret;
+}
+
+/**
+ * Check the MAC of fp_in without producing any plaintext.
+ */
+int vse_verify_file_v2(const char *password, size_t password_nbytes,
+                       FILE *fp_in)
+{
+    uint8_t data_key[DATA_KEY_LEN] = {0};
+    vse_header_v2_t header;
+
+    int ret = vse_open_header_v2(password, password_nbytes, fp_in, &header, data_key);
+    if (ret == 0)
+    {
+        uint64_t t = VSE_TIMING_NOW();
+        ret = vse_verify_mac_v2(&header, data_key, fp_in);
+        VSE_TIMING_LAP(VSE_PHASE_VERIFY, t);
+    }
+
+    memset(data_key, 0, sizeof(data_key));
+    return ret;
+}
@@ -0,0 +1,13 @@
+#ifndef DECRYPT_V2_B81E4A2D_96C3_4F07_8D5A_2E7F1C0B9A36_H
+#define DECRYPT_V2_B81E4A2D_96C3_4F07_8D5A_2E7F1C0B9A36_H
+
+#include <stdlib.h>
+#include <stdio.h>
+
+int vse_decrypt_file_v2(const char *password, size_t password_nbytes,
+                        FILE *fp_in, FILE *fp_out);
+
+int vse_verify_file_v2(const char *password, size_t password_nbytes,
+                       FILE *fp_in);
+
+#endif
@@ -3,126 +3,10 @@
 #include <errno.h>
 #include "encrypt_v1.h"
 #include "crypto_random.h"
-#include "argon2/include/argon2.h"
-#include "argon2/src/blake2/blake2.h"
-#include "salsa20/salsa20.h"
-#include "aes/aes.h"
 #include "hexdump.h"
-#include "chacha/chacha.h"
-#include "chacha/poly1305.h"
-
-int vse_gen_key_v1(const uint8_t *salt, size_t salt_nbytes,
-                   const char *password, size_t password_nbytes,
-                   size_t key_nbytes, uint8_t *key)
-{
-    uint32_t time_cost = 2;           // 2-pass computation
-    uint32_t memory_cost = (1 << 16); // 64 MB memory vse_usage
-    uint32_t parallelism = 4;         // number of threads and lanes
-
-    return argon2i_hash_raw(time_cost, memory_cost, parallelism,
-                            password, password_nbytes,
-                            salt, salt_nbytes,
-                            key, key_nbytes);
-}
-
-/**
- * Generate IV based on salt and input.
- *
- * Faster than vse_gen_key_v1().
- */
-int vse_gen_iv_v1(const uint8_t *salt, size_t salt_nbytes,
-                  const uint8_t *password, size_t password_nbytes,
-                  size_t iv_nbytes, uint8_t *iv)
-{
-    uint32_t time_cost = 1;          // 1-pass computation
-    uint32_t memory_cost = (1 << 8); // 32 MB memory vse_usage
-    uint32_t parallelism = 1;        // number of threads and lanes
-
-    return argon2i_hash_raw(time_cost, memory_cost, parallelism,
-                            password, password_nbytes,
-                            salt, salt_nbytes,
-                            iv, iv_nbytes);
-}
-
-void vse_calculate_mac_v1(const vse_header_v1_t *header,
-                          const uint8_t *file_hash,
-                          const uint8_t *key, // 32 bytes
-                          uint8_t *mac)       // 16 bytes. out
-{
-    uint8_t message[SALT_LEN + IV_LEN + FILE_HASH_LEN] = {0};
-    memcpy(message, header->salt, SALT_LEN);
-    memcpy(message + SALT_LEN, header->iv, IV_LEN);
-    memcpy(message + SALT_LEN + IV_LEN, file_hash, FILE_HASH_LEN);
-
-    poly1305_auth(mac,
-                  message, sizeof(message) / sizeof(uint8_t),
-                  key);
-}
-
-static void vse_setup_cipher_v1(salsa20_ctx_t *salsa20,
-                                chacha_ctx_t *chacha,
-                                aes_ctx_t *aes,
-                                const uint8_t *iv, size_t iv_nbytes,
-                                const uint8_t *key, size_t key_nbytes)
-{
-    uint8_t iv_aes[IV_LEN] = {0};
-    uint8_t iv_chacha[IV_LEN] = {0};
-    uint8_t iv_salsa20[IV_LEN] = {0};
-    vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"aes", 3, IV_LEN, iv_aes);
-    vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"chacha", 6, IV_LEN, iv_chacha);
-    vse_gen_iv_v1(iv, iv_nbytes, (uint8_t *)"salsa20", 7, IV_LEN, iv_salsa20);
-
-    AES_init_ctx_iv(aes, key, iv_aes);
-
-    chacha_ivsetup(chacha, iv_chacha, NULL);
-    chacha_keysetup(chacha, key, 256);
-
-    salsa20_keysetup(salsa20, key, 256, IV_LEN * 8);
-    salsa20_ivsetup(salsa20, iv_salsa20);
-}
-
-int vse_block_xcrypt_v1(int cipher,
-                        salsa20_ctx_t *salsa20,
-                        chacha_ctx_t *chacha,
-                        aes_ctx_t *aes,
-                        uint8_t *buf, uint32_t buf_nbytes)
-{
-    int ret = 0;
-    switch (cipher)
-    {
-    case CIPHER_SALSA20:
-        salsa20_xcrypt_bytes(salsa20, buf, buf, buf_nbytes);
-        break;
-    case CIPHER_CHACHA20:
-        chacha_xcrypt_bytes(chacha, buf, buf, buf_nbytes);
-        break;
-    case CIPHER_AES_256_CTR:
-        AES_CTR_xcrypt_buffer(aes, buf, buf_nbytes);
-        break;
-    case CIPHER_AES_256_CTR_CHACHA20:
-        AES_CTR_xcrypt_buffer(aes, buf, buf_nbytes);
-        chacha_xcrypt_bytes(chacha, buf, buf, buf_nbytes);
-        break;
-    case CIPHER_CHACHA20_AES_256_CTR:
-        chacha_xcrypt_bytes(chacha, buf, buf, buf_nbytes);
-        AES_CTR_xcrypt_buffer(aes, buf, buf_nbytes);
-        break;
-    case CIPHER_AES_256_CTR_SALSA20:
-        AES_CTR_xcrypt_buffer(aes, buf, buf_nbytes);
-        salsa20_xcrypt_bytes(salsa20, buf, buf, buf_nbytes);
-        break;
-    case CIPHER_SALSA20_AES_256_CTR:
-        salsa20_xcrypt_bytes(salsa20, buf, buf, buf_nbytes);
-        AES_CTR_xcrypt_buffer(aes, buf, buf_nbytes);
-        break;
-    default:
-        vse_print_error("Error: Invalid cipher %d", cipher);
-        ret = ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER;
-        break;
-    }
-
-    return ret;
-}
+#include "timing.h"
+#include "ranges.h"
+#include "multibuf.h"
 
 int vse_stream_crypt_v1(int mode, int cipher,
                         const uint8_t *iv, size_t iv_nbytes,
@@ -131,96 +15,103 @@ int vse_stream_crypt_v1(int mode, int cipher,
                         uint8_t *file_hash, size_t file_hash_nbytes)
 {
     int ret = 0;
-    aes_ctx_t aes;
-    chacha_ctx_t chacha;
-    salsa20_ctx_t salsa20;
+    vse_cipher_ctx_t ctx;
 
-    vse_setup_cipher_v1(&salsa20,
-                        &chacha,
-                        &aes,
-                        iv, iv_nbytes,
-                        key, key_nbytes);
-
-    blake2b_state blake2b;
-    blake2b_init_key(&blake2b, file_hash_nbytes, iv, iv_nbytes);
+    const vse_cipher_t *desc = vse_cipher_find(cipher);
+    if (desc == NULL)
+    {
+        vse_print_error("Error: Invalid cipher %d\n", cipher);
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER;
+    }
 
-    uint8_t buf[4096];
-    size_t len;
-    while ((len = fread(buf, 1, 4096, fp_in)) > 0)
+    if (desc->setup(&ctx, iv, iv_nbytes, key, key_nbytes) != 0)
     {
-        ret = vse_block_xcrypt_v1(cipher, &salsa20, &chacha, &aes, buf, (uint32_t)len);
-        if (ret != 0)
-        {
-            return ret;
-        }
+        vse_print_error("Error: Failed to derive iv\n");
+        memset(&ctx, 0, sizeof(ctx));
+        return ERR_LIB_KDF_FAILED;
+    }
+
+    // Ranges seek the keystream to their offset: aegis256 has none.
+    int split = vse_range_pool != NULL && desc->seek != NULL;
 
-        if (mode == MODE_ENCRYPT)
+    if (mode == MODE_ENCRYPT)
+    {
+        // calculate hash after encrypt
+        vse_file_hash_t hash;
+        (void)file_hash_nbytes; // FILE_HASH_LEN
+        if (desc->hash_init(&hash, iv, iv_nbytes, key, key_nbytes) != 0)
         {
-            // calculate hash after encrypt
-            blake2b_update(&blake2b, buf, len);
+            vse_print_error("Error: Failed to derive iv\n");
+            ret = ERR_LIB_KDF_FAILED;
         }
-
-        if (fwrite(buf, 1, len, fp_out) != len)
+        else if (split)
+            ret = vse_stream_crypt_ranges(desc, &ctx, &hash, fp_in, fp_out);
+        else
+            ret = desc->encrypt_stream(&ctx, &hash, fp_in, fp_out);
+        if (ret == 0)
         {
-            vse_print_error("Error: Failed to write to output file: %s\n", strerror(errno));
-            return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+            desc->hash_final(&hash, file_hash);
         }
     }
+    else if (split)
+    {
+        ret = vse_stream_crypt_ranges(desc, &ctx, NULL, fp_in, fp_out);
+    }
+    else
+    {
+        ret = desc->decrypt_stream(&ctx, fp_in, fp_out);
+    }
 
-    if (!feof(fp_in))
+    if (ret == ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE)
+    {
+        vse_print_error("Error: Failed to write to output file: %s\n", strerror(errno));
+    }
+    else if (ret == ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE)
     {
         vse_print_error("Error: Failed to read infile: %s", strerror(errno));
-        return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;
     }
 
-    blake2b_final(&blake2b, file_hash, file_hash_nbytes);
-
+    memset(&ctx, 0, sizeof(ctx));
     return ret;
 }
 
 /**
- * Encrypt file.
+ * Encrypt fp_in into fp_out.
  *
  * The MAC calculation is based on salt, iv and encrypted data
  * to provide authentication and integration.
+ *
+ * fp_out must be seekable: the header is written last, at offset 1.
  */
-int vse_encrypt_file_v1(int cipher,
-                        const char *password, size_t password_nbytes,
-                        const char *infile, const char *outfile)
+int vse_encrypt_fp_v1(int cipher,
+                      const char *password, size_t password_nbytes,
+                      FILE *fp_in, FILE *fp_out)
 {
     int ret = 0;
     uint8_t key[KEY_LEN] = {0};
     uint8_t file_hash[FILE_HASH_LEN];
     vse_header_v1_t header;
+
+    // Encrypted already, side by side with other small files.
+    if (vse_mb_lane != NULL && vse_mb_lane->ready && vse_mb_lane->header.cipher == cipher)
+        return vse_mb_write_v1(vse_mb_lane, fp_out);
+
     memset(&header, 0, sizeof(vse_header_v1_t));
 
     header.cipher = cipher;
+    VSE_TIMING_CIPHER(cipher);
     crypto_random(header.salt, SALT_LEN);
     crypto_random(header.iv, IV_LEN);
 
-    vse_gen_key_v1(header.salt, SALT_LEN,
-                   password, password_nbytes, KEY_LEN, key);
+    if (vse_gen_key_v1(header.salt, SALT_LEN,
+                       password, password_nbytes, KEY_LEN, key) != 0)
+    {
+        vse_print_error("Error: Failed to derive key\n");
+        return ERR_LIB_KDF_FAILED;
+    }
 
-    FILE *fp_in = NULL;
-    FILE *fp_out = NULL;
     do
     {
-        fp_in = fopen(infile, "rb");
-        if (fp_in == NULL)
-        {
-            vse_print_error("Error: Failed to open input file %s: %s\n", infile, strerror(errno));
-            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_INPUT_FILE;
-            break;
-        }
-
-        fp_out = fopen(outfile, "wb");
-        if (fp_out == NULL)
-        {
-            vse_print_error("Error: Failed to open output file %s: %s\n", outfile, strerror(errno));
-            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE;
-            break;
-        }
-
         uint8_t version = 1;
         if (fwrite(&version, 1, 1, fp_out) != 1)
         {
@@ -256,7 +147,7 @@ int vse_encrypt_file_v1(int cipher,
 
         if (fseek(fp_out, 1, SEEK_SET) != 0)
         {
-            vse_print_error("Error: Failed to seek to v1 header of file %s: %s\n", outfile, strerror(errno));
+            vse_print_error("Error: Failed to seek to v1 header: %s\n", strerror(errno));
             ret = ERR_ENCRYPT_FILE_OUTFILE_SEEK_TO_HEAD_FAILED;
             break;
         }
@@ -269,6 +160,40 @@ int vse_encrypt_file_v1(int cipher,
         }
     } while (0);
 
+    return ret;
+}
+
+/**
+ * Encrypt file.
+ */
+int vse_encrypt_file_v1(int cipher,
+                        const char *password, size_t password_nbytes,
+                        const char *infile, const char *outfile)
+{
+    int ret = 0;
+    FILE *fp_in = NULL;
+    FILE *fp_out = NULL;
+    do
+    {
+        fp_in = fopen(infile, "rb");
+        if (fp_in == NULL)
+        {
+            vse_print_error("Error: Failed to open input file %s: %s\n", infile, strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_INPUT_FILE;
+            break;
+        }
+
+        fp_out = fopen(outfile, "wb");
+        if (fp_out == NULL)
+        {
+            vse_print_error("Error: Failed to open output file %s: %s\n", outfile, strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE;
+            break;
+        }
+
+        ret = vse_encrypt_fp_v1(cipher, password, password_nbytes, fp_in, fp_out);
+    } while (0);
+
     if (fp_in)
     {
         fclose(fp_in);
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "encrypt_v1.h"
+#include "encrypt_v2.h"
+#include "crypt_v2.h"
+#include "crypto_random.h"
+#include "timing.h"
+
+int vse_encrypt_fp_v2(int cipher,
+                      const char *password, size_t password_nbytes,
+                      FILE *fp_in, FILE *fp_out)
+{
+    int ret = 0;
+    uint8_t data_key[DATA_KEY_LEN] = {0};
+    uint8_t file_hash[FILE_HASH_LEN];
+    vse_header_v2_t header;
+    memset(&header, 0, sizeof(vse_header_v2_t));
+
+    header.cipher = cipher;
+    VSE_TIMING_CIPHER(cipher);
+    crypto_random(header.iv, IV_LEN);
+    crypto_random(data_key, DATA_KEY_LEN);
+
+    do
+    {
+        ret = vse_wrap_key_v2(&header, &header.slots[0], password, password_nbytes, data_key);
+        if (ret != 0)
+        {
+            vse_print_error("Error: Failed to derive key\n");
+            break;
+        }
+
+        uint8_t version = 2;
+        if (fwrite(&version, 1, 1, fp_out) != 1)
+        {
+            vse_print_error("Error: Failed to write version: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_WRITE_VERSION;
+            break;
+        }
+
+        if (fseek(fp_out, sizeof(vse_header_v2_t), SEEK_CUR) != 0)
+        {
+            vse_print_error("Error: Failed to seek to end of header: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_SEEK_END_OF_HEADER;
+            break;
+        }
+
+        ret = vse_stream_crypt_v1(MODE_ENCRYPT,
+                                  cipher,
+                                  header.iv, IV_LEN,
+                                  data_key, KEY_LEN,
+                                  fp_in, fp_out,
+                                  file_hash, FILE_HASH_LEN);
+        if (ret != 0)
+        {
+            break;
+        }
+
+        vse_calculate_mac_v2(&header, file_hash, data_key, header.mac);
+
+        if (fseek(fp_out, 1, SEEK_SET) != 0)
+        {
+            vse_print_error("Error: Failed to seek to v2 header: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_OUTFILE_SEEK_TO_HEAD_FAILED;
+            break;
+        }
+
+        if (fwrite(&header, sizeof(vse_header_v2_t), 1, fp_out) != 1)
+        {
+            vse_print_error("Error: Failed to write file header: %s", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_FAILED_TO_WRITE_HEADER;
+            break;
+        }
+    } while (0);
+
+    memset(data_key, 0, sizeof(data_key));
+    return ret;
+}
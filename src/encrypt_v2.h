@@ -0,0 +1,17 @@
+#ifndef ENCRYPT_V2_3F9C1E62_7A48_4B1D_95E3_0C6D8B2A7F14_H
+#define ENCRYPT_V2_3F9C1E62_7A48_4B1D_95E3_0C6D8B2A7F14_H
+
+#include <stdio.h>
+#include "vse.h"
+
+/**
+ * Encrypt fp_in into fp_out as version 2: the data is encrypted under a
+ * random data key, which slot 0 holds wrapped under password.
+ *
+ * fp_out must be seekable: the header is written last, at offset 1.
+ */
+int vse_encrypt_fp_v2(int cipher,
+                      const char *password, size_t password_nbytes,
+                      FILE *fp_in, FILE *fp_out);
+
+#endif
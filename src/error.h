@@ -20,5 +20,38 @@
 #define ERR_DECRYPT_V1_FAIL_TO_READ_FILE_HEADER 66
 #define ERR_DECRYPT_V1_INVALID_PASSWORD 67
 #define ERR_DECRYPT_V1_FAILED_TO_READ_INFILE 68
+#define ERR_DECRYPT_V2_FAIL_TO_READ_FILE_HEADER 69
+#define ERR_DECRYPT_V2_INVALID_PASSWORD 70
+#define ERR_DECRYPT_V2_INVALID_MAC 71
+
+#define ERR_SERVE_FAILED_TO_LISTEN 81
+#define ERR_SERVE_BAD_REQUEST 82
+#define ERR_SERVE_MISSING_FD 83
+#define ERR_SERVE_FAILED_TO_CREATE_OUTPUT 84
+#define ERR_SERVE_UNSUPPORTED 85
+
+#define ERR_LIB_KDF_FAILED 91
+#define ERR_LIB_BAD_STATE 92
+#define ERR_LIB_BUFFER_TOO_SMALL 93
+
+#define ERR_STATS_FAILED_TO_OPEN 101
+#define ERR_TRACE_FAILED_TO_OPEN 102
+#define ERR_METRICS_FAILED_TO_WRITE 103
+
+#define ERR_REKEY_UNSUPPORTED_VERSION 111
+#define ERR_REKEY_FAILED_TO_OPEN_FILE 112
+#define ERR_REKEY_FAILED_TO_WRITE_HEADER 113
+
+#define ERR_MANIFEST_FAILED_TO_OPEN 121
+#define ERR_MANIFEST_CORRUPT 122
+#define ERR_MANIFEST_FAILED_TO_WRITE 123
+
+#define ERR_JOURNAL_FAILED_TO_OPEN 131
+#define ERR_JOURNAL_MODE_MISMATCH 132
+#define ERR_JOURNAL_FAILED_TO_WRITE 133
+
+#define ERR_CHECKPOINT_FAILED_TO_WRITE 141
+#define ERR_CHECKPOINT_INVALID 142
+#define ERR_CHECKPOINT_INPUT_CHANGED 143
 
 #endif
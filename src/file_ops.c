@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <assert.h>
+#if _MSC_VER
+#include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include "vse.h"
+#include "hexdump.h"
+#include "crypto_random.h"
+#include "encrypt_v1.h"
+#include "decrypt_v1.h"
+#include "encrypt_v2.h"
+#include "decrypt_v2.h"
+#include "rekey_v2.h"
+#include "reencrypt_v1.h"
+#include "resumable_v1.h"
+#include "file_ops.h"
+#include "timing.h"
+#include "stats.h"
+#include "probes.h"
+
+static int vse_read_version(FILE *fp_in, uint8_t *version)
+{
+    if (fread(version, 1, 1, fp_in) != 1)
+    {
+        vse_print_error("Error: Failed to read 1st byte of input file\n");
+        return ERR_DECRYPT_FILE_FAILED_TO_OPEN_INPUT_FILE;
+    }
+
+    if (*version != 1 && *version != 2)
+    {
+        vse_print_error("Error: Invalid version %d\n", *version);
+        return ERR_DECRYPT_FILE_INVALID_VERSION;
+    }
+
+    return 0;
+}
+
+int vse_decrypt_fp(const char *password, size_t password_nbytes,
+                   FILE *fp_in, FILE *fp_out)
+{
+    uint8_t version = 0;
+    int ret = vse_read_version(fp_in, &version);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    switch (version)
+    {
+    case 1:
+        ret = vse_decrypt_file_v1(password, password_nbytes, fp_in, fp_out);
+        break;
+    case 2:
+        ret = vse_decrypt_file_v2(password, password_nbytes, fp_in, fp_out);
+        break;
+    default:
+        assert(!"BUG: un-handled version");
+    }
+
+    return ret;
+}
+
+static FILE *vse_open_infile(const char *infile, int *ret)
+{
+    struct stat buf;
+    if (stat(infile, &buf) != 0)
+    {
+        vse_print_error("Error: Failed to stat file %s: %s\n", infile, strerror(errno));
+        *ret = ERR_DECRYPT_FILE_FAILED_TO_STAT_INPUT_FILE;
+        return NULL;
+    }
+
+    if (buf.st_size < (off_t)(1 + FILE_HEADER_LEN))
+    {
+        vse_print_error("Error: File too small to decrypted: %s\n", infile);
+        *ret = ERR_DECRYPT_FILE_INPUT_FILE_SIZE_TOO_SMALL;
+        return NULL;
+    }
+
+    FILE *fp_in = fopen(infile, "rb");
+    if (fp_in == NULL)
+    {
+        vse_print_error("Error: Failed to open file %s for read\n", infile);
+        *ret = ERR_DECRYPT_FILE_FAILED_TO_OPEN_INPUT_FILE;
+        return NULL;
+    }
+
+    return fp_in;
+}
+
+int vse_decrypt_file(const char *password, size_t password_nbytes,
+                     const char *infile, const char *outfile)
+{
+    int ret = 0;
+    FILE *fp_in = NULL;
+    FILE *fp_out = NULL;
+
+    do
+    {
+        fp_in = vse_open_infile(infile, &ret);
+        if (fp_in == NULL)
+        {
+            break;
+        }
+
+        fp_out = fopen(outfile, "wb");
+        if (fp_out == NULL)
+        {
+            vse_print_error("Error: Failed to open file %s for write\n", outfile);
+            ret = ERR_DECRYPT_FILE_FAILED_TO_OPEN_OUTPUT_FILE;
+            break;
+        }
+
+        ret = vse_decrypt_fp(password, password_nbytes, fp_in, fp_out);
+    } while (0);
+
+    if (fp_in != NULL)
+    {
+        fclose(fp_in);
+    }
+
+    if (fp_out != NULL)
+    {
+        fclose(fp_out);
+    }
+
+    return ret;
+}
+
+int vse_verify_fp(const char *password, size_t password_nbytes,
+                  FILE *fp_in)
+{
+    uint8_t version = 0;
+    int ret = vse_read_version(fp_in, &version);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    switch (version)
+    {
+    case 1:
+        ret = vse_verify_file_v1(password, password_nbytes, fp_in);
+        break;
+    case 2:
+        ret = vse_verify_file_v2(password, password_nbytes, fp_in);
+        break;
+    default:
+        assert(!"BUG: un-handled version");
+    }
+
+    return ret;
+}
+
+int vse_verify_file(const char *password, size_t password_nbytes,
+                    const char *infile)
+{
+    int ret = 0;
+    FILE *fp_in = vse_open_infile(infile, &ret);
+    if (fp_in == NULL)
+    {
+        return ret;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    // One front-to-back pass: let the kernel read ahead aggressively.
+    posix_fadvise(fileno(fp_in), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    ret = vse_verify_fp(password, password_nbytes, fp_in);
+    fclose(fp_in);
+
+    return ret;
+}
+
+int vse_reencrypt_fp(const char *password, size_t password_nbytes,
+                     int cipher,
+                     const char *new_password, size_t new_password_nbytes,
+                     FILE *fp_in, FILE *fp_out)
+{
+    uint8_t version = 0;
+    int ret = vse_read_version(fp_in, &version);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    switch (version)
+    {
+    case 1:
+        ret = vse_reencrypt_fp_v1(password, password_nbytes, cipher,
+                                  new_password, new_password_nbytes, fp_in, fp_out);
+        break;
+    case 2:
+        // The data key never depends on the password: --rekey is enough.
+        vse_print_error("Error: Version 2 files are re-keyed in place, use --rekey\n");
+        ret = ERR_REKEY_UNSUPPORTED_VERSION;
+        break;
+    default:
+        assert(!"BUG: un-handled version");
+    }
+
+    return ret;
+}
+
+int vse_reencrypt_file(const char *password, size_t password_nbytes,
+                       int cipher,
+                       const char *new_password, size_t new_password_nbytes,
+                       const char *infile, const char *outfile)
+{
+    int ret = 0;
+    FILE *fp_in = NULL;
+    FILE *fp_out = NULL;
+
+    do
+    {
+        fp_in = vse_open_infile(infile, &ret);
+        if (fp_in == NULL)
+        {
+            break;
+        }
+
+        fp_out = fopen(outfile, "wb");
+        if (fp_out == NULL)
+        {
+            vse_print_error("Error: Failed to open file %s for write\n", outfile);
+            ret = ERR_DECRYPT_FILE_FAILED_TO_OPEN_OUTPUT_FILE;
+            break;
+        }
+
+        ret = vse_reencrypt_fp(password, password_nbytes, cipher,
+                               new_password, new_password_nbytes, fp_in, fp_out);
+    } while (0);
+
+    if (fp_in != NULL)
+    {
+        fclose(fp_in);
+    }
+
+    if (fp_out != NULL)
+    {
+        fclose(fp_out);
+    }
+
+    return ret;
+}
+
+int vse_encrypt_file(int version, int cipher,
+                     const char *password, size_t password_nbytes,
+                     const char *infile, const char *outfile)
+{
+    if (version != 2)
+    {
+        return vse_encrypt_file_v1(cipher, password, password_nbytes, infile, outfile);
+    }
+
+    int ret = 0;
+    FILE *fp_in = NULL;
+    FILE *fp_out = NULL;
+    do
+    {
+        fp_in = fopen(infile, "rb");
+        if (fp_in == NULL)
+        {
+            vse_print_error("Error: Failed to open input file %s: %s\n", infile, strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_INPUT_FILE;
+            break;
+        }
+
+        fp_out = fopen(outfile, "wb");
+        if (fp_out == NULL)
+        {
+            vse_print_error("Error: Failed to open output file %s: %s\n", outfile, strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE;
+            break;
+        }
+
+        ret = vse_encrypt_fp_v2(cipher, password, password_nbytes, fp_in, fp_out);
+    } while (0);
+
+    if (fp_in != NULL)
+    {
+        fclose(fp_in);
+    }
+
+    if (fp_out != NULL)
+    {
+        fclose(fp_out);
+    }
+
+    return ret;
+}
+
+int vse_rekey_file(const char *password, size_t password_nbytes,
+                   const char *new_password, size_t new_password_nbytes,
+                   const char *infile)
+{
+    int ret = 0;
+    FILE *fp = fopen(infile, "r+b");
+    if (fp == NULL)
+    {
+        vse_print_error("Error: Failed to open file %s for update: %s\n", infile, strerror(errno));
+        return ERR_REKEY_FAILED_TO_OPEN_FILE;
+    }
+
+    uint8_t version = 0;
+    ret = vse_read_version(fp, &version);
+    if (ret == 0 && version != 2)
+    {
+        vse_print_error("Error: Only version 2 files can be re-keyed, use -R for %s\n", infile);
+        ret = ERR_REKEY_UNSUPPORTED_VERSION;
+    }
+
+    if (ret == 0)
+    {
+        ret = vse_rekey_fp_v2(password, password_nbytes,
+                              new_password, new_password_nbytes, fp);
+    }
+
+    if (fclose(fp) != 0 && ret == 0)
+    {
+        vse_print_error("Error: Failed to write file header: %s\n", strerror(errno));
+        ret = ERR_REKEY_FAILED_TO_WRITE_HEADER;
+    }
+
+    return ret;
+}
+
+int64_t vse_stat_mtime_ns(const struct stat *st)
+{
+#if _MSC_VER
+    return (int64_t)st->st_mtime * 1000000000;
+#elif defined(__APPLE__)
+    return (int64_t)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+char *vse_suffixed_path(const char *path, const char *suffix)
+{
+    char *ret = calloc(strlen(path) + strlen(suffix) + 1, 1);
+    if (ret == NULL)
+        return NULL;
+    strcpy(ret, path);
+    strcat(ret, suffix);
+    return ret;
+}
+
+static char *gen_tmp_filename(const char *path)
+{
+    uint8_t random_buf[4] = {0};
+    char buf[10] = {0};
+    crypto_random(random_buf, 4);
+
+    char suffix[10] = ".";
+    strcat(suffix, hexdump(random_buf, 4, buf));
+    return vse_suffixed_path(path, suffix);
+}
+
+// Flush a closed file, or on POSIX a folder, down to the disk.
+static int vse_sync_path(const char *path)
+{
+#if _MSC_VER
+    int fd = _open(path, _O_RDWR | _O_BINARY);
+    if (fd < 0)
+        return -1;
+    int ret = _commit(fd);
+    _close(fd);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    int ret = fsync(fd);
+    close(fd);
+#endif
+    return ret;
+}
+
+int vse_sync_file(FILE *fp)
+{
+    if (fflush(fp) != 0)
+        return -1;
+#if _MSC_VER
+    return _commit(_fileno(fp));
+#else
+    return fsync(fileno(fp));
+#endif
+}
+
+int vse_replace_file(const char *tmp_path, const char *path, int durable)
+{
+    if (durable && vse_sync_path(tmp_path) != 0)
+        return -1;
+
+#if _MSC_VER
+    DWORD flags = MOVEFILE_REPLACE_EXISTING | (durable ? MOVEFILE_WRITE_THROUGH : 0);
+    return MoveFileExA(tmp_path, path, flags) ? 0 : -1;
+#else
+    if (rename(tmp_path, path) != 0)
+        return -1;
+    if (!durable)
+        return 0;
+
+    // The rename itself is only on the disk once its folder is.
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL)
+        return vse_sync_path(".");
+    char *dir = strdup(path);
+    if (dir == NULL)
+        return -1;
+    dir[slash == path ? 1 : slash - path] = 0;
+    int ret = vse_sync_path(dir);
+    free(dir);
+    return ret;
+#endif
+}
+
+int vse_commit_tmp_file(FILE *fp, const char *tmp_path, const char *path, int sync)
+{
+    int failed = (sync ? vse_sync_file(fp) : fflush(fp)) != 0 || ferror(fp);
+    if (fclose(fp) != 0 || failed || vse_replace_file(tmp_path, path, 0) != 0)
+    {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int vse_run_on_file_untimed(const vse_run_opts_t *opts,
+                                   const char *infile, const char *outfile)
+{
+    if (opts->mode == MODE_VERIFY)
+    {
+        return vse_verify_file(opts->password, opts->password_nbytes, infile);
+    }
+
+    if (opts->mode == MODE_REKEY)
+    {
+        return vse_rekey_file(opts->password, opts->password_nbytes,
+                              opts->new_password, opts->new_password_nbytes, infile);
+    }
+
+    // A checkpointed run uses fixed names, so that --resume finds what an
+    // interrupted one left behind.
+    char *tmp_outfile = opts->checkpoint ? vse_suffixed_path(outfile, ".part")
+                                         : gen_tmp_filename(outfile);
+    if (tmp_outfile == NULL)
+    {
+        vse_print_error("Error: Out of memory\n");
+        return ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE;
+    }
+    int ret;
+
+    if (opts->mode == MODE_ENCRYPT && opts->checkpoint)
+    {
+        char *ckpt_path = vse_suffixed_path(outfile, ".ckpt");
+        if (ckpt_path == NULL)
+        {
+            vse_print_error("Error: Out of memory\n");
+            free(tmp_outfile);
+            return ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE;
+        }
+        ret = vse_encrypt_file_resumable_v1(opts->cipher, opts->password, opts->password_nbytes,
+                                            infile, tmp_outfile, ckpt_path, opts->resume);
+        free(ckpt_path);
+    }
+    else if (opts->mode == MODE_ENCRYPT)
+        ret = vse_encrypt_file(opts->version, opts->cipher,
+                               opts->password, opts->password_nbytes, infile, tmp_outfile);
+    else if (opts->mode == MODE_REENCRYPT)
+        ret = vse_reencrypt_file(opts->password, opts->password_nbytes, opts->cipher,
+                                 opts->new_password, opts->new_password_nbytes,
+                                 infile, tmp_outfile);
+    else
+        ret = vse_decrypt_file(opts->password, opts->password_nbytes, infile, tmp_outfile);
+
+    if (ret == 0)
+    {
+        uint64_t t = VSE_TIMING_NOW();
+        ret = vse_replace_file(tmp_outfile, outfile, opts->durable);
+        VSE_TIMING_LAP(VSE_PHASE_RENAME, t);
+        if (ret != 0)
+        {
+            vse_print_error("Error: Failed to rename output file: %s\n", strerror(errno));
+            unlink(tmp_outfile);
+        }
+    }
+    else if (!opts->checkpoint)
+    {
+        unlink(tmp_outfile);
+    }
+
+    free(tmp_outfile);
+
+    if (ret == 0 && opts->delete_infile && strcmp(infile, outfile) != 0)
+        unlink(infile);
+
+    return ret;
+}
+
+int vse_run_on_file(const vse_run_opts_t *opts,
+                    const char *infile, const char *outfile)
+{
+    vse_timing_t timing;
+    uint64_t t0 = vse_stats_file_begin(&timing, infile);
+    VSE_PROBE2(file__start, infile, opts->mode);
+
+    int ret = vse_run_on_file_untimed(opts, infile, outfile);
+
+    VSE_PROBE3(file__end, infile, opts->mode, ret);
+    vse_stats_file_end(&timing, t0, opts->mode, infile, ret);
+    return ret;
+}
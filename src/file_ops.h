@@ -0,0 +1,123 @@
+#ifndef FILE_OPS_9E1F4B27_3C6A_4D58_B0E2_71A5C8D94F16_H
+#define FILE_OPS_9E1F4B27_3C6A_4D58_B0E2_71A5C8D94F16_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/**
+ * Decrypt an already opened .vse stream (version byte first) into fp_out.
+ */
+int vse_decrypt_fp(const char *password, size_t password_nbytes,
+                   FILE *fp_in, FILE *fp_out);
+
+/**
+ * Decrypt infile into outfile.
+ */
+int vse_decrypt_file(const char *password, size_t password_nbytes,
+                     const char *infile, const char *outfile);
+
+/**
+ * Check the MAC of an already opened .vse stream without writing anything.
+ */
+int vse_verify_fp(const char *password, size_t password_nbytes,
+                  FILE *fp_in);
+
+/**
+ * Check the MAC of infile without writing anything.
+ */
+int vse_verify_file(const char *password, size_t password_nbytes,
+                    const char *infile);
+
+/**
+ * Re-encrypt an already opened .vse stream (version byte first) into fp_out
+ * under new_password, in one pass. cipher is the output's CIPHER_*, or
+ * CIPHER_UNKNOWN to keep the input's.
+ */
+int vse_reencrypt_fp(const char *password, size_t password_nbytes,
+                     int cipher,
+                     const char *new_password, size_t new_password_nbytes,
+                     FILE *fp_in, FILE *fp_out);
+
+/**
+ * Re-encrypt infile into outfile, see vse_reencrypt_fp().
+ */
+int vse_reencrypt_file(const char *password, size_t password_nbytes,
+                       int cipher,
+                       const char *new_password, size_t new_password_nbytes,
+                       const char *infile, const char *outfile);
+
+/**
+ * Encrypt infile into outfile as the given format version (1 or 2).
+ */
+int vse_encrypt_file(int version, int cipher,
+                     const char *password, size_t password_nbytes,
+                     const char *infile, const char *outfile);
+
+/**
+ * Move the key slot password opens in a version 2 infile over to
+ * new_password. Only the header is rewritten, in place.
+ */
+int vse_rekey_file(const char *password, size_t password_nbytes,
+                   const char *new_password, size_t new_password_nbytes,
+                   const char *infile);
+
+/**
+ * The modification time of st in nanoseconds (seconds only on Windows).
+ */
+int64_t vse_stat_mtime_ns(const struct stat *st);
+
+/**
+ * path with suffix appended, to free(); NULL if out of memory.
+ */
+char *vse_suffixed_path(const char *path, const char *suffix);
+
+/**
+ * Flush fp's buffer and the file down to the disk.
+ */
+int vse_sync_file(FILE *fp);
+
+/**
+ * Move tmp_path over path in one step: path is either the old file or the
+ * new one, never missing. With durable, tmp_path's data reaches the disk
+ * before the rename and the rename before returning, so that a power loss
+ * cannot leave path empty or half written.
+ */
+int vse_replace_file(const char *tmp_path, const char *path, int durable);
+
+/**
+ * Close fp, opened for writing on tmp_path, and move it over path with
+ * vse_replace_file(). With sync, fp reaches the disk first, so that path
+ * stays intact until its replacement is there. tmp_path is removed on
+ * failure.
+ *
+ * @return 0, or -1 on any write, sync or rename error.
+ */
+int vse_commit_tmp_file(FILE *fp, const char *tmp_path, const char *path, int sync);
+
+typedef struct vse_run_opts
+{
+    int mode;    // MODE_*
+    int cipher;  // CIPHER_*; for MODE_REENCRYPT, CIPHER_UNKNOWN keeps the input's
+    int version; // format written by MODE_ENCRYPT
+    const char *password;
+    size_t password_nbytes;
+    const char *new_password; // MODE_REENCRYPT and MODE_REKEY only
+    size_t new_password_nbytes;
+    int delete_infile;
+    int checkpoint; // MODE_ENCRYPT, version 1: write outfile.ckpt as it goes
+    int resume;     // with checkpoint: continue from outfile.ckpt if there is one
+    int durable;    // outfile on the disk before returning, see vse_replace_file()
+} vse_run_opts_t;
+
+/**
+ * Encrypt, decrypt or re-encrypt infile to outfile via a temp file, then
+ * rename into place; outfile may be infile. MODE_VERIFY only checks infile
+ * and MODE_REKEY rewrites its header in place; for both, outfile is ignored
+ * and may be NULL.
+ */
+int vse_run_on_file(const vse_run_opts_t *opts,
+                    const char *infile, const char *outfile);
+
+#endif
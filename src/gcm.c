@@ -0,0 +1,445 @@
+#include <string.h>
+#include "gcm.h"
+#include "cpu_features.h"
+
+static uint64_t get_be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_be64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--)
+    {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/*
+ * Portable GHASH: Shoup's 4-bit tables, x * H one nibble at a time.
+ */
+
+static const uint64_t g_last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0};
+
+static void vse_ghash_table(vse_gcm_t *gcm, const uint8_t *h)
+{
+    uint64_t vh = get_be64(h);
+    uint64_t vl = get_be64(h + 8);
+
+    gcm->hl[8] = vl;
+    gcm->hh[8] = vh;
+    gcm->hl[0] = 0;
+    gcm->hh[0] = 0;
+    for (int i = 4; i > 0; i >>= 1)
+    {
+        uint64_t t = (vl & 1) * 0xe1000000u;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (t << 32);
+        gcm->hl[i] = vl;
+        gcm->hh[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2)
+    {
+        for (int j = 1; j < i; j++)
+        {
+            gcm->hh[i + j] = gcm->hh[i] ^ gcm->hh[j];
+            gcm->hl[i + j] = gcm->hl[i] ^ gcm->hl[j];
+        }
+    }
+}
+
+static void vse_ghash_mult(const vse_gcm_t *gcm, const uint8_t *x, uint8_t *out)
+{
+    uint8_t lo = x[15] & 0xf;
+    uint64_t zh = gcm->hh[lo];
+    uint64_t zl = gcm->hl[lo];
+
+    for (int i = 15; i >= 0; i--)
+    {
+        uint8_t hi = x[i] >> 4;
+        uint8_t rem;
+        lo = x[i] & 0xf;
+        if (i != 15)
+        {
+            rem = zl & 0xf;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (g_last4[rem] << 48);
+            zh ^= gcm->hh[lo];
+            zl ^= gcm->hl[lo];
+        }
+        rem = zl & 0xf;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (g_last4[rem] << 48);
+        zh ^= gcm->hh[hi];
+        zl ^= gcm->hl[hi];
+    }
+    put_be64(out, zh);
+    put_be64(out + 8, zl);
+}
+
+void vse_ghash_blocks(vse_gcm_t *gcm, const uint8_t *in, size_t nblocks)
+{
+    for (; nblocks > 0; nblocks--, in += 16)
+    {
+        for (int i = 0; i < 16; i++)
+            gcm->x[i] ^= in[i];
+        vse_ghash_mult(gcm, gcm->x, gcm->x);
+    }
+}
+
+void vse_gcm_encrypt_blocks(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nblocks)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+    kern->aes_ctr_xcrypt(aes, buf, nblocks * 16);
+    kern->ghash_blocks(gcm, buf, nblocks);
+}
+
+/*
+ * Messages.
+ */
+
+static void vse_gcm_absorb(vse_gcm_t *gcm, const uint8_t *buf, size_t nbytes)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+
+    if (gcm->buf_len > 0)
+    {
+        size_t n = 16 - gcm->buf_len;
+        if (n > nbytes)
+            n = nbytes;
+        memcpy(gcm->buf + gcm->buf_len, buf, n);
+        gcm->buf_len += n;
+        buf += n;
+        nbytes -= n;
+        if (gcm->buf_len < 16)
+            return;
+        kern->ghash_blocks(gcm, gcm->buf, 1);
+        gcm->buf_len = 0;
+    }
+
+    kern->ghash_blocks(gcm, buf, nbytes / 16);
+    buf += nbytes & ~(size_t)15;
+    nbytes &= 15;
+    memcpy(gcm->buf, buf, nbytes);
+    gcm->buf_len = nbytes;
+}
+
+// Zero-pad a partial block into the hash: aad and ciphertext each end on one.
+static void vse_gcm_pad(vse_gcm_t *gcm)
+{
+    if (gcm->buf_len == 0)
+        return;
+    memset(gcm->buf + gcm->buf_len, 0, 16 - gcm->buf_len);
+    vse_cpu_dispatch()->ghash_blocks(gcm, gcm->buf, 1);
+    gcm->buf_len = 0;
+}
+
+void vse_gcm_init(vse_gcm_t *gcm, aes_ctx_t *aes,
+                  const uint8_t *key,
+                  const uint8_t *nonce,
+                  const uint8_t *aad, size_t aad_nbytes)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+    aes_ctx_t local;
+    uint8_t block[16] = {0};
+    uint8_t h[16] = {0};
+
+    if (aes == NULL)
+        aes = &local;
+    memset(gcm, 0, sizeof(vse_gcm_t));
+
+    // H = E(K, 0^128)
+    AES_init_ctx_iv(aes, key, block);
+    kern->aes_ctr_xcrypt(aes, h, sizeof(h));
+    vse_ghash_table(gcm, h);
+
+    // H^1..H^8 for the aggregated PCLMULQDQ loops, highest byte first.
+    uint8_t p[16];
+    memcpy(p, h, 16);
+    for (int k = 0; k < 8; k++)
+    {
+        for (int i = 0; i < 16; i++)
+            gcm->hpow[k][i] = p[15 - i];
+        vse_ghash_mult(gcm, p, p);
+    }
+
+    // J0 = nonce || 1: E(K, J0) masks the tag, J0 + 1 starts the keystream.
+    memcpy(block, nonce, VSE_GCM_NONCE_LEN);
+    block[15] = 1;
+    AES_ctx_set_iv(aes, block);
+    kern->aes_ctr_xcrypt(aes, gcm->ek0, sizeof(gcm->ek0));
+
+    vse_gcm_absorb(gcm, aad, aad_nbytes);
+    vse_gcm_pad(gcm);
+    gcm->aad_nbytes = aad_nbytes;
+
+    memset(h, 0, sizeof(h));
+    memset(p, 0, sizeof(p));
+    if (aes == &local)
+        memset(&local, 0, sizeof(local));
+}
+
+void vse_gcm_update(vse_gcm_t *gcm, const uint8_t *buf, size_t nbytes)
+{
+    gcm->nbytes += nbytes;
+    vse_gcm_absorb(gcm, buf, nbytes);
+}
+
+void vse_gcm_encrypt(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nbytes)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+
+    if (gcm->buf_len == 0)
+    {
+        size_t nblocks = nbytes / 16;
+        kern->gcm_encrypt_blocks(gcm, aes, buf, nblocks);
+        gcm->nbytes += nblocks * 16;
+        buf += nblocks * 16;
+        nbytes -= nblocks * 16;
+    }
+    kern->aes_ctr_xcrypt(aes, buf, nbytes);
+    vse_gcm_update(gcm, buf, nbytes);
+}
+
+void vse_gcm_final(vse_gcm_t *gcm, uint8_t *tag)
+{
+    uint8_t lens[16];
+
+    vse_gcm_pad(gcm);
+    put_be64(lens, gcm->aad_nbytes * 8);
+    put_be64(lens + 8, gcm->nbytes * 8);
+    vse_cpu_dispatch()->ghash_blocks(gcm, lens, 1);
+
+    for (int i = 0; i < VSE_GCM_TAG_LEN; i++)
+        tag[i] = gcm->x[i] ^ gcm->ek0[i];
+    memset(gcm, 0, sizeof(vse_gcm_t));
+}
+
+/*
+ * PCLMULQDQ. Blocks are byte-reversed on load, so that GF(2^128) elements
+ * sit in the bit order carry-less multiplication works in, and products
+ * are reduced as in Intel's "Carry-Less Multiplication Instruction and its
+ * Usage for Computing the GCM Mode" (Gueron, Kounavis). The reduction is
+ * linear, so the sum of 8 products takes a single one:
+ *
+ *     X' = (X + C0) H^8 + C1 H^7 + ... + C7 H
+ */
+
+#if VSE_X86
+#include <immintrin.h>
+
+#define GCM_ROUNDS 14 // AES-256
+#define GCM_LANES 8
+
+VSE_TARGET("sse2,ssse3,pclmul")
+static inline __m128i vse_bswap128(__m128i v)
+{
+    return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// lo, mid, hi += the 256-bit carry-less product a * b, unreduced.
+VSE_TARGET("sse2,ssse3,pclmul")
+static inline void vse_clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x10));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x01));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+}
+
+VSE_TARGET("sse2,ssse3,pclmul")
+static inline __m128i vse_ghash_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t3 = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    __m128i t6 = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    __m128i t7, t8, t9, t2;
+
+    // Shift the product left by one: the operands are bit-reflected.
+    t7 = _mm_srli_epi32(t3, 31);
+    t8 = _mm_srli_epi32(t6, 31);
+    t3 = _mm_slli_epi32(t3, 1);
+    t6 = _mm_slli_epi32(t6, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    t3 = _mm_or_si128(t3, t7);
+    t6 = _mm_or_si128(t6, t8);
+    t6 = _mm_or_si128(t6, t9);
+
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+    t7 = _mm_slli_epi32(t3, 31);
+    t8 = _mm_slli_epi32(t3, 30);
+    t9 = _mm_slli_epi32(t3, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    t3 = _mm_xor_si128(t3, t7);
+
+    t2 = _mm_srli_epi32(t3, 1);
+    t7 = _mm_srli_epi32(t3, 2);
+    t9 = _mm_srli_epi32(t3, 7);
+    t2 = _mm_xor_si128(t2, t7);
+    t2 = _mm_xor_si128(t2, t9);
+    t2 = _mm_xor_si128(t2, t8);
+    t3 = _mm_xor_si128(t3, t2);
+    return _mm_xor_si128(t6, t3);
+}
+
+VSE_TARGET("sse2,ssse3,pclmul")
+static inline __m128i vse_ghash_one(__m128i x, __m128i c, __m128i h)
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    vse_clmul_acc(_mm_xor_si128(x, c), h, &lo, &mid, &hi);
+    return vse_ghash_reduce(lo, mid, hi);
+}
+
+VSE_TARGET("sse2,ssse3,pclmul")
+void vse_ghash_blocks_clmul(vse_gcm_t *gcm, const uint8_t *in, size_t nblocks)
+{
+    __m128i hp[GCM_LANES];
+    __m128i x = vse_bswap128(_mm_loadu_si128((const __m128i *)gcm->x));
+
+    for (int k = 0; k < GCM_LANES; k++)
+        hp[k] = _mm_loadu_si128((const __m128i *)gcm->hpow[k]);
+
+    while (nblocks >= GCM_LANES)
+    {
+        __m128i lo = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        for (int i = 0; i < GCM_LANES; i++)
+        {
+            __m128i c = vse_bswap128(_mm_loadu_si128((const __m128i *)(in + i * 16)));
+            if (i == 0)
+                c = _mm_xor_si128(c, x);
+            vse_clmul_acc(c, hp[GCM_LANES - 1 - i], &lo, &mid, &hi);
+        }
+        x = vse_ghash_reduce(lo, mid, hi);
+        in += GCM_LANES * 16;
+        nblocks -= GCM_LANES;
+    }
+
+    for (; nblocks > 0; nblocks--, in += 16)
+        x = vse_ghash_one(x, vse_bswap128(_mm_loadu_si128((const __m128i *)in)), hp[0]);
+
+    _mm_storeu_si128((__m128i *)gcm->x, vse_bswap128(x));
+}
+
+#if _MSC_VER
+#include <stdlib.h>
+#define vse_bswap64(x) _byteswap_uint64(x)
+#else
+#define vse_bswap64(x) __builtin_bswap64(x)
+#endif
+
+// The AES_CTR_xcrypt_buffer() counter, as in aes_ni.c.
+VSE_TARGET("sse2,aes")
+static inline __m128i vse_gcm_next_counter(uint64_t *hi, uint64_t *lo)
+{
+    __m128i block = _mm_set_epi64x((long long)vse_bswap64(*lo), (long long)vse_bswap64(*hi));
+    if (++*lo == 0)
+        ++*hi;
+    return block;
+}
+
+VSE_TARGET("sse2,ssse3,aes,pclmul")
+void vse_gcm_encrypt_blocks_aesni(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nblocks)
+{
+    __m128i rk[GCM_ROUNDS + 1];
+    __m128i hp[GCM_LANES];
+    __m128i b[GCM_LANES];
+    __m128i c[GCM_LANES]; // previous ciphertext, byte-reversed, not hashed yet
+    int pending = 0;
+    __m128i x = vse_bswap128(_mm_loadu_si128((const __m128i *)gcm->x));
+    uint64_t hi = get_be64(aes->Iv);
+    uint64_t lo = get_be64(aes->Iv + 8);
+
+    for (int r = 0; r <= GCM_ROUNDS; r++)
+        rk[r] = _mm_loadu_si128((const __m128i *)(aes->RoundKey + r * AES_BLOCKLEN));
+    for (int k = 0; k < GCM_LANES; k++)
+        hp[k] = _mm_loadu_si128((const __m128i *)gcm->hpow[k]);
+
+    while (nblocks >= GCM_LANES)
+    {
+        __m128i glo = _mm_setzero_si128();
+        __m128i gmid = _mm_setzero_si128();
+        __m128i ghi = _mm_setzero_si128();
+
+        for (int i = 0; i < GCM_LANES; i++)
+            b[i] = _mm_xor_si128(vse_gcm_next_counter(&hi, &lo), rk[0]);
+        if (pending)
+            c[0] = _mm_xor_si128(c[0], x);
+
+        // One product of the previous 8 blocks per round, while the AES
+        // units work on the next 8.
+        for (int r = 1; r < GCM_ROUNDS; r++)
+        {
+            for (int i = 0; i < GCM_LANES; i++)
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+            if (pending && r <= GCM_LANES)
+                vse_clmul_acc(c[r - 1], hp[GCM_LANES - r], &glo, &gmid, &ghi);
+        }
+        if (pending)
+            x = vse_ghash_reduce(glo, gmid, ghi);
+
+        for (int i = 0; i < GCM_LANES; i++)
+        {
+            __m128i *p = (__m128i *)(buf + i * AES_BLOCKLEN);
+            __m128i out = _mm_xor_si128(_mm_loadu_si128(p), _mm_aesenclast_si128(b[i], rk[GCM_ROUNDS]));
+            _mm_storeu_si128(p, out);
+            c[i] = vse_bswap128(out);
+        }
+        pending = 1;
+        buf += GCM_LANES * AES_BLOCKLEN;
+        nblocks -= GCM_LANES;
+    }
+
+    if (pending)
+    {
+        __m128i glo = _mm_setzero_si128();
+        __m128i gmid = _mm_setzero_si128();
+        __m128i ghi = _mm_setzero_si128();
+        c[0] = _mm_xor_si128(c[0], x);
+        for (int i = 0; i < GCM_LANES; i++)
+            vse_clmul_acc(c[i], hp[GCM_LANES - 1 - i], &glo, &gmid, &ghi);
+        x = vse_ghash_reduce(glo, gmid, ghi);
+    }
+
+    for (; nblocks > 0; nblocks--, buf += AES_BLOCKLEN)
+    {
+        __m128i k = _mm_xor_si128(vse_gcm_next_counter(&hi, &lo), rk[0]);
+        for (int r = 1; r < GCM_ROUNDS; r++)
+            k = _mm_aesenc_si128(k, rk[r]);
+        __m128i out = _mm_xor_si128(_mm_loadu_si128((const __m128i *)buf),
+                                    _mm_aesenclast_si128(k, rk[GCM_ROUNDS]));
+        _mm_storeu_si128((__m128i *)buf, out);
+        x = vse_ghash_one(x, vse_bswap128(out), hp[0]);
+    }
+
+    _mm_storeu_si128((__m128i *)gcm->x, vse_bswap128(x));
+    put_be64(aes->Iv, hi);
+    put_be64(aes->Iv + 8, lo);
+}
+
+#else
+
+void vse_ghash_blocks_clmul(vse_gcm_t *gcm, const uint8_t *in, size_t nblocks)
+{
+    vse_ghash_blocks(gcm, in, nblocks);
+}
+
+void vse_gcm_encrypt_blocks_aesni(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nblocks)
+{
+    vse_gcm_encrypt_blocks(gcm, aes, buf, nblocks);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef GCM_8D2F6A14_5C3B_4E97_A1D0_6B9E4F27C853_H
+#define GCM_8D2F6A14_5C3B_4E97_A1D0_6B9E4F27C853_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "aes/aes.h"
+
+/*
+ * AES-256-GCM (NIST SP 800-38D) with a 96-bit nonce.
+ *
+ * The CTR part runs on the AES_CTR_xcrypt_buffer() counter, the whole 16
+ * bytes taken as one big-endian number, where GCM only increments the last
+ * 32 bits: both agree for the first 2^32 - 2 blocks of a nonce, i.e. up to
+ * 64 GiB, the most GCM allows for one nonce anyway.
+ *
+ * GHASH runs on 4-bit tables (Shoup), or on PCLMULQDQ, 8 blocks per
+ * reduction; with AES-NI as well, encryption is one stitched loop: the AES
+ * rounds of 8 blocks interleave with the GHASH of the 8 before.
+ */
+
+#define VSE_GCM_NONCE_LEN 12
+#define VSE_GCM_TAG_LEN 16
+
+typedef struct vse_gcm
+{
+    uint64_t hl[16];      // 4-bit multiplication table of H, low halves
+    uint64_t hh[16];      // and high halves
+    uint8_t hpow[8][16];  // H^1..H^8, byte-reversed for PCLMULQDQ
+    uint8_t x[16];        // GHASH so far
+    uint8_t ek0[16];      // E(K, J0), masks the tag
+    uint8_t buf[16];      // partial ciphertext block
+    size_t buf_len;
+    uint64_t aad_nbytes;
+    uint64_t nbytes;      // ciphertext hashed
+} vse_gcm_t;
+
+/**
+ * Start a message: hash key, tag mask and aad from key and nonce. If aes is
+ * not NULL, it is set up with key and its counter at J0 + 1, ready for
+ * vse_gcm_encrypt() or a plain CTR decrypt.
+ */
+void vse_gcm_init(vse_gcm_t *gcm, aes_ctx_t *aes,
+                  const uint8_t *key, // 32 bytes
+                  const uint8_t *nonce, // VSE_GCM_NONCE_LEN bytes
+                  const uint8_t *aad, size_t aad_nbytes);
+
+/**
+ * Add ciphertext to the tag. Any length, in as many calls as wanted.
+ */
+void vse_gcm_update(vse_gcm_t *gcm, const uint8_t *buf, size_t nbytes);
+
+/**
+ * Encrypt buf in place and add it to the tag. Every call but the last of a
+ * message must be a multiple of 16 bytes.
+ */
+void vse_gcm_encrypt(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nbytes);
+
+/**
+ * Finish the message.
+ */
+void vse_gcm_final(vse_gcm_t *gcm, uint8_t *tag); // VSE_GCM_TAG_LEN bytes
+
+/*
+ * Kernels, picked by vse_cpu_dispatch(). They take whole blocks and leave
+ * the byte counts to the functions above.
+ */
+void vse_ghash_blocks(vse_gcm_t *gcm, const uint8_t *in, size_t nblocks);
+void vse_gcm_encrypt_blocks(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nblocks);
+
+// Only call them when vse_cpu_features() has VSE_CPU_SSSE3 and
+// VSE_CPU_PCLMUL, and VSE_CPU_AESNI for the second.
+void vse_ghash_blocks_clmul(vse_gcm_t *gcm, const uint8_t *in, size_t nblocks);
+void vse_gcm_encrypt_blocks_aesni(vse_gcm_t *gcm, aes_ctx_t *aes, uint8_t *buf, size_t nblocks);
+
+#endif
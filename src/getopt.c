@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "getopt.h"
 
 int	opterr = 1,		/* if error message should be printed */
 	optind = 1,		/* index into parent argv vector */
@@ -43,6 +44,8 @@ char	*optarg;		/* argument associated with option */
 #define	BADARG	(int)':'
 #define	EMSG	""
 
+static char *place = EMSG;		/* option letter processing */
+
 /*
  * getopt --
  *	Parse argc/argv argument vector.
@@ -51,7 +54,6 @@ int getopt(int nargc,
 		   char* const nargv[],
 	   	   const char* ostr)
 {
-	static char *place = EMSG;		/* option letter processing */
 	char *oli;				/* option letter list index */
 
 	if (optreset || *place == 0) {		/* update scanning pointer */
@@ -120,3 +122,80 @@ int getopt(int nargc,
 	}
 	return (optopt);			/* return option letter */
 }
+
+/*
+ * getopt_long --
+ *	Parse argc/argv argument vector, accepting "--name", "--name=value"
+ *	and "--name value" in addition to everything getopt() accepts.
+ */
+int getopt_long(int nargc,
+		char* const nargv[],
+		const char* ostr,
+		const struct option* longopts,
+		int* longindex)
+{
+	const struct option *o;
+	const char *name, *eq;
+	size_t namelen;
+
+	if (optreset || *place == 0) {
+		if (optind >= nargc || nargv[optind][0] != '-' ||
+		    nargv[optind][1] != '-' || nargv[optind][2] == 0)
+			return getopt(nargc, nargv, ostr);
+
+		optreset = 0;
+		place = EMSG;
+		name = nargv[optind] + 2;
+		eq = strchr(name, '=');
+		namelen = eq ? (size_t)(eq - name) : strlen(name);
+		++optind;
+
+		for (o = longopts; o != NULL && o->name != NULL; ++o) {
+			if (strlen(o->name) == namelen &&
+			    strncmp(o->name, name, namelen) == 0)
+				break;
+		}
+		if (o == NULL || o->name == NULL) {
+			optopt = 0;
+			if (opterr && *ostr != ':')
+				(void)fprintf(stderr,
+				    "%s: illegal option -- %s\n", nargv[0],
+				    name);
+			return (BADCH);
+		}
+
+		optopt = o->val;
+		optarg = NULL;
+		if (o->has_arg == no_argument) {
+			if (eq != NULL) {
+				if (opterr && *ostr != ':')
+					(void)fprintf(stderr,
+					    "%s: option does not take an argument -- %s\n",
+					    nargv[0], o->name);
+				return (BADCH);
+			}
+		} else if (eq != NULL) {
+			optarg = (char *)eq + 1;
+		} else if (optind < nargc) {
+			optarg = nargv[optind++];
+		} else {
+			if (*ostr == ':')
+				return (BADARG);
+			if (opterr)
+				(void)fprintf(stderr,
+				    "%s: option requires an argument -- %s\n",
+				    nargv[0], o->name);
+			return (BADCH);
+		}
+
+		if (longindex != NULL)
+			*longindex = (int)(o - longopts);
+		if (o->flag != NULL) {
+			*o->flag = o->val;
+			return (0);
+		}
+		return (o->val);
+	}
+
+	return getopt(nargc, nargv, ostr);
+}
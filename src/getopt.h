@@ -11,3 +11,20 @@ extern char *optarg;         /* argument associated with option */
 int getopt(int argc,
            char *const argv[],
            const char *optstring);
+
+#define no_argument 0
+#define required_argument 1
+
+struct option
+{
+    const char *name; /* long option name, without the leading "--" */
+    int has_arg;      /* no_argument or required_argument */
+    int *flag;        /* if not NULL, set *flag to val and return 0 */
+    int val;          /* value to return (or store in *flag) */
+};
+
+int getopt_long(int argc,
+                char *const argv[],
+                const char *optstring,
+                const struct option *longopts,
+                int *longindex);
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "vse.h"
+#include "journal.h"
+#include "sync.h"
+#include "timing.h"
+#include "file_ops.h"
+
+#define JOURNAL_MAGIC "vsencrypt-journal 1"
+
+struct vse_journal
+{
+    char *path;
+
+    // Loaded by --resume, sorted by path: "F path" or "D path".
+    char **done;
+    size_t done_count;
+
+    vse_mutex_t lock; // guards everything below
+    FILE *fp;
+    int failed;
+    size_t unsynced;
+    uint64_t t_synced;
+};
+
+static int vse_journal_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a + 2, *(char *const *)b + 2);
+}
+
+/* Undo the escaping of vse_journal_write() in place. */
+static void vse_journal_unescape(char *s)
+{
+    char *out = s;
+    for (; *s; s++)
+    {
+        if (*s == '\\' && s[1] != '\0')
+        {
+            s++;
+            *out++ = *s == 'n' ? '\n' : *s;
+        }
+        else
+        {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+}
+
+/*
+ * Load the finished paths of the journal in buf. Only whole lines count: a
+ * crash may have cut the last one short, and what is left of it may well be
+ * the path of something else.
+ */
+static int vse_journal_parse(vse_journal_t *j, char *buf, size_t len, int mode)
+{
+    char header[64];
+    snprintf(header, sizeof(header), JOURNAL_MAGIC " %d\n", mode);
+    if (len == 0)
+        return 0; // created, but nothing made it to disk
+    if (len < strlen(header) || memcmp(buf, header, strlen(header)) != 0)
+        return ERR_JOURNAL_MODE_MISMATCH;
+
+    size_t cap = 0;
+    char *line = buf + strlen(header);
+    char *end = buf + len;
+    char *nl;
+    while (line < end && (nl = memchr(line, '\n', (size_t)(end - line))) != NULL)
+    {
+        *nl = '\0';
+        if ((line[0] == 'F' || line[0] == 'D') && line[1] == ' ')
+        {
+            if (j->done_count == cap)
+            {
+                cap = cap ? cap * 2 : 1024;
+                j->done = realloc(j->done, cap * sizeof(char *));
+            }
+            vse_journal_unescape(line + 2);
+            j->done[j->done_count++] = strdup(line);
+        }
+        line = nl + 1;
+    }
+
+    qsort(j->done, j->done_count, sizeof(char *), vse_journal_cmp);
+    return 0;
+}
+
+static int vse_journal_load(vse_journal_t *j, int mode)
+{
+    FILE *fp = fopen(j->path, "rb");
+    if (fp == NULL)
+        return errno == ENOENT ? 0 : ERR_JOURNAL_FAILED_TO_OPEN;
+
+    size_t cap = 64 * 1024;
+    size_t len = 0;
+    char *buf = malloc(cap);
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len, fp)) > 0)
+    {
+        len += n;
+        if (len == cap)
+        {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+    }
+    int failed = ferror(fp);
+    fclose(fp);
+
+    int ret = failed ? ERR_JOURNAL_FAILED_TO_OPEN : vse_journal_parse(j, buf, len, mode);
+    free(buf);
+    return ret;
+}
+
+static void vse_journal_write(FILE *fp, char type, const char *relpath)
+{
+    fputc(type, fp);
+    fputc(' ', fp);
+    for (const char *p = relpath; *p; p++)
+    {
+        if (*p == '\\' || *p == '\n')
+            fputc('\\', fp);
+        fputc(*p == '\n' ? 'n' : *p, fp);
+    }
+    fputc('\n', fp);
+}
+
+/*
+ * Rewrite the journal with just what was loaded, through a temp file and
+ * rename(): this drops a torn last line before anything is appended to it.
+ */
+static int vse_journal_rewrite(vse_journal_t *j, int mode)
+{
+    char *tmp_path = vse_suffixed_path(j->path, ".tmp");
+    if (tmp_path == NULL)
+        return ERR_JOURNAL_FAILED_TO_WRITE;
+
+    int ret = ERR_JOURNAL_FAILED_TO_WRITE;
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp != NULL)
+    {
+        fprintf(fp, JOURNAL_MAGIC " %d\n", mode);
+        for (size_t i = 0; i < j->done_count; i++)
+            vse_journal_write(fp, j->done[i][0], j->done[i] + 2);
+        if (vse_commit_tmp_file(fp, tmp_path, j->path, 1) == 0)
+            ret = 0;
+    }
+
+    free(tmp_path);
+    return ret;
+}
+
+vse_journal_t *vse_journal_open(const char *path, int mode, int resume, int *ret)
+{
+    vse_journal_t *j = calloc(1, sizeof(vse_journal_t));
+    j->path = strdup(path);
+    vse_mutex_init(&j->lock);
+    j->t_synced = vse_now_ns();
+
+    *ret = 0;
+    if (resume)
+    {
+        *ret = vse_journal_load(j, mode);
+        if (*ret == 0)
+            *ret = vse_journal_rewrite(j, mode);
+        if (*ret == 0)
+        {
+            j->fp = fopen(path, "ab");
+        }
+    }
+    else
+    {
+        j->fp = fopen(path, "wb");
+        if (j->fp != NULL)
+            fprintf(j->fp, JOURNAL_MAGIC " %d\n", mode);
+    }
+
+    if (*ret == 0 && j->fp == NULL)
+        *ret = ERR_JOURNAL_FAILED_TO_OPEN;
+    if (*ret != 0)
+    {
+        vse_journal_close(j, 0);
+        return NULL;
+    }
+    return j;
+}
+
+int vse_journal_done(const vse_journal_t *j, const char *relpath)
+{
+    size_t lo = 0;
+    size_t hi = j->done_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = strcmp(relpath, j->done[mid] + 2);
+        if (c == 0)
+            return 1;
+        if (c < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return 0;
+}
+
+static void vse_journal_sync(vse_journal_t *j)
+{
+    if (vse_sync_file(j->fp) != 0)
+        j->failed = 1;
+    j->unsynced = 0;
+    j->t_synced = vse_now_ns();
+}
+
+static void vse_journal_append(vse_journal_t *j, char type, const char *relpath)
+{
+    vse_mutex_lock(&j->lock);
+
+    vse_journal_write(j->fp, type, relpath);
+    if (ferror(j->fp))
+        j->failed = 1;
+
+    if (++j->unsynced >= VSE_JOURNAL_SYNC_RECORDS ||
+        vse_now_ns() - j->t_synced >= VSE_JOURNAL_SYNC_NS)
+        vse_journal_sync(j);
+
+    vse_mutex_unlock(&j->lock);
+}
+
+void vse_journal_file_done(vse_journal_t *j, const char *relpath)
+{
+    vse_journal_append(j, 'F', relpath);
+}
+
+void vse_journal_dir_done(vse_journal_t *j, const char *relpath)
+{
+    vse_journal_append(j, 'D', relpath);
+}
+
+int vse_journal_close(vse_journal_t *j, int complete)
+{
+    int ret = 0;
+    if (j->fp != NULL)
+    {
+        vse_journal_sync(j);
+        if (fclose(j->fp) != 0 || j->failed)
+            ret = ERR_JOURNAL_FAILED_TO_WRITE;
+        if (ret == 0 && complete)
+            remove(j->path);
+    }
+
+    for (size_t i = 0; i < j->done_count; i++)
+        free(j->done[i]);
+    free(j->done);
+    vse_mutex_destroy(&j->lock);
+    free(j->path);
+    free(j);
+    return ret;
+}
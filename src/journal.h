@@ -0,0 +1,56 @@
+#ifndef JOURNAL_D2B94E57_8C1A_4F36_A07E_5B3F9C6182DA_H
+#define JOURNAL_D2B94E57_8C1A_4F36_A07E_5B3F9C6182DA_H
+
+/*
+ * --journal: an append-only record of a folder run's progress, so that
+ * --resume can pick up where a crashed or killed run stopped.
+ *
+ * Every line is "F path" for a file whose output is in place, or "D path"
+ * for a folder whose whole subtree is done; paths are relative to -i. A
+ * resumed run skips both without looking at them, so finished subtrees are
+ * not even listed again.
+ *
+ * Lines are fsynced in batches (VSE_JOURNAL_SYNC_RECORDS lines or
+ * VSE_JOURNAL_SYNC_NS, whichever comes first). A crash loses at most the
+ * last batch, whose files are then simply processed again: outputs are
+ * only renamed into place when complete, so redoing one is harmless.
+ */
+
+#define VSE_JOURNAL_SYNC_RECORDS 256
+#define VSE_JOURNAL_SYNC_NS 1000000000ull
+
+typedef struct vse_journal vse_journal_t;
+
+/**
+ * Start journaling a run in mode MODE_* to path. With resume, first load
+ * what path already records; it must be from a run in the same mode. A
+ * missing file is an empty journal either way.
+ *
+ * @return NULL with *ret set to ERR_JOURNAL_FAILED_TO_OPEN or
+ *         ERR_JOURNAL_MODE_MISMATCH.
+ */
+vse_journal_t *vse_journal_open(const char *path, int mode, int resume, int *ret);
+
+/**
+ * @return 1 if the loaded journal has relpath as a finished file or folder.
+ */
+int vse_journal_done(const vse_journal_t *j, const char *relpath);
+
+/**
+ * Append a finished file. Thread-safe.
+ */
+void vse_journal_file_done(vse_journal_t *j, const char *relpath);
+
+/**
+ * Append a finished folder. Thread-safe.
+ */
+void vse_journal_dir_done(vse_journal_t *j, const char *relpath);
+
+/**
+ * Sync and close the journal, and delete it if complete (the run succeeded).
+ *
+ * @return 0 or ERR_JOURNAL_FAILED_TO_WRITE if any line failed to write.
+ */
+int vse_journal_close(vse_journal_t *j, int complete);
+
+#endif
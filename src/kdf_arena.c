@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include "vse.h"
+#include "kdf_arena.h"
+#include "numa.h"
+#include "argon2/include/argon2.h"
+
+typedef struct vse_kdf_arena
+{
+    int enabled;
+    int in_use;
+    uint8_t *memory;
+    size_t nbytes;
+    int lent_in_use;
+    uint8_t *lent; // caller-owned, never freed here
+    size_t lent_nbytes;
+} vse_kdf_arena_t;
+
+static VSE_THREAD_LOCAL vse_kdf_arena_t g_arena;
+
+void vse_kdf_arena_enable(void)
+{
+    g_arena.enabled = 1;
+}
+
+void vse_kdf_arena_release(void)
+{
+    vse_numa_free(g_arena.memory, g_arena.nbytes);
+    g_arena.memory = NULL;
+    g_arena.nbytes = 0;
+    g_arena.in_use = 0;
+    g_arena.enabled = 0;
+}
+
+void vse_kdf_arena_lend(uint8_t *memory, size_t nbytes)
+{
+    g_arena.lent = memory;
+    g_arena.lent_nbytes = memory == NULL ? 0 : nbytes;
+    g_arena.lent_in_use = 0;
+}
+
+int vse_kdf_alloc(uint8_t **memory, size_t nbytes)
+{
+    if (g_arena.lent != NULL && !g_arena.lent_in_use && g_arena.lent_nbytes >= nbytes)
+    {
+        g_arena.lent_in_use = 1;
+        *memory = g_arena.lent;
+        return ARGON2_OK;
+    }
+
+    if (!g_arena.enabled || g_arena.in_use)
+    {
+        *memory = vse_numa_alloc(nbytes);
+        return *memory == NULL ? ARGON2_MEMORY_ALLOCATION_ERROR : ARGON2_OK;
+    }
+
+    if (g_arena.nbytes < nbytes)
+    {
+        vse_numa_free(g_arena.memory, g_arena.nbytes);
+        g_arena.memory = vse_numa_alloc(nbytes);
+        g_arena.nbytes = g_arena.memory == NULL ? 0 : nbytes;
+        if (g_arena.memory == NULL)
+        {
+            *memory = NULL;
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
+    }
+
+    g_arena.in_use = 1;
+    *memory = g_arena.memory;
+    return ARGON2_OK;
+}
+
+void vse_kdf_free(uint8_t *memory, size_t nbytes)
+{
+    if (memory != NULL && memory == g_arena.lent)
+    {
+        g_arena.lent_in_use = 0;
+        return;
+    }
+    if (memory != NULL && memory == g_arena.memory)
+    {
+        g_arena.in_use = 0;
+        return;
+    }
+    vse_numa_free(memory, nbytes);
+}
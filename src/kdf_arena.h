@@ -0,0 +1,36 @@
+#ifndef KDF_ARENA_5C0D7E2A_8B3F_4F61_9A77_2E4B1C6D0F93_H
+#define KDF_ARENA_5C0D7E2A_8B3F_4F61_9A77_2E4B1C6D0F93_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Keep Argon2 working memory alive between KDF calls on this thread.
+ *
+ * vse_gen_key_v1() needs 64 MiB per call. Long-lived workers call this once
+ * so later calls reuse the same (already faulted-in) pages instead of going
+ * back to the allocator. Argon2 wipes the memory before handing it back.
+ */
+void vse_kdf_arena_enable(void);
+
+/**
+ * Release this thread's arena, if any, and go back to malloc/free.
+ */
+void vse_kdf_arena_release(void);
+
+/**
+ * Let KDF calls made on this thread use caller-owned memory until
+ * vse_kdf_arena_lend(NULL, 0). Calls that need more than nbytes, or that
+ * run while the memory is already in use, fall back to the arena/malloc.
+ */
+void vse_kdf_arena_lend(uint8_t *memory, size_t nbytes);
+
+/**
+ * Argon2 allocate_cbk/free_cbk. Fall back to vse_numa_alloc/vse_numa_free
+ * (malloc/free unless NUMA placement is on) when the calling thread has no
+ * arena enabled. Arenas are allocated the same way, on the worker's node.
+ */
+int vse_kdf_alloc(uint8_t **memory, size_t nbytes);
+void vse_kdf_free(uint8_t *memory, size_t nbytes);
+
+#endif
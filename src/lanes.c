@@ -0,0 +1,476 @@
+#include <string.h>
+#include "lanes.h"
+#include "cpu_features.h"
+#include "argon2/src/blake2/blake2.h"
+
+void vse_chacha20_xcrypt_lanes(chacha_ctx_t *const *ctx, uint8_t *const *buf,
+                               const size_t *nbytes, int nlanes)
+{
+    for (int i = 0; i < nlanes; i++)
+        chacha_xcrypt_bytes(ctx[i], buf[i], buf[i], nbytes[i]);
+}
+
+void vse_salsa20_xcrypt_lanes(salsa20_ctx_t *const *ctx, uint8_t *const *buf,
+                              const size_t *nbytes, int nlanes)
+{
+    for (int i = 0; i < nlanes; i++)
+        salsa20_xcrypt_bytes(ctx[i], buf[i], buf[i], nbytes[i]);
+}
+
+void vse_blake2b_lanes(uint8_t *const *out, size_t outlen,
+                       const uint8_t *const *key, size_t keylen,
+                       const uint8_t *const *in, const size_t *nbytes, int nlanes)
+{
+    for (int i = 0; i < nlanes; i++)
+    {
+        blake2b_state state;
+        if (keylen > 0)
+            blake2b_init_key(&state, outlen, key[i], keylen);
+        else
+            blake2b_init(&state, outlen);
+        blake2b_update(&state, in[i], nbytes[i]);
+        blake2b_final(&state, out[i], outlen);
+    }
+}
+
+#if VSE_X86
+#include <immintrin.h>
+
+/*
+ * ChaCha20 and Salsa20 share one loop: a 16-word state whose 64-bit block
+ * counter is words ctr and ctr + 1, a block being the rounds plus the input.
+ * Vector j holds word j of the eight lanes; lanes past nlanes copy lane 0
+ * and are never stored.
+ */
+
+#define VSE_ROTL32(x, n) _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+
+#define VSE_CHACHA_QR(a, b, c, d)                                              \
+    do                                                                         \
+    {                                                                          \
+        a = _mm256_add_epi32(a, b);                                            \
+        d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16);                \
+        c = _mm256_add_epi32(c, d);                                            \
+        b = VSE_ROTL32(_mm256_xor_si256(b, c), 12);                            \
+        a = _mm256_add_epi32(a, b);                                            \
+        d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot8);                 \
+        c = _mm256_add_epi32(c, d);                                            \
+        b = VSE_ROTL32(_mm256_xor_si256(b, c), 7);                             \
+    } while (0)
+
+#define VSE_SALSA_STEP(a, b, c, n) a = _mm256_xor_si256(a, VSE_ROTL32(_mm256_add_epi32(b, c), n))
+
+VSE_TARGET("avx2")
+static void vse_chacha20_rounds_avx2(__m256i *x)
+{
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                           2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                          3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    for (int i = 0; i < 10; i++)
+    {
+        VSE_CHACHA_QR(x[0], x[4], x[8], x[12]);
+        VSE_CHACHA_QR(x[1], x[5], x[9], x[13]);
+        VSE_CHACHA_QR(x[2], x[6], x[10], x[14]);
+        VSE_CHACHA_QR(x[3], x[7], x[11], x[15]);
+        VSE_CHACHA_QR(x[0], x[5], x[10], x[15]);
+        VSE_CHACHA_QR(x[1], x[6], x[11], x[12]);
+        VSE_CHACHA_QR(x[2], x[7], x[8], x[13]);
+        VSE_CHACHA_QR(x[3], x[4], x[9], x[14]);
+    }
+}
+
+VSE_TARGET("avx2")
+static void vse_salsa20_rounds_avx2(__m256i *x)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        VSE_SALSA_STEP(x[4], x[0], x[12], 7);
+        VSE_SALSA_STEP(x[8], x[4], x[0], 9);
+        VSE_SALSA_STEP(x[12], x[8], x[4], 13);
+        VSE_SALSA_STEP(x[0], x[12], x[8], 18);
+        VSE_SALSA_STEP(x[9], x[5], x[1], 7);
+        VSE_SALSA_STEP(x[13], x[9], x[5], 9);
+        VSE_SALSA_STEP(x[1], x[13], x[9], 13);
+        VSE_SALSA_STEP(x[5], x[1], x[13], 18);
+        VSE_SALSA_STEP(x[14], x[10], x[6], 7);
+        VSE_SALSA_STEP(x[2], x[14], x[10], 9);
+        VSE_SALSA_STEP(x[6], x[2], x[14], 13);
+        VSE_SALSA_STEP(x[10], x[6], x[2], 18);
+        VSE_SALSA_STEP(x[3], x[15], x[11], 7);
+        VSE_SALSA_STEP(x[7], x[3], x[15], 9);
+        VSE_SALSA_STEP(x[11], x[7], x[3], 13);
+        VSE_SALSA_STEP(x[15], x[11], x[7], 18);
+        VSE_SALSA_STEP(x[1], x[0], x[3], 7);
+        VSE_SALSA_STEP(x[2], x[1], x[0], 9);
+        VSE_SALSA_STEP(x[3], x[2], x[1], 13);
+        VSE_SALSA_STEP(x[0], x[3], x[2], 18);
+        VSE_SALSA_STEP(x[6], x[5], x[4], 7);
+        VSE_SALSA_STEP(x[7], x[6], x[5], 9);
+        VSE_SALSA_STEP(x[4], x[7], x[6], 13);
+        VSE_SALSA_STEP(x[5], x[4], x[7], 18);
+        VSE_SALSA_STEP(x[11], x[10], x[9], 7);
+        VSE_SALSA_STEP(x[8], x[11], x[10], 9);
+        VSE_SALSA_STEP(x[9], x[8], x[11], 13);
+        VSE_SALSA_STEP(x[10], x[9], x[8], 18);
+        VSE_SALSA_STEP(x[12], x[15], x[14], 7);
+        VSE_SALSA_STEP(x[13], x[12], x[15], 9);
+        VSE_SALSA_STEP(x[14], x[13], x[12], 13);
+        VSE_SALSA_STEP(x[15], x[14], x[13], 18);
+    }
+}
+
+/* Turn r[j] = word j of lanes 0..7 into r[k] = words 0..7 of lane k. */
+VSE_TARGET("avx2")
+static void vse_transpose8x32(__m256i *r)
+{
+    __m256i a[8];
+    __m256i b[8];
+    for (int i = 0; i < 8; i += 2)
+    {
+        a[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        a[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4)
+    {
+        b[i] = _mm256_unpacklo_epi64(a[i], a[i + 2]);
+        b[i + 1] = _mm256_unpackhi_epi64(a[i], a[i + 2]);
+        b[i + 2] = _mm256_unpacklo_epi64(a[i + 1], a[i + 3]);
+        b[i + 3] = _mm256_unpackhi_epi64(a[i + 1], a[i + 3]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        r[i] = _mm256_permute2x128_si256(b[i], b[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2x128_si256(b[i], b[i + 4], 0x31);
+    }
+}
+
+VSE_TARGET("avx2")
+static void vse_xcrypt_lanes_avx2(uint32_t *const *input, int ctr, int salsa,
+                                  uint8_t *const *buf, const size_t *nbytes, int nlanes)
+{
+    uint32_t words[16][8];
+    size_t longest = 0;
+    for (int k = 0; k < 8; k++)
+    {
+        const uint32_t *in = input[k < nlanes ? k : 0];
+        for (int j = 0; j < 16; j++)
+            words[j][k] = in[j];
+        if (k < nlanes && nbytes[k] > longest)
+            longest = nbytes[k];
+    }
+
+    __m256i state[16];
+    for (int j = 0; j < 16; j++)
+        state[j] = _mm256_loadu_si256((const __m256i *)words[j]);
+
+    const __m256i one = _mm256_set1_epi32(1);
+    for (size_t pos = 0; pos < longest; pos += 64)
+    {
+        __m256i x[16];
+        memcpy(x, state, sizeof(x));
+        if (salsa)
+            vse_salsa20_rounds_avx2(x);
+        else
+            vse_chacha20_rounds_avx2(x);
+        for (int j = 0; j < 16; j++)
+            x[j] = _mm256_add_epi32(x[j], state[j]);
+        vse_transpose8x32(x);     // x[k]: words 0..7 of lane k
+        vse_transpose8x32(x + 8); // x[8 + k]: words 8..15
+
+        for (int k = 0; k < nlanes; k++)
+        {
+            if (pos >= nbytes[k])
+                continue;
+            uint8_t *p = buf[k] + pos;
+            size_t left = nbytes[k] - pos;
+            if (left >= 64)
+            {
+                _mm256_storeu_si256((__m256i *)p, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)p), x[k]));
+                _mm256_storeu_si256((__m256i *)(p + 32), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + 32)), x[8 + k]));
+            }
+            else
+            {
+                uint8_t block[64];
+                _mm256_storeu_si256((__m256i *)block, x[k]);
+                _mm256_storeu_si256((__m256i *)(block + 32), x[8 + k]);
+                for (size_t i = 0; i < left; i++)
+                    p[i] ^= block[i];
+                memset(block, 0, sizeof(block));
+            }
+        }
+
+        // 64-bit counter: carry into the high word where the low one wrapped.
+        state[ctr] = _mm256_add_epi32(state[ctr], one);
+        state[ctr + 1] = _mm256_sub_epi32(state[ctr + 1], _mm256_cmpeq_epi32(state[ctr], _mm256_setzero_si256()));
+    }
+
+    // Every block, partial or not, moves the counter on, as in the one-stream code.
+    for (int k = 0; k < nlanes; k++)
+    {
+        uint64_t counter = ((uint64_t)input[k][ctr + 1] << 32) | input[k][ctr];
+        counter += (nbytes[k] + 63) / 64;
+        input[k][ctr] = (uint32_t)counter;
+        input[k][ctr + 1] = (uint32_t)(counter >> 32);
+    }
+    memset(words, 0, sizeof(words));
+}
+
+void vse_chacha20_xcrypt_lanes_avx2(chacha_ctx_t *const *ctx, uint8_t *const *buf,
+                                    const size_t *nbytes, int nlanes)
+{
+    uint32_t *input[VSE_LANES_MAX];
+    for (int k = 0; k < nlanes; k++)
+        input[k] = ctx[k]->input;
+    if (nlanes > 0)
+        vse_xcrypt_lanes_avx2(input, 12, 0, buf, nbytes, nlanes);
+}
+
+void vse_salsa20_xcrypt_lanes_avx2(salsa20_ctx_t *const *ctx, uint8_t *const *buf,
+                                   const size_t *nbytes, int nlanes)
+{
+    uint32_t *input[VSE_LANES_MAX];
+    for (int k = 0; k < nlanes; k++)
+        input[k] = ctx[k]->input;
+    if (nlanes > 0)
+        vse_xcrypt_lanes_avx2(input, 8, 1, buf, nbytes, nlanes);
+}
+
+/*
+ * One ChaCha20 stream, 512 bytes at a time: lane k runs block counter + k.
+ * The tail goes through the one-stream code, which moves the counter on the
+ * same way.
+ */
+VSE_TARGET("avx2")
+void vse_chacha20_xcrypt_avx2(chacha_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes)
+{
+    size_t nchunks = nbytes / 512;
+    if (nchunks > 0)
+    {
+        const __m256i sign = _mm256_set1_epi32((int)0x80000000);
+        const __m256i eight = _mm256_set1_epi32(8);
+        __m256i state[16];
+        for (int j = 0; j < 16; j++)
+            state[j] = _mm256_set1_epi32((int)ctx->input[j]);
+
+        // lane counters, carrying into the high word where the low one wrapped
+        __m256i lo = _mm256_add_epi32(state[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        state[13] = _mm256_sub_epi32(state[13], _mm256_cmpgt_epi32(_mm256_xor_si256(state[12], sign),
+                                                                   _mm256_xor_si256(lo, sign)));
+        state[12] = lo;
+
+        for (size_t c = 0; c < nchunks; c++, in += 512, out += 512)
+        {
+            __m256i x[16];
+            memcpy(x, state, sizeof(x));
+            vse_chacha20_rounds_avx2(x);
+            for (int j = 0; j < 16; j++)
+                x[j] = _mm256_add_epi32(x[j], state[j]);
+            vse_transpose8x32(x);
+            vse_transpose8x32(x + 8);
+            for (int k = 0; k < 8; k++)
+            {
+                const uint8_t *p = in + 64 * k;
+                uint8_t *q = out + 64 * k;
+                _mm256_storeu_si256((__m256i *)q, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)p), x[k]));
+                _mm256_storeu_si256((__m256i *)(q + 32), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + 32)), x[8 + k]));
+            }
+
+            lo = _mm256_add_epi32(state[12], eight);
+            state[13] = _mm256_sub_epi32(state[13], _mm256_cmpgt_epi32(_mm256_xor_si256(state[12], sign),
+                                                                       _mm256_xor_si256(lo, sign)));
+            state[12] = lo;
+        }
+
+        uint64_t counter = ((uint64_t)ctx->input[13] << 32) | ctx->input[12];
+        counter += (uint64_t)nchunks * 8;
+        ctx->input[12] = (uint32_t)counter;
+        ctx->input[13] = (uint32_t)(counter >> 32);
+        nbytes -= nchunks * 512;
+    }
+    if (nbytes > 0)
+        chacha_xcrypt_bytes(ctx, in, out, nbytes);
+}
+
+/*
+ * BLAKE2b, 4 lanes: vector i holds word i of the four states. Each lane
+ * hashes its key block, if any, then its input; a lane past its last block
+ * keeps its state.
+ */
+
+static const uint64_t g_blake2b_iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+
+static const uint8_t g_blake2b_sigma[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+};
+
+#define VSE_B2B_G(a, b, c, d, x, y)                                                                   \
+    do                                                                                                \
+    {                                                                                                 \
+        a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);                                              \
+        d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2, 3, 0, 1));                    \
+        c = _mm256_add_epi64(c, d);                                                                   \
+        b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), rot24);                                       \
+        a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);                                              \
+        d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16);                                       \
+        c = _mm256_add_epi64(c, d);                                                                   \
+        b = _mm256_xor_si256(b, c);                                                                   \
+        b = _mm256_xor_si256(_mm256_srli_epi64(b, 63), _mm256_add_epi64(b, b));                       \
+    } while (0)
+
+VSE_TARGET("avx2")
+static void vse_blake2b_x4_avx2(uint8_t *const *out, size_t outlen,
+                                const uint8_t *const *key, size_t keylen,
+                                const uint8_t *const *in, const size_t *nbytes, int nlanes)
+{
+    const __m256i rot24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                           3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                           2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    uint8_t blocks[4][BLAKE2B_BLOCKBYTES]; // key blocks, then partial last blocks
+    uint64_t total[4] = {0};
+    uint64_t nblocks[4] = {0};
+    uint64_t most = 0;
+    size_t head = keylen > 0 ? BLAKE2B_BLOCKBYTES : 0;
+    memset(blocks, 0, sizeof(blocks));
+
+    for (int k = 0; k < nlanes; k++)
+    {
+        total[k] = head + nbytes[k];
+        nblocks[k] = total[k] == 0 ? 1 : (total[k] + BLAKE2B_BLOCKBYTES - 1) / BLAKE2B_BLOCKBYTES;
+        if (nblocks[k] > most)
+            most = nblocks[k];
+    }
+
+    __m256i h[8];
+    for (int i = 0; i < 8; i++)
+        h[i] = _mm256_set1_epi64x((long long)g_blake2b_iv[i]);
+    h[0] = _mm256_xor_si256(h[0], _mm256_set1_epi64x((long long)(0x01010000 ^ (keylen << 8) ^ outlen)));
+
+    for (uint64_t b = 0; b < most; b++)
+    {
+        const uint8_t *p[4];
+        uint64_t t[4];
+        uint64_t last[4];
+        uint64_t active[4];
+        for (int k = 0; k < 4; k++)
+        {
+            p[k] = blocks[0]; // idle lanes hash anything, and keep their state
+            t[k] = 0;
+            last[k] = 0;
+            active[k] = 0;
+            if (k >= nlanes || b >= nblocks[k])
+                continue;
+
+            active[k] = ~0ULL;
+            last[k] = b + 1 == nblocks[k] ? ~0ULL : 0;
+            t[k] = last[k] ? total[k] : (b + 1) * BLAKE2B_BLOCKBYTES;
+            if (b == 0 && head > 0)
+            {
+                memset(blocks[k], 0, BLAKE2B_BLOCKBYTES);
+                memcpy(blocks[k], key[k], keylen);
+                p[k] = blocks[k];
+                continue;
+            }
+            size_t off = (size_t)(b * BLAKE2B_BLOCKBYTES - head);
+            size_t left = nbytes[k] - off;
+            if (left >= BLAKE2B_BLOCKBYTES)
+            {
+                p[k] = in[k] + off;
+            }
+            else
+            {
+                memset(blocks[k], 0, BLAKE2B_BLOCKBYTES);
+                if (left > 0)
+                    memcpy(blocks[k], in[k] + off, left);
+                p[k] = blocks[k];
+            }
+        }
+
+        // m[i]: message word i of the four lanes.
+        __m256i m[16];
+        for (int j = 0; j < 16; j += 4)
+        {
+            __m256i r0 = _mm256_loadu_si256((const __m256i *)(p[0] + 8 * j));
+            __m256i r1 = _mm256_loadu_si256((const __m256i *)(p[1] + 8 * j));
+            __m256i r2 = _mm256_loadu_si256((const __m256i *)(p[2] + 8 * j));
+            __m256i r3 = _mm256_loadu_si256((const __m256i *)(p[3] + 8 * j));
+            __m256i a0 = _mm256_unpacklo_epi64(r0, r1);
+            __m256i a1 = _mm256_unpackhi_epi64(r0, r1);
+            __m256i a2 = _mm256_unpacklo_epi64(r2, r3);
+            __m256i a3 = _mm256_unpackhi_epi64(r2, r3);
+            m[j] = _mm256_permute2x128_si256(a0, a2, 0x20);
+            m[j + 1] = _mm256_permute2x128_si256(a1, a3, 0x20);
+            m[j + 2] = _mm256_permute2x128_si256(a0, a2, 0x31);
+            m[j + 3] = _mm256_permute2x128_si256(a1, a3, 0x31);
+        }
+
+        __m256i v[16];
+        for (int i = 0; i < 8; i++)
+        {
+            v[i] = h[i];
+            v[i + 8] = _mm256_set1_epi64x((long long)g_blake2b_iv[i]);
+        }
+        v[12] = _mm256_xor_si256(v[12], _mm256_loadu_si256((const __m256i *)t));
+        v[14] = _mm256_xor_si256(v[14], _mm256_loadu_si256((const __m256i *)last));
+
+        for (int r = 0; r < 12; r++)
+        {
+            const uint8_t *s = g_blake2b_sigma[r];
+            VSE_B2B_G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+            VSE_B2B_G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+            VSE_B2B_G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+            VSE_B2B_G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+            VSE_B2B_G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+            VSE_B2B_G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+            VSE_B2B_G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+            VSE_B2B_G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+        }
+
+        __m256i mask = _mm256_loadu_si256((const __m256i *)active);
+        for (int i = 0; i < 8; i++)
+        {
+            __m256i next = _mm256_xor_si256(h[i], _mm256_xor_si256(v[i], v[i + 8]));
+            h[i] = _mm256_blendv_epi8(h[i], next, mask);
+        }
+    }
+
+    uint64_t words[8][4];
+    for (int i = 0; i < 8; i++)
+        _mm256_storeu_si256((__m256i *)words[i], h[i]);
+    for (int k = 0; k < nlanes; k++)
+    {
+        uint8_t digest[BLAKE2B_OUTBYTES];
+        for (int i = 0; i < 8; i++)
+        {
+            for (int j = 0; j < 8; j++)
+                digest[8 * i + j] = (uint8_t)(words[i][k] >> (8 * j));
+        }
+        memcpy(out[k], digest, outlen);
+    }
+    memset(blocks, 0, sizeof(blocks));
+}
+
+void vse_blake2b_lanes_avx2(uint8_t *const *out, size_t outlen,
+                            const uint8_t *const *key, size_t keylen,
+                            const uint8_t *const *in, const size_t *nbytes, int nlanes)
+{
+    for (int k = 0; k < nlanes; k += 4)
+        vse_blake2b_x4_avx2(out + k, outlen, key + k, keylen, in + k, nbytes + k,
+                            nlanes - k < 4 ? nlanes - k : 4);
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef LANES_C83F5A17_2E9D_4B06_A4D1_7F0B93E6C258_H
+#define LANES_C83F5A17_2E9D_4B06_A4D1_7F0B93E6C258_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chacha/chacha.h"
+#include "salsa20/salsa20.h"
+
+/*
+ * Multi-buffer kernels: up to VSE_LANES_MAX independent streams, each with
+ * its own key, nonce and length, run side by side in SIMD lanes. For small
+ * files, where one stream never fills a vector for long, this is where the
+ * width comes from.
+ *
+ * Every lane gives the same output, and leaves its ctx in the same state,
+ * as the one-stream kernel over the same bytes. Lanes run in lock step up
+ * to the longest one, so streams of similar length go together best.
+ *
+ * They are reached through the CPU dispatch table (cpu_features.h); the
+ * portable versions below are plain loops over the one-stream code.
+ */
+
+#define VSE_LANES_MAX 8
+
+/**
+ * ChaCha20 en/decrypt buf[i] (nbytes[i] bytes) in place with ctx[i], for
+ * i < nlanes.
+ */
+void vse_chacha20_xcrypt_lanes(chacha_ctx_t *const *ctx, uint8_t *const *buf,
+                               const size_t *nbytes, int nlanes);
+
+/**
+ * Salsa20, as vse_chacha20_xcrypt_lanes().
+ */
+void vse_salsa20_xcrypt_lanes(salsa20_ctx_t *const *ctx, uint8_t *const *buf,
+                              const size_t *nbytes, int nlanes);
+
+/**
+ * out[i] = BLAKE2b-outlen of in[i] (nbytes[i] bytes) keyed with key[i]
+ * (keylen bytes, at most 64), for i < nlanes.
+ */
+void vse_blake2b_lanes(uint8_t *const *out, size_t outlen,
+                       const uint8_t *const *key, size_t keylen,
+                       const uint8_t *const *in, const size_t *nbytes, int nlanes);
+
+/*
+ * AVX2: 8 ChaCha20/Salsa20 lanes of 32-bit words, 4 BLAKE2b lanes of 64-bit
+ * words (more are run 4 at a time). Only call them when vse_cpu_features()
+ * has VSE_CPU_AVX2.
+ */
+void vse_chacha20_xcrypt_lanes_avx2(chacha_ctx_t *const *ctx, uint8_t *const *buf,
+                                    const size_t *nbytes, int nlanes);
+void vse_salsa20_xcrypt_lanes_avx2(salsa20_ctx_t *const *ctx, uint8_t *const *buf,
+                                   const size_t *nbytes, int nlanes);
+void vse_blake2b_lanes_avx2(uint8_t *const *out, size_t outlen,
+                            const uint8_t *const *key, size_t keylen,
+                            const uint8_t *const *in, const size_t *nbytes, int nlanes);
+
+/*
+ * One ChaCha20 stream, 8 consecutive blocks per vector: the dispatched
+ * chacha20_xcrypt with VSE_CPU_AVX2. Same output and counter as
+ * chacha_xcrypt_bytes().
+ */
+void vse_chacha20_xcrypt_avx2(chacha_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes);
+
+#endif
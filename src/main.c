@@ -15,11 +15,65 @@
 #include "getpass.h"
 #include "error.h"
 #include "crypto_random.h"
+#include "cipher.h"
 #include "encrypt_v1.h"
 #include "decrypt_v1.h"
+#include "file_ops.h"
+#include "server.h"
+#include "threadpool.h"
+#include "sync.h"
+#include "cpu_features.h"
+#include "stats.h"
+#include "trace.h"
+#include "metrics.h"
+#include "manifest.h"
+#include "journal.h"
+#include "ranges.h"
+#include "multibuf.h"
+#include "mem_budget.h"
+#include "numa.h"
+#include "cpu_tokens.h"
+#include "probes.h"
 
 #define VERSION "1.0.1"
 
+#define OPT_SERVE 256
+#define OPT_CPU_INFO 257
+#define OPT_STATS 258
+#define OPT_STATS_JSON 259
+#define OPT_TRACE 260
+#define OPT_METRICS_FILE 261
+#define OPT_REKEY 262
+#define OPT_FORMAT 263
+#define OPT_INCREMENTAL 264
+#define OPT_PRUNE 265
+#define OPT_JOURNAL 266
+#define OPT_RESUME 267
+#define OPT_CHECKPOINT 268
+#define OPT_MEM_BUDGET 269
+#define OPT_CPUS 270
+#define OPT_NUMA 271
+
+static const struct option long_options[] = {
+    {"serve", required_argument, NULL, OPT_SERVE},
+    {"cpu-info", no_argument, NULL, OPT_CPU_INFO},
+    {"stats", no_argument, NULL, OPT_STATS},
+    {"stats-json", required_argument, NULL, OPT_STATS_JSON},
+    {"trace", required_argument, NULL, OPT_TRACE},
+    {"metrics-file", required_argument, NULL, OPT_METRICS_FILE},
+    {"rekey", no_argument, NULL, OPT_REKEY},
+    {"format", required_argument, NULL, OPT_FORMAT},
+    {"incremental", required_argument, NULL, OPT_INCREMENTAL},
+    {"prune", no_argument, NULL, OPT_PRUNE},
+    {"journal", required_argument, NULL, OPT_JOURNAL},
+    {"resume", no_argument, NULL, OPT_RESUME},
+    {"checkpoint", no_argument, NULL, OPT_CHECKPOINT},
+    {"mem-budget", required_argument, NULL, OPT_MEM_BUDGET},
+    {"cpus", required_argument, NULL, OPT_CPUS},
+    {"numa", no_argument, NULL, OPT_NUMA},
+    {NULL, 0, NULL, 0},
+};
+
 static int g_quiet = 0;
 
 void vse_print_error(const char *fmt, ...)
@@ -31,91 +85,14 @@ void vse_print_error(const char *fmt, ...)
     va_end(ap);
 }
 
-static int vse_decrypt_file(const char *password, size_t password_nbytes,
-                            const char *infile, const char *outfile)
-{
-    int ret = 0;
-    FILE *fp_in = NULL;
-    FILE *fp_out = NULL;
-
-    do
-    {
-        struct stat buf;
-        if (stat(infile, &buf) != 0)
-        {
-            vse_print_error("Error: Failed to stat file %s: %s\n", infile, strerror(errno));
-            ret = ERR_DECRYPT_FILE_FAILED_TO_STAT_INPUT_FILE;
-            break;
-        }
-
-        if (buf.st_size < (off_t)(1 + FILE_HEADER_LEN))
-        {
-            vse_print_error("Error: File too small to decrypted: %s\n", infile);
-            ret = ERR_DECRYPT_FILE_INPUT_FILE_SIZE_TOO_SMALL;
-            break;
-        }
-
-        fp_in = fopen(infile, "rb");
-        if (fp_in == NULL)
-        {
-            vse_print_error("Error: Failed to open file %s for read\n", infile);
-            ret = ERR_DECRYPT_FILE_FAILED_TO_OPEN_INPUT_FILE;
-            break;
-        }
-
-        uint8_t version = 0;
-        if (fread(&version, 1, 1, fp_in) != 1)
-        {
-            vse_print_error("Error: Failed to read 1st byte of file %s\n", infile);
-            ret = ERR_DECRYPT_FILE_FAILED_TO_OPEN_INPUT_FILE;
-            break;
-        }
-
-        if (version != 1)
-        {
-            vse_print_error("Error: Invalid version %d\n", version);
-            ret = ERR_DECRYPT_FILE_INVALID_VERSION;
-            break;
-        }
-
-        fp_out = fopen(outfile, "wb");
-        if (fp_out == NULL)
-        {
-            vse_print_error("Error: Failed to open file %s for write\n", outfile);
-            ret = ERR_DECRYPT_FILE_FAILED_TO_OPEN_OUTPUT_FILE;
-            break;
-        }
-
-        switch (version)
-        {
-        case 1:
-            ret = vse_decrypt_file_v1(password, password_nbytes, fp_in, fp_out);
-            break;
-        default:
-            assert(!"BUG: un-handled version");
-        }
-
-    } while (0);
-
-    if (fp_in != NULL)
-    {
-        fclose(fp_in);
-    }
-
-    if (fp_out != NULL)
-    {
-        fclose(fp_out);
-    }
-
-    return ret;
-}
-
 static void vse_usage(const char *argv0)
 {
     printf("NAME\n");
     printf("  %s -- Very secure file encryption.\n\n", argv0);
     printf("SYNOPSIS\n");
-    printf("  %s [-h] [-v] [-q] [-f] [-D] -e|-d [-a cipher] -i infile|infolder [-o outfile|outfolder] [-p password]\n\n", argv0);
+    printf("  %s [-h] [-v] [-q] [-f] [-D] -e|-d|-t|-R|--rekey [-a cipher] [--format 1|2] -i infile|infolder [-o outfile|outfolder] [-p password] [-P new_password] [--incremental manifest.db [--prune]] [--journal file [--resume]] [--checkpoint [--resume]] [--mem-budget size] [--cpus list] [--numa] [--stats] [--stats-json file] [--trace file] [--metrics-file file]\n", argv0);
+    printf("  %s --serve socket [-j workers] [--mem-budget size] [--cpus list] [--numa] [--trace file] [--metrics-file file]\n", argv0);
+    printf("  %s [--cpus list] --cpu-info\n\n", argv0);
     printf("DESCRIPTION\n");
     printf("  Use very strong cipher to encrypt/decrypt file.\n\n");
     printf("  The following options are available:\n\n");
@@ -126,15 +103,24 @@ static void vse_usage(const char *argv0)
     printf("  -D Delete input file if encrypt/decrypt success.\n\n");
     printf("  -e Encryption.\n\n");
     printf("  -d Decryption.\n\n");
-    printf("  -a Encryption cipher, used in encryption mode(-e) only.\n\n");
+    printf("  -t Test: check the MAC of .vse files without decrypting or writing\n");
+    printf("     anything. Prints OK or FAIL for every file.\n\n");
+    printf("  -R Re-encrypt .vse files under the new password (-P) and, if -c is given,\n");
+    printf("     a new cipher, in one pass and without writing plaintext. Files are\n");
+    printf("     replaced in place unless -o is given. Version 2 files use --rekey.\n\n");
+    printf("  --rekey Change the password of version 2 .vse files to -P. Only the\n");
+    printf("          header is rewritten, in place, so it takes the same time for\n");
+    printf("          any file size.\n\n");
+    printf("  --format <1|2>  File format written by encryption (-e). Default: 1.\n");
+    printf("                  Version 2 encrypts under a random data key held in\n");
+    printf("                  password key slots, so it can be re-keyed with --rekey.\n\n");
+    printf("  -a Encryption cipher, used in encryption (-e) and re-encryption (-R) mode only.\n\n");
     printf("     Available ciphers:\n\n");
-    printf("     chacha20         256bit, faster than AES 256.\n");
-    printf("     salsa20          256bit, faster than AES 256.\n");
-    printf("     aes256           AES 256bit in CTR mode.\n");
-    printf("     aes256_chacha20  aes256 then chacha20 (default cipher).\n");
-    printf("     aes256_salsa20   aes256 then salsa20.\n");
-    printf("     chacha20_aes256  chacha20 then aes256.\n");
-    printf("     salsa20_aes256   salsa20 then aes256.\n\n");
+    for (size_t i = 0; vse_cipher_at(i) != NULL; i++)
+    {
+        printf("     %-18s %s\n", vse_cipher_at(i)->name, vse_cipher_at(i)->description);
+    }
+    printf("\n");
     printf("  -i <infile|infolder>  Input file or folder for encrypt/decrypt.\n");
     printf("                        When a folder is given, all non-empty regular files are\n");
     printf("                        processed recursively.\n\n");
@@ -143,6 +129,50 @@ static void vse_usage(const char *argv0)
     printf("                          mirrored; the folder is created if it does not exist.\n");
     printf("                          Omit to process files in-place.\n\n");
     printf("  -p Password.\n\n");
+    printf("  -P New password, used by re-encryption (-R) and --rekey only.\n\n");
+    printf("  -j <n> Number of worker threads in folder and server mode.\n");
+    printf("         Default: one per usable CPU (affinity, cgroup cpu.max).\n");
+    printf("         Folder mode starts the biggest files first and splits those\n");
+    printf("         of 64 MiB and more over all workers.\n\n");
+    printf("  --serve <socket>  Run as a long-lived server on a Unix domain socket.\n");
+    printf("                    Clients send framed encrypt/decrypt/verify requests for\n");
+    printf("                    paths, or pass the data as fds (see src/server.h).\n\n");
+    printf("  --incremental <manifest.db>  Folder mode, -e or -d into -o: skip files\n");
+    printf("                  whose size, mtime, inode and content fingerprint match\n");
+    printf("                  manifest.db, then save the new state there. Implies -f.\n\n");
+    printf("  --prune  With --incremental, delete the outputs of source files that\n");
+    printf("           are gone.\n\n");
+    printf("  --journal <file>  Folder mode: record finished files and folders in file,\n");
+    printf("                    synced in batches. It is deleted when the run succeeds.\n\n");
+    printf("  --resume  With --journal, skip what the journal of an interrupted run\n");
+    printf("            records as finished, without looking at it again. With\n");
+    printf("            --checkpoint, continue outfile.part from outfile.ckpt.\n\n");
+    printf("  --checkpoint  Single-file -e, format 1: encrypt into outfile.part and\n");
+    printf("                save the progress to outfile.ckpt every 256 MiB, so that\n");
+    printf("                an interrupted run can be continued with --resume. Not\n");
+    printf("                with aes256gcm, aegis256 or xchacha20poly1305.\n\n");
+    printf("  --mem-budget <size>  Memory the Argon2 KDFs in flight may use together,\n");
+    printf("                       in bytes or with a K, M or G suffix; KDFs over it\n");
+    printf("                       wait. 0 for no limit. Default: 75%% of the cgroup's\n");
+    printf("                       memory.max if there is one, else no limit.\n\n");
+    printf("  --cpus <list>  Run on these CPUs only, e.g. 0-7,16-23. The CPU\n");
+    printf("                 budget, and so -j, follows.\n\n");
+    printf("  --numa  Pin every worker to the CPUs of one NUMA node, round-robin,\n");
+    printf("          and allocate its KDF memory and split-file buffers there.\n\n");
+    printf("  --stats  Print where the time went (KDF, IV, read, cipher, hash, write,\n");
+    printf("           MAC verification, rename) for every file and in total, to stderr.\n\n");
+    printf("  --stats-json <file>  Append the same as NDJSON to file: one record per\n");
+    printf("                       file and a final \"total\" record.\n\n");
+    printf("  --trace <file>  Write a Chrome/Perfetto trace of every file, KDF, chunk read,\n");
+    printf("                  cipher, hash, write and rename, per thread, to file.\n");
+    printf("                  Open it in ui.perfetto.dev or chrome://tracing.\n\n");
+    printf("  --metrics-file <file.prom>  Keep Prometheus metrics (files, bytes, errors,\n");
+    printf("                              KDF latency, peak RSS, throughput) in file for\n");
+    printf("                              node_exporter's textfile collector. Rewritten\n");
+    printf("                              atomically every few seconds and at exit.\n\n");
+    printf("  --cpu-info  Show the CPU features found and the implementation used for\n");
+    printf("              each primitive. Set VSE_CPU_TIER=generic|sse2|ssse3|avx2|avx512\n");
+    printf("              to force a lower tier.\n\n");
     printf("EXAMPLES\n");
     printf("  Encryption:\n");
     printf("  %s -e -i foo.jpg -o foo.jpg.vse -p secret123\n", argv0);
@@ -154,60 +184,55 @@ static void vse_usage(const char *argv0)
     printf("  %s -d -i foo.jpg.vse  # will output as foo.jpg and ask password\n", argv0);
     printf("  %s -d -i enc/ -o dec/ -p secret123  # decrypt tree enc/ into dec/\n", argv0);
     printf("  %s -d -i enc/ -p secret123          # decrypt in-place inside enc/\n\n", argv0);
+    printf("  Re-encryption:\n");
+    printf("  %s -R -i enc/ -p secret123 -P n3wsecret -c aes256_chacha20\n\n", argv0);
+    printf("  Password change:\n");
+    printf("  %s -e --format 2 -i foo.jpg -p secret123\n", argv0);
+    printf("  %s --rekey -i foo.jpg.vse -p secret123 -P n3wsecret\n\n", argv0);
+    printf("  Verification:\n");
+    printf("  %s -t -i enc/ -p secret123 -j 8     # check every .vse file under enc/\n\n", argv0);
+    printf("  Server:\n");
+    printf("  %s --serve /run/vse.sock -j 8\n\n", argv0);
     printf("Version: %s\n\n", VERSION);
 }
 
-static int vse_parse_cipher(const char *cipher_name)
+static void vse_print_cpu_info(void)
 {
-    int cipher = CIPHER_UNKNOWN;
-    if (strcmp(cipher_name, "chacha20") == 0 || strcmp(cipher_name, "chacha") == 0)
-    {
-        cipher = CIPHER_CHACHA20;
-    }
-    else if (strcmp(cipher_name, "salsa20") == 0)
-    {
-        cipher = CIPHER_SALSA20;
-    }
-    else if (strcmp(cipher_name, "aes") == 0 || strcmp(cipher_name, "aes256") == 0)
-    {
-        cipher = CIPHER_AES_256_CTR;
-    }
-    else if (strcmp(cipher_name, "aes256_chacha20") == 0)
-    {
-        cipher = CIPHER_AES_256_CTR_CHACHA20;
-    }
-    else if (strcmp(cipher_name, "chacha20_aes256") == 0)
+    uint32_t detected = vse_cpu_features_detected();
+    uint32_t features = vse_cpu_features();
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+    const char *tier_env = getenv("VSE_CPU_TIER");
+
+    printf("CPU features:");
+    for (int i = 0; vse_cpu_feature_name(i) != NULL; i++)
     {
-        cipher = CIPHER_CHACHA20_AES_256_CTR;
+        if (detected & (1u << i))
+        {
+            printf(" %s%s", vse_cpu_feature_name(i), (features & (1u << i)) ? "" : "(off)");
+        }
     }
-    else if (strcmp(cipher_name, "aes256_salsa20") == 0)
+    printf("\n");
+    if (tier_env != NULL)
     {
-        cipher = CIPHER_AES_256_CTR_SALSA20;
+        printf("Tier: %s (VSE_CPU_TIER=%s)\n", vse_cpu_tier_name(vse_cpu_tier()), tier_env);
     }
-    else if (strcmp(cipher_name, "salsa20_aes256") == 0)
+    else
     {
-        cipher = CIPHER_SALSA20_AES_256_CTR;
+        printf("Tier: %s\n", vse_cpu_tier_name(vse_cpu_tier()));
     }
-    else
+    printf("CPUs usable: %d (affinity, cgroup cpu.max)\n", vse_cpu_budget());
+    printf("NUMA nodes: %d\n", vse_numa_nodes());
+    printf("\nImplementations:\n");
+    for (int i = 0; i < VSE_PRIM_COUNT; i++)
     {
-        // do nothing here.
+        printf("  %-10s %s\n", vse_primitive_name((vse_primitive_t)i), dispatch->impl[i]);
     }
-
-    return cipher;
 }
 
-static const char *gen_tmp_filename(const char *path)
+static int vse_parse_cipher(const char *cipher_name)
 {
-    uint8_t random_buf[4] = {0};
-    char buf[10] = {0};
-    crypto_random(random_buf, 4);
-
-    char *ret = calloc(strlen(path) + 10, 1);
-    strcpy(ret, path);
-    strcat(ret, ".");
-    strcat(ret, hexdump(random_buf, 4, buf));
-
-    return ret;
+    const vse_cipher_t *cipher = vse_cipher_find_by_name(cipher_name);
+    return cipher == NULL ? CIPHER_UNKNOWN : cipher->id;
 }
 
 /* Returns a pointer to the filename component of path (after the last / or \). */
@@ -224,9 +249,63 @@ static const char *path_basename(const char *path)
     return (p > q ? p : q) + 1;
 }
 
+/*
+ * Parse a size like 512M. Returns 0 on success.
+ */
+static int parse_size(const char *s, uint64_t *nbytes)
+{
+    char *end;
+    uint64_t n = strtoull(s, &end, 10);
+    if (end == s)
+        return -1;
+    int shift = 0;
+    if (*end == 'K' || *end == 'k')
+        shift = 10;
+    else if (*end == 'M' || *end == 'm')
+        shift = 20;
+    else if (*end == 'G' || *end == 'g')
+        shift = 30;
+    if (shift != 0)
+        end++;
+    if (*end != '\0')
+        return -1;
+    *nbytes = n << shift;
+    return 0;
+}
+
+// getpass() hands back its own buffer, overwritten by the next prompt:
+// keep a copy and wipe the original.
+static char *prompt_password(const char *prompt, size_t *nbytes)
+{
+    char *pass = (char *)getpass(prompt);
+    if (pass == NULL)
+        return NULL;
+    char *copy = strdup(pass);
+    volatile char *p = pass;
+    while (*p)
+        *p++ = 0;
+#if _MSC_VER
+    free(pass); // strdup()ed by our getpass()
+#endif
+    if (copy != NULL)
+        *nbytes = strlen(copy);
+    return copy;
+}
+
+static void free_password(char *password)
+{
+    if (password == NULL)
+        return;
+    volatile char *p = password;
+    while (*p)
+        *p++ = 0;
+    free(password);
+}
+
 /*
  * Given a bare filename (no directory), returns a malloc'd output filename, or
- * NULL if the name cannot be derived (decrypt mode and name lacks .vse suffix).
+ * NULL if the name cannot be derived (decrypt, verify or re-encrypt mode and
+ * name lacks .vse suffix). Re-encrypting keeps the name.
  */
 static char *derive_outname(int mode, const char *name)
 {
@@ -243,7 +322,8 @@ static char *derive_outname(int mode, const char *name)
         name[len - 3] == 'v' && name[len - 4] == '.')
     {
         char *out = strdup(name);
-        out[len - 4] = 0;
+        if (mode != MODE_REENCRYPT && mode != MODE_REKEY)
+            out[len - 4] = 0;
         return out;
     }
     return NULL;
@@ -280,55 +360,429 @@ static int make_dir(const char *path)
 #endif
 }
 
-/* Encrypt or decrypt infile to outfile via a temp file, then rename into place. */
-static int run_on_file(int mode, int cipher,
-                       const char *password, size_t password_nbytes,
-                       const char *infile, const char *outfile,
-                       int delete_infile)
+/*
+ * With --journal, a folder is done once it has been walked and all of its
+ * files and subfolders are done. pending counts those still running plus
+ * one for the walk; the last to finish journals the folder and releases
+ * its parent.
+ */
+typedef struct vse_dir_node
 {
-    const char *tmp_outfile = gen_tmp_filename(outfile);
-    int ret;
+    struct vse_dir_node *parent;
+    char *relpath; // NULL for -i itself
+    int pending;
+    int failed;
+} vse_dir_node_t;
 
-    if (mode == MODE_ENCRYPT)
-        ret = vse_encrypt_file_v1(cipher, password, password_nbytes, infile, tmp_outfile);
-    else
-        ret = vse_decrypt_file(password, password_nbytes, infile, tmp_outfile);
+/*
+ * Files found in folder mode run as jobs on a thread pool (-j workers).
+ * A job owns its paths.
+ */
+typedef struct vse_file_job
+{
+    vse_run_opts_t opts;
+    char *infile;
+    char *outfile; // NULL in verify and rekey mode
+    uint64_t size;
+    int split; // stream split over the pool, see ranges.h
+    vse_manifest_entry_t entry; // --incremental only
+    vse_dir_node_t *dir;        // --journal only
+    struct vse_file_job *next;  // rest of its batch
+} vse_file_job_t;
 
-    if (ret == 0)
+/*
+ * The walk does not start files as it finds them: up to VSE_SCHED_WINDOW
+ * are collected, then queued biggest first (LPT), so that the largest do
+ * not end up as the tail of the run. Files of at least VSE_SPLIT_MIN_BYTES
+ * are split over the whole pool; files under VSE_SCHED_SMALL_BYTES go to
+ * the workers in batches, which keeps the queue short.
+ */
+#define VSE_SCHED_WINDOW 65536
+#define VSE_SCHED_SMALL_BYTES (256 * 1024)
+#define VSE_SCHED_BATCH_FILES 64
+#define VSE_SCHED_BATCH_BYTES (4 << 20)
+
+static vse_threadpool_t *g_pool; // NULL: run files on the calling thread
+static vse_file_job_t **g_sched; // collected by the walk, not queued yet
+static size_t g_sched_count;
+static size_t g_sched_cap;
+static vse_manifest_t *g_manifest; // --incremental
+static vse_journal_t *g_journal; // --journal
+static vse_dir_node_t *g_walk_dir; // folder being walked, --journal only
+static size_t g_root_len; // of -i, to make paths relative for the manifest and journal
+static uint64_t g_unchanged;
+static uint64_t g_changed;
+static vse_mutex_t g_result_lock;
+static int g_any_error;
+static uint64_t g_verify_ok;
+static uint64_t g_verify_failed;
+
+/* Record the outcome of a file; in verify mode also print its OK/FAIL line. */
+static void report_file(int mode, const char *infile, int ret)
+{
+    vse_mutex_lock(&g_result_lock);
+    if (mode == MODE_VERIFY)
+    {
+        if (ret == 0)
+        {
+            g_verify_ok++;
+            printf("OK   %s\n", infile);
+        }
+        else
+        {
+            g_verify_failed++;
+            printf("FAIL %s (error %d)\n", infile, ret);
+        }
+        fflush(stdout);
+    }
+    else if (ret != 0)
     {
-        struct stat stat_buf;
-        if (stat(outfile, &stat_buf) == 0)
-            unlink(outfile);
+        vse_print_error("Error: Failed to process %s: %d\n", infile, ret);
+    }
+    if (ret != 0 && g_any_error == 0)
+        g_any_error = ret;
+    vse_mutex_unlock(&g_result_lock);
+}
 
-        ret = rename(tmp_outfile, outfile);
-        if (ret != 0)
+static vse_dir_node_t *dir_node_new(vse_dir_node_t *parent, const char *infolder)
+{
+    if (g_journal == NULL)
+        return NULL;
+
+    vse_dir_node_t *node = calloc(1, sizeof(vse_dir_node_t));
+    node->parent = parent;
+    node->relpath = parent != NULL ? strdup(infolder + g_root_len + 1) : NULL;
+    node->pending = 1;
+    if (parent != NULL)
+    {
+        vse_mutex_lock(&g_result_lock);
+        parent->pending++;
+        vse_mutex_unlock(&g_result_lock);
+    }
+    return node;
+}
+
+static void dir_node_hold(vse_dir_node_t *node)
+{
+    if (node == NULL)
+        return;
+    vse_mutex_lock(&g_result_lock);
+    node->pending++;
+    vse_mutex_unlock(&g_result_lock);
+}
+
+static void dir_node_release(vse_dir_node_t *node, int failed)
+{
+    while (node != NULL)
+    {
+        vse_mutex_lock(&g_result_lock);
+        node->failed |= failed;
+        int done = --node->pending == 0;
+        vse_mutex_unlock(&g_result_lock);
+        if (!done)
+            return;
+
+        // A folder with a failed file stays unfinished, and so do its parents.
+        failed = node->failed;
+        if (!failed && node->relpath != NULL)
+            vse_journal_dir_done(g_journal, node->relpath);
+        vse_dir_node_t *parent = node->parent;
+        free(node->relpath);
+        free(node);
+        node = parent;
+    }
+}
+
+static void run_file_job(void *arg)
+{
+    vse_file_job_t *job = arg;
+    if (job->split)
+        vse_ranges_attach(g_pool);
+    int ret = vse_run_on_file(&job->opts, job->infile, job->outfile);
+    vse_ranges_attach(NULL);
+    report_file(job->opts.mode, job->infile, ret);
+    if (g_manifest != NULL && ret == 0)
+        vse_manifest_record(g_manifest, job->infile + g_root_len + 1, &job->entry);
+    if (g_journal != NULL)
+    {
+        if (ret == 0)
+            vse_journal_file_done(g_journal, job->infile + g_root_len + 1);
+        dir_node_release(job->dir, ret != 0);
+    }
+    free(job->outfile);
+    free(job->infile);
+    free(job);
+}
+
+// --trace keeps the one-file path, whose spans nest in their file's.
+static int can_share_lanes(const vse_file_job_t *job)
+{
+    return job->opts.mode == MODE_ENCRYPT && job->opts.version == 1 && !job->opts.checkpoint &&
+           !vse_trace_enabled && !vse_cipher_find(job->opts.cipher)->aead;
+}
+
+/*
+ * Run a batch of small files. Those encrypted to format 1 go through the
+ * multi-buffer engine VSE_LANES_MAX at a time (see multibuf.h); batches
+ * come biggest first, so a group holds files of about the same size.
+ */
+static void run_batch_job(void *arg)
+{
+    vse_file_job_t *job = arg;
+    while (job != NULL)
+    {
+        vse_mb_lane_t lanes[VSE_LANES_MAX];
+        vse_file_job_t *group[VSE_LANES_MAX];
+        int n = 0;
+        for (vse_file_job_t *j = job; j != NULL && n < VSE_LANES_MAX && can_share_lanes(j); j = j->next)
         {
-            vse_print_error("Error: Failed to rename output file: %s\n", strerror(errno));
-            unlink(tmp_outfile);
+            group[n] = j;
+            lanes[n].infile = j->infile;
+            lanes[n].size = j->size;
+            n++;
+        }
+
+        if (n < 2)
+        {
+            vse_file_job_t *next = job->next;
+            run_file_job(job);
+            job = next;
+            continue;
+        }
+
+        vse_mb_encrypt_v1(job->opts.cipher, job->opts.password, job->opts.password_nbytes, lanes, n);
+        for (int i = 0; i < n; i++)
+        {
+            job = group[i]->next;
+            vse_mb_attach(&lanes[i]);
+            run_file_job(group[i]);
+            vse_mb_attach(NULL);
+            vse_mb_free(&lanes[i]);
         }
     }
+}
+
+static void submit_job(vse_job_fn fn, vse_file_job_t *job)
+{
+    if (vse_threadpool_submit(g_pool, fn, job) != 0)
+        fn(job);
+}
+
+static int sched_cmp(const void *a, const void *b)
+{
+    uint64_t size_a = (*(vse_file_job_t *const *)a)->size;
+    uint64_t size_b = (*(vse_file_job_t *const *)b)->size;
+    return size_a < size_b ? 1 : size_a > size_b ? -1 : 0;
+}
+
+/* Queue the collected files on the pool, biggest first. */
+static void sched_flush(void)
+{
+    qsort(g_sched, g_sched_count, sizeof(vse_file_job_t *), sched_cmp);
+
+    uint64_t split_min = VSE_SPLIT_MIN_BYTES;
+    const char *env = getenv("VSE_SPLIT_MIN_BYTES");
+    if (env != NULL && strtoull(env, NULL, 10) != 0)
+        split_min = strtoull(env, NULL, 10);
+    int can_split = vse_threadpool_size(g_pool) > 1;
+
+    vse_file_job_t *batch = NULL;
+    vse_file_job_t **tail = &batch;
+    size_t batch_files = 0;
+    uint64_t batch_bytes = 0;
+    for (size_t i = 0; i < g_sched_count; i++)
+    {
+        vse_file_job_t *job = g_sched[i];
+        if (job->size >= VSE_SCHED_SMALL_BYTES)
+        {
+            job->split = can_split && job->size >= split_min;
+            submit_job(run_file_job, job);
+            continue;
+        }
+
+        *tail = job;
+        tail = &job->next;
+        batch_bytes += job->size;
+        if (++batch_files == VSE_SCHED_BATCH_FILES || batch_bytes >= VSE_SCHED_BATCH_BYTES)
+        {
+            submit_job(run_batch_job, batch);
+            batch = NULL;
+            tail = &batch;
+            batch_files = 0;
+            batch_bytes = 0;
+        }
+    }
+    if (batch != NULL)
+        submit_job(run_batch_job, batch);
+
+    g_sched_count = 0;
+}
+
+/*
+ * Work out the output path of filepath (named name, in the folder being
+ * walked) and queue it. Takes ownership of filepath.
+ */
+static void queue_file(const vse_run_opts_t *opts,
+                       char *filepath, const struct stat *file_stat,
+                       const char *name, const char *outfolder,
+                       int force_override)
+{
+    int mode = opts->mode;
+    char *outfile = NULL;
+    if (mode == MODE_VERIFY || mode == MODE_REKEY)
+    {
+        // Nothing new is written; only .vse files are touched.
+        char *outname = derive_outname(mode, name);
+        if (outname == NULL)
+        {
+            free(filepath);
+            return;
+        }
+        free(outname);
+    }
+    else if (outfolder != NULL)
+    {
+        char *outname = derive_outname(mode, name);
+        if (outname == NULL)
+        {
+            vse_print_error("Warning: Skipping %s: cannot derive output filename\n", filepath);
+            free(filepath);
+            return;
+        }
+        size_t out_len = strlen(outfolder) + 1 + strlen(outname) + 1;
+        outfile = malloc(out_len);
+#if _MSC_VER
+        snprintf(outfile, out_len, "%s\\%s", outfolder, outname);
+#else
+        snprintf(outfile, out_len, "%s/%s", outfolder, outname);
+#endif
+        free(outname);
+    }
     else
     {
-        unlink(tmp_outfile);
+        outfile = derive_outfile(mode, filepath);
+        if (outfile == NULL)
+        {
+            vse_print_error("Warning: Skipping %s: cannot derive output filename\n", filepath);
+            free(filepath);
+            return;
+        }
+    }
+
+    struct stat st;
+    vse_manifest_entry_t entry = {0};
+    if (g_manifest != NULL)
+    {
+        // Skip files unchanged since the last run whose output is still
+        // there. --incremental implies -f: the others replace their output.
+        const char *relpath = filepath + g_root_len + 1;
+        if (vse_manifest_check(g_manifest, relpath, filepath, file_stat, &entry) &&
+            stat(outfile, &st) == 0)
+        {
+            vse_manifest_record(g_manifest, relpath, &entry);
+            g_unchanged++;
+            free(outfile);
+            free(filepath);
+            return;
+        }
+        g_changed++;
     }
 
-    free((void *)tmp_outfile);
+    // Re-encrypting in place replaces the input, which is the point.
+    if (outfile != NULL && !force_override && strcmp(outfile, filepath) != 0 && stat(outfile, &st) == 0)
+    {
+        vse_print_error("Warning: Skipping %s: output %s already exists. Use -f to override.\n",
+                        filepath, outfile);
+        free(outfile);
+        free(filepath);
+        return;
+    }
 
-    if (ret == 0 && delete_infile)
-        unlink(infile);
+    vse_file_job_t *job = malloc(sizeof(vse_file_job_t));
+    job->opts = *opts;
+    job->infile = filepath;
+    job->outfile = outfile;
+    job->size = (uint64_t)file_stat->st_size;
+    job->split = 0;
+    job->entry = entry;
+    job->dir = g_walk_dir;
+    job->next = NULL;
+    dir_node_hold(job->dir);
+
+    if (g_pool == NULL)
+    {
+        run_file_job(job);
+        return;
+    }
 
-    return ret;
+    if (g_sched_count == g_sched_cap)
+    {
+        g_sched_cap = g_sched_cap ? g_sched_cap * 2 : 1024;
+        g_sched = realloc(g_sched, g_sched_cap * sizeof(vse_file_job_t *));
+    }
+    g_sched[g_sched_count++] = job;
+    if (g_sched_count == VSE_SCHED_WINDOW)
+        sched_flush();
+}
+
+static int process_folder(const vse_run_opts_t *opts,
+                          const char *infolder, const char *outfolder,
+                          int force_override);
+
+typedef struct vse_prune_ctx
+{
+    int mode;
+    const char *outfolder;
+    uint64_t pruned;
+} vse_prune_ctx_t;
+
+/* Remove the output of a source file that is gone. */
+static void prune_output(const char *relpath, void *arg)
+{
+    vse_prune_ctx_t *ctx = arg;
+    char *outname = derive_outname(ctx->mode, relpath);
+    if (outname == NULL)
+        return;
+
+    size_t out_len = strlen(ctx->outfolder) + 1 + strlen(outname) + 1;
+    char *outfile = malloc(out_len);
+#if _MSC_VER
+    snprintf(outfile, out_len, "%s\\%s", ctx->outfolder, outname);
+#else
+    snprintf(outfile, out_len, "%s/%s", ctx->outfolder, outname);
+#endif
+    if (remove(outfile) == 0)
+        ctx->pruned++;
+    free(outfile);
+    free(outname);
 }
 
 /*
- * Recursively process all non-empty regular files under infolder.
- * outfolder: mirror directory for output, or NULL to write output in-place (next to input).
- * Returns the first non-zero error encountered, or 0.
+ * After an --incremental walk: prune the outputs of deleted sources if asked
+ * and the whole tree was walked, then save the manifest.
  */
-static int process_folder(int mode, int cipher,
-                           const char *password, size_t password_nbytes,
-                           const char *infolder, const char *outfolder,
-                           int force_override, int delete_infile)
+static int finish_incremental(int mode, const char *outfolder, const char *manifest_path,
+                              int walk_ret, int prune)
+{
+    vse_prune_ctx_t ctx = {mode, outfolder, 0};
+    if (prune && walk_ret == 0)
+        vse_manifest_for_each_removed(g_manifest, prune_output, &ctx);
+
+    int ret = vse_manifest_commit(g_manifest);
+    if (ret != 0)
+        vse_print_error("Error: Failed to write manifest %s\n", manifest_path);
+    vse_manifest_free(g_manifest);
+    g_manifest = NULL;
+
+    printf("%llu unchanged, %llu changed, %llu pruned\n",
+           (unsigned long long)g_unchanged, (unsigned long long)g_changed,
+           (unsigned long long)ctx.pruned);
+    return walk_ret != 0 ? walk_ret : ret;
+}
+
+static int process_folder_entries(const vse_run_opts_t *opts,
+                                  const char *infolder, const char *outfolder,
+                                  int force_override)
 {
     int any_error = 0;
 
@@ -352,6 +806,11 @@ static int process_folder(int mode, int cipher,
         size_t path_len = strlen(infolder) + 1 + strlen(fd.cFileName) + 1;
         char *filepath = malloc(path_len);
         snprintf(filepath, path_len, "%s\\%s", infolder, fd.cFileName);
+        if (g_journal != NULL && vse_journal_done(g_journal, filepath + g_root_len + 1))
+        {
+            free(filepath);
+            continue;
+        }
 
         if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
         {
@@ -370,66 +829,21 @@ static int process_folder(int mode, int cipher,
                     continue;
                 }
             }
-            int ret = process_folder(mode, cipher, password, password_nbytes,
-                                     filepath, suboutfolder, force_override, delete_infile);
+            int ret = process_folder(opts, filepath, suboutfolder, force_override);
             if (ret != 0 && any_error == 0) any_error = ret;
             free(suboutfolder);
             free(filepath);
             continue;
         }
 
-        if (fd.nFileSizeLow == 0 && fd.nFileSizeHigh == 0)
-        {
-            free(filepath);
-            continue;
-        }
-
-        char *outfile;
-        if (outfolder != NULL)
-        {
-            char *outname = derive_outname(mode, fd.cFileName);
-            if (outname == NULL)
-            {
-                vse_print_error("Warning: Skipping %s: cannot derive output filename\n", filepath);
-                free(filepath);
-                continue;
-            }
-            size_t out_len = strlen(outfolder) + 1 + strlen(outname) + 1;
-            outfile = malloc(out_len);
-            snprintf(outfile, out_len, "%s\\%s", outfolder, outname);
-            free(outname);
-        }
-        else
-        {
-            outfile = derive_outfile(mode, filepath);
-            if (outfile == NULL)
-            {
-                vse_print_error("Warning: Skipping %s: cannot derive output filename\n", filepath);
-                free(filepath);
-                continue;
-            }
-        }
-
         struct stat st;
-        if (!force_override && stat(outfile, &st) == 0)
+        if ((fd.nFileSizeLow == 0 && fd.nFileSizeHigh == 0) || stat(filepath, &st) != 0)
         {
-            vse_print_error("Warning: Skipping %s: output %s already exists. Use -f to override.\n",
-                            filepath, outfile);
-            free(outfile);
             free(filepath);
             continue;
         }
 
-        int ret = run_on_file(mode, cipher, password, password_nbytes,
-                              filepath, outfile, delete_infile);
-        if (ret != 0)
-        {
-            vse_print_error("Error: Failed to process %s: %d\n", filepath, ret);
-            if (any_error == 0) any_error = ret;
-        }
-
-        free(outfile);
-        free(filepath);
+        queue_file(opts, filepath, &st, fd.cFileName, outfolder, force_override);
     } while (FindNextFileA(hFind, &fd));
 
     FindClose(hFind);
@@ -450,6 +864,12 @@ static int process_folder(int mode, int cipher,
         size_t path_len = strlen(infolder) + 1 + strlen(entry->d_name) + 1;
         char *filepath = malloc(path_len);
         snprintf(filepath, path_len, "%s/%s", infolder, entry->d_name);
+        // Finished in an earlier run: not even stat()ed.
+        if (g_journal != NULL && vse_journal_done(g_journal, filepath + g_root_len + 1))
+        {
+            free(filepath);
+            continue;
+        }
 
         struct stat st;
         if (stat(filepath, &st) != 0)
@@ -476,8 +896,7 @@ static int process_folder(int mode, int cipher,
                     continue;
                 }
             }
-            int ret = process_folder(mode, cipher, password, password_nbytes,
-                                     filepath, suboutfolder, force_override, delete_infile);
+            int ret = process_folder(opts, filepath, suboutfolder, force_override);
             if (ret != 0 && any_error == 0) any_error = ret;
             free(suboutfolder);
             free(filepath);
@@ -490,51 +909,7 @@ static int process_folder(int mode, int cipher,
             continue;
         }
 
-        char *outfile;
-        if (outfolder != NULL)
-        {
-            char *outname = derive_outname(mode, entry->d_name);
-            if (outname == NULL)
-            {
-                vse_print_error("Warning: Skipping %s: cannot derive output filename\n", filepath);
-                free(filepath);
-                continue;
-            }
-            size_t out_len = strlen(outfolder) + 1 + strlen(outname) + 1;
-            outfile = malloc(out_len);
-            snprintf(outfile, out_len, "%s/%s", outfolder, outname);
-            free(outname);
-        }
-        else
-        {
-            outfile = derive_outfile(mode, filepath);
-            if (outfile == NULL)
-            {
-                vse_print_error("Warning: Skipping %s: cannot derive output filename\n", filepath);
-                free(filepath);
-                continue;
-            }
-        }
-
-        if (!force_override && stat(outfile, &st) == 0)
-        {
-            vse_print_error("Warning: Skipping %s: output %s already exists. Use -f to override.\n",
-                            filepath, outfile);
-            free(outfile);
-            free(filepath);
-            continue;
-        }
-
-        int ret = run_on_file(mode, cipher, password, password_nbytes,
-                              filepath, outfile, delete_infile);
-        if (ret != 0)
-        {
-            vse_print_error("Error: Failed to process %s: %d\n", filepath, ret);
-            if (any_error == 0) any_error = ret;
-        }
-
-        free(outfile);
-        free(filepath);
+        queue_file(opts, filepath, &st, entry->d_name, outfolder, force_override);
     }
 
     closedir(dir);
@@ -543,22 +918,62 @@ static int process_folder(int mode, int cipher,
     return any_error;
 }
 
+/*
+ * Recursively queue all non-empty regular files under infolder.
+ * outfolder: mirror directory for output, or NULL to write output in-place (next to input).
+ * Returns the first error of the walk itself, or 0; errors of the files are
+ * collected in g_any_error as they finish.
+ */
+static int process_folder(const vse_run_opts_t *opts,
+                          const char *infolder, const char *outfolder,
+                          int force_override)
+{
+    VSE_PROBE1(folder__enter, infolder);
+    vse_dir_node_t *parent = g_walk_dir;
+    g_walk_dir = dir_node_new(parent, infolder);
+    int ret = process_folder_entries(opts, infolder, outfolder, force_override);
+    dir_node_release(g_walk_dir, ret != 0);
+    g_walk_dir = parent;
+    VSE_PROBE2(folder__exit, infolder, ret);
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     int ret = 0;
-    int mode = MODE_UNKNOWN;                  // encrypt or decrypt
+    int mode = MODE_UNKNOWN;                  // encrypt, decrypt, verify, re-encrypt or rekey
     int cipher = CIPHER_AES_256_CTR_CHACHA20; // default cipher
+    int cipher_given = 0;
+    int version = 1; // format written by -e
     int opt;
     int force_override_outfile = 0;
     int delete_infile = 0;
-    const char *password = NULL;
+    char *password = NULL;
     char *infile = NULL;
     char *outfile = NULL;
     size_t password_nbytes = 0;
+    char *new_password = NULL;
+    size_t new_password_nbytes = 0;
+    const char *serve_path = NULL;
+    int nworkers = 0;
+    int print_stats = 0;
+    const char *stats_json = NULL;
+    const char *trace_path = NULL;
+    const char *metrics_path = NULL;
+    const char *manifest_path = NULL;
+    int prune = 0;
+    const char *journal_path = NULL;
+    int resume = 0;
+    int checkpoint = 0;
+    uint64_t mem_budget = vse_mem_budget_from_cgroup();
+    const char *cpus = NULL;
+    int numa = 0;
+    int cpu_info = 0;
 
     opterr = 0; // do not allow getopt() print any error.
+    vse_mutex_init(&g_result_lock);
 
-    while ((opt = getopt(argc, argv, "hvqfDedc:p:i:o:")) != -1)
+    while ((opt = getopt_long(argc, argv, "hvqfDedtRc:p:P:i:o:j:", long_options, NULL)) != -1)
     {
         switch (opt)
         {
@@ -585,8 +1000,15 @@ int main(int argc, char *argv[])
         case 'd':
             mode = MODE_DECRYPT;
             break;
+        case 't':
+            mode = MODE_VERIFY;
+            break;
+        case 'R':
+            mode = MODE_REENCRYPT;
+            break;
         case 'c':
             cipher = vse_parse_cipher(optarg);
+            cipher_given = 1;
             break;
         case 'i':
             infile = strdup(optarg);
@@ -598,27 +1020,141 @@ int main(int argc, char *argv[])
             password = strdup(optarg);
             password_nbytes = strlen(password);
             break;
+        case 'P':
+            new_password = strdup(optarg);
+            new_password_nbytes = strlen(new_password);
+            break;
+        case 'j':
+            nworkers = atoi(optarg);
+            break;
+        case OPT_SERVE:
+            serve_path = optarg;
+            break;
+        case OPT_CPU_INFO:
+            cpu_info = 1;
+            break;
+        case OPT_STATS:
+            print_stats = 1;
+            break;
+        case OPT_STATS_JSON:
+            stats_json = optarg;
+            break;
+        case OPT_TRACE:
+            trace_path = optarg;
+            break;
+        case OPT_METRICS_FILE:
+            metrics_path = optarg;
+            break;
+        case OPT_REKEY:
+            mode = MODE_REKEY;
+            break;
+        case OPT_FORMAT:
+            version = atoi(optarg);
+            if (version != 1 && version != 2)
+            {
+                vse_print_error("Error: Invalid format %s, must be 1 or 2.\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_INCREMENTAL:
+            manifest_path = optarg;
+            break;
+        case OPT_PRUNE:
+            prune = 1;
+            break;
+        case OPT_JOURNAL:
+            journal_path = optarg;
+            break;
+        case OPT_RESUME:
+            resume = 1;
+            break;
+        case OPT_CHECKPOINT:
+            checkpoint = 1;
+            break;
+        case OPT_MEM_BUDGET:
+            if (parse_size(optarg, &mem_budget) != 0)
+            {
+                vse_print_error("Error: Invalid --mem-budget %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_CPUS:
+            cpus = optarg;
+            break;
+        case OPT_NUMA:
+            numa = 1;
+            break;
         default: /* '?' */
-            vse_print_error("Error: Illegal option \"-%c\".\n", optopt);
+            vse_print_error("Error: Illegal option \"%s\".\n", argv[optind - 1]);
             vse_print_error("       Use \"%s -h\" to see all available options.\n", argv[0]);
             exit(EXIT_FAILURE);
         }
     }
 
+    // Before any thread starts, so that they all inherit it.
+    if (cpus != NULL && vse_numa_set_cpus(cpus) != 0)
+    {
+        vse_print_error("Error: Invalid --cpus %s, or none of its CPUs may be used.\n", cpus);
+        return 1;
+    }
+
+    if (numa && vse_numa_enable() < 0)
+    {
+        vse_print_error("Error: --numa: no NUMA node found.\n");
+        return 1;
+    }
+
+    if (cpu_info)
+    {
+        vse_print_cpu_info();
+        return 0;
+    }
+
+    if (trace_path != NULL && vse_trace_open(trace_path) != 0)
+    {
+        vse_print_error("Error: Failed to open trace file %s\n", trace_path);
+        return ERR_TRACE_FAILED_TO_OPEN;
+    }
+
+    if (metrics_path != NULL && vse_metrics_open(metrics_path) != 0)
+    {
+        vse_print_error("Error: Failed to write metrics file %s\n", metrics_path);
+        return ERR_METRICS_FAILED_TO_WRITE;
+    }
+
+    vse_mem_budget_set(mem_budget);
+    // An explicit -j above the budget is the user's call.
+    int cpu_budget = vse_cpu_budget();
+    vse_cpu_tokens_init(nworkers > cpu_budget ? nworkers : cpu_budget);
+
+    if (serve_path != NULL)
+    {
+        // Served requests are traced too; the trace is written on shutdown.
+        ret = vse_serve(serve_path, nworkers);
+        vse_metrics_close();
+        vse_trace_close();
+        return ret;
+    }
+
     if (mode == MODE_UNKNOWN)
     {
-        vse_print_error("Error: Missing -e or -d.\n");
+        vse_print_error("Error: Missing -e, -d, -t, -R or --rekey.\n");
         vse_usage(argv[0]);
         return 1;
     }
 
-    if (mode == MODE_ENCRYPT && cipher == CIPHER_UNKNOWN)
+    if ((mode == MODE_ENCRYPT || mode == MODE_REENCRYPT) && cipher == CIPHER_UNKNOWN)
     {
         vse_print_error("Error: Invalid cipher.\n");
         vse_usage(argv[0]);
         return 1;
     }
 
+    if (mode == MODE_REENCRYPT && !cipher_given)
+    {
+        cipher = CIPHER_UNKNOWN; // keep the cipher of every file
+    }
+
     if (infile == NULL)
     {
         vse_print_error("Error: Missing -i\n");
@@ -626,6 +1162,77 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (mode == MODE_VERIFY && outfile != NULL)
+    {
+        vse_print_error("Error: -t writes no output, -o cannot be used with it.\n");
+        return 1;
+    }
+
+    if (mode == MODE_REKEY && outfile != NULL)
+    {
+        vse_print_error("Error: --rekey rewrites files in place, -o cannot be used with it.\n");
+        return 1;
+    }
+
+    if (manifest_path != NULL)
+    {
+        struct stat st;
+        if (outfile == NULL || stat(infile, &st) != 0 || !S_ISDIR(st.st_mode) ||
+            (mode != MODE_ENCRYPT && mode != MODE_DECRYPT) || delete_infile)
+        {
+            vse_print_error("Error: --incremental needs -e or -d from a folder (-i) into another (-o), without -D.\n");
+            return 1;
+        }
+    }
+    else if (prune)
+    {
+        vse_print_error("Error: --prune can only be used with --incremental.\n");
+        return 1;
+    }
+
+    if (journal_path != NULL)
+    {
+        // Files a resumed run skips would look deleted to the manifest.
+        struct stat st;
+        if (stat(infile, &st) != 0 || !S_ISDIR(st.st_mode) || manifest_path != NULL)
+        {
+            vse_print_error("Error: --journal needs a folder for -i and cannot be used with --incremental.\n");
+            return 1;
+        }
+    }
+    else if (resume && !checkpoint)
+    {
+        vse_print_error("Error: --resume needs --journal or --checkpoint.\n");
+        return 1;
+    }
+
+    if (checkpoint)
+    {
+        // A version 2 data key is random, so it could not be derived again.
+        struct stat st;
+        if (mode != MODE_ENCRYPT || version != 1 || journal_path != NULL ||
+            (stat(infile, &st) == 0 && S_ISDIR(st.st_mode)))
+        {
+            vse_print_error("Error: --checkpoint needs -e of a single file in format 1.\n");
+            return 1;
+        }
+        // The checkpoint holds a BLAKE2b state, not the tag of an AEAD mode.
+        if (vse_cipher_find(cipher)->aead)
+        {
+            vse_print_error("Error: --checkpoint cannot be used with %s.\n", vse_cipher_find(cipher)->name);
+            return 1;
+        }
+    }
+
+    if (print_stats || stats_json != NULL)
+    {
+        ret = vse_stats_open(print_stats, stats_json);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+
     // Folder mode: process recursively.
     struct stat infile_stat;
     if (stat(infile, &infile_stat) == 0 && S_ISDIR(infile_stat.st_mode))
@@ -657,16 +1264,101 @@ int main(int argc, char *argv[])
 
         if (password == NULL)
         {
-            password = getpass("Password: ");
-            password_nbytes = strlen(password);
+            password = prompt_password("Password: ", &password_nbytes);
+            if (password == NULL)
+            {
+                vse_print_error("Error: Failed to read password\n");
+                return 1;
+            }
+        }
+
+        if ((mode == MODE_REENCRYPT || mode == MODE_REKEY) && new_password == NULL)
+        {
+            new_password = prompt_password("New password: ", &new_password_nbytes);
+            if (new_password == NULL)
+            {
+                vse_print_error("Error: Failed to read password\n");
+                free_password(password);
+                return 1;
+            }
+        }
+
+        if (manifest_path != NULL)
+        {
+            g_manifest = vse_manifest_open(manifest_path, &ret);
+            if (g_manifest == NULL)
+            {
+                vse_print_error("Error: Failed to read manifest %s\n", manifest_path);
+                return ret;
+            }
+            g_root_len = strlen(infile);
+            force_override_outfile = 1;
+        }
+
+        if (journal_path != NULL)
+        {
+            g_journal = vse_journal_open(journal_path, mode, resume, &ret);
+            if (g_journal == NULL)
+            {
+                vse_print_error(ret == ERR_JOURNAL_MODE_MISMATCH
+                                    ? "Error: Journal %s is not from a run in this mode\n"
+                                    : "Error: Failed to open journal %s\n",
+                                journal_path);
+                return ret;
+            }
+            g_root_len = strlen(infile);
         }
 
-        return process_folder(mode, cipher, password, password_nbytes,
-                              infile, outfolder, force_override_outfile, delete_infile);
+        // A journaled file, or a deleted input, is only as safe as its output
+        // on the disk.
+        vse_run_opts_t opts = {mode, cipher, version, password, password_nbytes,
+                               new_password, new_password_nbytes, delete_infile, 0, 0,
+                               journal_path != NULL || delete_infile};
+        g_pool = vse_threadpool_new(nworkers);
+        ret = process_folder(&opts, infile, outfolder, force_override_outfile);
+        if (g_pool != NULL)
+        {
+            sched_flush();
+            free(g_sched);
+            g_sched = NULL;
+            vse_threadpool_free(g_pool); // waits for the queued files
+            g_pool = NULL;
+        }
+        if (g_manifest != NULL)
+        {
+            ret = finish_incremental(mode, outfolder, manifest_path, ret, prune);
+        }
+        if (ret == 0)
+        {
+            ret = g_any_error;
+        }
+        if (g_journal != NULL)
+        {
+            // Kept for --resume unless every file made it.
+            int journal_ret = vse_journal_close(g_journal, ret == 0);
+            g_journal = NULL;
+            if (journal_ret != 0)
+            {
+                vse_print_error("Error: Failed to write journal %s\n", journal_path);
+                if (ret == 0)
+                    ret = journal_ret;
+            }
+        }
+        if (mode == MODE_VERIFY)
+        {
+            printf("%llu OK, %llu FAIL\n",
+                   (unsigned long long)g_verify_ok, (unsigned long long)g_verify_failed);
+        }
+        free_password(password);
+        free_password(new_password);
+        vse_stats_close();
+        vse_metrics_close();
+        vse_trace_close();
+        return ret;
     }
 
     // Single-file mode.
-    if (outfile == NULL)
+    if (outfile == NULL && mode != MODE_VERIFY && mode != MODE_REKEY)
     {
         outfile = derive_outfile(mode, infile);
         if (outfile == NULL)
@@ -678,7 +1370,8 @@ int main(int argc, char *argv[])
     }
 
     struct stat stat_buf;
-    if (force_override_outfile == 0 && stat(outfile, &stat_buf) == 0)
+    if (outfile != NULL && force_override_outfile == 0 && strcmp(outfile, infile) != 0 &&
+        stat(outfile, &stat_buf) == 0)
     {
         vse_print_error("Error: output file %s already exist. Use -f to force override it.\n", outfile);
         return ERR_MAIN_OUTPUT_FILE_ALREADY_EXIST;
@@ -686,12 +1379,40 @@ int main(int argc, char *argv[])
 
     if (password == NULL)
     {
-        password = getpass("Password: ");
-        password_nbytes = strlen(password);
+        password = prompt_password("Password: ", &password_nbytes);
+        if (password == NULL)
+        {
+            vse_print_error("Error: Failed to read password\n");
+            return 1;
+        }
+    }
+
+    if ((mode == MODE_REENCRYPT || mode == MODE_REKEY) && new_password == NULL)
+    {
+        new_password = prompt_password("New password: ", &new_password_nbytes);
+        if (new_password == NULL)
+        {
+            vse_print_error("Error: Failed to read password\n");
+            free_password(password);
+            return 1;
+        }
     }
 
-    ret = run_on_file(mode, cipher, password, password_nbytes,
-                      infile, outfile, delete_infile);
+    vse_run_opts_t opts = {mode, cipher, version, password, password_nbytes,
+                           new_password, new_password_nbytes, delete_infile,
+                           checkpoint, resume, delete_infile};
+    vse_cpu_enter();
+    ret = vse_run_on_file(&opts, infile, outfile);
+    vse_cpu_leave();
+    free_password(password);
+    free_password(new_password);
+    if (mode == MODE_VERIFY)
+    {
+        report_file(mode, infile, ret);
+    }
+    vse_stats_close();
+    vse_metrics_close();
+    vse_trace_close();
 
     return ret;
 }
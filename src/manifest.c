@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#if _MSC_VER
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+#include "vse.h"
+#include "manifest.h"
+#include "sync.h"
+#include "file_ops.h"
+#include "argon2/src/blake2/blake2.h"
+
+#define MANIFEST_MAGIC "VSEMAN01"
+#define MANIFEST_MAGIC_LEN 8
+
+// Bytes hashed at each of the start, middle and end of a file.
+#define MANIFEST_SAMPLE_LEN (16 * 1024)
+
+typedef struct vse_manifest_file_header
+{
+    char magic[MANIFEST_MAGIC_LEN];
+    uint64_t count;
+    uint64_t paths_nbytes;
+} vse_manifest_file_header_t;
+
+typedef struct vse_manifest_record
+{
+    uint64_t path_offset; // into the paths, which are NUL-terminated
+    uint32_t path_len;    // without the NUL
+    uint32_t reserved;
+    vse_manifest_entry_t entry;
+} vse_manifest_record_t;
+
+typedef struct vse_manifest_new_entry
+{
+    char *path;
+    vse_manifest_entry_t entry;
+} vse_manifest_new_entry_t;
+
+struct vse_manifest
+{
+    char *path;
+    char *tmp_path;
+
+    // The old manifest, mapped.
+    const uint8_t *map;
+    size_t map_nbytes;
+    const vse_manifest_record_t *records;
+    const char *paths;
+    uint64_t count;
+    uint64_t paths_nbytes;
+    uint8_t *seen; // one per record
+
+    vse_mutex_t lock; // guards the next manifest
+    vse_manifest_new_entry_t *next;
+    size_t next_count;
+    size_t next_cap;
+};
+
+/* The path of record i, or NULL if the record points outside the file. */
+static const char *vse_manifest_path_at(const vse_manifest_t *m, uint64_t i)
+{
+    const vse_manifest_record_t *r = &m->records[i];
+    if (r->path_offset >= m->paths_nbytes ||
+        r->path_len >= m->paths_nbytes - r->path_offset ||
+        m->paths[r->path_offset + r->path_len] != '\0')
+        return NULL;
+    return m->paths + r->path_offset;
+}
+
+static void vse_manifest_unmap(vse_manifest_t *m)
+{
+    if (m->map == NULL)
+        return;
+#if _MSC_VER
+    free((void *)m->map);
+#else
+    munmap((void *)m->map, m->map_nbytes);
+#endif
+    m->map = NULL;
+}
+
+/* Map path into m; ENOENT leaves m empty. */
+static int vse_manifest_map(vse_manifest_t *m, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return errno == ENOENT ? 0 : ERR_MANIFEST_FAILED_TO_OPEN;
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0)
+    {
+        fclose(fp);
+        return ERR_MANIFEST_FAILED_TO_OPEN;
+    }
+    if ((uint64_t)st.st_size < sizeof(vse_manifest_file_header_t))
+    {
+        fclose(fp);
+        return ERR_MANIFEST_CORRUPT;
+    }
+    m->map_nbytes = (size_t)st.st_size;
+
+#if _MSC_VER
+    uint8_t *buf = malloc(m->map_nbytes);
+    if (buf != NULL && fread(buf, 1, m->map_nbytes, fp) != m->map_nbytes)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    m->map = buf;
+#else
+    void *map = mmap(NULL, m->map_nbytes, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    m->map = map == MAP_FAILED ? NULL : map;
+#endif
+    fclose(fp);
+    if (m->map == NULL)
+        return ERR_MANIFEST_FAILED_TO_OPEN;
+
+    const vse_manifest_file_header_t *header = (const vse_manifest_file_header_t *)m->map;
+    uint64_t body = m->map_nbytes - sizeof(vse_manifest_file_header_t);
+    if (memcmp(header->magic, MANIFEST_MAGIC, MANIFEST_MAGIC_LEN) != 0 ||
+        header->count > body / sizeof(vse_manifest_record_t) ||
+        header->paths_nbytes != body - header->count * sizeof(vse_manifest_record_t))
+    {
+        vse_manifest_unmap(m);
+        return ERR_MANIFEST_CORRUPT;
+    }
+
+    m->count = header->count;
+    m->paths_nbytes = header->paths_nbytes;
+    m->records = (const vse_manifest_record_t *)(m->map + sizeof(vse_manifest_file_header_t));
+    m->paths = (const char *)(m->records + m->count);
+    return 0;
+}
+
+vse_manifest_t *vse_manifest_open(const char *path, int *ret)
+{
+    vse_manifest_t *m = calloc(1, sizeof(vse_manifest_t));
+    if (m == NULL)
+    {
+        *ret = ERR_MANIFEST_FAILED_TO_OPEN;
+        return NULL;
+    }
+    m->path = strdup(path);
+    m->tmp_path = vse_suffixed_path(path, ".tmp");
+
+    *ret = m->path != NULL && m->tmp_path != NULL ? vse_manifest_map(m, path)
+                                                  : ERR_MANIFEST_FAILED_TO_OPEN;
+    if (*ret != 0)
+    {
+        vse_manifest_free(m);
+        return NULL;
+    }
+
+    m->seen = calloc(m->count + 1, 1);
+    vse_mutex_init(&m->lock);
+    return m;
+}
+
+/* Binary search; -1 if relpath is not in the old manifest. */
+static int64_t vse_manifest_find(const vse_manifest_t *m, const char *relpath)
+{
+    uint64_t lo = 0;
+    uint64_t hi = m->count;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const char *p = vse_manifest_path_at(m, mid);
+        if (p == NULL)
+            return -1;
+        int c = strcmp(relpath, p);
+        if (c == 0)
+            return (int64_t)mid;
+        if (c < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return -1;
+}
+
+static uint64_t vse_fingerprint(const char *filepath, uint64_t size)
+{
+    uint8_t buf[MANIFEST_SAMPLE_LEN];
+    uint64_t fingerprint = 0;
+    blake2b_state blake2b;
+    blake2b_init(&blake2b, sizeof(fingerprint));
+    blake2b_update(&blake2b, &size, sizeof(size));
+
+    FILE *fp = fopen(filepath, "rb");
+    if (fp != NULL)
+    {
+        // Small files are hashed whole; the samples overlap.
+        uint64_t offsets[3] = {0, size / 2, size > MANIFEST_SAMPLE_LEN ? size - MANIFEST_SAMPLE_LEN : 0};
+        for (int i = 0; i < 3; i++)
+        {
+            if (vse_fseek64(fp, (int64_t)offsets[i], SEEK_SET) != 0)
+                break;
+            size_t len = fread(buf, 1, sizeof(buf), fp);
+            blake2b_update(&blake2b, buf, len);
+        }
+        fclose(fp);
+    }
+
+    blake2b_final(&blake2b, &fingerprint, sizeof(fingerprint));
+    return fingerprint;
+}
+
+int vse_manifest_check(vse_manifest_t *m, const char *relpath,
+                       const char *filepath, const struct stat *st,
+                       vse_manifest_entry_t *entry)
+{
+    memset(entry, 0, sizeof(vse_manifest_entry_t));
+    entry->size = (uint64_t)st->st_size;
+    entry->mtime_ns = vse_stat_mtime_ns(st);
+    entry->ino = (uint64_t)st->st_ino;
+    entry->fingerprint = vse_fingerprint(filepath, entry->size);
+
+    int64_t i = vse_manifest_find(m, relpath);
+    if (i < 0)
+        return 0;
+
+    m->seen[i] = 1;
+    return memcmp(&m->records[i].entry, entry, sizeof(vse_manifest_entry_t)) == 0;
+}
+
+void vse_manifest_record(vse_manifest_t *m, const char *relpath,
+                         const vse_manifest_entry_t *entry)
+{
+    vse_mutex_lock(&m->lock);
+    if (m->next_count == m->next_cap)
+    {
+        m->next_cap = m->next_cap ? m->next_cap * 2 : 1024;
+        m->next = realloc(m->next, m->next_cap * sizeof(vse_manifest_new_entry_t));
+    }
+    m->next[m->next_count].path = strdup(relpath);
+    m->next[m->next_count].entry = *entry;
+    m->next_count++;
+    vse_mutex_unlock(&m->lock);
+}
+
+void vse_manifest_for_each_removed(vse_manifest_t *m,
+                                   void (*fn)(const char *relpath, void *arg),
+                                   void *arg)
+{
+    for (uint64_t i = 0; i < m->count; i++)
+    {
+        const char *p = vse_manifest_path_at(m, i);
+        if (!m->seen[i] && p != NULL)
+            fn(p, arg);
+    }
+}
+
+static int vse_manifest_cmp(const void *a, const void *b)
+{
+    return strcmp(((const vse_manifest_new_entry_t *)a)->path,
+                  ((const vse_manifest_new_entry_t *)b)->path);
+}
+
+int vse_manifest_commit(vse_manifest_t *m)
+{
+    qsort(m->next, m->next_count, sizeof(vse_manifest_new_entry_t), vse_manifest_cmp);
+
+    FILE *fp = fopen(m->tmp_path, "wb");
+    if (fp == NULL)
+        return ERR_MANIFEST_FAILED_TO_WRITE;
+
+    vse_manifest_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MANIFEST_MAGIC, MANIFEST_MAGIC_LEN);
+    header.count = m->next_count;
+    for (size_t i = 0; i < m->next_count; i++)
+        header.paths_nbytes += strlen(m->next[i].path) + 1;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < m->next_count; i++)
+    {
+        vse_manifest_record_t r;
+        memset(&r, 0, sizeof(r));
+        r.path_offset = offset;
+        r.path_len = (uint32_t)strlen(m->next[i].path);
+        r.entry = m->next[i].entry;
+        fwrite(&r, sizeof(r), 1, fp);
+        offset += r.path_len + 1;
+    }
+    for (size_t i = 0; i < m->next_count; i++)
+        fwrite(m->next[i].path, strlen(m->next[i].path) + 1, 1, fp);
+
+    // The old manifest must stay intact until the new one is on disk.
+    if (vse_commit_tmp_file(fp, m->tmp_path, m->path, 1) != 0)
+        return ERR_MANIFEST_FAILED_TO_WRITE;
+    return 0;
+}
+
+void vse_manifest_free(vse_manifest_t *m)
+{
+    if (m == NULL)
+        return;
+
+    vse_manifest_unmap(m);
+    if (m->seen != NULL)
+        vse_mutex_destroy(&m->lock);
+    for (size_t i = 0; i < m->next_count; i++)
+        free(m->next[i].path);
+    free(m->next);
+    free(m->seen);
+    free(m->tmp_path);
+    free(m->path);
+    free(m);
+}
@@ -0,0 +1,70 @@
+#ifndef MANIFEST_A4E7C2B9_1F63_4D08_9B5E_3C8D2F7A6E10_H
+#define MANIFEST_A4E7C2B9_1F63_4D08_9B5E_3C8D2F7A6E10_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+/*
+ * --incremental: what a previous folder run processed, keyed by the path of
+ * each source file relative to the input folder.
+ *
+ * The file is an array of fixed-size records sorted by path, followed by
+ * the paths themselves, in host byte order. It is memory-mapped and binary
+ * searched, so only the pages a run looks at are read. The next manifest is
+ * collected in memory while files complete and replaces the old one through
+ * a temp file and rename() by vse_manifest_commit().
+ */
+
+typedef struct vse_manifest vse_manifest_t;
+
+typedef struct vse_manifest_entry
+{
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t ino;
+    uint64_t fingerprint; // see vse_manifest_check()
+} vse_manifest_entry_t;
+
+/**
+ * Map the manifest at path; a missing file is an empty manifest.
+ *
+ * @return NULL with *ret set to ERR_MANIFEST_FAILED_TO_OPEN or
+ *         ERR_MANIFEST_CORRUPT.
+ */
+vse_manifest_t *vse_manifest_open(const char *path, int *ret);
+
+/**
+ * Fill entry for filepath from st and a fingerprint of its content: a hash
+ * of its size and of a few sampled blocks at the start, middle and end.
+ * Marks relpath as seen. Not thread-safe: call it from the folder walk.
+ *
+ * @return 1 if the manifest has relpath with the same entry, else 0.
+ */
+int vse_manifest_check(vse_manifest_t *m, const char *relpath,
+                       const char *filepath, const struct stat *st,
+                       vse_manifest_entry_t *entry);
+
+/**
+ * Add relpath to the next manifest. Thread-safe.
+ */
+void vse_manifest_record(vse_manifest_t *m, const char *relpath,
+                         const vse_manifest_entry_t *entry);
+
+/**
+ * Call fn for every path of the old manifest vse_manifest_check() has not
+ * seen, i.e. whose source is gone.
+ */
+void vse_manifest_for_each_removed(vse_manifest_t *m,
+                                   void (*fn)(const char *relpath, void *arg),
+                                   void *arg);
+
+/**
+ * Atomically replace the manifest file with the recorded paths.
+ *
+ * @return 0 or ERR_MANIFEST_FAILED_TO_WRITE.
+ */
+int vse_manifest_commit(vse_manifest_t *m);
+
+void vse_manifest_free(vse_manifest_t *m);
+
+#endif
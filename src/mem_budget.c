@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <string.h>
+#include "mem_budget.h"
+#include "cgroup.h"
+#include "sync.h"
+
+static struct
+{
+    uint64_t budget; // 0: no budget, nothing else is used
+    vse_mutex_t lock; // guards in_use
+    vse_cond_t released;
+    uint64_t in_use;
+} g_budget;
+
+void vse_mem_budget_set(uint64_t nbytes)
+{
+    if (g_budget.budget == 0 && nbytes != 0)
+    {
+        vse_mutex_init(&g_budget.lock);
+        vse_cond_init(&g_budget.released);
+    }
+    g_budget.budget = nbytes;
+}
+
+uint64_t vse_mem_budget_get(void)
+{
+    return g_budget.budget;
+}
+
+static void vse_memory_max(const char *line, void *arg)
+{
+    uint64_t *min = arg;
+    if (strcmp(line, "max") == 0)
+        return;
+    uint64_t limit = strtoull(line, NULL, 10);
+    if (limit != 0 && (*min == 0 || limit < *min))
+        *min = limit;
+}
+
+uint64_t vse_mem_budget_from_cgroup(void)
+{
+    uint64_t limit = 0;
+    vse_cgroup_for_each("memory.max", vse_memory_max, &limit);
+    return limit / 100 * VSE_MEM_BUDGET_CGROUP_PERCENT;
+}
+
+int vse_mem_budget_acquire(uint64_t nbytes)
+{
+    if (g_budget.budget == 0)
+        return 0;
+
+    vse_mutex_lock(&g_budget.lock);
+    while (g_budget.in_use != 0 && g_budget.in_use + nbytes > g_budget.budget)
+        vse_cond_wait(&g_budget.released, &g_budget.lock);
+    g_budget.in_use += nbytes;
+    vse_mutex_unlock(&g_budget.lock);
+    return 1;
+}
+
+void vse_mem_budget_release(uint64_t nbytes)
+{
+    vse_mutex_lock(&g_budget.lock);
+    g_budget.in_use -= nbytes;
+    vse_cond_broadcast(&g_budget.released);
+    vse_mutex_unlock(&g_budget.lock);
+}
@@ -0,0 +1,52 @@
+#ifndef MEM_BUDGET_8A4C1E73_2D95_4B6F_B380_E7F15A92C0D4_H
+#define MEM_BUDGET_8A4C1E73_2D95_4B6F_B380_E7F15A92C0D4_H
+
+#include <stdint.h>
+
+/*
+ * Memory budget for key derivation.
+ *
+ * Every vse_gen_key_v1() needs 64 MiB of Argon2 memory, and every
+ * vse_gen_iv_v1() a little. With a budget set, a KDF first waits until its
+ * memory fits in what the KDFs in flight leave of it (a KDF larger than the
+ * whole budget runs alone). Threads past their KDF keep reading, ciphering
+ * and writing meanwhile. The wait is booked as VSE_PHASE_KDF_WAIT.
+ *
+ * The budget covers KDF memory only: stream buffers and per-thread KDF
+ * arenas kept between calls are not counted.
+ */
+
+// Share of the cgroup's memory.max the default budget takes; the rest is
+// left for buffers and everything else.
+#define VSE_MEM_BUDGET_CGROUP_PERCENT 75
+
+/**
+ * Set the budget in bytes, 0 for none (the default). Call it before any
+ * KDF runs.
+ */
+void vse_mem_budget_set(uint64_t nbytes);
+
+/**
+ * @return the budget in bytes, 0 if there is none.
+ */
+uint64_t vse_mem_budget_get(void);
+
+/**
+ * @return VSE_MEM_BUDGET_CGROUP_PERCENT of the lowest memory.max of our
+ *         cgroup v2 and its ancestors, or 0 if none is set.
+ */
+uint64_t vse_mem_budget_from_cgroup(void);
+
+/**
+ * Wait until nbytes fit in the budget, and take them.
+ *
+ * @return 1 if a budget is set, 0 if not (and nothing was taken).
+ */
+int vse_mem_budget_acquire(uint64_t nbytes);
+
+/**
+ * Give back what vse_mem_budget_acquire() took.
+ */
+void vse_mem_budget_release(uint64_t nbytes);
+
+#endif
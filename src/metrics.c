@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "vse.h"
+#include "cipher.h"
+#include "metrics.h"
+#include "sync.h"
+#include "file_ops.h"
+
+#if _MSC_VER
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define VSE_METRICS_MODES 6
+#define VSE_METRICS_CIPHERS 256
+#define VSE_METRICS_ERRORS 256
+
+// Upper bounds, in seconds, of the KDF latency buckets; +Inf is implied.
+static const double g_kdf_buckets[] = {0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+#define VSE_METRICS_KDF_BUCKETS (sizeof(g_kdf_buckets) / sizeof(g_kdf_buckets[0]))
+
+#define VSE_ERR(code) {code, #code}
+
+static const struct
+{
+    int code;
+    const char *name;
+} g_errors[] = {
+    VSE_ERR(ERR_MAIN_OUTPUT_FILE_ALREADY_EXIST),
+    VSE_ERR(ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE),
+    VSE_ERR(ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER),
+    VSE_ERR(ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE),
+    VSE_ERR(ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_INPUT_FILE),
+    VSE_ERR(ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE),
+    VSE_ERR(ERR_ENCRYPT_FILE_V1_FAIL_TO_WRITE_VERSION),
+    VSE_ERR(ERR_ENCRYPT_FILE_V1_FAIL_TO_SEEK_END_OF_HEADER),
+    VSE_ERR(ERR_ENCRYPT_FILE_OUTFILE_SEEK_TO_HEAD_FAILED),
+    VSE_ERR(ERR_ENCRYPT_FILE_FAILED_TO_WRITE_HEADER),
+    VSE_ERR(ERR_DECRYPT_FILE_FAILED_TO_STAT_INPUT_FILE),
+    VSE_ERR(ERR_DECRYPT_FILE_INPUT_FILE_SIZE_TOO_SMALL),
+    VSE_ERR(ERR_DECRYPT_FILE_FAILED_TO_OPEN_INPUT_FILE),
+    VSE_ERR(ERR_DECRYPT_FILE_FAILED_TO_OPEN_OUTPUT_FILE),
+    VSE_ERR(ERR_DECRYPT_FILE_INVALID_VERSION),
+    VSE_ERR(ERR_DECRYPT_V1_FAIL_TO_READ_FILE_HEADER),
+    VSE_ERR(ERR_DECRYPT_V1_INVALID_PASSWORD),
+    VSE_ERR(ERR_DECRYPT_V1_FAILED_TO_READ_INFILE),
+    VSE_ERR(ERR_DECRYPT_V2_FAIL_TO_READ_FILE_HEADER),
+    VSE_ERR(ERR_DECRYPT_V2_INVALID_PASSWORD),
+    VSE_ERR(ERR_DECRYPT_V2_INVALID_MAC),
+    VSE_ERR(ERR_SERVE_FAILED_TO_LISTEN),
+    VSE_ERR(ERR_SERVE_BAD_REQUEST),
+    VSE_ERR(ERR_SERVE_MISSING_FD),
+    VSE_ERR(ERR_SERVE_FAILED_TO_CREATE_OUTPUT),
+    VSE_ERR(ERR_SERVE_UNSUPPORTED),
+    VSE_ERR(ERR_LIB_KDF_FAILED),
+    VSE_ERR(ERR_LIB_BAD_STATE),
+    VSE_ERR(ERR_LIB_BUFFER_TOO_SMALL),
+    VSE_ERR(ERR_STATS_FAILED_TO_OPEN),
+    VSE_ERR(ERR_TRACE_FAILED_TO_OPEN),
+    VSE_ERR(ERR_METRICS_FAILED_TO_WRITE),
+    VSE_ERR(ERR_REKEY_UNSUPPORTED_VERSION),
+    VSE_ERR(ERR_REKEY_FAILED_TO_OPEN_FILE),
+    VSE_ERR(ERR_REKEY_FAILED_TO_WRITE_HEADER),
+    VSE_ERR(ERR_MANIFEST_FAILED_TO_OPEN),
+    VSE_ERR(ERR_MANIFEST_CORRUPT),
+    VSE_ERR(ERR_MANIFEST_FAILED_TO_WRITE),
+    VSE_ERR(ERR_JOURNAL_FAILED_TO_OPEN),
+    VSE_ERR(ERR_JOURNAL_MODE_MISMATCH),
+    VSE_ERR(ERR_JOURNAL_FAILED_TO_WRITE),
+    VSE_ERR(ERR_CHECKPOINT_FAILED_TO_WRITE),
+    VSE_ERR(ERR_CHECKPOINT_INVALID),
+    VSE_ERR(ERR_CHECKPOINT_INPUT_CHANGED),
+};
+
+typedef struct vse_metrics
+{
+    char *path;
+    char *tmp_path;
+    uint64_t t_open;
+
+    vse_mutex_t lock; // guards everything below
+    uint64_t t_written;
+    uint64_t files[VSE_METRICS_MODES][VSE_METRICS_CIPHERS];
+    uint64_t bytes[VSE_METRICS_MODES][VSE_METRICS_CIPHERS];
+    uint64_t errors[VSE_METRICS_ERRORS]; // codes past the table end share the last slot
+    uint64_t kdf_buckets[VSE_METRICS_KDF_BUCKETS];
+    uint64_t kdf_count;
+    uint64_t kdf_ns;
+} vse_metrics_t;
+
+int vse_metrics_enabled;
+
+static vse_metrics_t g_metrics;
+
+static const char *vse_metrics_mode_name(int mode)
+{
+    switch (mode)
+    {
+    case MODE_ENCRYPT:
+        return "encrypt";
+    case MODE_DECRYPT:
+        return "decrypt";
+    case MODE_VERIFY:
+        return "verify";
+    case MODE_REENCRYPT:
+        return "reencrypt";
+    case MODE_REKEY:
+        return "rekey";
+    default:
+        return "unknown";
+    }
+}
+
+static const char *vse_metrics_cipher_name(int cipher)
+{
+    const vse_cipher_t *desc = vse_cipher_find(cipher);
+    return desc != NULL ? desc->name : "unknown";
+}
+
+static const char *vse_metrics_error_name(int code)
+{
+    for (size_t i = 0; i < sizeof(g_errors) / sizeof(g_errors[0]); i++)
+    {
+        if (g_errors[i].code == code)
+            return g_errors[i].name;
+    }
+    return "unknown";
+}
+
+static uint64_t vse_peak_rss_bytes(void)
+{
+#if _MSC_VER
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return (uint64_t)pmc.PeakWorkingSetSize;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+#if __APPLE__
+    return (uint64_t)ru.ru_maxrss; // bytes
+#else
+    return (uint64_t)ru.ru_maxrss * 1024; // KiB
+#endif
+#endif
+}
+
+// Called with the lock held.
+static int vse_metrics_write(void)
+{
+    const vse_metrics_t *m = &g_metrics;
+    FILE *fp = fopen(m->tmp_path, "w");
+    if (fp == NULL)
+        return ERR_METRICS_FAILED_TO_WRITE;
+
+    uint64_t now = vse_now_ns();
+    uint64_t total_bytes = 0;
+
+    fprintf(fp, "# HELP vsencrypt_files_total Files processed, failed ones included.\n");
+    fprintf(fp, "# TYPE vsencrypt_files_total counter\n");
+    for (int mode = 0; mode < VSE_METRICS_MODES; mode++)
+    {
+        for (int cipher = 0; cipher < VSE_METRICS_CIPHERS; cipher++)
+        {
+            if (m->files[mode][cipher] != 0)
+                fprintf(fp, "vsencrypt_files_total{mode=\"%s\",cipher=\"%s\"} %llu\n",
+                        vse_metrics_mode_name(mode), vse_metrics_cipher_name(cipher),
+                        (unsigned long long)m->files[mode][cipher]);
+        }
+    }
+
+    fprintf(fp, "# HELP vsencrypt_bytes_total Input bytes of the files processed.\n");
+    fprintf(fp, "# TYPE vsencrypt_bytes_total counter\n");
+    for (int mode = 0; mode < VSE_METRICS_MODES; mode++)
+    {
+        for (int cipher = 0; cipher < VSE_METRICS_CIPHERS; cipher++)
+        {
+            if (m->files[mode][cipher] != 0)
+                fprintf(fp, "vsencrypt_bytes_total{mode=\"%s\",cipher=\"%s\"} %llu\n",
+                        vse_metrics_mode_name(mode), vse_metrics_cipher_name(cipher),
+                        (unsigned long long)m->bytes[mode][cipher]);
+            total_bytes += m->bytes[mode][cipher];
+        }
+    }
+
+    fprintf(fp, "# HELP vsencrypt_errors_total Failed files by ERR_* code (error.h).\n");
+    fprintf(fp, "# TYPE vsencrypt_errors_total counter\n");
+    for (int code = 1; code < VSE_METRICS_ERRORS; code++)
+    {
+        if (m->errors[code] != 0)
+            fprintf(fp, "vsencrypt_errors_total{code=\"%d\",name=\"%s\"} %llu\n",
+                    code, vse_metrics_error_name(code), (unsigned long long)m->errors[code]);
+    }
+
+    fprintf(fp, "# HELP vsencrypt_kdf_seconds Argon2 key derivation latency.\n");
+    fprintf(fp, "# TYPE vsencrypt_kdf_seconds histogram\n");
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < VSE_METRICS_KDF_BUCKETS; i++)
+    {
+        cumulative += m->kdf_buckets[i];
+        fprintf(fp, "vsencrypt_kdf_seconds_bucket{le=\"%g\"} %llu\n",
+                g_kdf_buckets[i], (unsigned long long)cumulative);
+    }
+    fprintf(fp, "vsencrypt_kdf_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)m->kdf_count);
+    fprintf(fp, "vsencrypt_kdf_seconds_sum %.6f\n", m->kdf_ns / 1e9);
+    fprintf(fp, "vsencrypt_kdf_seconds_count %llu\n", (unsigned long long)m->kdf_count);
+
+    double elapsed = (now - m->t_open) / 1e9;
+    fprintf(fp, "# HELP vsencrypt_peak_rss_bytes Peak resident set size of the process.\n");
+    fprintf(fp, "# TYPE vsencrypt_peak_rss_bytes gauge\n");
+    fprintf(fp, "vsencrypt_peak_rss_bytes %llu\n", (unsigned long long)vse_peak_rss_bytes());
+    fprintf(fp, "# HELP vsencrypt_throughput_bytes_per_second Input bytes per second of wall time so far.\n");
+    fprintf(fp, "# TYPE vsencrypt_throughput_bytes_per_second gauge\n");
+    fprintf(fp, "vsencrypt_throughput_bytes_per_second %.1f\n", elapsed > 0 ? total_bytes / elapsed : 0.0);
+    fprintf(fp, "# HELP vsencrypt_elapsed_seconds Wall time since the run started.\n");
+    fprintf(fp, "# TYPE vsencrypt_elapsed_seconds gauge\n");
+    fprintf(fp, "vsencrypt_elapsed_seconds %.3f\n", elapsed);
+    fprintf(fp, "# HELP vsencrypt_last_update_timestamp_seconds When this file was written.\n");
+    fprintf(fp, "# TYPE vsencrypt_last_update_timestamp_seconds gauge\n");
+    fprintf(fp, "vsencrypt_last_update_timestamp_seconds %lld\n", (long long)time(NULL));
+
+    // Scraped while the run goes on, not worth an fsync each time.
+    if (vse_commit_tmp_file(fp, m->tmp_path, m->path, 0) != 0)
+        return ERR_METRICS_FAILED_TO_WRITE;
+
+    g_metrics.t_written = now;
+    return 0;
+}
+
+int vse_metrics_open(const char *path)
+{
+    memset(&g_metrics, 0, sizeof(g_metrics));
+    g_metrics.path = strdup(path);
+    g_metrics.tmp_path = vse_suffixed_path(path, ".tmp");
+    g_metrics.t_open = vse_now_ns();
+
+    // Fail early on a bad path rather than after the first batch of files.
+    int ret = g_metrics.path != NULL && g_metrics.tmp_path != NULL ? vse_metrics_write()
+                                                                   : ERR_METRICS_FAILED_TO_WRITE;
+    if (ret != 0)
+    {
+        free(g_metrics.path);
+        free(g_metrics.tmp_path);
+        memset(&g_metrics, 0, sizeof(g_metrics));
+        return ret;
+    }
+
+    vse_mutex_init(&g_metrics.lock);
+    vse_metrics_enabled = 1;
+    return 0;
+}
+
+void vse_metrics_file_end(const vse_timing_t *timing, int mode,
+                          const char *infile, int status)
+{
+    struct stat st;
+    uint64_t bytes = stat(infile, &st) == 0 ? (uint64_t)st.st_size : 0;
+    int m = mode >= 0 && mode < VSE_METRICS_MODES ? mode : MODE_UNKNOWN;
+    int cipher = (uint8_t)timing->cipher;
+
+    vse_mutex_lock(&g_metrics.lock);
+
+    g_metrics.files[m][cipher]++;
+    g_metrics.bytes[m][cipher] += bytes;
+    if (status != 0)
+        g_metrics.errors[status > 0 && status < VSE_METRICS_ERRORS ? status : VSE_METRICS_ERRORS - 1]++;
+
+    if (timing->calls[VSE_PHASE_KDF] != 0)
+    {
+        uint64_t ns = timing->ns[VSE_PHASE_KDF] / timing->calls[VSE_PHASE_KDF];
+        for (size_t i = 0; i < VSE_METRICS_KDF_BUCKETS; i++)
+        {
+            if (ns <= g_kdf_buckets[i] * 1e9)
+            {
+                g_metrics.kdf_buckets[i] += timing->calls[VSE_PHASE_KDF];
+                break;
+            }
+        }
+        g_metrics.kdf_count += timing->calls[VSE_PHASE_KDF];
+        g_metrics.kdf_ns += timing->ns[VSE_PHASE_KDF];
+    }
+
+    if (vse_now_ns() - g_metrics.t_written >= VSE_METRICS_INTERVAL_NS)
+        vse_metrics_write();
+
+    vse_mutex_unlock(&g_metrics.lock);
+}
+
+void vse_metrics_close(void)
+{
+    if (!vse_metrics_enabled)
+        return;
+    vse_metrics_enabled = 0;
+
+    if (vse_metrics_write() != 0)
+        vse_print_error("Error: Failed to write metrics file %s\n", g_metrics.path);
+
+    vse_mutex_destroy(&g_metrics.lock);
+    free(g_metrics.path);
+    free(g_metrics.tmp_path);
+    memset(&g_metrics, 0, sizeof(g_metrics));
+}
@@ -0,0 +1,41 @@
+#ifndef METRICS_5C2F8B16_9E47_4A3D_B0D8_2716E4A9C53F_H
+#define METRICS_5C2F8B16_9E47_4A3D_B0D8_2716E4A9C53F_H
+
+#include <stdint.h>
+#include "timing.h"
+
+/*
+ * --metrics-file: Prometheus text format, for node_exporter's textfile
+ * collector.
+ *
+ * Counts files and bytes by mode and cipher, errors by ERR_* code, and the
+ * KDF latency as a histogram, plus peak RSS and throughput. The file is
+ * rewritten through a temp file and rename(), so a scrape never sees half
+ * of it: after a file completes once VSE_METRICS_INTERVAL_NS has passed
+ * since the last write, and by vse_metrics_close().
+ */
+
+#define VSE_METRICS_INTERVAL_NS 5000000000ull
+
+extern int vse_metrics_enabled;
+
+/**
+ * Start collecting, to be written to path.
+ *
+ * @return 0 or ERR_METRICS_FAILED_TO_WRITE if path cannot be written.
+ */
+int vse_metrics_open(const char *path);
+
+/**
+ * Count a finished file. timing is the one vse_stats_file_begin() attached.
+ * Thread-safe.
+ */
+void vse_metrics_file_end(const vse_timing_t *timing, int mode,
+                          const char *infile, int status);
+
+/**
+ * Write the final values and stop collecting.
+ */
+void vse_metrics_close(void);
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "multibuf.h"
+#include "cipher.h"
+#include "crypt_v1.h"
+#include "crypto_random.h"
+#include "probes.h"
+
+VSE_THREAD_LOCAL vse_mb_lane_t *vse_mb_lane;
+
+void vse_mb_attach(vse_mb_lane_t *lane)
+{
+    vse_mb_lane = lane;
+}
+
+void vse_mb_free(vse_mb_lane_t *lane)
+{
+    if (lane->data != NULL)
+    {
+        memset(lane->data, 0, (size_t)lane->size);
+        free(lane->data);
+        lane->data = NULL;
+    }
+    lane->ready = 0;
+}
+
+/* Read infile whole into lane->data; -1 unless it still has lane->size bytes. */
+static int vse_mb_read(vse_mb_lane_t *lane)
+{
+    FILE *fp = fopen(lane->infile, "rb");
+    if (fp == NULL)
+        return -1;
+
+    int ret = -1;
+    lane->data = malloc(lane->size > 0 ? (size_t)lane->size : 1);
+    if (lane->data != NULL &&
+        fread(lane->data, 1, (size_t)lane->size, fp) == lane->size &&
+        fgetc(fp) == EOF && !ferror(fp))
+        ret = 0;
+    fclose(fp);
+    return ret;
+}
+
+/* Book ns of work shared by the lanes to each, by its share of the bytes. */
+static void vse_mb_book(vse_mb_lane_t *const *lanes, int nlanes, uint64_t total,
+                        vse_phase_t phase, uint64_t ns)
+{
+    for (int i = 0; i < nlanes; i++)
+    {
+        lanes[i]->timing.ns[phase] += total == 0 ? ns / (uint64_t)nlanes : ns * lanes[i]->size / total;
+        lanes[i]->timing.calls[phase]++;
+    }
+}
+
+void vse_mb_encrypt_v1(int cipher,
+                       const char *password, size_t password_nbytes,
+                       vse_mb_lane_t *lanes, int nlanes)
+{
+    const vse_cipher_t *desc = vse_cipher_find(cipher);
+    if (desc == NULL)
+        return;
+
+    vse_cipher_ctx_t ctx[VSE_LANES_MAX];
+    uint8_t key[VSE_LANES_MAX][KEY_LEN];
+    uint8_t file_hash[VSE_LANES_MAX][FILE_HASH_LEN];
+    vse_mb_lane_t *ready[VSE_LANES_MAX];
+    vse_cipher_ctx_t *ctxs[VSE_LANES_MAX];
+    uint8_t *bufs[VSE_LANES_MAX];
+    const uint8_t *ciphertexts[VSE_LANES_MAX];
+    size_t nbytes[VSE_LANES_MAX];
+    const uint8_t *ivs[VSE_LANES_MAX];
+    uint8_t *hashes[VSE_LANES_MAX];
+    uint64_t total = 0;
+    int n = 0;
+
+    // One file at a time: read it, then its salt, IV, key and step IVs.
+    vse_timing_t *sink = vse_timing_sink;
+    for (int i = 0; i < nlanes && i < VSE_LANES_MAX; i++)
+    {
+        vse_mb_lane_t *lane = &lanes[i];
+        memset(&lane->timing, 0, sizeof(vse_timing_t));
+        lane->ready = 0;
+        lane->data = NULL;
+        vse_timing_attach(&lane->timing);
+
+        uint64_t t = VSE_TIMING_NOW();
+        if (vse_mb_read(lane) != 0)
+        {
+            vse_mb_free(lane);
+            continue;
+        }
+        VSE_TIMING_LAP(VSE_PHASE_READ, t);
+        VSE_PROBE1(chunk__read, lane->size);
+
+        memset(&lane->header, 0, sizeof(vse_header_v1_t));
+        lane->header.cipher = cipher;
+        lane->timing.cipher = cipher;
+        crypto_random(lane->header.salt, SALT_LEN);
+        crypto_random(lane->header.iv, IV_LEN);
+        if (vse_gen_key_v1(lane->header.salt, SALT_LEN,
+                           password, password_nbytes, KEY_LEN, key[n]) != 0 ||
+            desc->setup(&ctx[n], lane->header.iv, IV_LEN, key[n], KEY_LEN) != 0)
+        {
+            vse_mb_free(lane);
+            continue;
+        }
+
+        ctxs[n] = &ctx[n];
+        bufs[n] = lane->data;
+        ciphertexts[n] = lane->data;
+        nbytes[n] = (size_t)lane->size;
+        ivs[n] = lane->header.iv;
+        hashes[n] = file_hash[n];
+        ready[n++] = lane;
+        total += lane->size;
+    }
+    vse_timing_attach(NULL);
+
+    // All files at once: the cipher steps, then the hashes of the ciphertexts.
+    uint64_t t0 = vse_now_ns();
+    desc->xcrypt_lanes(ctxs, bufs, nbytes, n);
+    uint64_t t1 = vse_now_ns();
+    vse_cpu_dispatch()->blake2b_lanes(hashes, FILE_HASH_LEN, ivs, IV_LEN, ciphertexts, nbytes, n);
+    uint64_t t2 = vse_now_ns();
+    vse_mb_book(ready, n, total, VSE_PHASE_CIPHER, t1 - t0);
+    vse_mb_book(ready, n, total, VSE_PHASE_HASH, t2 - t1);
+
+    for (int i = 0; i < n; i++)
+    {
+        vse_calculate_mac_v1(&ready[i]->header, file_hash[i], key[i], ready[i]->header.mac);
+        ready[i]->ready = 1;
+    }
+
+    memset(ctx, 0, sizeof(ctx));
+    memset(key, 0, sizeof(key));
+    vse_timing_attach(sink);
+}
+
+int vse_mb_write_v1(const vse_mb_lane_t *lane, FILE *fp_out)
+{
+    vse_timing_add(&lane->timing);
+
+    uint64_t t = VSE_TIMING_NOW();
+    uint8_t version = 1;
+    if (fwrite(&version, 1, 1, fp_out) != 1)
+    {
+        vse_print_error("Error: Failed to write version: %s\n", strerror(errno));
+        return ERR_ENCRYPT_FILE_V1_FAIL_TO_WRITE_VERSION;
+    }
+
+    if (fwrite(&lane->header, sizeof(vse_header_v1_t), 1, fp_out) != 1)
+    {
+        vse_print_error("Error: Failed to write file header: %s", strerror(errno));
+        return ERR_ENCRYPT_FILE_FAILED_TO_WRITE_HEADER;
+    }
+
+    if (fwrite(lane->data, 1, (size_t)lane->size, fp_out) != lane->size)
+    {
+        vse_print_error("Error: Failed to write to output file: %s\n", strerror(errno));
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+    }
+    VSE_TIMING_LAP(VSE_PHASE_WRITE, t);
+    VSE_PROBE1(chunk__write, lane->size);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef MULTIBUF_96D2B4E1_0C7A_4F3B_8E15_A4C7F2903D6B_H
+#define MULTIBUF_96D2B4E1_0C7A_4F3B_8E15_A4C7F2903D6B_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "vse.h"
+#include "timing.h"
+#include "lanes.h"
+
+/*
+ * Multi-buffer encryption of small files, version 1.
+ *
+ * A folder batch hands up to VSE_LANES_MAX small files at once to
+ * vse_mb_encrypt_v1(). It reads each one whole and derives its salt, IV and
+ * key, then runs the cipher steps and the BLAKE2b file hashes of all of
+ * them side by side in SIMD lanes (lanes.h), and works out every MAC.
+ *
+ * Each file then goes through vse_run_on_file() as usual, with its lane
+ * attached to the thread: vse_encrypt_fp_v1() writes the prepared header
+ * and ciphertext instead of encrypting. Temp files, renames, -D, stats and
+ * the journal are thus those of any other file. A lane that could not be
+ * prepared is not ready and takes the one-file path.
+ */
+
+typedef struct vse_mb_lane
+{
+    const char *infile;
+    uint64_t size; // as found by the walk; a file that changed is not prepared
+
+    int ready;
+    vse_header_v1_t header;
+    uint8_t *data; // ciphertext, size bytes
+    vse_timing_t timing; // spent preparing it
+} vse_mb_lane_t;
+
+// Lane of the file this thread runs; NULL: none.
+extern VSE_THREAD_LOCAL vse_mb_lane_t *vse_mb_lane;
+
+/**
+ * Hand lane to the next vse_encrypt_fp_v1() on this thread. NULL stops.
+ */
+void vse_mb_attach(vse_mb_lane_t *lane);
+
+/**
+ * Prepare lanes[0..nlanes) (nlanes <= VSE_LANES_MAX) for encryption with
+ * cipher under password. Sets ready on the lanes that were.
+ */
+void vse_mb_encrypt_v1(int cipher,
+                       const char *password, size_t password_nbytes,
+                       vse_mb_lane_t *lanes, int nlanes);
+
+/**
+ * Write version 1 file lane into fp_out, in place of vse_encrypt_fp_v1(),
+ * and add its preparation to this thread's timing.
+ *
+ * @return 0 or the error vse_encrypt_fp_v1() returns for a failed write.
+ */
+int vse_mb_write_v1(const vse_mb_lane_t *lane, FILE *fp_out);
+
+/**
+ * Wipe and free the ciphertext of lane.
+ */
+void vse_mb_free(vse_mb_lane_t *lane);
+
+#endif
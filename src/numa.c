@@ -0,0 +1,208 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vse.h"
+#include "numa.h"
+
+#if defined(__linux__)
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#define VSE_NUMA_MASK_BITS (8 * sizeof(unsigned long))
+
+typedef struct vse_numa_node
+{
+    int id;
+    cpu_set_t cpus; // those of the node the process may use
+} vse_numa_node_t;
+
+static struct
+{
+    int enabled;
+    int found; // nodes looked up since the last affinity change
+    int nnodes;
+    vse_numa_node_t nodes[VSE_NUMA_MAX_NODES];
+} g_numa;
+
+static VSE_THREAD_LOCAL vse_numa_node_t *t_node; // NULL: not pinned
+
+/* Parse a CPU list such as "0-3,8" into set; -1 if invalid or empty. */
+static int vse_numa_parse_list(const char *list, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    const char *p = list;
+    while (*p != '\0')
+    {
+        char *end;
+        if (!isdigit((unsigned char)*p))
+            return -1;
+        unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        if (*end == '-')
+        {
+            p = end + 1;
+            if (!isdigit((unsigned char)*p))
+                return -1;
+            last = strtoul(p, &end, 10);
+        }
+        if (last < first || last >= CPU_SETSIZE)
+            return -1;
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+
+        p = end;
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return -1;
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+static void vse_numa_find(void)
+{
+    if (g_numa.found)
+        return;
+    g_numa.found = 1;
+    g_numa.nnodes = 0;
+
+    cpu_set_t usable;
+    if (sched_getaffinity(0, sizeof(usable), &usable) != 0)
+        return;
+
+    for (int id = 0; id < VSE_NUMA_MAX_NODES; id++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL)
+            continue;
+        char line[4096];
+        int ok = fgets(line, sizeof(line), fp) != NULL;
+        fclose(fp);
+        if (!ok)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+
+        // Memory-only nodes have an empty list.
+        vse_numa_node_t *node = &g_numa.nodes[g_numa.nnodes];
+        if (vse_numa_parse_list(line, &node->cpus) != 0)
+            continue;
+        CPU_AND(&node->cpus, &node->cpus, &usable);
+        if (CPU_COUNT(&node->cpus) == 0)
+            continue;
+        node->id = id;
+        g_numa.nnodes++;
+    }
+}
+
+int vse_numa_set_cpus(const char *list)
+{
+    cpu_set_t set;
+    if (vse_numa_parse_list(list, &set) != 0 || sched_setaffinity(0, sizeof(set), &set) != 0)
+        return -1;
+    g_numa.found = 0;
+    return 0;
+}
+
+int vse_numa_enable(void)
+{
+    vse_numa_find();
+    if (g_numa.nnodes == 0)
+        return -1;
+    g_numa.enabled = 1;
+    return g_numa.nnodes;
+}
+
+int vse_numa_nodes(void)
+{
+    vse_numa_find();
+    return g_numa.nnodes;
+}
+
+void vse_numa_pin_worker(int index)
+{
+    if (!g_numa.enabled)
+        return;
+
+    vse_numa_node_t *node = &g_numa.nodes[index % g_numa.nnodes];
+    if (sched_setaffinity(0, sizeof(node->cpus), &node->cpus) == 0)
+        t_node = node;
+}
+
+void *vse_numa_alloc(size_t nbytes)
+{
+    if (!g_numa.enabled)
+        return malloc(nbytes);
+
+    // Fresh pages from mmap(): none is touched yet, so all follow the policy.
+    void *memory = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return NULL;
+
+    if (t_node != NULL)
+    {
+        // Preferred rather than bound: when the node is full, pages come
+        // from another one instead of failing.
+        unsigned long mask[VSE_NUMA_MAX_NODES / VSE_NUMA_MASK_BITS] = {0};
+        mask[t_node->id / VSE_NUMA_MASK_BITS] |= 1ul << (t_node->id % VSE_NUMA_MASK_BITS);
+        syscall(SYS_mbind, memory, nbytes, MPOL_PREFERRED, mask, VSE_NUMA_MAX_NODES + 1, 0);
+    }
+    return memory;
+}
+
+void vse_numa_free(void *memory, size_t nbytes)
+{
+    if (memory == NULL)
+        return;
+    if (!g_numa.enabled)
+        free(memory);
+    else
+        munmap(memory, nbytes);
+}
+
+#else
+
+int vse_numa_set_cpus(const char *list)
+{
+    (void)list;
+    return -1;
+}
+
+int vse_numa_enable(void)
+{
+    return -1;
+}
+
+int vse_numa_nodes(void)
+{
+    return 0;
+}
+
+void vse_numa_pin_worker(int index)
+{
+    (void)index;
+}
+
+void *vse_numa_alloc(size_t nbytes)
+{
+    return malloc(nbytes);
+}
+
+void vse_numa_free(void *memory, size_t nbytes)
+{
+    (void)nbytes;
+    free(memory);
+}
+
+#endif
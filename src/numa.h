@@ -0,0 +1,62 @@
+#ifndef NUMA_7B1E4C92_3A6D_4F58_8E20_D5C9A1F7B364_H
+#define NUMA_7B1E4C92_3A6D_4F58_8E20_D5C9A1F7B364_H
+
+#include <stddef.h>
+
+/*
+ * CPU and NUMA placement (Linux only), with the raw sched_setaffinity() and
+ * mbind() system calls rather than libnuma.
+ *
+ * Nodes are read from /sys/devices/system/node; only those with a CPU the
+ * process may use count. With placement on, thread pool workers are pinned
+ * round-robin to the CPUs of one node each, and the large buffers they
+ * allocate through vse_numa_alloc() (KDF arenas, split-file ranges) are
+ * bound to that node before they are first touched. Stream buffers live on
+ * the worker's stack, which is local once it is pinned.
+ */
+
+// Node ids this high and above are ignored.
+#define VSE_NUMA_MAX_NODES 64
+
+/**
+ * Restrict the process to the CPUs in list, e.g. "0-3,8,10-11". Call it
+ * before starting threads: they inherit it.
+ *
+ * @return 0, or -1 if list is invalid, leaves no CPU the process may use,
+ *         or CPU affinity is not supported here.
+ */
+int vse_numa_set_cpus(const char *list);
+
+/**
+ * Turn on per-node placement. Call it after vse_numa_set_cpus() and before
+ * starting threads.
+ *
+ * @return the number of nodes, or -1 if none could be found.
+ */
+int vse_numa_enable(void);
+
+/**
+ * @return the number of nodes with a CPU the process may use; 0 if unknown.
+ */
+int vse_numa_nodes(void);
+
+/**
+ * Pin the calling thread, worker index of a pool, to the CPUs of node
+ * index % vse_numa_nodes(). Nothing happens unless placement is on.
+ */
+void vse_numa_pin_worker(int index);
+
+/**
+ * Allocate nbytes on the node of the calling thread when placement is on
+ * and the thread is pinned; malloc() otherwise.
+ *
+ * @return NULL if out of memory.
+ */
+void *vse_numa_alloc(size_t nbytes);
+
+/**
+ * Free what vse_numa_alloc(nbytes) returned, on any thread.
+ */
+void vse_numa_free(void *memory, size_t nbytes);
+
+#endif
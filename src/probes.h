@@ -0,0 +1,44 @@
+#ifndef PROBES_E4A2C97B_1F58_4D3A_86B0_C7D5E9F12A64_H
+#define PROBES_E4A2C97B_1F58_4D3A_86B0_C7D5E9F12A64_H
+
+/*
+ * USDT (sys/sdt.h) static tracepoints, provider "vsencrypt".
+ *
+ * Each probe is a single nop plus an ELF note, so they cost nothing until
+ * perf/bpftrace/SystemTap attaches. Built in when sys/sdt.h is found
+ * (systemtap-sdt-dev, systemtap-sdt-devel), otherwise compiled out; define
+ * VSE_NO_USDT to compile them out anyway.
+ *
+ *     bpftrace -e 'usdt:./vsencrypt:vsencrypt:kdf__end { ... }'
+ *
+ * Probes and arguments:
+ *
+ *     file__start     (const char *path, int mode)
+ *     file__end       (const char *path, int mode, int status)
+ *     kdf__begin      (size_t password_nbytes)
+ *     kdf__end        (int status)
+ *     chunk__read     (size_t nbytes)
+ *     chunk__write    (size_t nbytes)
+ *     mac__verify     (int status)           0: MAC matches
+ *     folder__enter   (const char *path)
+ *     folder__exit    (const char *path, int status)
+ */
+
+#if !defined(VSE_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define VSE_HAVE_USDT 1
+#endif
+#endif
+
+#if VSE_HAVE_USDT
+#include <sys/sdt.h>
+#define VSE_PROBE1(name, a) DTRACE_PROBE1(vsencrypt, name, a)
+#define VSE_PROBE2(name, a, b) DTRACE_PROBE2(vsencrypt, name, a, b)
+#define VSE_PROBE3(name, a, b, c) DTRACE_PROBE3(vsencrypt, name, a, b, c)
+#else
+#define VSE_PROBE1(name, a) ((void)0)
+#define VSE_PROBE2(name, a, b) ((void)0)
+#define VSE_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+#endif
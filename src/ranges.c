@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ranges.h"
+#include "sync.h"
+#include "timing.h"
+#include "probes.h"
+#include "numa.h"
+
+VSE_THREAD_LOCAL vse_threadpool_t *vse_range_pool;
+
+enum
+{
+    RANGE_FREE,
+    RANGE_QUEUED,
+    RANGE_RUNNING,
+    RANGE_DONE
+};
+
+typedef struct vse_range
+{
+    uint64_t seq; // index in the stream
+    uint8_t *buf;
+    size_t len;
+    int state;
+} vse_range_t;
+
+/*
+ * Shared by the caller and the jobs it queued. A job may still sit in the
+ * pool queue after the caller ran its range itself and returned, so the
+ * last one out frees it.
+ */
+typedef struct vse_ranges
+{
+    const vse_cipher_t *desc;
+    vse_cipher_ctx_t ctx; // fresh from setup, copied by every range
+
+    vse_mutex_t lock;  // guards refs and the state of every slot
+    vse_cond_t done;   // signalled when a range is done
+    int refs;
+    size_t nslots;
+    vse_range_t *slots;
+} vse_ranges_t;
+
+typedef struct vse_range_job
+{
+    vse_ranges_t *rs;
+    size_t slot;
+    uint64_t seq;
+} vse_range_job_t;
+
+void vse_ranges_attach(vse_threadpool_t *pool)
+{
+    vse_range_pool = pool;
+}
+
+static void vse_ranges_release(vse_ranges_t *rs)
+{
+    vse_mutex_lock(&rs->lock);
+    int last = --rs->refs == 0;
+    vse_mutex_unlock(&rs->lock);
+    if (!last)
+        return;
+
+    for (size_t i = 0; i < rs->nslots; i++)
+        vse_numa_free(rs->slots[i].buf, VSE_RANGE_BYTES);
+    free(rs->slots);
+    memset(&rs->ctx, 0, sizeof(rs->ctx));
+    vse_cond_destroy(&rs->done);
+    vse_mutex_destroy(&rs->lock);
+    free(rs);
+}
+
+static void vse_range_crypt(vse_ranges_t *rs, vse_range_t *r)
+{
+    vse_cipher_ctx_t ctx = rs->ctx;
+    rs->desc->seek(&ctx, r->seq * VSE_RANGE_BYTES);
+    rs->desc->xcrypt(&ctx, r->buf, r->len);
+    memset(&ctx, 0, sizeof(ctx));
+
+    vse_mutex_lock(&rs->lock);
+    r->state = RANGE_DONE;
+    vse_cond_broadcast(&rs->done);
+    vse_mutex_unlock(&rs->lock);
+}
+
+static void vse_range_job(void *arg)
+{
+    vse_range_job_t *job = arg;
+    vse_ranges_t *rs = job->rs;
+    vse_range_t *r = &rs->slots[job->slot];
+
+    // Skip a range the caller already took, or whose slot moved on since.
+    vse_mutex_lock(&rs->lock);
+    int run = r->seq == job->seq && r->state == RANGE_QUEUED;
+    if (run)
+        r->state = RANGE_RUNNING;
+    vse_mutex_unlock(&rs->lock);
+
+    if (run)
+        vse_range_crypt(rs, r);
+    vse_ranges_release(rs);
+    free(job);
+}
+
+/* Wait for r to be done, running it here if no worker has started it. */
+static void vse_range_wait(vse_ranges_t *rs, vse_range_t *r)
+{
+    vse_mutex_lock(&rs->lock);
+    if (r->state == RANGE_QUEUED)
+    {
+        r->state = RANGE_RUNNING;
+        vse_mutex_unlock(&rs->lock);
+        vse_range_crypt(rs, r);
+        vse_mutex_lock(&rs->lock);
+    }
+    while (r->state != RANGE_DONE)
+        vse_cond_wait(&rs->done, &rs->lock);
+    r->state = RANGE_FREE;
+    vse_mutex_unlock(&rs->lock);
+}
+
+static void vse_range_queue(vse_ranges_t *rs, size_t slot)
+{
+    vse_range_job_t *job = malloc(sizeof(vse_range_job_t));
+    if (job == NULL)
+        return; // the caller runs it
+
+    job->rs = rs;
+    job->slot = slot;
+    job->seq = rs->slots[slot].seq;
+
+    vse_mutex_lock(&rs->lock);
+    rs->refs++;
+    vse_mutex_unlock(&rs->lock);
+
+    if (vse_threadpool_submit_first(vse_range_pool, vse_range_job, job) != 0)
+    {
+        free(job);
+        vse_ranges_release(rs);
+    }
+}
+
+static vse_ranges_t *vse_ranges_new(const vse_cipher_t *desc, const vse_cipher_ctx_t *ctx)
+{
+    vse_ranges_t *rs = calloc(1, sizeof(vse_ranges_t));
+    if (rs == NULL)
+        return NULL;
+
+    rs->desc = desc;
+    rs->ctx = *ctx;
+    rs->refs = 1;
+    vse_mutex_init(&rs->lock);
+    vse_cond_init(&rs->done);
+
+    rs->nslots = (size_t)vse_threadpool_size(vse_range_pool) * VSE_RANGE_SLOTS_PER_WORKER;
+    if (rs->nslots > VSE_RANGE_MAX_SLOTS)
+        rs->nslots = VSE_RANGE_MAX_SLOTS;
+    rs->slots = calloc(rs->nslots, sizeof(vse_range_t));
+    for (size_t i = 0; rs->slots != NULL && i < rs->nslots; i++)
+    {
+        // On the node of the caller, which reads, hashes and writes them.
+        rs->slots[i].buf = vse_numa_alloc(VSE_RANGE_BYTES);
+        if (rs->slots[i].buf == NULL)
+        {
+            rs->nslots = i; // release() frees what there is
+            break;
+        }
+    }
+
+    if (rs->slots == NULL || rs->nslots == 0)
+    {
+        vse_ranges_release(rs);
+        return NULL;
+    }
+    return rs;
+}
+
+int vse_stream_crypt_ranges(const vse_cipher_t *desc, vse_cipher_ctx_t *ctx,
+                            vse_file_hash_t *hash,
+                            FILE *fp_in, FILE *fp_out)
+{
+    // Without memory for the slots, one thread does it all.
+    vse_ranges_t *rs = vse_ranges_new(desc, ctx);
+    if (rs == NULL)
+    {
+        return hash != NULL ? desc->encrypt_stream(ctx, hash, fp_in, fp_out)
+                            : desc->decrypt_stream(ctx, fp_in, fp_out);
+    }
+
+    int ret = 0;
+    int eof = 0;
+    uint64_t next_read = 0;
+    uint64_t next_write = 0;
+    uint64_t t = VSE_TIMING_NOW();
+    for (;;)
+    {
+        // Keep every slot busy: ranges are read, and cipher jobs queued,
+        // ahead of the one written next.
+        while (!eof && next_read - next_write < rs->nslots)
+        {
+            size_t slot = (size_t)(next_read % rs->nslots);
+            vse_range_t *r = &rs->slots[slot];
+            size_t len = fread(r->buf, 1, VSE_RANGE_BYTES, fp_in);
+            VSE_TIMING_LAP(VSE_PHASE_READ, t);
+            if (len < VSE_RANGE_BYTES)
+            {
+                eof = 1;
+                if (!feof(fp_in))
+                {
+                    ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;
+                    break;
+                }
+                if (len == 0)
+                    break;
+            }
+            VSE_PROBE1(chunk__read, len);
+
+            vse_mutex_lock(&rs->lock);
+            r->seq = next_read;
+            r->len = len;
+            r->state = RANGE_QUEUED;
+            vse_mutex_unlock(&rs->lock);
+            vse_range_queue(rs, slot);
+            next_read++;
+        }
+
+        if (ret != 0 || next_write == next_read)
+            break;
+
+        vse_range_t *r = &rs->slots[next_write % rs->nslots];
+        vse_range_wait(rs, r);
+        VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);
+        if (hash != NULL)
+        {
+            desc->hash_update(hash, r->buf, r->len);
+            VSE_TIMING_LAP(VSE_PHASE_HASH, t);
+        }
+        if (fwrite(r->buf, 1, r->len, fp_out) != r->len)
+        {
+            ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+            break;
+        }
+        VSE_TIMING_LAP(VSE_PHASE_WRITE, t);
+        VSE_PROBE1(chunk__write, r->len);
+        next_write++;
+    }
+
+    // On error, ranges may still be running on the slots wiped below: see
+    // them out first.
+    for (; next_write < next_read; next_write++)
+        vse_range_wait(rs, &rs->slots[next_write % rs->nslots]);
+
+    for (size_t i = 0; i < rs->nslots; i++)
+        memset(rs->slots[i].buf, 0, VSE_RANGE_BYTES);
+    vse_ranges_release(rs);
+    return ret;
+}
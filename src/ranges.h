@@ -0,0 +1,56 @@
+#ifndef RANGES_E5A3C16F_9B42_4D7E_8F05_2C71B9D4A63E_H
+#define RANGES_E5A3C16F_9B42_4D7E_8F05_2C71B9D4A63E_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "vse.h"
+#include "cipher.h"
+#include "threadpool.h"
+
+/*
+ * Intra-file parallelism: one large stream cut into VSE_RANGE_BYTES ranges
+ * whose cipher work runs on the workers of a thread pool.
+ *
+ * The calling thread reads the ranges in order and queues them at the front
+ * of the pool; each range copies the cipher context, set up once per
+ * stream, and seeks it to its offset (vse_cipher_t.seek). The caller hashes and writes the results
+ * in order, so the output and its MAC are those of the one-thread loop.
+ *
+ * The caller never waits on a range no worker has picked up yet: it runs
+ * it itself. It may thus be a job of the same pool, even with every other
+ * worker waiting on ranges of its own.
+ */
+
+#define VSE_RANGE_BYTES (4 << 20)
+
+// Ranges in flight per stream: per worker, and at most.
+#define VSE_RANGE_SLOTS_PER_WORKER 2
+#define VSE_RANGE_MAX_SLOTS 32
+
+// Folder mode splits files at least this large. The environment variable
+// VSE_SPLIT_MIN_BYTES overrides it, for tests.
+#define VSE_SPLIT_MIN_BYTES (64ull << 20)
+
+// Pool the streams of this thread are split over; NULL: not split.
+extern VSE_THREAD_LOCAL vse_threadpool_t *vse_range_pool;
+
+/**
+ * Split the streams of this thread over pool until the next call. NULL
+ * stops.
+ */
+void vse_ranges_attach(vse_threadpool_t *pool);
+
+/**
+ * Run the rest of fp_in through the cipher into fp_out over vse_range_pool,
+ * from ctx, fresh from desc->setup. If hash is not NULL, the output is added
+ * to it. Falls back to desc->encrypt_stream (with hash) or decrypt_stream on
+ * ctx when there is no memory for the ranges.
+ *
+ * @return 0, ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE or
+ *         ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE.
+ */
+int vse_stream_crypt_ranges(const vse_cipher_t *desc, vse_cipher_ctx_t *ctx,
+                            vse_file_hash_t *hash,
+                            FILE *fp_in, FILE *fp_out);
+
+#endif
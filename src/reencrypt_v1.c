@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "vse.h"
+#include "reencrypt_v1.h"
+#include "crypt_v1.h"
+#include "cipher.h"
+#include "crypto_random.h"
+#include "timing.h"
+#include "probes.h"
+
+// Multiple of every cipher block size; see vse_cipher_t.xcrypt.
+#define REENCRYPT_BUF_SIZE (64 * 1024)
+
+static int vse_reencrypt_stream_v1(const vse_header_v1_t *old_header, const uint8_t *old_key,
+                                   const vse_header_v1_t *new_header, const uint8_t *new_key,
+                                   FILE *fp_in, FILE *fp_out, uint8_t *mac, uint8_t *new_file_hash)
+{
+    const vse_cipher_t *old_desc = vse_cipher_find(old_header->cipher);
+    const vse_cipher_t *new_desc = vse_cipher_find(new_header->cipher);
+    if (old_desc == NULL || new_desc == NULL)
+    {
+        vse_print_error("Error: Invalid cipher %d\n", old_desc == NULL ? old_header->cipher : new_header->cipher);
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER;
+    }
+
+    uint8_t *buf = malloc(REENCRYPT_BUF_SIZE);
+    if (buf == NULL)
+    {
+        vse_print_error("Error: Out of memory\n");
+        return ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
+    }
+
+    vse_cipher_ctx_t old_ctx;
+    vse_cipher_ctx_t new_ctx;
+    vse_file_hash_t old_hash;
+    vse_file_hash_t new_hash;
+    if (old_desc->setup(&old_ctx, old_header->iv, IV_LEN, old_key, KEY_LEN) != 0 ||
+        new_desc->setup(&new_ctx, new_header->iv, IV_LEN, new_key, KEY_LEN) != 0 ||
+        old_desc->hash_init(&old_hash, old_header->iv, IV_LEN, old_key, KEY_LEN) != 0 ||
+        new_desc->hash_init(&new_hash, new_header->iv, IV_LEN, new_key, KEY_LEN) != 0)
+    {
+        vse_print_error("Error: Failed to derive iv\n");
+        free(buf);
+        memset(&old_ctx, 0, sizeof(old_ctx));
+        memset(&new_ctx, 0, sizeof(new_ctx));
+        return ERR_LIB_KDF_FAILED;
+    }
+
+    int ret = 0;
+    size_t len;
+    uint64_t t = VSE_TIMING_NOW();
+    while ((len = fread(buf, 1, REENCRYPT_BUF_SIZE, fp_in)) > 0)
+    {
+        VSE_TIMING_LAP(VSE_PHASE_READ, t);
+        VSE_PROBE1(chunk__read, len);
+        old_desc->hash_update(&old_hash, buf, len);
+        VSE_TIMING_LAP(VSE_PHASE_HASH, t);
+        old_desc->xcrypt(&old_ctx, buf, len);
+        // seal, as xcrypt of aegis256 decrypts
+        new_desc->seal(&new_ctx, &new_hash, buf, len);
+        VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);
+        if (fwrite(buf, 1, len, fp_out) != len)
+        {
+            vse_print_error("Error: Failed to write to output file: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+            break;
+        }
+        VSE_TIMING_LAP(VSE_PHASE_WRITE, t);
+        VSE_PROBE1(chunk__write, len);
+    }
+    VSE_TIMING_LAP(VSE_PHASE_READ, t);
+
+    if (ret == 0 && !feof(fp_in))
+    {
+        vse_print_error("Error: Failed to read infile: %s\n", strerror(errno));
+        ret = ERR_DECRYPT_V1_FAILED_TO_READ_INFILE;
+    }
+
+    if (ret == 0)
+    {
+        uint8_t old_file_hash[FILE_HASH_LEN];
+        old_desc->hash_final(&old_hash, old_file_hash);
+        vse_calculate_mac_v1(old_header, old_file_hash, old_key, mac);
+        new_desc->hash_final(&new_hash, new_file_hash);
+    }
+
+    memset(buf, 0, REENCRYPT_BUF_SIZE);
+    free(buf);
+    memset(&old_ctx, 0, sizeof(old_ctx));
+    memset(&new_ctx, 0, sizeof(new_ctx));
+    return ret;
+}
+
+int vse_reencrypt_fp_v1(const char *password, size_t password_nbytes,
+                        int cipher,
+                        const char *new_password, size_t new_password_nbytes,
+                        FILE *fp_in, FILE *fp_out)
+{
+    int ret = 0;
+    uint8_t old_key[KEY_LEN] = {0};
+    uint8_t new_key[KEY_LEN] = {0};
+    uint8_t mac[MAC_LEN] = {0};
+    uint8_t new_file_hash[FILE_HASH_LEN];
+
+    vse_header_v1_t old_header = {0};
+    if ((fread(&old_header, sizeof(vse_header_v1_t), 1, fp_in)) != 1)
+    {
+        vse_print_error("Error: Failed to read file header.\n");
+        return ERR_DECRYPT_V1_FAIL_TO_READ_FILE_HEADER;
+    }
+
+    vse_header_v1_t new_header;
+    memset(&new_header, 0, sizeof(vse_header_v1_t));
+    new_header.cipher = cipher != CIPHER_UNKNOWN ? cipher : old_header.cipher;
+    VSE_TIMING_CIPHER(new_header.cipher);
+    crypto_random(new_header.salt, SALT_LEN);
+    crypto_random(new_header.iv, IV_LEN);
+
+    if (vse_gen_key_v1(old_header.salt, SALT_LEN,
+                       password, password_nbytes, KEY_LEN, old_key) != 0 ||
+        vse_gen_key_v1(new_header.salt, SALT_LEN,
+                       new_password, new_password_nbytes, KEY_LEN, new_key) != 0)
+    {
+        vse_print_error("Error: Failed to derive key\n");
+        memset(old_key, 0, KEY_LEN);
+        memset(new_key, 0, KEY_LEN);
+        return ERR_LIB_KDF_FAILED;
+    }
+
+    do
+    {
+        uint8_t version = 1;
+        if (fwrite(&version, 1, 1, fp_out) != 1)
+        {
+            vse_print_error("Error: Failed to write version: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_WRITE_VERSION;
+            break;
+        }
+
+        if (fseek(fp_out, sizeof(vse_header_v1_t), SEEK_CUR) != 0)
+        {
+            vse_print_error("Error: Failed to seek to end of header: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_SEEK_END_OF_HEADER;
+            break;
+        }
+
+        ret = vse_reencrypt_stream_v1(&old_header, old_key, &new_header, new_key,
+                                      fp_in, fp_out, mac, new_file_hash);
+        if (ret != 0)
+        {
+            break;
+        }
+
+        // The whole input has been read by now; what was written is only
+        // kept if the input was authentic.
+        int mac_ok = memcmp(mac, old_header.mac, MAC_LEN) == 0;
+        VSE_PROBE1(mac__verify, mac_ok ? 0 : ERR_DECRYPT_V1_INVALID_PASSWORD);
+        if (!mac_ok)
+        {
+            vse_print_error("Error: Invalid password\n");
+            ret = ERR_DECRYPT_V1_INVALID_PASSWORD;
+            break;
+        }
+
+        vse_calculate_mac_v1(&new_header, new_file_hash, new_key, new_header.mac);
+
+        if (fseek(fp_out, 1, SEEK_SET) != 0)
+        {
+            vse_print_error("Error: Failed to seek to v1 header: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_OUTFILE_SEEK_TO_HEAD_FAILED;
+            break;
+        }
+
+        if (fwrite(&new_header, sizeof(vse_header_v1_t), 1, fp_out) != 1)
+        {
+            vse_print_error("Error: Failed to write file header: %s", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_FAILED_TO_WRITE_HEADER;
+            break;
+        }
+    } while (0);
+
+    memset(old_key, 0, KEY_LEN);
+    memset(new_key, 0, KEY_LEN);
+    return ret;
+}
@@ -0,0 +1,20 @@
+#ifndef REENCRYPT_V1_E52A9C17_4B3F_4D86_9A70_1C8E6F2B5D43_H
+#define REENCRYPT_V1_E52A9C17_4B3F_4D86_9A70_1C8E6F2B5D43_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Re-encrypt a version 1 stream (positioned after the version byte) under
+ * a new password and cipher, in one pass and without plaintext leaving
+ * memory. Each chunk is hashed for the old MAC, decrypted, encrypted again
+ * and hashed for the new MAC. fp_out is only valid if this returns 0.
+ *
+ * @param cipher  CIPHER_* of the output, CIPHER_UNKNOWN to keep the old one.
+ */
+int vse_reencrypt_fp_v1(const char *password, size_t password_nbytes,
+                        int cipher,
+                        const char *new_password, size_t new_password_nbytes,
+                        FILE *fp_in, FILE *fp_out);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#if _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "vse.h"
+#include "rekey_v2.h"
+#include "crypt_v2.h"
+
+static int vse_write_header_v2(const vse_header_v2_t *header, FILE *fp)
+{
+    if (fseek(fp, 1, SEEK_SET) != 0 ||
+        fwrite(header, sizeof(vse_header_v2_t), 1, fp) != 1 ||
+        fflush(fp) != 0)
+    {
+        vse_print_error("Error: Failed to write file header: %s\n", strerror(errno));
+        return ERR_REKEY_FAILED_TO_WRITE_HEADER;
+    }
+
+#if _MSC_VER
+    int ret = _commit(_fileno(fp));
+#else
+    int ret = fsync(fileno(fp));
+#endif
+    if (ret != 0)
+    {
+        vse_print_error("Error: Failed to sync file header: %s\n", strerror(errno));
+        return ERR_REKEY_FAILED_TO_WRITE_HEADER;
+    }
+    return 0;
+}
+
+int vse_rekey_fp_v2(const char *password, size_t password_nbytes,
+                    const char *new_password, size_t new_password_nbytes,
+                    FILE *fp)
+{
+    int ret = 0;
+    uint8_t data_key[DATA_KEY_LEN] = {0};
+    vse_header_v2_t header;
+
+    if ((fread(&header, sizeof(vse_header_v2_t), 1, fp)) != 1)
+    {
+        vse_print_error("Error: Failed to read file header.\n");
+        return ERR_DECRYPT_V2_FAIL_TO_READ_FILE_HEADER;
+    }
+
+    int old_slot = vse_open_key_slots_v2(&header, password, password_nbytes, data_key);
+    if (old_slot < 0)
+    {
+        vse_print_error("Error: Invalid password\n");
+        return ERR_DECRYPT_V2_INVALID_PASSWORD;
+    }
+
+    // Fill a free slot first and only then drop the old one, so that a crash
+    // in between leaves a file both passwords open rather than neither.
+    int new_slot = old_slot;
+    for (int i = 0; i < KEY_SLOTS_V2; i++)
+    {
+        if (!(header.slots[i].flags & KEY_SLOT_USED))
+        {
+            new_slot = i;
+            break;
+        }
+    }
+
+    do
+    {
+        ret = vse_wrap_key_v2(&header, &header.slots[new_slot],
+                              new_password, new_password_nbytes, data_key);
+        if (ret != 0)
+        {
+            vse_print_error("Error: Failed to derive key\n");
+            break;
+        }
+
+        ret = vse_write_header_v2(&header, fp);
+        if (ret != 0 || new_slot == old_slot)
+        {
+            break;
+        }
+
+        memset(&header.slots[old_slot], 0, sizeof(vse_key_slot_v2_t));
+        ret = vse_write_header_v2(&header, fp);
+    } while (0);
+
+    memset(data_key, 0, sizeof(data_key));
+    return ret;
+}
@@ -0,0 +1,16 @@
+#ifndef REKEY_V2_5C2D8E71_A9F4_4E36_B1C7_8F03D6A92E45_H
+#define REKEY_V2_5C2D8E71_A9F4_4E36_B1C7_8F03D6A92E45_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Move the key slot password opens over to new_password, rewriting only the
+ * header of a version 2 stream positioned after its version byte. fp must be
+ * open for update. The data and its MAC are left as they are.
+ */
+int vse_rekey_fp_v2(const char *password, size_t password_nbytes,
+                    const char *new_password, size_t new_password_nbytes,
+                    FILE *fp);
+
+#endif
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "vse.h"
+#include "resumable_v1.h"
+#include "crypt_v1.h"
+#include "cipher.h"
+#include "crypto_random.h"
+#include "file_ops.h"
+#include "argon2/src/blake2/blake2.h"
+#include "timing.h"
+#include "probes.h"
+
+// Multiple of every cipher block size; checkpoints fall on its boundaries.
+#define RESUMABLE_BUF_SIZE (64 * 1024)
+
+#define CHECKPOINT_MAGIC "VSECKPT1"
+
+typedef struct vse_checkpoint_v1
+{
+    char magic[8];
+    uint32_t state_nbytes; // sizeof(blake2b_state), which is stored raw
+    uint8_t cipher;
+    uint8_t reserved[3];
+    uint8_t salt[SALT_LEN];
+    uint8_t iv[IV_LEN];
+    uint64_t offset; // of the input, done and synced to the output
+    uint64_t in_size;
+    int64_t in_mtime_ns;
+    blake2b_state hash; // of the ciphertext up to offset
+    uint8_t tag[MAC_LEN]; // BLAKE2b keyed by the file key, of all of the above
+} vse_checkpoint_v1_t;
+
+static void vse_checkpoint_tag(const vse_checkpoint_v1_t *ckpt, const uint8_t *key, uint8_t *tag)
+{
+    blake2b(tag, MAC_LEN, ckpt, offsetof(vse_checkpoint_v1_t, tag), key, KEY_LEN);
+}
+
+/* Replace ckpt_path with ckpt, after making sure fp_out holds what it covers. */
+static int vse_checkpoint_save(vse_checkpoint_v1_t *ckpt, const uint8_t *key,
+                               FILE *fp_out, const char *ckpt_path)
+{
+    if (vse_sync_file(fp_out) != 0)
+    {
+        vse_print_error("Error: Failed to sync output file: %s\n", strerror(errno));
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+    }
+
+    vse_checkpoint_tag(ckpt, key, ckpt->tag);
+
+    int ret = ERR_CHECKPOINT_FAILED_TO_WRITE;
+    char *tmp_path = vse_suffixed_path(ckpt_path, ".tmp");
+    FILE *fp = tmp_path != NULL ? fopen(tmp_path, "wb") : NULL;
+    if (fp != NULL)
+    {
+        fwrite(ckpt, sizeof(vse_checkpoint_v1_t), 1, fp); // ferror() is checked on commit
+        if (vse_commit_tmp_file(fp, tmp_path, ckpt_path, 1) == 0)
+            ret = 0;
+    }
+    free(tmp_path);
+
+    if (ret != 0)
+        vse_print_error("Error: Failed to write checkpoint %s\n", ckpt_path);
+    return ret;
+}
+
+/*
+ * Load the checkpoint of an interrupted run and derive its key.
+ *
+ * @return 0, 1 if there is none, ERR_CHECKPOINT_* or ERR_LIB_KDF_FAILED.
+ */
+static int vse_checkpoint_load(vse_checkpoint_v1_t *ckpt, const char *ckpt_path,
+                               const char *password, size_t password_nbytes,
+                               const struct stat *in_stat, uint8_t *key)
+{
+    FILE *fp = fopen(ckpt_path, "rb");
+    if (fp == NULL)
+        return errno == ENOENT ? 1 : ERR_CHECKPOINT_INVALID;
+    int ok = fread(ckpt, sizeof(vse_checkpoint_v1_t), 1, fp) == 1;
+    fclose(fp);
+
+    if (!ok || memcmp(ckpt->magic, CHECKPOINT_MAGIC, sizeof(ckpt->magic)) != 0 ||
+        ckpt->state_nbytes != sizeof(blake2b_state) || ckpt->offset % RESUMABLE_BUF_SIZE != 0)
+    {
+        vse_print_error("Error: Invalid checkpoint %s\n", ckpt_path);
+        return ERR_CHECKPOINT_INVALID;
+    }
+
+    uint8_t tag[MAC_LEN];
+    if (vse_gen_key_v1(ckpt->salt, SALT_LEN, password, password_nbytes, KEY_LEN, key) != 0)
+    {
+        vse_print_error("Error: Failed to derive key\n");
+        return ERR_LIB_KDF_FAILED;
+    }
+    vse_checkpoint_tag(ckpt, key, tag);
+    if (memcmp(tag, ckpt->tag, MAC_LEN) != 0)
+    {
+        vse_print_error("Error: Invalid password or corrupted checkpoint %s\n", ckpt_path);
+        return ERR_CHECKPOINT_INVALID;
+    }
+
+    if (ckpt->in_size != (uint64_t)in_stat->st_size ||
+        ckpt->in_mtime_ns != vse_stat_mtime_ns(in_stat) ||
+        ckpt->offset > ckpt->in_size)
+    {
+        vse_print_error("Error: Input file changed since checkpoint %s\n", ckpt_path);
+        return ERR_CHECKPOINT_INPUT_CHANGED;
+    }
+
+    return 0;
+}
+
+static int vse_encrypt_resumable_stream_v1(vse_checkpoint_v1_t *ckpt, const uint8_t *key,
+                                           FILE *fp_in, FILE *fp_out, const char *ckpt_path)
+{
+    const vse_cipher_t *desc = vse_cipher_find(ckpt->cipher);
+    if (desc == NULL)
+    {
+        vse_print_error("Error: Invalid cipher %d\n", ckpt->cipher);
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER;
+    }
+
+    uint64_t interval = VSE_CHECKPOINT_BYTES;
+    const char *env = getenv("VSE_CHECKPOINT_BYTES");
+    if (env != NULL && strtoull(env, NULL, 10) != 0)
+        interval = strtoull(env, NULL, 10);
+
+    uint8_t *buf = malloc(RESUMABLE_BUF_SIZE);
+    if (buf == NULL)
+    {
+        vse_print_error("Error: Out of memory\n");
+        return ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;
+    }
+
+    vse_cipher_ctx_t ctx;
+    if (desc->setup(&ctx, ckpt->iv, IV_LEN, key, KEY_LEN) != 0)
+    {
+        vse_print_error("Error: Failed to derive iv\n");
+        memset(&ctx, 0, sizeof(ctx));
+        free(buf);
+        return ERR_LIB_KDF_FAILED;
+    }
+    desc->seek(&ctx, ckpt->offset);
+
+    int ret = 0;
+    size_t len;
+    uint64_t saved = ckpt->offset;
+    uint64_t t = VSE_TIMING_NOW();
+    while ((len = fread(buf, 1, RESUMABLE_BUF_SIZE, fp_in)) > 0)
+    {
+        VSE_TIMING_LAP(VSE_PHASE_READ, t);
+        VSE_PROBE1(chunk__read, len);
+        desc->xcrypt(&ctx, buf, len);
+        VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);
+        blake2b_update(&ckpt->hash, buf, len);
+        VSE_TIMING_LAP(VSE_PHASE_HASH, t);
+        if (fwrite(buf, 1, len, fp_out) != len)
+        {
+            vse_print_error("Error: Failed to write to output file: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+            break;
+        }
+        VSE_TIMING_LAP(VSE_PHASE_WRITE, t);
+        VSE_PROBE1(chunk__write, len);
+
+        ckpt->offset += len;
+        if (len == RESUMABLE_BUF_SIZE && ckpt->offset - saved >= interval)
+        {
+            ret = vse_checkpoint_save(ckpt, key, fp_out, ckpt_path);
+            if (ret != 0)
+                break;
+            saved = ckpt->offset;
+            t = VSE_TIMING_NOW();
+        }
+    }
+    VSE_TIMING_LAP(VSE_PHASE_READ, t);
+
+    if (ret == 0 && !feof(fp_in))
+    {
+        vse_print_error("Error: Failed to read infile: %s\n", strerror(errno));
+        ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_READ_INFILE;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    free(buf);
+    return ret;
+}
+
+int vse_encrypt_file_resumable_v1(int cipher,
+                                  const char *password, size_t password_nbytes,
+                                  const char *infile, const char *outfile,
+                                  const char *ckpt_path, int resume)
+{
+    int ret = 0;
+    uint8_t key[KEY_LEN] = {0};
+    vse_checkpoint_v1_t ckpt;
+    FILE *fp_in = NULL;
+    FILE *fp_out = NULL;
+
+    struct stat in_stat;
+    if (stat(infile, &in_stat) != 0)
+    {
+        vse_print_error("Error: Failed to stat file %s: %s\n", infile, strerror(errno));
+        return ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_INPUT_FILE;
+    }
+
+    int found = 0;
+    if (resume)
+    {
+        ret = vse_checkpoint_load(&ckpt, ckpt_path, password, password_nbytes, &in_stat, key);
+        if (ret > 1)
+            return ret;
+        found = ret == 0;
+        ret = 0;
+    }
+
+    if (!found)
+    {
+        // Zeroed first: the padding is covered by the tag as well.
+        memset(&ckpt, 0, sizeof(ckpt));
+        memcpy(ckpt.magic, CHECKPOINT_MAGIC, sizeof(ckpt.magic));
+        ckpt.state_nbytes = sizeof(blake2b_state);
+        ckpt.cipher = (uint8_t)cipher;
+        crypto_random(ckpt.salt, SALT_LEN);
+        crypto_random(ckpt.iv, IV_LEN);
+        ckpt.in_size = (uint64_t)in_stat.st_size;
+        ckpt.in_mtime_ns = vse_stat_mtime_ns(&in_stat);
+        blake2b_init_key(&ckpt.hash, FILE_HASH_LEN, ckpt.iv, IV_LEN);
+        if (vse_gen_key_v1(ckpt.salt, SALT_LEN, password, password_nbytes, KEY_LEN, key) != 0)
+        {
+            vse_print_error("Error: Failed to derive key\n");
+            memset(key, 0, sizeof(key));
+            memset(&ckpt, 0, sizeof(ckpt));
+            return ERR_LIB_KDF_FAILED;
+        }
+    }
+    VSE_TIMING_CIPHER(ckpt.cipher);
+
+    do
+    {
+        fp_in = fopen(infile, "rb");
+        if (fp_in == NULL || vse_fseek64(fp_in, ckpt.offset, SEEK_SET) != 0)
+        {
+            vse_print_error("Error: Failed to open input file %s: %s\n", infile, strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_INPUT_FILE;
+            break;
+        }
+
+        fp_out = fopen(outfile, found ? "r+b" : "wb");
+        if (fp_out == NULL)
+        {
+            vse_print_error("Error: Failed to open output file %s: %s\n", outfile, strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_OPEN_OUTPUT_FILE;
+            break;
+        }
+
+        if (!found)
+        {
+            // The header is only known at the end; keep its place.
+            uint8_t head[1 + FILE_HEADER_LEN] = {1};
+            if (fwrite(head, sizeof(head), 1, fp_out) != 1)
+            {
+                vse_print_error("Error: Failed to write version: %s\n", strerror(errno));
+                ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_WRITE_VERSION;
+                break;
+            }
+        }
+        else if (vse_fseek64(fp_out, 1 + FILE_HEADER_LEN + ckpt.offset, SEEK_SET) != 0)
+        {
+            vse_print_error("Error: Failed to seek in output file: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_V1_FAIL_TO_SEEK_END_OF_HEADER;
+            break;
+        }
+
+        ret = vse_encrypt_resumable_stream_v1(&ckpt, key, fp_in, fp_out, ckpt_path);
+        if (ret != 0)
+        {
+            break;
+        }
+
+        uint8_t file_hash[FILE_HASH_LEN];
+        vse_header_v1_t header;
+        memset(&header, 0, sizeof(header));
+        header.cipher = ckpt.cipher;
+        memcpy(header.salt, ckpt.salt, SALT_LEN);
+        memcpy(header.iv, ckpt.iv, IV_LEN);
+        blake2b_final(&ckpt.hash, file_hash, FILE_HASH_LEN);
+        vse_calculate_mac_v1(&header, file_hash, key, header.mac);
+
+        if (fseek(fp_out, 1, SEEK_SET) != 0)
+        {
+            vse_print_error("Error: Failed to seek to v1 header: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_OUTFILE_SEEK_TO_HEAD_FAILED;
+            break;
+        }
+
+        if (fwrite(&header, sizeof(vse_header_v1_t), 1, fp_out) != 1)
+        {
+            vse_print_error("Error: Failed to write file header: %s", strerror(errno));
+            ret = ERR_ENCRYPT_FILE_FAILED_TO_WRITE_HEADER;
+            break;
+        }
+    } while (0);
+
+    if (fp_in != NULL)
+    {
+        fclose(fp_in);
+    }
+
+    if (fp_out != NULL && fclose(fp_out) != 0 && ret == 0)
+    {
+        vse_print_error("Error: Failed to write to output file: %s\n", strerror(errno));
+        ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+    }
+
+    if (ret == 0)
+    {
+        remove(ckpt_path);
+    }
+
+    memset(key, 0, sizeof(key));
+    memset(&ckpt, 0, sizeof(ckpt));
+    return ret;
+}
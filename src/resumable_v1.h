@@ -0,0 +1,33 @@
+#ifndef RESUMABLE_V1_6B1F3D84_C27E_4A95_8E06_D4A3F1B7920C_H
+#define RESUMABLE_V1_6B1F3D84_C27E_4A95_8E06_D4A3F1B7920C_H
+
+#include <stdlib.h>
+
+/*
+ * Resumable version 1 encryption of one large file.
+ *
+ * Every VSE_CHECKPOINT_BYTES of input, outfile is synced and the position,
+ * salt, iv and BLAKE2b state of the ciphertext hash are written to
+ * ckpt_path. The cipher counters follow from the position (see
+ * vse_cipher_t.seek) and the key from the password, so the checkpoint holds
+ * no key material; a keyed hash of it tells a wrong password on resume.
+ *
+ * The environment variable VSE_CHECKPOINT_BYTES overrides the interval, for
+ * tests.
+ */
+
+#define VSE_CHECKPOINT_BYTES (256ull << 20)
+
+/**
+ * Encrypt infile into outfile, checkpointing to ckpt_path. With resume and
+ * an existing checkpoint, continue the outfile it belongs to instead; the
+ * result is the file an uninterrupted run would have written.
+ *
+ * outfile and ckpt_path are left in place on failure, for a later resume.
+ */
+int vse_encrypt_file_resumable_v1(int cipher,
+                                  const char *password, size_t password_nbytes,
+                                  const char *infile, const char *outfile,
+                                  const char *ckpt_path, int resume);
+
+#endif
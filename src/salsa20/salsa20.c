@@ -75,7 +75,7 @@ void salsa20_ivsetup(salsa20_ctx_t *x, const uint8_t *iv)
     x->input[9] = 0;
 }
 
-void salsa20_xcrypt_bytes(salsa20_ctx_t *x, const uint8_t *m, uint8_t *c, uint32_t bytes)
+void salsa20_xcrypt_bytes(salsa20_ctx_t *x, const uint8_t *m, uint8_t *c, size_t bytes)
 {
     uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
     uint32_t j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
@@ -1,6 +1,7 @@
 #ifndef SALSA20_3118A7C5_9DBB_425A_A350_302EB42E8649_H
 #define SALSA20_3118A7C5_9DBB_425A_A350_302EB42E8649_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct salsa20_ctx
@@ -48,6 +49,6 @@ void salsa20_xcrypt_bytes(
     salsa20_ctx_t *ctx,
     const uint8_t *in,
     uint8_t *out,
-    uint32_t msglen); /* Message length in bytes. */
+    size_t msglen); /* Message length in bytes. */
 
 #endif
@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "vse.h"
+#include "server.h"
+
+#if _MSC_VER
+
+int vse_serve(const char *socket_path, int nworkers)
+{
+    (void)socket_path;
+    (void)nworkers;
+    vse_print_error("Error: --serve is not supported on this platform\n");
+    return ERR_SERVE_UNSUPPORTED;
+}
+
+#else
+
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "encrypt_v1.h"
+#include "file_ops.h"
+#include "kdf_arena.h"
+#include "threadpool.h"
+
+#define VSE_SERVE_MAX_FDS 2
+
+// A request that stops arriving half-way for this many seconds (ticks of
+// SO_RCVTIMEO) drops its connection rather than holding a worker.
+#define VSE_SERVE_STALL_SECONDS 10
+
+static volatile sig_atomic_t g_stop = 0;
+
+// Workers hand connections back to the poll loop through this pipe.
+static int g_handback_fd = -1;
+
+static void vse_serve_on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+/*
+ * Whether a read that returned n should be retried. Reads wake up once a
+ * second (SO_RCVTIMEO) so that workers notice a shutdown or a stalled
+ * client.
+ */
+static int vse_read_again(ssize_t n, int *stalled)
+{
+    if (n >= 0 || g_stop)
+        return 0;
+    if (errno == EINTR)
+        return 1;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) && ++*stalled < VSE_SERVE_STALL_SECONDS;
+}
+
+/*
+ * Read exactly nbytes.
+ *
+ * Returns 0 on success, -1 on EOF, error, stall or shutdown.
+ */
+static int vse_read_full(int fd, void *buf, size_t nbytes)
+{
+    uint8_t *p = buf;
+    int stalled = 0;
+    while (nbytes > 0)
+    {
+        ssize_t n = read(fd, p, nbytes);
+        if (n > 0)
+        {
+            p += n;
+            nbytes -= (size_t)n;
+            continue;
+        }
+        if (vse_read_again(n, &stalled))
+            continue;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Receive the fixed-size request header together with any fds attached to it.
+ */
+static int vse_recv_request(int fd, vse_serve_request_t *req, int *fds, int *nfds)
+{
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * VSE_SERVE_MAX_FDS)];
+    } control;
+    struct iovec iov;
+    struct msghdr msg;
+    ssize_t n;
+    int stalled = 0;
+
+    *nfds = 0;
+    for (;;)
+    {
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = req;
+        iov.iov_len = sizeof(vse_serve_request_t);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        n = recvmsg(fd, &msg, 0);
+        if (n > 0)
+            break;
+        if (vse_read_again(n, &stalled))
+            continue;
+        return -1;
+    }
+
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *cfds = (int *)CMSG_DATA(cmsg);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (*nfds < VSE_SERVE_MAX_FDS)
+                fds[(*nfds)++] = cfds[i];
+            else
+                close(cfds[i]);
+        }
+    }
+
+    if (msg.msg_flags & MSG_CTRUNC)
+    {
+        return -1;
+    }
+
+    if ((size_t)n < sizeof(vse_serve_request_t))
+        return vse_read_full(fd, (uint8_t *)req + n, sizeof(vse_serve_request_t) - (size_t)n);
+
+    return 0;
+}
+
+static int vse_send_response(int fd, int status, int out_fd)
+{
+    vse_serve_response_t resp;
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov;
+    struct msghdr msg;
+
+    resp.magic = VSE_SERVE_MAGIC;
+    resp.status = status;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &resp;
+    iov.iov_len = sizeof(resp);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (out_fd >= 0)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &out_fd, sizeof(int));
+    }
+
+    ssize_t n;
+    do
+    {
+        n = sendmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+
+    return n == (ssize_t)sizeof(resp) ? 0 : -1;
+}
+
+/*
+ * Run one request whose data is passed in-band as fds.
+ * On success with no client supplied output fd, *ret_fd is the result.
+ */
+static int vse_serve_fds(const vse_serve_request_t *req,
+                         const char *password,
+                         const int *fds, int nfds,
+                         int *ret_fd)
+{
+    int ret = 0;
+    FILE *fp_in = NULL;
+    FILE *fp_out = NULL;
+    int cipher = req->cipher != CIPHER_UNKNOWN ? req->cipher : CIPHER_AES_256_CTR_CHACHA20;
+
+    if (nfds < 1)
+    {
+        vse_print_error("Error: Request without input fd\n");
+        return ERR_SERVE_MISSING_FD;
+    }
+
+    do
+    {
+        int in_fd = dup(fds[0]);
+        fp_in = in_fd < 0 ? NULL : fdopen(in_fd, "rb");
+        if (fp_in == NULL)
+        {
+            if (in_fd >= 0)
+                close(in_fd);
+            vse_print_error("Error: Failed to open input fd: %s\n", strerror(errno));
+            ret = ERR_SERVE_MISSING_FD;
+            break;
+        }
+
+        if (req->op == MODE_VERIFY)
+        {
+            ret = vse_verify_fp(password, req->password_nbytes, fp_in);
+            break;
+        }
+
+        if (nfds >= 2)
+        {
+            int out_fd = dup(fds[1]);
+            fp_out = out_fd < 0 ? NULL : fdopen(out_fd, "wb");
+            if (fp_out == NULL && out_fd >= 0)
+                close(out_fd);
+        }
+        else
+        {
+            fp_out = tmpfile();
+        }
+        if (fp_out == NULL)
+        {
+            vse_print_error("Error: Failed to open output: %s\n", strerror(errno));
+            ret = ERR_SERVE_FAILED_TO_CREATE_OUTPUT;
+            break;
+        }
+
+        if (req->op == MODE_ENCRYPT)
+            ret = vse_encrypt_fp_v1(cipher, password, req->password_nbytes, fp_in, fp_out);
+        else
+            ret = vse_decrypt_fp(password, req->password_nbytes, fp_in, fp_out);
+
+        if (ret == 0 && fflush(fp_out) != 0)
+        {
+            vse_print_error("Error: Failed to write output: %s\n", strerror(errno));
+            ret = ERR_ENCRYPT_V1_STREAM_CRYPT_FAILED_TO_WRITE_OUTFILE;
+        }
+
+        if (ret == 0 && nfds < 2)
+        {
+            *ret_fd = dup(fileno(fp_out));
+            if (*ret_fd >= 0 && lseek(*ret_fd, 0, SEEK_SET) != 0)
+            {
+                close(*ret_fd);
+                *ret_fd = -1;
+            }
+            if (*ret_fd < 0)
+            {
+                ret = ERR_SERVE_FAILED_TO_CREATE_OUTPUT;
+            }
+        }
+    } while (0);
+
+    if (fp_in != NULL)
+        fclose(fp_in);
+    if (fp_out != NULL)
+        fclose(fp_out);
+
+    return ret;
+}
+
+static int vse_serve_paths(const vse_serve_request_t *req,
+                           const char *password,
+                           const char *infile, const char *outfile)
+{
+    int cipher = req->cipher != CIPHER_UNKNOWN ? req->cipher : CIPHER_AES_256_CTR_CHACHA20;
+
+    if (req->infile_nbytes == 0 || (req->op != MODE_VERIFY && req->outfile_nbytes == 0))
+    {
+        vse_print_error("Error: Request without infile/outfile\n");
+        return ERR_SERVE_BAD_REQUEST;
+    }
+
+    struct stat st;
+    if (req->op != MODE_VERIFY && !(req->flags & VSE_SERVE_FLAG_FORCE) && stat(outfile, &st) == 0)
+    {
+        vse_print_error("Error: output file %s already exist.\n", outfile);
+        return ERR_MAIN_OUTPUT_FILE_ALREADY_EXIST;
+    }
+
+    vse_run_opts_t opts = {req->op, cipher, 1, password, req->password_nbytes, NULL, 0, 0, 0, 0, 0};
+    return vse_run_on_file(&opts, infile, outfile);
+}
+
+/*
+ * Serve the request waiting on fd.
+ *
+ * Returns 0 if the connection can take another one, -1 to hang up.
+ */
+static int vse_serve_request(int fd, char *payload)
+{
+    vse_serve_request_t req;
+    int fds[VSE_SERVE_MAX_FDS];
+    int nfds = 0;
+    int ret_fd = -1;
+    int status;
+
+    if (vse_recv_request(fd, &req, fds, &nfds) != 0)
+    {
+        for (int i = 0; i < nfds; i++)
+            close(fds[i]);
+        return -1;
+    }
+
+    if (req.magic != VSE_SERVE_MAGIC ||
+        req.password_nbytes > VSE_SERVE_MAX_FIELD_LEN ||
+        req.infile_nbytes > VSE_SERVE_MAX_FIELD_LEN ||
+        req.outfile_nbytes > VSE_SERVE_MAX_FIELD_LEN)
+    {
+        // Cannot resync on a broken stream, report and hang up.
+        vse_send_response(fd, ERR_SERVE_BAD_REQUEST, -1);
+        for (int i = 0; i < nfds; i++)
+            close(fds[i]);
+        return -1;
+    }
+
+    char *password = payload;
+    char *infile = password + VSE_SERVE_MAX_FIELD_LEN + 1;
+    char *outfile = infile + VSE_SERVE_MAX_FIELD_LEN + 1;
+    if (vse_read_full(fd, password, req.password_nbytes) != 0 ||
+        vse_read_full(fd, infile, req.infile_nbytes) != 0 ||
+        vse_read_full(fd, outfile, req.outfile_nbytes) != 0)
+    {
+        memset(password, 0, req.password_nbytes);
+        for (int i = 0; i < nfds; i++)
+            close(fds[i]);
+        return -1;
+    }
+    password[req.password_nbytes] = 0;
+    infile[req.infile_nbytes] = 0;
+    outfile[req.outfile_nbytes] = 0;
+
+    if (req.op != MODE_ENCRYPT && req.op != MODE_DECRYPT && req.op != MODE_VERIFY)
+        status = ERR_SERVE_BAD_REQUEST;
+    else if (req.flags & VSE_SERVE_FLAG_FDS)
+        status = vse_serve_fds(&req, password, fds, nfds, &ret_fd);
+    else
+        status = vse_serve_paths(&req, password, infile, outfile);
+
+    memset(password, 0, req.password_nbytes);
+    for (int i = 0; i < nfds; i++)
+        close(fds[i]);
+
+    int sent = vse_send_response(fd, status, ret_fd);
+    if (ret_fd >= 0)
+        close(ret_fd);
+    return sent;
+}
+
+/*
+ * Worker job: serve one request, then hand the connection back to the
+ * poll loop of vse_serve() to wait for the next one. An idle client holds
+ * no worker.
+ */
+static void vse_serve_connection(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    char *payload = malloc(3 * (VSE_SERVE_MAX_FIELD_LEN + 1));
+
+    // Workers live as long as the server, keep their Argon2 memory warm.
+    vse_kdf_arena_enable();
+
+    int keep = payload != NULL && vse_serve_request(fd, payload) == 0 && !g_stop;
+    free(payload);
+
+    // A write of an int to a pipe is atomic.
+    if (!keep || write(g_handback_fd, &fd, sizeof(fd)) != (ssize_t)sizeof(fd))
+        close(fd);
+}
+
+/*
+ * Connections waiting for their next request, after the listening socket
+ * and the hand-back pipe.
+ */
+typedef struct vse_serve_polls
+{
+    struct pollfd *fds;
+    size_t count;
+    size_t cap;
+} vse_serve_polls_t;
+
+static int vse_serve_polls_add(vse_serve_polls_t *polls, int fd)
+{
+    if (polls->count == polls->cap)
+    {
+        size_t cap = polls->cap * 2;
+        struct pollfd *fds = realloc(polls->fds, cap * sizeof(struct pollfd));
+        if (fds == NULL)
+            return -1;
+        polls->fds = fds;
+        polls->cap = cap;
+    }
+    polls->fds[polls->count].fd = fd;
+    polls->fds[polls->count].events = POLLIN;
+    polls->fds[polls->count].revents = 0;
+    polls->count++;
+    return 0;
+}
+
+static ssize_t vse_serve_take_back(vse_serve_polls_t *polls, int pipe_fd)
+{
+    int fds[64];
+    ssize_t n = read(pipe_fd, fds, sizeof(fds));
+    for (ssize_t i = 0; i < n / (ssize_t)sizeof(int); i++)
+    {
+        if (vse_serve_polls_add(polls, fds[i]) != 0)
+            close(fds[i]);
+    }
+    return n;
+}
+
+static int vse_serve_listen(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        vse_print_error("Error: Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    // Replace a stale socket left behind by a previous server.
+    struct stat st;
+    if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        vse_print_error("Error: Failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Passwords travel over this socket: owner only.
+    mode_t old_umask = umask(0077);
+    int ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_umask);
+    if (ret != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        vse_print_error("Error: Failed to listen on %s: %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int vse_serve(const char *socket_path, int nworkers)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = vse_serve_on_signal; // no SA_RESTART: accept() must return
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = vse_serve_listen(socket_path);
+    if (listen_fd < 0)
+        return ERR_SERVE_FAILED_TO_LISTEN;
+
+    // Workers inherit a blocked mask so the signals land on accept() below.
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+    vse_threadpool_t *pool = vse_threadpool_new(nworkers);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (pool == NULL)
+    {
+        vse_print_error("Error: Failed to start workers\n");
+        close(listen_fd);
+        unlink(socket_path);
+        return ERR_SERVE_FAILED_TO_LISTEN;
+    }
+
+    int handback[2];
+    vse_serve_polls_t polls = {NULL, 0, 16};
+    polls.fds = malloc(polls.cap * sizeof(struct pollfd));
+    if (polls.fds == NULL || pipe(handback) != 0)
+    {
+        vse_print_error("Error: Failed to start workers\n");
+        free(polls.fds);
+        close(listen_fd);
+        unlink(socket_path);
+        vse_threadpool_free(pool);
+        return ERR_SERVE_FAILED_TO_LISTEN;
+    }
+    g_handback_fd = handback[1];
+    vse_serve_polls_add(&polls, listen_fd);
+    vse_serve_polls_add(&polls, handback[0]);
+
+    while (!g_stop)
+    {
+        if (poll(polls.fds, (nfds_t)polls.count, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            vse_print_error("Error: poll() failed: %s\n", strerror(errno));
+            break;
+        }
+
+        // Each connection with something to read (or a hang-up to notice)
+        // leaves the set for one request on a worker.
+        for (size_t i = 2; i < polls.count;)
+        {
+            if (polls.fds[i].revents == 0)
+            {
+                i++;
+                continue;
+            }
+            int fd = polls.fds[i].fd;
+            polls.fds[i] = polls.fds[--polls.count];
+            if (vse_threadpool_submit(pool, vse_serve_connection, (void *)(intptr_t)fd) != 0)
+                close(fd);
+        }
+
+        if (polls.fds[1].revents & POLLIN)
+            vse_serve_take_back(&polls, handback[0]);
+
+        if (polls.fds[0].revents & POLLIN)
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+                    continue;
+                vse_print_error("Error: accept() failed: %s\n", strerror(errno));
+                break;
+            }
+
+            struct timeval tv = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            if (vse_serve_polls_add(&polls, fd) != 0)
+                close(fd);
+        }
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    vse_threadpool_free(pool);
+
+    // Connections handed back while the workers finished.
+    fcntl(handback[0], F_SETFL, O_NONBLOCK);
+    while (vse_serve_take_back(&polls, handback[0]) > 0)
+        ;
+    for (size_t i = 2; i < polls.count; i++)
+        close(polls.fds[i].fd);
+    free(polls.fds);
+    g_handback_fd = -1;
+    close(handback[0]);
+    close(handback[1]);
+
+    return 0;
+}
+
+#endif
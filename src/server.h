@@ -0,0 +1,72 @@
+#ifndef SERVER_6F3A2D18_94B7_4C0E_8E5D_1B7C2A9F6E40_H
+#define SERVER_6F3A2D18_94B7_4C0E_8E5D_1B7C2A9F6E40_H
+
+#include <stdint.h>
+
+/*
+ * vsencrypt --serve protocol.
+ *
+ * Clients connect to a Unix domain stream socket and send any number of
+ * requests, one at a time. Every request gets exactly one response. All
+ * integers are in host byte order; the socket never leaves the machine.
+ *
+ * Request:
+ *
+ *     +-----------------------------------------------------------------+
+ *     | magic(4) | op(1) | cipher(1) | flags(2) | password_nbytes(4) |  |
+ *     | infile_nbytes(4) | outfile_nbytes(4) | password | infile | outfile |
+ *     +-----------------------------------------------------------------+
+ *
+ * - op is MODE_ENCRYPT, MODE_DECRYPT or MODE_VERIFY.
+ * - cipher is a CIPHER_* id, used by MODE_ENCRYPT only. 0 means default.
+ * - infile/outfile are paths on the server side, not NUL terminated.
+ *
+ * With VSE_SERVE_FLAG_FDS the paths are ignored and the data is passed
+ * in-band instead: the first byte of the request carries SCM_RIGHTS with
+ * the input fd and, optionally, an output fd. Without an output fd the
+ * server writes into an anonymous temp file and passes it back with the
+ * response, positioned at offset 0. Encryption output and decryption input
+ * must be seekable.
+ *
+ * Response:
+ *
+ *     +--------------------------+
+ *     | magic(4) | status(4)     |  [+ SCM_RIGHTS output fd]
+ *     +--------------------------+
+ *
+ * status is 0 on success or one of the ERR_* codes from error.h.
+ */
+
+#define VSE_SERVE_MAGIC 0x31455356 // "VSE1"
+
+#define VSE_SERVE_FLAG_FORCE 0x1 // override existing outfile
+#define VSE_SERVE_FLAG_FDS 0x2   // data passed as SCM_RIGHTS fds
+
+#define VSE_SERVE_MAX_FIELD_LEN 4096
+
+typedef struct vse_serve_request
+{
+    uint32_t magic;
+    uint8_t op;
+    uint8_t cipher;
+    uint16_t flags;
+    uint32_t password_nbytes;
+    uint32_t infile_nbytes;
+    uint32_t outfile_nbytes;
+} vse_serve_request_t;
+
+typedef struct vse_serve_response
+{
+    uint32_t magic;
+    int32_t status;
+} vse_serve_response_t;
+
+/**
+ * Listen on socket_path and serve requests on nworkers threads until
+ * SIGINT/SIGTERM. nworkers <= 0 means one per online CPU.
+ *
+ * @return 0 on clean shutdown, ERR_SERVE_* otherwise.
+ */
+int vse_serve(const char *socket_path, int nworkers);
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "vse.h"
+#include "stats.h"
+#include "sync.h"
+#include "trace.h"
+#include "metrics.h"
+
+typedef struct vse_stats
+{
+    int enabled;
+    int print;
+    FILE *fp_json;
+    uint64_t t_open;
+
+    vse_mutex_t lock; // guards everything below
+    uint64_t files;
+    uint64_t failed;
+    uint64_t bytes;
+    uint64_t total_ns;
+    vse_timing_t timing;
+} vse_stats_t;
+
+static vse_stats_t g_stats;
+
+static const char *vse_mode_name(int mode)
+{
+    switch (mode)
+    {
+    case MODE_ENCRYPT:
+        return "encrypt";
+    case MODE_DECRYPT:
+        return "decrypt";
+    case MODE_VERIFY:
+        return "verify";
+    case MODE_REENCRYPT:
+        return "reencrypt";
+    case MODE_REKEY:
+        return "rekey";
+    default:
+        return "unknown";
+    }
+}
+
+static void json_write_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static void json_write_phases(FILE *fp, const vse_timing_t *timing)
+{
+    for (int i = 0; i < VSE_PHASE_COUNT; i++)
+    {
+        const char *name = vse_phase_name((vse_phase_t)i);
+        fprintf(fp, ",\"%s_ns\":%llu,\"%s_calls\":%llu",
+                name, (unsigned long long)timing->ns[i],
+                name, (unsigned long long)timing->calls[i]);
+    }
+}
+
+int vse_stats_open(int print, const char *json_path)
+{
+    memset(&g_stats, 0, sizeof(g_stats));
+    if (json_path != NULL)
+    {
+        g_stats.fp_json = fopen(json_path, "a");
+        if (g_stats.fp_json == NULL)
+        {
+            vse_print_error("Error: Failed to open stats file %s\n", json_path);
+            return ERR_STATS_FAILED_TO_OPEN;
+        }
+    }
+
+    vse_mutex_init(&g_stats.lock);
+    g_stats.print = print;
+    g_stats.t_open = vse_now_ns();
+    g_stats.enabled = 1;
+    return 0;
+}
+
+uint64_t vse_stats_file_begin(vse_timing_t *timing, const char *infile)
+{
+    if (!g_stats.enabled && !vse_trace_enabled && !vse_metrics_enabled)
+        return 0;
+
+    // --trace and --metrics-file are fed by the same timing laps.
+    memset(timing, 0, sizeof(vse_timing_t));
+    vse_timing_attach(timing);
+    if (vse_trace_enabled)
+        vse_trace_set_file(infile);
+    return vse_now_ns();
+}
+
+void vse_stats_file_end(vse_timing_t *timing, uint64_t t0,
+                        int mode, const char *infile, int status)
+{
+    if (t0 == 0)
+        return;
+
+    uint64_t t1 = vse_now_ns();
+    uint64_t total_ns = t1 - t0 + timing->ahead_ns;
+    vse_timing_attach(NULL);
+
+    if (vse_trace_enabled)
+    {
+        vse_trace_span("file", t0, t1);
+        vse_trace_set_file(NULL);
+    }
+    if (vse_metrics_enabled)
+        vse_metrics_file_end(timing, mode, infile, status);
+    if (!g_stats.enabled)
+        return;
+
+    struct stat st;
+    uint64_t bytes = stat(infile, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+    vse_mutex_lock(&g_stats.lock);
+
+    g_stats.files++;
+    if (status != 0)
+        g_stats.failed++;
+    g_stats.bytes += bytes;
+    g_stats.total_ns += total_ns;
+    for (int i = 0; i < VSE_PHASE_COUNT; i++)
+    {
+        g_stats.timing.ns[i] += timing->ns[i];
+        g_stats.timing.calls[i] += timing->calls[i];
+    }
+
+    if (g_stats.print)
+    {
+        fprintf(stderr, "stats: %s %s %llu B %.1f ms:", infile, vse_mode_name(mode),
+                (unsigned long long)bytes, total_ns / 1e6);
+        for (int i = 0; i < VSE_PHASE_COUNT; i++)
+        {
+            if (timing->calls[i] != 0)
+                fprintf(stderr, " %s %.1f", vse_phase_name((vse_phase_t)i), timing->ns[i] / 1e6);
+        }
+        fprintf(stderr, "%s\n", status != 0 ? " (failed)" : "");
+    }
+
+    if (g_stats.fp_json != NULL)
+    {
+        FILE *fp = g_stats.fp_json;
+        fprintf(fp, "{\"type\":\"file\",\"path\":");
+        json_write_string(fp, infile);
+        fprintf(fp, ",\"mode\":\"%s\",\"status\":%d,\"bytes\":%llu,\"total_ns\":%llu",
+                vse_mode_name(mode), status, (unsigned long long)bytes, (unsigned long long)total_ns);
+        json_write_phases(fp, timing);
+        fprintf(fp, "}\n");
+        fflush(fp);
+    }
+
+    vse_mutex_unlock(&g_stats.lock);
+}
+
+void vse_stats_close(void)
+{
+    if (!g_stats.enabled)
+        return;
+
+    uint64_t wall_ns = vse_now_ns() - g_stats.t_open;
+    const vse_timing_t *timing = &g_stats.timing;
+
+    if (g_stats.print)
+    {
+        uint64_t accounted = 0;
+        fprintf(stderr, "stats: %llu files (%llu failed), %llu B in %.3f s, %.2f MB/s\n",
+                (unsigned long long)g_stats.files, (unsigned long long)g_stats.failed,
+                (unsigned long long)g_stats.bytes, wall_ns / 1e9,
+                wall_ns ? g_stats.bytes * 1e3 / wall_ns : 0.0);
+        fprintf(stderr, "stats:   %-8s %12s %7s %10s\n", "phase", "ms", "%", "calls");
+        for (int i = 0; i < VSE_PHASE_COUNT; i++)
+        {
+            accounted += timing->ns[i];
+            fprintf(stderr, "stats:   %-8s %12.1f %7.1f %10llu\n",
+                    vse_phase_name((vse_phase_t)i), timing->ns[i] / 1e6,
+                    g_stats.total_ns ? 100.0 * timing->ns[i] / g_stats.total_ns : 0.0,
+                    (unsigned long long)timing->calls[i]);
+        }
+        uint64_t other = g_stats.total_ns > accounted ? g_stats.total_ns - accounted : 0;
+        fprintf(stderr, "stats:   %-8s %12.1f %7.1f\n", "other", other / 1e6,
+                g_stats.total_ns ? 100.0 * other / g_stats.total_ns : 0.0);
+    }
+
+    if (g_stats.fp_json != NULL)
+    {
+        FILE *fp = g_stats.fp_json;
+        fprintf(fp, "{\"type\":\"total\",\"files\":%llu,\"failed\":%llu,\"bytes\":%llu,\"total_ns\":%llu,\"wall_ns\":%llu",
+                (unsigned long long)g_stats.files, (unsigned long long)g_stats.failed,
+                (unsigned long long)g_stats.bytes, (unsigned long long)g_stats.total_ns,
+                (unsigned long long)wall_ns);
+        json_write_phases(fp, timing);
+        fprintf(fp, "}\n");
+        fclose(fp);
+    }
+
+    vse_mutex_destroy(&g_stats.lock);
+    memset(&g_stats, 0, sizeof(g_stats));
+}
@@ -0,0 +1,43 @@
+#ifndef STATS_B8E14D2A_6F39_4C07_A5D1_3E92C7F06B48_H
+#define STATS_B8E14D2A_6F39_4C07_A5D1_3E92C7F06B48_H
+
+#include <stdint.h>
+#include "timing.h"
+
+/*
+ * --stats and --stats-json: per-file and aggregate phase timings.
+ *
+ * vse_run_on_file() brackets every file with vse_stats_file_begin/end();
+ * both are no-ops until vse_stats_open() has been called.
+ */
+
+/**
+ * Start collecting.
+ *
+ * @param print      print a line per file and a summary to stderr.
+ * @param json_path  append one NDJSON record per file, plus a "total"
+ *                   record, to this file. NULL for none.
+ * @return 0 or ERR_STATS_FAILED_TO_OPEN.
+ */
+int vse_stats_open(int print, const char *json_path);
+
+/**
+ * Clear timing and attach it to this thread; tag its trace spans with infile.
+ *
+ * @return the start time, 0 when none of stats, --trace or --metrics-file are on.
+ */
+uint64_t vse_stats_file_begin(vse_timing_t *timing, const char *infile);
+
+/**
+ * Detach timing, record the file's trace span and metrics and report it.
+ * Thread-safe.
+ */
+void vse_stats_file_end(vse_timing_t *timing, uint64_t t0,
+                        int mode, const char *infile, int status);
+
+/**
+ * Report the totals and close the NDJSON file.
+ */
+void vse_stats_close(void);
+
+#endif
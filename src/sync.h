@@ -0,0 +1,38 @@
+#ifndef SYNC_7C3E9A15_2D84_4B6F_91E0_5A8F2C6D4B37_H
+#define SYNC_7C3E9A15_2D84_4B6F_91E0_5A8F2C6D4B37_H
+
+/*
+ * Mutex and condition variable: pthreads, or the Win32 equivalents.
+ */
+
+#if _MSC_VER
+#include <Windows.h>
+
+typedef CRITICAL_SECTION vse_mutex_t;
+typedef CONDITION_VARIABLE vse_cond_t;
+#define vse_mutex_init(m) InitializeCriticalSection(m)
+#define vse_mutex_destroy(m) DeleteCriticalSection(m)
+#define vse_mutex_lock(m) EnterCriticalSection(m)
+#define vse_mutex_unlock(m) LeaveCriticalSection(m)
+#define vse_cond_init(c) InitializeConditionVariable(c)
+#define vse_cond_destroy(c)
+#define vse_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define vse_cond_signal(c) WakeConditionVariable(c)
+#define vse_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t vse_mutex_t;
+typedef pthread_cond_t vse_cond_t;
+#define vse_mutex_init(m) pthread_mutex_init(m, NULL)
+#define vse_mutex_destroy(m) pthread_mutex_destroy(m)
+#define vse_mutex_lock(m) pthread_mutex_lock(m)
+#define vse_mutex_unlock(m) pthread_mutex_unlock(m)
+#define vse_cond_init(c) pthread_cond_init(c, NULL)
+#define vse_cond_destroy(c) pthread_cond_destroy(c)
+#define vse_cond_wait(c, m) pthread_cond_wait(c, m)
+#define vse_cond_signal(c) pthread_cond_signal(c)
+#define vse_cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+#endif
@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include "threadpool.h"
+#include "sync.h"
+#include "cpu_tokens.h"
+#include "numa.h"
+
+#if _MSC_VER
+#include <process.h>
+
+typedef HANDLE vse_thread_t;
+#define VSE_THREAD_RET unsigned __stdcall
+#else
+typedef pthread_t vse_thread_t;
+#define VSE_THREAD_RET void *
+#endif
+
+typedef struct vse_job
+{
+    vse_job_fn fn;
+    void *arg;
+    struct vse_job *next;
+} vse_job_t;
+
+struct vse_threadpool
+{
+    vse_mutex_t lock;
+    vse_cond_t has_job; // signalled when a job is queued or on shutdown
+    vse_cond_t idle;    // signalled when pending drops to 0
+    vse_job_t *head;
+    vse_job_t *tail;
+    int pending; // queued + running jobs
+    int shutdown;
+    int nthreads;
+    int started; // workers that took their index
+    vse_thread_t *threads;
+};
+
+static VSE_THREAD_RET vse_worker(void *arg)
+{
+    vse_threadpool_t *pool = arg;
+
+    vse_mutex_lock(&pool->lock);
+    int index = pool->started++;
+    vse_mutex_unlock(&pool->lock);
+    vse_numa_pin_worker(index);
+
+    for (;;)
+    {
+        vse_mutex_lock(&pool->lock);
+        while (pool->head == NULL && !pool->shutdown)
+            vse_cond_wait(&pool->has_job, &pool->lock);
+
+        vse_job_t *job = pool->head;
+        if (job == NULL)
+        {
+            // shutdown and nothing left to do
+            vse_mutex_unlock(&pool->lock);
+            break;
+        }
+        pool->head = job->next;
+        if (pool->head == NULL)
+            pool->tail = NULL;
+        vse_mutex_unlock(&pool->lock);
+
+        // A job is CPU work: it holds a CPU token while it runs.
+        vse_cpu_enter();
+        job->fn(job->arg);
+        vse_cpu_leave();
+        free(job);
+
+        vse_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            vse_cond_broadcast(&pool->idle);
+        vse_mutex_unlock(&pool->lock);
+    }
+
+    return 0;
+}
+
+vse_threadpool_t *vse_threadpool_new(int nthreads)
+{
+    if (nthreads <= 0)
+        nthreads = vse_cpu_budget();
+
+    vse_threadpool_t *pool = calloc(1, sizeof(vse_threadpool_t));
+    if (pool == NULL)
+        return NULL;
+
+    pool->threads = calloc((size_t)nthreads, sizeof(vse_thread_t));
+    if (pool->threads == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    vse_mutex_init(&pool->lock);
+    vse_cond_init(&pool->has_job);
+    vse_cond_init(&pool->idle);
+
+    for (int i = 0; i < nthreads; i++)
+    {
+#if _MSC_VER
+        pool->threads[i] = (HANDLE)_beginthreadex(NULL, 0, vse_worker, pool, 0, NULL);
+        if (pool->threads[i] == 0)
+            break;
+#else
+        if (pthread_create(&pool->threads[i], NULL, vse_worker, pool) != 0)
+            break;
+#endif
+        pool->nthreads++;
+    }
+
+    if (pool->nthreads == 0)
+    {
+        vse_threadpool_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+static int vse_threadpool_push(vse_threadpool_t *pool, vse_job_fn fn, void *arg, int first)
+{
+    vse_job_t *job = malloc(sizeof(vse_job_t));
+    if (job == NULL)
+        return -1;
+    job->fn = fn;
+    job->arg = arg;
+    job->next = NULL;
+
+    vse_mutex_lock(&pool->lock);
+    if (pool->shutdown)
+    {
+        vse_mutex_unlock(&pool->lock);
+        free(job);
+        return -1;
+    }
+    if (first)
+    {
+        job->next = pool->head;
+        pool->head = job;
+        if (pool->tail == NULL)
+            pool->tail = job;
+    }
+    else
+    {
+        if (pool->tail != NULL)
+            pool->tail->next = job;
+        else
+            pool->head = job;
+        pool->tail = job;
+    }
+    pool->pending++;
+    vse_cond_signal(&pool->has_job);
+    vse_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+int vse_threadpool_submit(vse_threadpool_t *pool, vse_job_fn fn, void *arg)
+{
+    return vse_threadpool_push(pool, fn, arg, 0);
+}
+
+int vse_threadpool_submit_first(vse_threadpool_t *pool, vse_job_fn fn, void *arg)
+{
+    return vse_threadpool_push(pool, fn, arg, 1);
+}
+
+int vse_threadpool_size(const vse_threadpool_t *pool)
+{
+    return pool->nthreads;
+}
+
+void vse_threadpool_wait(vse_threadpool_t *pool)
+{
+    vse_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        vse_cond_wait(&pool->idle, &pool->lock);
+    vse_mutex_unlock(&pool->lock);
+}
+
+void vse_threadpool_free(vse_threadpool_t *pool)
+{
+    if (pool == NULL)
+        return;
+
+    vse_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    vse_cond_broadcast(&pool->has_job);
+    vse_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++)
+    {
+#if _MSC_VER
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+
+    vse_cond_destroy(&pool->idle);
+    vse_cond_destroy(&pool->has_job);
+    vse_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,47 @@
+#ifndef THREADPOOL_2B6E9A41_7D3C_4E85_A1F0_C94D5B283E7A_H
+#define THREADPOOL_2B6E9A41_7D3C_4E85_A1F0_C94D5B283E7A_H
+
+typedef struct vse_threadpool vse_threadpool_t;
+
+typedef void (*vse_job_fn)(void *arg);
+
+/**
+ * Start a pool of nthreads workers. nthreads <= 0 means one per CPU the
+ * process may use (vse_cpu_budget()). With NUMA placement on, worker i is
+ * pinned to the CPUs of node i % vse_numa_nodes().
+ *
+ * @return NULL if no worker could be started.
+ */
+vse_threadpool_t *vse_threadpool_new(int nthreads);
+
+/**
+ * Queue fn(arg) to run on one of the workers.
+ *
+ * @return 0 on success, -1 if the pool is shutting down or out of memory.
+ */
+int vse_threadpool_submit(vse_threadpool_t *pool, vse_job_fn fn, void *arg);
+
+/**
+ * Queue fn(arg) ahead of everything already queued: for work that others
+ * wait on, such as the ranges of a split file.
+ *
+ * @return 0 on success, -1 if the pool is shutting down or out of memory.
+ */
+int vse_threadpool_submit_first(vse_threadpool_t *pool, vse_job_fn fn, void *arg);
+
+/**
+ * Number of workers.
+ */
+int vse_threadpool_size(const vse_threadpool_t *pool);
+
+/**
+ * Block until every submitted job has finished.
+ */
+void vse_threadpool_wait(vse_threadpool_t *pool);
+
+/**
+ * Finish queued jobs, join the workers and free the pool.
+ */
+void vse_threadpool_free(vse_threadpool_t *pool);
+
+#endif
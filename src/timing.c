@@ -0,0 +1,66 @@
+#include <time.h>
+#include "timing.h"
+#include "trace.h"
+
+#if _MSC_VER
+#include <Windows.h>
+#endif
+
+VSE_THREAD_LOCAL vse_timing_t *vse_timing_sink;
+
+static const char *g_phase_names[VSE_PHASE_COUNT] = {
+    "kdf", "kdf_wait", "iv", "read", "cipher", "hash", "write", "verify", "rename"};
+
+uint64_t vse_now_ns(void)
+{
+#if _MSC_VER
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (uint64_t)((double)t.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void vse_timing_attach(vse_timing_t *timing)
+{
+    vse_timing_sink = timing;
+}
+
+void vse_timing_add(const vse_timing_t *timing)
+{
+    vse_timing_t *sink = vse_timing_sink;
+    if (sink == NULL)
+        return;
+    for (int i = 0; i < VSE_PHASE_COUNT; i++)
+    {
+        sink->ns[i] += timing->ns[i];
+        sink->calls[i] += timing->calls[i];
+        sink->ahead_ns += timing->ns[i];
+    }
+    sink->cipher = timing->cipher;
+}
+
+uint64_t vse_timing_lap(vse_phase_t phase, uint64_t t0)
+{
+    uint64_t now = vse_now_ns();
+    vse_timing_t *timing = vse_timing_sink;
+    if (timing != NULL)
+    {
+        timing->ns[phase] += now - t0;
+        timing->calls[phase]++;
+    }
+    if (vse_trace_enabled)
+        vse_trace_span(g_phase_names[phase], t0, now);
+    return now;
+}
+
+const char *vse_phase_name(vse_phase_t phase)
+{
+    return phase >= 0 && phase < VSE_PHASE_COUNT ? g_phase_names[phase] : "unknown";
+}
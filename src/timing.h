@@ -0,0 +1,91 @@
+#ifndef TIMING_2A7F1C94_5E3B_4D86_A0C9_B41E6D3F8A25_H
+#define TIMING_2A7F1C94_5E3B_4D86_A0C9_B41E6D3F8A25_H
+
+#include <stdint.h>
+#include "vse.h"
+
+/*
+ * Per-phase timing of a file operation.
+ *
+ * A caller attaches a vse_timing_t to the current thread; the hot paths
+ * then add the time spent in each phase to it. With nothing attached the
+ * cost is one thread-local load and branch per phase boundary.
+ *
+ * Phases are timed as laps: each VSE_TIMING_LAP() books the time since the
+ * previous one, so a chunk of the stream loop costs one clock read per phase.
+ *
+ *     uint64_t t = VSE_TIMING_NOW();
+ *     fread(...);
+ *     VSE_TIMING_LAP(VSE_PHASE_READ, t);
+ *     xcrypt(...);
+ *     VSE_TIMING_LAP(VSE_PHASE_CIPHER, t);
+ */
+
+typedef enum vse_phase
+{
+    VSE_PHASE_KDF,      // vse_gen_key_v1()
+    VSE_PHASE_KDF_WAIT, // KDFs waiting for the memory budget, see mem_budget.h
+    VSE_PHASE_IV,       // vse_gen_iv_v1()
+    VSE_PHASE_READ,     // fread() of the stream loops
+    VSE_PHASE_CIPHER,   // cipher steps
+    VSE_PHASE_HASH,     // blake2b_update() of the ciphertext
+    VSE_PHASE_WRITE,    // fwrite() of the stream loops
+    VSE_PHASE_VERIFY,   // MAC verification pass before decrypting
+    VSE_PHASE_RENAME,   // temp file into place
+    VSE_PHASE_COUNT
+} vse_phase_t;
+
+typedef struct vse_timing
+{
+    uint64_t ns[VSE_PHASE_COUNT];
+    uint64_t calls[VSE_PHASE_COUNT];
+    int cipher; // CIPHER_* of the file, once its header is known
+    uint64_t ahead_ns; // spent on the file before it started, see vse_timing_add()
+} vse_timing_t;
+
+extern VSE_THREAD_LOCAL vse_timing_t *vse_timing_sink;
+
+/**
+ * Monotonic clock, in nanoseconds.
+ */
+uint64_t vse_now_ns(void);
+
+/**
+ * Send this thread's timings to timing until the next call. NULL stops.
+ */
+void vse_timing_attach(vse_timing_t *timing);
+
+/**
+ * Add the phases of timing, and its cipher, to this thread's timing: for
+ * work done for a file before it started (see multibuf.h). Their sum goes
+ * to ahead_ns, which file totals include.
+ */
+void vse_timing_add(const vse_timing_t *timing);
+
+/**
+ * Book now - t0 to phase.
+ *
+ * @return now, the start of the next lap.
+ */
+uint64_t vse_timing_lap(vse_phase_t phase, uint64_t t0);
+
+const char *vse_phase_name(vse_phase_t phase);
+
+// Start of a lap, 0 when no timing is attached.
+#define VSE_TIMING_NOW() (vse_timing_sink != NULL ? vse_now_ns() : 0)
+
+#define VSE_TIMING_LAP(phase, t)                 \
+    do                                           \
+    {                                            \
+        if ((t) != 0)                            \
+            (t) = vse_timing_lap((phase), (t));  \
+    } while (0)
+
+#define VSE_TIMING_CIPHER(id)                    \
+    do                                           \
+    {                                            \
+        if (vse_timing_sink != NULL)             \
+            vse_timing_sink->cipher = (id);      \
+    } while (0)
+
+#endif
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vse.h"
+#include "trace.h"
+#include "timing.h"
+
+#if _MSC_VER
+#include <Windows.h>
+#define vse_atomic_inc(p) InterlockedIncrement((volatile LONG *)(p))
+#define vse_atomic_cas_ptr(p, expected, desired) \
+    (InterlockedCompareExchangePointer((PVOID volatile *)(p), (desired), (expected)) == (expected))
+#else
+#define vse_atomic_inc(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define vse_atomic_cas_ptr(p, expected, desired) \
+    __atomic_compare_exchange_n((p), &(expected), (desired), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+#endif
+
+typedef struct vse_trace_event
+{
+    const char *name;
+    const char *file; // owned by the ring's file list
+    uint64_t t0;
+    uint64_t t1;
+} vse_trace_event_t;
+
+typedef struct vse_trace_file
+{
+    char *path;
+    struct vse_trace_file *next;
+} vse_trace_file_t;
+
+typedef struct vse_trace_ring
+{
+    int tid;
+    uint64_t head; // events ever recorded; only the owning thread writes it
+    vse_trace_file_t *files;
+    const char *file; // current file
+    struct vse_trace_ring *next;
+    vse_trace_event_t events[VSE_TRACE_RING_EVENTS];
+} vse_trace_ring_t;
+
+int vse_trace_enabled;
+
+static FILE *g_fp;
+static uint64_t g_t_open;
+static long g_next_tid;
+static vse_trace_ring_t *g_rings; // every thread's ring, pushed lock-free
+static VSE_THREAD_LOCAL vse_trace_ring_t *t_ring;
+
+static vse_trace_ring_t *vse_trace_ring(void)
+{
+    if (t_ring != NULL)
+        return t_ring;
+
+    vse_trace_ring_t *ring = calloc(1, sizeof(vse_trace_ring_t));
+    if (ring == NULL)
+        return NULL;
+    ring->tid = (int)vse_atomic_inc(&g_next_tid);
+
+    vse_trace_ring_t *head = g_rings;
+    do
+    {
+        ring->next = head;
+    } while (!vse_atomic_cas_ptr(&g_rings, head, ring));
+
+    t_ring = ring;
+    return ring;
+}
+
+int vse_trace_open(const char *path)
+{
+    g_fp = fopen(path, "w");
+    if (g_fp == NULL)
+        return ERR_TRACE_FAILED_TO_OPEN;
+
+    g_t_open = vse_now_ns();
+    vse_trace_enabled = 1;
+    return 0;
+}
+
+void vse_trace_set_file(const char *path)
+{
+    vse_trace_ring_t *ring = vse_trace_ring();
+    if (ring == NULL)
+        return;
+
+    ring->file = NULL;
+    if (path == NULL)
+        return;
+
+    vse_trace_file_t *file = malloc(sizeof(vse_trace_file_t));
+    if (file == NULL)
+        return;
+    file->path = strdup(path);
+    file->next = ring->files;
+    ring->files = file;
+    ring->file = file->path;
+}
+
+void vse_trace_span(const char *name, uint64_t t0_ns, uint64_t t1_ns)
+{
+    vse_trace_ring_t *ring = vse_trace_ring();
+    if (ring == NULL)
+        return;
+
+    vse_trace_event_t *ev = &ring->events[ring->head % VSE_TRACE_RING_EVENTS];
+    ev->name = name;
+    ev->file = ring->file;
+    ev->t0 = t0_ns;
+    ev->t1 = t1_ns;
+    ring->head++;
+}
+
+static void json_write_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static const char *vse_trace_category(const char *name)
+{
+    if (strcmp(name, "kdf") == 0 || strcmp(name, "iv") == 0)
+        return "kdf";
+    if (strcmp(name, "cipher") == 0 || strcmp(name, "hash") == 0 || strcmp(name, "verify") == 0)
+        return "crypto";
+    if (strcmp(name, "file") == 0)
+        return "file";
+    return "io";
+}
+
+void vse_trace_close(void)
+{
+    if (!vse_trace_enabled)
+        return;
+    vse_trace_enabled = 0;
+
+    FILE *fp = g_fp;
+    int first = 1;
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    vse_trace_ring_t *ring = g_rings;
+    while (ring != NULL)
+    {
+        fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                first ? "" : ",", ring->tid, ring->tid);
+        first = 0;
+
+        uint64_t begin = ring->head > VSE_TRACE_RING_EVENTS ? ring->head - VSE_TRACE_RING_EVENTS : 0;
+        for (uint64_t i = begin; i < ring->head; i++)
+        {
+            const vse_trace_event_t *ev = &ring->events[i % VSE_TRACE_RING_EVENTS];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    ev->name, vse_trace_category(ev->name), ring->tid,
+                    (ev->t0 - g_t_open) / 1e3, (ev->t1 - ev->t0) / 1e3);
+            if (ev->file != NULL)
+            {
+                fprintf(fp, ",\"args\":{\"file\":");
+                json_write_string(fp, ev->file);
+                fprintf(fp, "}");
+            }
+            fprintf(fp, "}");
+        }
+        if (begin > 0)
+            fprintf(stderr, "trace: thread %d dropped its %llu oldest events\n",
+                    ring->tid, (unsigned long long)begin);
+
+        vse_trace_ring_t *next = ring->next;
+        while (ring->files != NULL)
+        {
+            vse_trace_file_t *file = ring->files;
+            ring->files = file->next;
+            free(file->path);
+            free(file);
+        }
+        free(ring);
+        ring = next;
+    }
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    g_fp = NULL;
+    g_rings = NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef TRACE_3D9B6E21_A4C7_4F8E_B265_0F1C8A7D3E59_H
+#define TRACE_3D9B6E21_A4C7_4F8E_B265_0F1C8A7D3E59_H
+
+#include <stdint.h>
+
+/*
+ * Chrome/Perfetto trace-event recording (--trace).
+ *
+ * Every thread records complete ("X") events into its own ring buffer,
+ * so recording takes no lock; the rings are written out by
+ * vse_trace_close(), once all threads are done. A full ring drops its
+ * oldest events.
+ *
+ * Spans come from the timing laps (see timing.h) plus one "file" span per
+ * vse_run_on_file(); each carries the file being processed on that thread.
+ */
+
+// Events kept per thread.
+#define VSE_TRACE_RING_EVENTS (1 << 16)
+
+extern int vse_trace_enabled;
+
+/**
+ * Start recording, to be written to path by vse_trace_close().
+ *
+ * @return 0 or ERR_TRACE_FAILED_TO_OPEN.
+ */
+int vse_trace_open(const char *path);
+
+/**
+ * Tag the following spans of this thread with path. NULL clears.
+ */
+void vse_trace_set_file(const char *path);
+
+/**
+ * Record a span of this thread. name must be a string literal.
+ */
+void vse_trace_span(const char *name, uint64_t t0_ns, uint64_t t1_ns);
+
+/**
+ * Write all events and stop recording. Call once every thread that
+ * recorded is done.
+ */
+void vse_trace_close(void);
+
+#endif
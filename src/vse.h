@@ -18,10 +18,31 @@
 #define CIPHER_CHACHA20_AES_256_CTR 0x23
 #define CIPHER_AES_256_CTR_SALSA20 0x31
 #define CIPHER_SALSA20_AES_256_CTR 0x13
+#define CIPHER_AES_256_GCM 0x4 // AEAD: the file hash is the GCM tag, see gcm.h
+#define CIPHER_AEGIS_256 0x5 // AEAD: the file hash is the AEGIS-256 tag, see aegis256.h
+#define CIPHER_XCHACHA20_POLY1305 0x6 // AEAD: the file hash is the Poly1305 tag, see xchacha20poly1305.h
+
+#if _MSC_VER
+#define VSE_THREAD_LOCAL __declspec(thread)
+#else
+#define VSE_THREAD_LOCAL __thread
+#endif
+
+// File positions past 2 GiB, where long is 32 bits.
+#if _MSC_VER
+#define vse_fseek64 _fseeki64
+#define vse_ftell64 _ftelli64
+#else
+#define vse_fseek64 fseeko
+#define vse_ftell64 ftello
+#endif
 
 #define MODE_UNKNOWN 0
 #define MODE_ENCRYPT 1
 #define MODE_DECRYPT 2
+#define MODE_VERIFY 3
+#define MODE_REENCRYPT 4
+#define MODE_REKEY 5
 
 typedef struct vse_header_v1
 {
@@ -33,14 +54,33 @@ typedef struct vse_header_v1
 
 #define FILE_HEADER_LEN (sizeof(vse_header_v1_t) / sizeof(char))
 
-void vse_print_error(const char *fmt, ...);
+/*
+ * Version 2: the data is encrypted under a random data key, which every
+ * key slot holds wrapped under a key derived from one password. Changing a
+ * password only rewrites a slot.
+ */
+#define DATA_KEY_LEN 64 // cipher key (KEY_LEN), then MAC key (KEY_LEN)
+#define KEY_SLOTS_V2 4
+#define KEY_SLOT_USED 0x1
 
-typedef struct vse_cipher
+typedef struct vse_key_slot_v2
 {
-    const char *name;
-    void *ctx;
-    int (*encrypt)(uint8_t *in, uint32_t in_nbytes, uint8_t *out, uint32_t out_nbytes);
-    int (*decrypt)(uint8_t *in, uint32_t in_nbytes, uint8_t *out, uint32_t out_nbytes);
-} vse_cipher_t;
+    uint8_t flags;                     // KEY_SLOT_*
+    uint8_t salt[SALT_LEN];            // salt for password
+    uint8_t wrapped_key[DATA_KEY_LEN]; // data key, encrypted
+    uint8_t tag[MAC_LEN];              // of the slot and the file iv
+} vse_key_slot_v2_t;
+
+typedef struct vse_header_v2
+{
+    uint8_t cipher;
+    uint8_t iv[IV_LEN];   // iv for encryption
+    uint8_t mac[MAC_LEN]; // of cipher, iv and data; not of the slots
+    vse_key_slot_v2_t slots[KEY_SLOTS_V2];
+} vse_header_v2_t;
+
+#define FILE_HEADER_V2_LEN (sizeof(vse_header_v2_t) / sizeof(char))
+
+void vse_print_error(const char *fmt, ...);
 
 #endif
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "vsencrypt.h"
+#include "crypt_v1.h"
+#include "cipher.h"
+#include "crypto_random.h"
+#include "kdf_arena.h"
+#include "argon2/src/blake2/blake2.h"
+
+#define VSE_CTX_MAGIC 0x56534543 // "VSEC"
+
+#define VSE_KS_LEN 64 // chacha/salsa20 block, 4 AES blocks
+
+/*
+ * Keystream left over from the last partial block of a step, so that
+ * update() can take any length and still produce one continuous stream.
+ */
+typedef struct vse_keystream
+{
+    uint8_t buf[VSE_KS_LEN];
+    size_t pos; // VSE_KS_LEN when empty
+} vse_keystream_t;
+
+struct vse_ctx
+{
+    uint32_t magic;
+    int owned; // allocated by vse_ctx_new()
+    int mode;  // MODE_UNKNOWN until *_init() succeeded
+    int error;
+    char error_message[128];
+
+    uint8_t *kdf_memory;
+    size_t kdf_memory_nbytes;
+
+    // Everything from here to the end is secret, see vse_ctx_wipe_keys().
+    const vse_cipher_t *cipher;
+    vse_header_v1_t header;
+    uint8_t key[KEY_LEN];
+    vse_cipher_ctx_t cipher_ctx;
+    vse_file_hash_t hash;
+    vse_keystream_t ks[VSE_CIPHER_MAX_STEPS]; // one per step of cipher
+};
+
+static int vse_ctx_fail(vse_ctx_t *ctx, int error, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(ctx->error_message, sizeof(ctx->error_message), fmt, ap);
+    va_end(ap);
+    ctx->error = error;
+    return error;
+}
+
+static void vse_ctx_wipe_keys(vse_ctx_t *ctx)
+{
+    volatile uint8_t *p = (volatile uint8_t *)&ctx->cipher;
+    size_t n = (size_t)((uint8_t *)(ctx + 1) - (uint8_t *)&ctx->cipher);
+    while (n--)
+        *p++ = 0;
+    ctx->mode = MODE_UNKNOWN;
+}
+
+size_t vse_ctx_size(void)
+{
+    return sizeof(vse_ctx_t);
+}
+
+vse_ctx_t *vse_ctx_init(void *mem, size_t mem_nbytes)
+{
+    if (mem == NULL || mem_nbytes < sizeof(vse_ctx_t))
+        return NULL;
+
+    vse_ctx_t *ctx = mem;
+    memset(ctx, 0, sizeof(vse_ctx_t));
+    ctx->magic = VSE_CTX_MAGIC;
+    ctx->mode = MODE_UNKNOWN;
+    return ctx;
+}
+
+vse_ctx_t *vse_ctx_new(void)
+{
+    vse_ctx_t *ctx = vse_ctx_init(malloc(sizeof(vse_ctx_t)), sizeof(vse_ctx_t));
+    if (ctx != NULL)
+        ctx->owned = 1;
+    return ctx;
+}
+
+void vse_ctx_free(vse_ctx_t *ctx)
+{
+    if (ctx == NULL || ctx->magic != VSE_CTX_MAGIC)
+        return;
+
+    vse_ctx_wipe_keys(ctx);
+    if (ctx->owned)
+    {
+        ctx->magic = 0;
+        free(ctx);
+    }
+}
+
+void vse_ctx_set_kdf_memory(vse_ctx_t *ctx, void *mem, size_t mem_nbytes)
+{
+    ctx->kdf_memory = mem;
+    ctx->kdf_memory_nbytes = mem == NULL ? 0 : mem_nbytes;
+}
+
+int vse_ctx_error(const vse_ctx_t *ctx)
+{
+    return ctx->error;
+}
+
+const char *vse_ctx_error_message(const vse_ctx_t *ctx)
+{
+    return ctx->error_message;
+}
+
+/*
+ * Derive the key and set up the ciphers and the ciphertext hash for
+ * ctx->header.
+ */
+static int vse_ctx_setup(vse_ctx_t *ctx, int mode,
+                         const char *password, size_t password_nbytes)
+{
+    int ret;
+
+    if (ctx->kdf_memory != NULL)
+        vse_kdf_arena_lend(ctx->kdf_memory, ctx->kdf_memory_nbytes);
+    ret = vse_gen_key_v1(ctx->header.salt, SALT_LEN,
+                         password, password_nbytes, KEY_LEN, ctx->key);
+    if (ctx->kdf_memory != NULL)
+        vse_kdf_arena_lend(NULL, 0);
+
+    if (ret != 0)
+    {
+        vse_ctx_wipe_keys(ctx);
+        return vse_ctx_fail(ctx, ERR_LIB_KDF_FAILED, "Key derivation failed: %d", ret);
+    }
+
+    if (ctx->cipher->setup(&ctx->cipher_ctx, ctx->header.iv, IV_LEN, ctx->key, KEY_LEN) != 0 ||
+        ctx->cipher->hash_init(&ctx->hash, ctx->header.iv, IV_LEN, ctx->key, KEY_LEN) != 0)
+    {
+        vse_ctx_wipe_keys(ctx);
+        return vse_ctx_fail(ctx, ERR_LIB_KDF_FAILED, "IV derivation failed");
+    }
+    for (int i = 0; i < VSE_CIPHER_MAX_STEPS; i++)
+        ctx->ks[i].pos = VSE_KS_LEN;
+
+    ctx->mode = mode;
+    ctx->error = 0;
+    ctx->error_message[0] = 0;
+    return 0;
+}
+
+static void vse_step_xcrypt(vse_ctx_t *ctx, int i, uint8_t *buf, size_t nbytes)
+{
+    const vse_cipher_step_t *step = ctx->cipher->steps[i];
+    vse_keystream_t *ks = &ctx->ks[i];
+
+    while (nbytes > 0 && ks->pos < VSE_KS_LEN)
+    {
+        *buf++ ^= ks->buf[ks->pos++];
+        nbytes--;
+    }
+
+    size_t whole = nbytes - nbytes % VSE_KS_LEN;
+    step->xcrypt(&ctx->cipher_ctx, buf, whole);
+    buf += whole;
+    nbytes -= whole;
+
+    if (nbytes > 0)
+    {
+        memset(ks->buf, 0, VSE_KS_LEN);
+        step->xcrypt(&ctx->cipher_ctx, ks->buf, VSE_KS_LEN);
+        for (ks->pos = 0; ks->pos < nbytes; ks->pos++)
+            buf[ks->pos] ^= ks->buf[ks->pos];
+    }
+}
+
+// No keystream carried over and whole blocks, or no keystream at all
+// (aegis256): the fused loops will do.
+static int vse_ctx_fused(const vse_ctx_t *ctx, size_t nbytes)
+{
+    if (ctx->cipher->nsteps == 0)
+        return 1;
+    return nbytes % VSE_KS_LEN == 0 && ctx->ks[0].pos == VSE_KS_LEN && ctx->ks[1].pos == VSE_KS_LEN;
+}
+
+static void vse_ctx_xcrypt(vse_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes)
+{
+    if (in != out)
+        memmove(out, in, nbytes);
+
+    if (vse_ctx_fused(ctx, nbytes))
+    {
+        ctx->cipher->xcrypt(&ctx->cipher_ctx, out, nbytes);
+        return;
+    }
+
+    for (int i = 0; i < ctx->cipher->nsteps; i++)
+        vse_step_xcrypt(ctx, i, out, nbytes);
+}
+
+int vse_encrypt_init(vse_ctx_t *ctx, int cipher,
+                     const char *password, size_t password_nbytes)
+{
+    vse_ctx_wipe_keys(ctx);
+
+    ctx->cipher = vse_cipher_find(cipher);
+    if (ctx->cipher == NULL)
+        return vse_ctx_fail(ctx, ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER, "Invalid cipher %d", cipher);
+
+    ctx->header.cipher = (uint8_t)cipher;
+    crypto_random(ctx->header.salt, SALT_LEN);
+    crypto_random(ctx->header.iv, IV_LEN);
+
+    return vse_ctx_setup(ctx, MODE_ENCRYPT, password, password_nbytes);
+}
+
+int vse_encrypt_update(vse_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes)
+{
+    if (ctx->mode != MODE_ENCRYPT)
+        return vse_ctx_fail(ctx, ERR_LIB_BAD_STATE, "vse_encrypt_init() not called");
+
+    if (vse_ctx_fused(ctx, nbytes))
+    {
+        if (in != out)
+            memmove(out, in, nbytes);
+        ctx->cipher->seal(&ctx->cipher_ctx, &ctx->hash, out, nbytes);
+        return 0;
+    }
+
+    vse_ctx_xcrypt(ctx, in, out, nbytes);
+
+    // calculate hash after encrypt
+    ctx->cipher->hash_update(&ctx->hash, out, nbytes);
+    return 0;
+}
+
+int vse_encrypt_final(vse_ctx_t *ctx, uint8_t *header, size_t header_nbytes)
+{
+    uint8_t file_hash[FILE_HASH_LEN];
+
+    if (ctx->mode != MODE_ENCRYPT)
+        return vse_ctx_fail(ctx, ERR_LIB_BAD_STATE, "vse_encrypt_init() not called");
+    if (header_nbytes < VSE_HEADER_LEN)
+        return vse_ctx_fail(ctx, ERR_LIB_BUFFER_TOO_SMALL, "Header buffer needs %d bytes", (int)VSE_HEADER_LEN);
+
+    ctx->cipher->hash_final(&ctx->hash, file_hash);
+    vse_calculate_mac_v1(&ctx->header, file_hash, ctx->key, ctx->header.mac);
+
+    header[0] = 1; // version
+    memcpy(header + 1, &ctx->header, sizeof(vse_header_v1_t));
+
+    vse_ctx_wipe_keys(ctx);
+    return 0;
+}
+
+int vse_decrypt_init(vse_ctx_t *ctx,
+                     const char *password, size_t password_nbytes,
+                     const uint8_t *header, size_t header_nbytes)
+{
+    vse_ctx_wipe_keys(ctx);
+
+    if (header_nbytes < VSE_HEADER_LEN)
+        return vse_ctx_fail(ctx, ERR_DECRYPT_FILE_INPUT_FILE_SIZE_TOO_SMALL, "Header too small");
+    if (header[0] != 1)
+        return vse_ctx_fail(ctx, ERR_DECRYPT_FILE_INVALID_VERSION, "Invalid version %d", header[0]);
+
+    memcpy(&ctx->header, header + 1, sizeof(vse_header_v1_t));
+    ctx->cipher = vse_cipher_find(ctx->header.cipher);
+    if (ctx->cipher == NULL)
+        return vse_ctx_fail(ctx, ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER, "Invalid cipher %d", ctx->header.cipher);
+
+    return vse_ctx_setup(ctx, MODE_DECRYPT, password, password_nbytes);
+}
+
+int vse_decrypt_update(vse_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes)
+{
+    if (ctx->mode != MODE_DECRYPT)
+        return vse_ctx_fail(ctx, ERR_LIB_BAD_STATE, "vse_decrypt_init() not called");
+
+    // hash the ciphertext before it gets overwritten
+    ctx->cipher->hash_update(&ctx->hash, in, nbytes);
+    vse_ctx_xcrypt(ctx, in, out, nbytes);
+    return 0;
+}
+
+int vse_decrypt_final(vse_ctx_t *ctx)
+{
+    uint8_t file_hash[FILE_HASH_LEN];
+    uint8_t mac[MAC_LEN];
+    int ret = 0;
+
+    if (ctx->mode != MODE_DECRYPT)
+        return vse_ctx_fail(ctx, ERR_LIB_BAD_STATE, "vse_decrypt_init() not called");
+
+    ctx->cipher->hash_final(&ctx->hash, file_hash);
+    vse_calculate_mac_v1(&ctx->header, file_hash, ctx->key, mac);
+
+    if (memcmp(mac, ctx->header.mac, MAC_LEN) != 0)
+        ret = vse_ctx_fail(ctx, ERR_DECRYPT_V1_INVALID_PASSWORD, "Invalid password or corrupted data");
+
+    vse_ctx_wipe_keys(ctx);
+    return ret;
+}
@@ -0,0 +1,127 @@
+#ifndef VSENCRYPT_8D2E5B17_A63C_4F09_9C41_E7B0D52A6F38_H
+#define VSENCRYPT_8D2E5B17_A63C_4F09_9C41_E7B0D52A6F38_H
+
+/*
+ * libvsencrypt -- streaming, re-entrant .vse encryption/decryption.
+ *
+ * Every call works on a caller-owned vse_ctx_t and reports failures through
+ * its return value (an ERR_* code from error.h) plus vse_ctx_error_message().
+ * The library never prints. Besides the contexts it keeps process-wide
+ * state, safe to share between threads:
+ *
+ * - the CPU feature table, filled in once on first use (cpu_features.h);
+ * - a random generator per thread, for salts and IVs (crypto_random.h);
+ * - the KDF memory budget, CPU tokens and NUMA placement the vsencrypt tool
+ *   sets up (mem_budget.h, cpu_tokens.h, numa.h). They are off until a
+ *   program turns them on, which nothing declared here does. Once on, they
+ *   cover every KDF in the process, vse_*_init() included: it may wait for
+ *   budget memory and runs Argon2 on as many threads as there are tokens.
+ *
+ * Output layout of an encryption is the same as a .vse file:
+ *
+ *     +---------------------------------------------------+
+ *     | header (VSE_HEADER_LEN) | vse_encrypt_update() output... |
+ *     +---------------------------------------------------+
+ *
+ * The header carries the MAC of the whole ciphertext, so it is only known
+ * once vse_encrypt_final() has run: reserve VSE_HEADER_LEN bytes in front
+ * of the ciphertext and fill them in at the end.
+ *
+ * Decryption takes the header first. vse_decrypt_update() hands out
+ * plaintext before the MAC has been checked; it must not be trusted (or
+ * published) until vse_decrypt_final() has returned 0.
+ *
+ * Example:
+ *
+ *     vse_ctx_t *ctx = vse_ctx_new();
+ *     vse_encrypt_init(ctx, CIPHER_AES_256_CTR_CHACHA20, "secret", 6);
+ *     vse_encrypt_update(ctx, in, out + VSE_HEADER_LEN, in_nbytes);
+ *     vse_encrypt_final(ctx, out, VSE_HEADER_LEN);
+ *     vse_ctx_free(ctx);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vse.h"
+
+#define VSE_HEADER_LEN (1 + FILE_HEADER_LEN) // version + v1 header
+
+// Argon2 working memory used by one vse_*_init() call.
+#define VSE_KDF_MEMORY_NBYTES ((size_t)64 << 20)
+
+typedef struct vse_ctx vse_ctx_t;
+
+/**
+ * Bytes needed for a context placed in caller memory by vse_ctx_init().
+ */
+size_t vse_ctx_size(void);
+
+/**
+ * Set up a context in caller-provided memory.
+ *
+ * @param mem        at least vse_ctx_size() bytes, suitably aligned for any
+ *                   object (e.g. from malloc or an aligned static buffer).
+ * @return ctx or NULL if mem is too small.
+ */
+vse_ctx_t *vse_ctx_init(void *mem, size_t mem_nbytes);
+
+/**
+ * Allocate and set up a context. The only allocation made by the library
+ * besides Argon2's working memory.
+ */
+vse_ctx_t *vse_ctx_new(void);
+
+/**
+ * Wipe the key material. Also frees the context if it came from vse_ctx_new().
+ */
+void vse_ctx_free(vse_ctx_t *ctx);
+
+/**
+ * Give the KDF caller-owned working memory (at least VSE_KDF_MEMORY_NBYTES)
+ * instead of letting Argon2 allocate it on every vse_*_init(). The memory
+ * must outlive the context; it is wiped after each use.
+ */
+void vse_ctx_set_kdf_memory(vse_ctx_t *ctx, void *mem, size_t mem_nbytes);
+
+/**
+ * Last error code (0 if none) and a human readable message ("" if none).
+ */
+int vse_ctx_error(const vse_ctx_t *ctx);
+const char *vse_ctx_error_message(const vse_ctx_t *ctx);
+
+/**
+ * Start encrypting with a fresh random salt and iv.
+ */
+int vse_encrypt_init(vse_ctx_t *ctx, int cipher,
+                     const char *password, size_t password_nbytes);
+
+/**
+ * Encrypt nbytes from in to out. in and out may be the same buffer.
+ */
+int vse_encrypt_update(vse_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes);
+
+/**
+ * Finish encrypting and write the VSE_HEADER_LEN byte header.
+ */
+int vse_encrypt_final(vse_ctx_t *ctx, uint8_t *header, size_t header_nbytes);
+
+/**
+ * Start decrypting a stream that begins with header (VSE_HEADER_LEN bytes).
+ */
+int vse_decrypt_init(vse_ctx_t *ctx,
+                     const char *password, size_t password_nbytes,
+                     const uint8_t *header, size_t header_nbytes);
+
+/**
+ * Decrypt nbytes from in to out. in and out may be the same buffer.
+ */
+int vse_decrypt_update(vse_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t nbytes);
+
+/**
+ * Check the MAC over everything passed to vse_decrypt_update().
+ *
+ * @return 0 if authentic, ERR_DECRYPT_V1_INVALID_PASSWORD otherwise.
+ */
+int vse_decrypt_final(vse_ctx_t *ctx);
+
+#endif
@@ -0,0 +1,457 @@
+/*
+ * vsencrypt_bench -- throughput and latency of everything on the hot path.
+ *
+ * Measures every registered cipher over buffer sizes from 64 B up to 1 GiB,
+ * BLAKE2b and Poly1305, the Argon2 KDF calls, and the vsencrypt command
+ * line end to end. Results go out as one JSON document so runs can be
+ * compared across releases (see `make bench`).
+ *
+ * Usage: vsencrypt_bench [--quick] [--max-size bytes] [--cli path] [-o out.json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "vse.h"
+#include "cipher.h"
+#include "crypt_v1.h"
+#include "cpu_features.h"
+#include "chacha/poly1305.h"
+#include "argon2/src/blake2/blake2.h"
+
+#if _MSC_VER
+#include <Windows.h>
+#include <intrin.h>
+#elif VSE_X86
+#include <x86intrin.h>
+#endif
+
+#define BENCH_MIN_SIZE 64
+#define BENCH_MAX_SIZE ((size_t)1 << 30)
+#define BENCH_MAX_SAMPLES 4096
+#define BENCH_BATCH_BYTES (64 * 1024) // calls per sample for small buffers
+
+typedef struct bench_opts
+{
+    int quick;
+    size_t max_size;
+    const char *cli;
+    const char *tmpdir;
+    double budget_s; // time spent per measurement
+} bench_opts_t;
+
+typedef struct bench_result
+{
+    size_t nsamples;
+    double p50_ns;
+    double p99_ns;
+    double mean_ns;
+    double cycles; // median TSC ticks per call, 0 if unknown
+} bench_result_t;
+
+static FILE *g_out;
+static int g_first_result = 1;
+
+static double now_ns(void)
+{
+#if _MSC_VER
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static uint64_t now_cycles(void)
+{
+#if VSE_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void summarize(double *ns, double *cycles, size_t n, bench_result_t *r)
+{
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += ns[i];
+    qsort(ns, n, sizeof(double), cmp_double);
+    qsort(cycles, n, sizeof(double), cmp_double);
+    r->nsamples = n;
+    r->mean_ns = sum / (double)n;
+    r->p50_ns = ns[(n - 1) * 50 / 100];
+    r->p99_ns = ns[(n - 1) * 99 / 100];
+    r->cycles = cycles[(n - 1) * 50 / 100];
+}
+
+/*
+ * Time fn(arg, buf, nbytes) until the budget is spent. Small buffers are
+ * timed in batches so that the clock does not dominate.
+ */
+typedef void (*bench_fn)(void *arg, uint8_t *buf, size_t nbytes);
+
+static void bench_run(const bench_opts_t *opts, bench_fn fn, void *arg,
+                      uint8_t *buf, size_t nbytes, size_t min_samples, bench_result_t *r)
+{
+    static double ns[BENCH_MAX_SAMPLES];
+    static double cycles[BENCH_MAX_SAMPLES];
+    size_t batch = nbytes >= BENCH_BATCH_BYTES ? 1 : BENCH_BATCH_BYTES / nbytes;
+    size_t n = 0;
+
+    fn(arg, buf, nbytes); // warm up caches and page in buf
+
+    double deadline = now_ns() + opts->budget_s * 1e9;
+    while (n < BENCH_MAX_SAMPLES && (n < min_samples || now_ns() < deadline))
+    {
+        uint64_t c0 = now_cycles();
+        double t0 = now_ns();
+        for (size_t i = 0; i < batch; i++)
+            fn(arg, buf, nbytes);
+        double t1 = now_ns();
+        uint64_t c1 = now_cycles();
+        ns[n] = (t1 - t0) / (double)batch;
+        cycles[n] = (double)(c1 - c0) / (double)batch;
+        n++;
+    }
+
+    summarize(ns, cycles, n, r);
+}
+
+static void json_result(const char *group, const char *name, size_t nbytes, const bench_result_t *r)
+{
+    fprintf(g_out, "%s\n    {\"group\": \"%s\", \"name\": \"%s\", ", g_first_result ? "" : ",", group, name);
+    g_first_result = 0;
+    if (nbytes > 0)
+    {
+        fprintf(g_out, "\"bytes\": %zu, \"mb_per_s\": %.2f, ", nbytes, (double)nbytes * 1e3 / r->p50_ns);
+        if (r->cycles > 0)
+            fprintf(g_out, "\"cycles_per_byte\": %.3f, ", r->cycles / (double)nbytes);
+        else
+            fprintf(g_out, "\"cycles_per_byte\": null, ");
+    }
+    fprintf(g_out, "\"samples\": %zu, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"mean_ns\": %.0f}",
+            r->nsamples, r->p50_ns, r->p99_ns, r->mean_ns);
+    fflush(g_out);
+
+    if (nbytes > 0)
+        fprintf(stderr, "%-6s %-24s %10zu B  p50 %12.0f ns  %9.2f MB/s\n",
+                group, name, nbytes, r->p50_ns, (double)nbytes * 1e3 / r->p50_ns);
+    else
+        fprintf(stderr, "%-6s %-24s %12s  p50 %12.0f ns\n", group, name, "", r->p50_ns);
+}
+
+static size_t min_samples_for(size_t nbytes)
+{
+    return nbytes >= ((size_t)256 << 20) ? 3 : 5;
+}
+
+/*
+ * Ciphers, straight from the registry: singles and cascades alike.
+ */
+typedef struct bench_cipher
+{
+    vse_cipher_ctx_t ctx;
+    vse_file_hash_t hash; // fresh from hash_init
+    const vse_cipher_t *cipher;
+} bench_cipher_t;
+
+static void bench_cipher_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    bench_cipher_t *c = arg;
+    c->cipher->xcrypt(&c->ctx, buf, nbytes);
+}
+
+// Encrypt and file hash, as a file gets them: one pass for AEAD ciphers.
+static void bench_seal_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    bench_cipher_t *c = arg;
+    vse_file_hash_t hash = c->hash;
+    uint8_t file_hash[FILE_HASH_LEN];
+    c->cipher->seal(&c->ctx, &hash, buf, nbytes);
+    c->cipher->hash_final(&hash, file_hash);
+}
+
+static void bench_ciphers(const bench_opts_t *opts, uint8_t *buf)
+{
+    uint8_t key[KEY_LEN];
+    uint8_t iv[IV_LEN];
+    memset(key, 0x11, sizeof(key));
+    memset(iv, 0x22, sizeof(iv));
+
+    for (size_t i = 0; vse_cipher_at(i) != NULL; i++)
+    {
+        bench_cipher_t arg;
+        arg.cipher = vse_cipher_at(i);
+        if (arg.cipher->setup(&arg.ctx, iv, IV_LEN, key, KEY_LEN) != 0 ||
+            arg.cipher->hash_init(&arg.hash, iv, IV_LEN, key, KEY_LEN) != 0)
+        {
+            fprintf(stderr, "warning: cannot set up %s, skipping\n", arg.cipher->name);
+            continue;
+        }
+
+        for (size_t n = BENCH_MIN_SIZE; n <= opts->max_size; n *= 16)
+        {
+            bench_result_t r;
+            bench_run(opts, bench_cipher_fn, &arg, buf, n, min_samples_for(n), &r);
+            json_result("cipher", arg.cipher->name, n, &r);
+        }
+        for (size_t n = BENCH_MIN_SIZE; n <= opts->max_size; n *= 16)
+        {
+            bench_result_t r;
+            bench_run(opts, bench_seal_fn, &arg, buf, n, min_samples_for(n), &r);
+            json_result("seal", arg.cipher->name, n, &r);
+        }
+    }
+}
+
+/*
+ * Hash and MAC.
+ */
+static void bench_blake2b_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    uint8_t hash[FILE_HASH_LEN];
+    blake2b_state state;
+    (void)arg;
+    blake2b_init_key(&state, FILE_HASH_LEN, buf, IV_LEN);
+    blake2b_update(&state, buf, nbytes);
+    blake2b_final(&state, hash, FILE_HASH_LEN);
+}
+
+static void bench_poly1305_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    uint8_t mac[POLY1305_TAGLEN];
+    poly1305_auth(mac, buf, nbytes, arg);
+}
+
+static void bench_hashes(const bench_opts_t *opts, uint8_t *buf)
+{
+    uint8_t key[KEY_LEN];
+    memset(key, 0x33, sizeof(key));
+
+    for (size_t n = BENCH_MIN_SIZE; n <= opts->max_size; n *= 16)
+    {
+        bench_result_t r;
+        bench_run(opts, bench_blake2b_fn, NULL, buf, n, min_samples_for(n), &r);
+        json_result("hash", "blake2b", n, &r);
+    }
+    for (size_t n = BENCH_MIN_SIZE; n <= opts->max_size; n *= 16)
+    {
+        bench_result_t r;
+        bench_run(opts, bench_poly1305_fn, key, buf, n, min_samples_for(n), &r);
+        json_result("mac", "poly1305", n, &r);
+    }
+}
+
+/*
+ * KDF: one call per sample.
+ */
+static void bench_gen_key_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    uint8_t key[KEY_LEN];
+    (void)arg;
+    vse_gen_key_v1(buf, SALT_LEN, "benchmark", 9, KEY_LEN, key);
+    (void)nbytes;
+}
+
+static void bench_gen_iv_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    uint8_t iv[IV_LEN];
+    (void)arg;
+    vse_gen_iv_v1(buf, IV_LEN, (const uint8_t *)"chacha", 6, IV_LEN, iv);
+    (void)nbytes;
+}
+
+static void bench_kdf(const bench_opts_t *opts, uint8_t *buf)
+{
+    bench_result_t r;
+    // The fns ignore nbytes; BENCH_BATCH_BYTES makes it one call per sample.
+    bench_run(opts, bench_gen_key_fn, NULL, buf, BENCH_BATCH_BYTES, opts->quick ? 3 : 10, &r);
+    json_result("kdf", "vse_gen_key_v1", 0, &r);
+    bench_run(opts, bench_gen_iv_fn, NULL, buf, BENCH_BATCH_BYTES, opts->quick ? 20 : 100, &r);
+    json_result("kdf", "vse_gen_iv_v1", 0, &r);
+}
+
+/*
+ * End to end: the vsencrypt binary on a real file, process start-up, KDF,
+ * temp file and rename included.
+ */
+typedef struct bench_cli
+{
+    char cmd[2048];
+} bench_cli_t;
+
+static void bench_cli_fn(void *arg, uint8_t *buf, size_t nbytes)
+{
+    bench_cli_t *cli = arg;
+    (void)buf;
+    (void)nbytes;
+    if (system(cli->cmd) != 0)
+        fprintf(stderr, "warning: \"%s\" failed\n", cli->cmd);
+}
+
+static int write_file(const char *path, const uint8_t *buf, size_t nbytes)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    size_t n = fwrite(buf, 1, nbytes, fp);
+    fclose(fp);
+    return n == nbytes ? 0 : -1;
+}
+
+static void bench_end_to_end(const bench_opts_t *opts, uint8_t *buf)
+{
+    static const size_t sizes[] = {(size_t)1 << 20, (size_t)64 << 20};
+    char plain[512], enc[512], dec[512];
+    bench_opts_t e2e = *opts;
+    e2e.budget_s = 0; // min samples only, each run costs a KDF
+
+    snprintf(plain, sizeof(plain), "%s/bench.plain", opts->tmpdir);
+    snprintf(enc, sizeof(enc), "%s/bench.vse", opts->tmpdir);
+    snprintf(dec, sizeof(dec), "%s/bench.dec", opts->tmpdir);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        size_t n = sizes[s];
+        if (n > opts->max_size || (opts->quick && s > 0))
+            break;
+        if (write_file(plain, buf, n) != 0)
+        {
+            fprintf(stderr, "warning: cannot write %s, skipping end-to-end\n", plain);
+            return;
+        }
+
+        for (size_t i = 0; vse_cipher_at(i) != NULL; i++)
+        {
+            const char *name = vse_cipher_at(i)->name;
+            bench_cli_t cli;
+            bench_result_t r;
+            char label[64];
+
+            snprintf(cli.cmd, sizeof(cli.cmd), "\"%s\" -q -f -e -c %s -i \"%s\" -o \"%s\" -p benchmark",
+                     opts->cli, name, plain, enc);
+            bench_run(&e2e, bench_cli_fn, &cli, buf, BENCH_BATCH_BYTES, opts->quick ? 1 : 3, &r);
+            snprintf(label, sizeof(label), "encrypt_%s", name);
+            json_result("e2e", label, n, &r);
+
+            snprintf(cli.cmd, sizeof(cli.cmd), "\"%s\" -q -f -d -i \"%s\" -o \"%s\" -p benchmark",
+                     opts->cli, enc, dec);
+            bench_run(&e2e, bench_cli_fn, &cli, buf, BENCH_BATCH_BYTES, opts->quick ? 1 : 3, &r);
+            snprintf(label, sizeof(label), "decrypt_%s", name);
+            json_result("e2e", label, n, &r);
+        }
+    }
+
+    remove(plain);
+    remove(enc);
+    remove(dec);
+}
+
+static void json_header(void)
+{
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+    uint32_t features = vse_cpu_features();
+
+    fprintf(g_out, "{\n  \"timestamp\": %lld,\n", (long long)time(NULL));
+    fprintf(g_out, "  \"cpu\": {\"tier\": \"%s\", \"features\": [", vse_cpu_tier_name(vse_cpu_tier()));
+    for (int i = 0, first = 1; vse_cpu_feature_name(i) != NULL; i++)
+    {
+        if (features & (1u << i))
+        {
+            fprintf(g_out, "%s\"%s\"", first ? "" : ", ", vse_cpu_feature_name(i));
+            first = 0;
+        }
+    }
+    fprintf(g_out, "], \"impl\": {");
+    for (int i = 0; i < VSE_PRIM_COUNT; i++)
+        fprintf(g_out, "%s\"%s\": \"%s\"", i ? ", " : "", vse_primitive_name((vse_primitive_t)i), dispatch->impl[i]);
+    fprintf(g_out, "}},\n  \"results\": [");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--quick] [--max-size bytes] [--cli path] [--tmpdir dir] [-o out.json]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_opts_t opts;
+    const char *outfile = NULL;
+
+    opts.quick = 0;
+    opts.max_size = BENCH_MAX_SIZE;
+    opts.cli = "./vsencrypt";
+    opts.tmpdir = "tmp";
+    opts.budget_s = 0.5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+        {
+            opts.quick = 1;
+            opts.max_size = (size_t)4 << 20;
+            opts.budget_s = 0.05;
+        }
+        else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+            opts.max_size = (size_t)strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--cli") == 0 && i + 1 < argc)
+            opts.cli = argv[++i];
+        else if (strcmp(argv[i], "--tmpdir") == 0 && i + 1 < argc)
+            opts.tmpdir = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outfile = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.max_size < BENCH_MIN_SIZE)
+        opts.max_size = BENCH_MIN_SIZE;
+    if (opts.max_size > BENCH_MAX_SIZE)
+        opts.max_size = BENCH_MAX_SIZE;
+
+    uint8_t *buf = malloc(opts.max_size);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "Error: cannot allocate %zu bytes\n", opts.max_size);
+        return 1;
+    }
+    for (size_t i = 0; i < opts.max_size; i++)
+        buf[i] = (uint8_t)(i * 131 + 17);
+
+    g_out = outfile != NULL ? fopen(outfile, "w") : stdout;
+    if (g_out == NULL)
+    {
+        fprintf(stderr, "Error: cannot open %s\n", outfile);
+        free(buf);
+        return 1;
+    }
+
+    json_header();
+    bench_ciphers(&opts, buf);
+    bench_hashes(&opts, buf);
+    bench_kdf(&opts, buf);
+    bench_end_to_end(&opts, buf);
+    fprintf(g_out, "\n  ]\n}\n");
+
+    if (g_out != stdout)
+        fclose(g_out);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,885 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "vsencrypt.h"
+#include "cpu_features.h"
+#include "lanes.h"
+#include "crypto_random.h"
+#include "cipher.h"
+#include "gcm.h"
+#include "aegis256.h"
+#include "xchacha20poly1305.h"
+#include "timing.h"
+
+#if __linux
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#define PASSWORD "secret123"
+
+static const int g_ciphers[] = {
+    CIPHER_SALSA20,
+    CIPHER_CHACHA20,
+    CIPHER_AES_256_CTR,
+    CIPHER_AES_256_CTR_CHACHA20,
+    CIPHER_CHACHA20_AES_256_CTR,
+    CIPHER_AES_256_CTR_SALSA20,
+    CIPHER_SALSA20_AES_256_CTR,
+    CIPHER_AES_256_GCM,
+    CIPHER_AEGIS_256,
+    CIPHER_XCHACHA20_POLY1305,
+};
+
+static const char *g_cipher_names[] = {
+    "salsa20",
+    "chacha20",
+    "aes256",
+    "aes256_chacha20",
+    "chacha20_aes256",
+    "aes256_salsa20",
+    "salsa20_aes256",
+    "aes256gcm",
+    "aegis256",
+    "xchacha20poly1305",
+};
+
+// Deliberately odd update sizes, to cross block boundaries every way.
+static const size_t g_chunks[] = {1, 7, 63, 64, 65, 100, 1000, 4096};
+
+static uint8_t *read_file(const char *path, size_t *nbytes)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    *nbytes = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = malloc(*nbytes + 1);
+    if (fread(buf, 1, *nbytes, fp) != *nbytes)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+static int decrypt_chunked(vse_ctx_t *ctx, const uint8_t *in, size_t in_nbytes,
+                           uint8_t *out, int chunk_offset)
+{
+    int ret = vse_decrypt_init(ctx, PASSWORD, strlen(PASSWORD), in, in_nbytes);
+    if (ret != 0)
+        return ret;
+
+    size_t pos = VSE_HEADER_LEN;
+    for (int i = chunk_offset; pos < in_nbytes; i++)
+    {
+        size_t n = g_chunks[i % (sizeof(g_chunks) / sizeof(g_chunks[0]))];
+        if (n > in_nbytes - pos)
+            n = in_nbytes - pos;
+        ret = vse_decrypt_update(ctx, in + pos, out + pos - VSE_HEADER_LEN, n);
+        if (ret != 0)
+            return ret;
+        pos += n;
+    }
+
+    return vse_decrypt_final(ctx);
+}
+
+// Files written by the CLI must decrypt through the library, in any chunking.
+static int test_decrypt_existing_files(void)
+{
+    int failed = 0;
+    vse_ctx_t *ctx = vse_ctx_new();
+
+    size_t plain_nbytes;
+    uint8_t *plain = read_file("testfiles/1kv1", &plain_nbytes);
+    if (plain == NULL)
+    {
+        printf("FAIL: cannot read testfiles/1kv1\n");
+        return 1;
+    }
+
+    for (size_t c = 0; c < sizeof(g_ciphers) / sizeof(g_ciphers[0]); c++)
+    {
+        char path[128];
+        size_t enc_nbytes;
+        snprintf(path, sizeof(path), "testfiles/1kv1.%s.vse", g_cipher_names[c]);
+        uint8_t *enc = read_file(path, &enc_nbytes);
+        uint8_t *out = malloc(enc_nbytes);
+
+        int ret = enc == NULL ? -1 : decrypt_chunked(ctx, enc, enc_nbytes, out, (int)c);
+        if (ret != 0 || enc_nbytes - VSE_HEADER_LEN != plain_nbytes ||
+            memcmp(out, plain, plain_nbytes) != 0)
+        {
+            printf("FAIL: decrypt %s: %d %s\n", path, ret, vse_ctx_error_message(ctx));
+            failed++;
+        }
+        free(out);
+        free(enc);
+    }
+
+    free(plain);
+    vse_ctx_free(ctx);
+    printf("%s: decrypt existing files\n", failed ? "FAIL" : "SUCCESS");
+    return failed;
+}
+
+// Encrypt and decrypt with different chunkings, in caller-owned memory.
+static int test_round_trip(void)
+{
+    int failed = 0;
+    const size_t plain_nbytes = 10000;
+    uint8_t *plain = malloc(plain_nbytes);
+    uint8_t *enc = malloc(VSE_HEADER_LEN + plain_nbytes);
+    uint8_t *dec = malloc(plain_nbytes);
+    void *ctx_mem = malloc(vse_ctx_size());
+    void *kdf_mem = malloc(VSE_KDF_MEMORY_NBYTES);
+
+    for (size_t i = 0; i < plain_nbytes; i++)
+        plain[i] = (uint8_t)(i * 31 + 7);
+
+    vse_ctx_t *ctx = vse_ctx_init(ctx_mem, vse_ctx_size());
+    vse_ctx_set_kdf_memory(ctx, kdf_mem, VSE_KDF_MEMORY_NBYTES);
+
+    for (size_t c = 0; c < sizeof(g_ciphers) / sizeof(g_ciphers[0]); c++)
+    {
+        int ret = vse_encrypt_init(ctx, g_ciphers[c], PASSWORD, strlen(PASSWORD));
+        size_t pos = 0;
+        for (int i = (int)c + 3; ret == 0 && pos < plain_nbytes; i++)
+        {
+            size_t n = g_chunks[i % (sizeof(g_chunks) / sizeof(g_chunks[0]))];
+            if (n > plain_nbytes - pos)
+                n = plain_nbytes - pos;
+            // in-place on every other chunk
+            if (i % 2)
+            {
+                memcpy(enc + VSE_HEADER_LEN + pos, plain + pos, n);
+                ret = vse_encrypt_update(ctx, enc + VSE_HEADER_LEN + pos, enc + VSE_HEADER_LEN + pos, n);
+            }
+            else
+            {
+                ret = vse_encrypt_update(ctx, plain + pos, enc + VSE_HEADER_LEN + pos, n);
+            }
+            pos += n;
+        }
+        if (ret == 0)
+            ret = vse_encrypt_final(ctx, enc, VSE_HEADER_LEN);
+
+        if (ret == 0)
+            ret = decrypt_chunked(ctx, enc, VSE_HEADER_LEN + plain_nbytes, dec, (int)c);
+
+        if (ret != 0 || memcmp(plain, dec, plain_nbytes) != 0)
+        {
+            printf("FAIL: round trip %s: %d %s\n", g_cipher_names[c], ret, vse_ctx_error_message(ctx));
+            failed++;
+            continue;
+        }
+
+        // A flipped ciphertext bit must be caught by decrypt_final().
+        enc[VSE_HEADER_LEN + plain_nbytes / 2] ^= 1;
+        ret = decrypt_chunked(ctx, enc, VSE_HEADER_LEN + plain_nbytes, dec, 0);
+        if (ret != ERR_DECRYPT_V1_INVALID_PASSWORD)
+        {
+            printf("FAIL: tampered %s not detected: %d\n", g_cipher_names[c], ret);
+            failed++;
+        }
+    }
+
+    vse_ctx_free(ctx);
+    free(kdf_mem);
+    free(ctx_mem);
+    free(dec);
+    free(enc);
+    free(plain);
+    printf("%s: round trip\n", failed ? "FAIL" : "SUCCESS");
+    return failed;
+}
+
+static int test_errors(void)
+{
+    int failed = 0;
+    uint8_t buf[VSE_HEADER_LEN] = {0};
+    vse_ctx_t *ctx = vse_ctx_new();
+
+    if (vse_encrypt_update(ctx, buf, buf, sizeof(buf)) != ERR_LIB_BAD_STATE)
+        failed++;
+    if (vse_encrypt_init(ctx, CIPHER_UNKNOWN, PASSWORD, strlen(PASSWORD)) != ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER)
+        failed++;
+    if (vse_ctx_error(ctx) != ERR_ENCRYPT_V1_STREAM_CRYPT_INVALID_CIPHER || vse_ctx_error_message(ctx)[0] == 0)
+        failed++;
+    buf[0] = 2;
+    if (vse_decrypt_init(ctx, PASSWORD, strlen(PASSWORD), buf, sizeof(buf)) != ERR_DECRYPT_FILE_INVALID_VERSION)
+        failed++;
+    if (vse_ctx_init(buf, 1) != NULL)
+        failed++;
+
+    vse_ctx_free(ctx);
+    printf("%s: errors\n", failed ? "FAIL" : "SUCCESS");
+    return failed;
+}
+
+// The dispatched kernels must match the portable code, call for call.
+static int test_kernels(void)
+{
+    int failed = 0;
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+    uint8_t key[AES_KEYLEN];
+    uint8_t iv[AES_BLOCKLEN];
+    uint8_t a[600];
+    uint8_t b[600];
+    aes_ctx_t ref;
+    aes_ctx_t fast;
+
+    for (size_t i = 0; i < sizeof(key); i++)
+        key[i] = (uint8_t)(i * 13 + 1);
+    // counter about to carry out of the low 64 bits
+    memset(iv, 0xff, sizeof(iv));
+    iv[0] = 0x42;
+    iv[7] = 0x00;
+    AES_init_ctx_iv(&ref, key, iv);
+    AES_init_ctx_iv(&fast, key, iv);
+
+    for (size_t n = 0; n <= sizeof(a); n += 37)
+    {
+        for (size_t i = 0; i < n; i++)
+            a[i] = b[i] = (uint8_t)(i ^ n);
+        AES_CTR_xcrypt_buffer(&ref, a, n);
+        dispatch->aes_ctr_xcrypt(&fast, b, n);
+        if (memcmp(a, b, n) != 0 || memcmp(ref.Iv, fast.Iv, AES_BLOCKLEN) != 0)
+        {
+            printf("FAIL: aes256 %s kernel, %d bytes\n", dispatch->impl[VSE_PRIM_AES], (int)n);
+            failed++;
+            break;
+        }
+    }
+
+    // ChaCha20 and Salsa20 block counters carry from the low word into the
+    // high one: one call across the carry matches block-by-block calls.
+    chacha_ctx_t chacha;
+    salsa20_ctx_t salsa20;
+    chacha_keysetup(&chacha, key, 256);
+    chacha_ivsetup(&chacha, iv, NULL);
+    salsa20_keysetup(&salsa20, key, 256, 64);
+    salsa20_ivsetup(&salsa20, iv);
+    for (int k = 0; k < 2; k++)
+    {
+        uint32_t *ctr = k == 0 ? &chacha.input[12] : &salsa20.input[8];
+        ctr[0] = 0xfffffffe;
+        ctr[1] = 7;
+        memset(a, 0, sizeof(a));
+        memset(b, 0, sizeof(b));
+        for (size_t off = 0; off < sizeof(a); off += 64)
+        {
+            uint64_t block = 0x7fffffffeull + off / 64;
+            size_t n = sizeof(a) - off < 64 ? sizeof(a) - off : 64;
+            chacha_ctx_t c1 = chacha;
+            salsa20_ctx_t s1 = salsa20;
+            uint32_t *c = k == 0 ? &c1.input[12] : &s1.input[8];
+            c[0] = (uint32_t)block;
+            c[1] = (uint32_t)(block >> 32);
+            if (k == 0)
+                chacha_xcrypt_bytes(&c1, a + off, a + off, n);
+            else
+                salsa20_xcrypt_bytes(&s1, a + off, a + off, n);
+        }
+        if (k == 0)
+            dispatch->chacha20_xcrypt(&chacha, b, b, sizeof(b));
+        else
+            dispatch->salsa20_xcrypt(&salsa20, b, b, sizeof(b));
+        if (memcmp(a, b, sizeof(a)) != 0 || ctr[0] != 8 || ctr[1] != 8)
+        {
+            printf("FAIL: %s counter carry\n", k == 0 ? "chacha20" : "salsa20");
+            failed++;
+        }
+    }
+
+    printf("%s: kernels (tier %s)\n", failed ? "FAIL" : "SUCCESS", vse_cpu_tier_name(vse_cpu_tier()));
+    return failed;
+}
+
+static void from_hex(const char *hex, uint8_t *out)
+{
+    for (size_t i = 0; hex[2 * i] != 0; i++)
+    {
+        unsigned int b;
+        sscanf(hex + 2 * i, "%2x", &b);
+        out[i] = (uint8_t)b;
+    }
+}
+
+/*
+ * AES-256 cases 13 to 16 of the GCM specification (McGrew, Viega), then
+ * the dispatched GHASH and stitched kernels against the portable ones, past
+ * the 8 blocks they aggregate.
+ */
+static int test_gcm(void)
+{
+    static const struct
+    {
+        const char *key, *nonce, *aad, *plain, *cipher, *tag;
+    } vectors[] = {
+        {"0000000000000000000000000000000000000000000000000000000000000000",
+         "000000000000000000000000", "", "", "",
+         "530f8afbc74536b9a963b4f1c4cb738b"},
+        {"0000000000000000000000000000000000000000000000000000000000000000",
+         "000000000000000000000000", "",
+         "00000000000000000000000000000000",
+         "cea7403d4d606b6e074ec5d3baf39d18",
+         "d0d1c8a799996bf0265b98b5d48ab919"},
+        {"feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+         "cafebabefacedbaddecaf888", "",
+         "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+         "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+         "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+         "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad",
+         "b094dac5d93471bdec1a502270e3cc6c"},
+        {"feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+         "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+         "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+         "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+         "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+         "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+         "76fc6ece0f4e1768cddf8853bb2d551b"},
+    };
+    int failed = 0;
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++)
+    {
+        uint8_t key[32], nonce[VSE_GCM_NONCE_LEN], aad[20], buf[64], expect[64];
+        uint8_t tag[VSE_GCM_TAG_LEN], expect_tag[VSE_GCM_TAG_LEN];
+        size_t aad_nbytes = strlen(vectors[v].aad) / 2;
+        size_t nbytes = strlen(vectors[v].plain) / 2;
+        vse_gcm_t gcm;
+        aes_ctx_t aes;
+
+        from_hex(vectors[v].key, key);
+        from_hex(vectors[v].nonce, nonce);
+        from_hex(vectors[v].aad, aad);
+        from_hex(vectors[v].plain, buf);
+        from_hex(vectors[v].cipher, expect);
+        from_hex(vectors[v].tag, expect_tag);
+
+        // Encrypt in two calls, the first of whole blocks.
+        size_t first = nbytes > 16 ? 16 : 0;
+        vse_gcm_init(&gcm, &aes, key, nonce, aad, aad_nbytes);
+        vse_gcm_encrypt(&gcm, &aes, buf, first);
+        vse_gcm_encrypt(&gcm, &aes, buf + first, nbytes - first);
+        vse_gcm_final(&gcm, tag);
+        if (memcmp(buf, expect, nbytes) != 0 || memcmp(tag, expect_tag, sizeof(tag)) != 0)
+        {
+            printf("FAIL: gcm test case %d, encrypt\n", (int)v + 13);
+            failed++;
+        }
+
+        // The tag alone, a byte at a time.
+        vse_gcm_init(&gcm, NULL, key, nonce, aad, aad_nbytes);
+        for (size_t i = 0; i < nbytes; i++)
+            vse_gcm_update(&gcm, expect + i, 1);
+        vse_gcm_final(&gcm, tag);
+        if (memcmp(tag, expect_tag, sizeof(tag)) != 0)
+        {
+            printf("FAIL: gcm test case %d, tag\n", (int)v + 13);
+            failed++;
+        }
+    }
+
+    uint8_t key[32];
+    uint8_t nonce[VSE_GCM_NONCE_LEN] = {0};
+    uint8_t a[37 * 16];
+    uint8_t b[37 * 16];
+    for (size_t i = 0; i < sizeof(key); i++)
+        key[i] = (uint8_t)(i * 7 + 3);
+    for (size_t i = 0; i < sizeof(a); i++)
+        a[i] = b[i] = (uint8_t)(i * 11);
+
+    vse_gcm_t ref, fast;
+    aes_ctx_t ref_aes, fast_aes;
+    vse_gcm_init(&ref, &ref_aes, key, nonce, NULL, 0);
+    vse_gcm_init(&fast, &fast_aes, key, nonce, NULL, 0);
+    vse_ghash_blocks(&ref, a, sizeof(a) / 16);
+    dispatch->ghash_blocks(&fast, b, sizeof(b) / 16);
+    if (memcmp(ref.x, fast.x, 16) != 0)
+    {
+        printf("FAIL: ghash %s kernel\n", dispatch->impl[VSE_PRIM_GHASH]);
+        failed++;
+    }
+    vse_gcm_encrypt_blocks(&ref, &ref_aes, a, sizeof(a) / 16);
+    dispatch->gcm_encrypt_blocks(&fast, &fast_aes, b, sizeof(b) / 16);
+    if (memcmp(a, b, sizeof(a)) != 0 || memcmp(ref.x, fast.x, 16) != 0 ||
+        memcmp(ref_aes.Iv, fast_aes.Iv, AES_BLOCKLEN) != 0)
+    {
+        printf("FAIL: aes256gcm %s kernel\n", dispatch->impl[VSE_PRIM_AES_GCM]);
+        failed++;
+    }
+
+    printf("%s: gcm (%s)\n", failed ? "FAIL" : "SUCCESS", dispatch->impl[VSE_PRIM_AES_GCM]);
+    return failed;
+}
+
+/*
+ * Test vectors of draft-irtf-cfrg-aegis-aead, AEGIS-256, then the dispatched
+ * kernels against the portable ones.
+ */
+static int test_aegis256(void)
+{
+    static const struct
+    {
+        const char *ad, *plain, *cipher, *tag;
+    } vectors[] = {
+        {"", "00000000000000000000000000000000",
+         "754fc3d8c973246dcc6d741412a4b236",
+         "1181a1d18091082bf0266f66297d167d2e68b845f61a3b0527d31fc7b7b89f13"},
+        {"", "", "",
+         "6a348c930adbd654896e1666aad67de989ea75ebaa2b82fb588977b1ffec864a"},
+        {"0001020304050607",
+         "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+         "f373079ed84b2709faee373584585d60accd191db310ef5d8b11833df9dec711",
+         "b7d28d0c3c0ebd409fd22b44160503073a547412da0854bfb9723020dab8da1a"},
+        {"0001020304050607", "000102030405060708090a0b0c0d",
+         "f373079ed84b2709faee37358458",
+         "8c1cc703c81281bee3f6d9966e14948b4a175b2efbdc31e61a98b4465235c2d9"},
+        {"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+         "20212223242526272829",
+         "101112131415161718191a1b1c1d1e1f202122232425262728292a2b2c2d2e2f"
+         "3031323334353637",
+         "57754a7d09963e7c787583a2e7b859bb24fa1e04d49fd550b2511a358e3bca25"
+         "2a9b1b8b30cc4a67",
+         "a3aca270c006094d71c20e6910b5161c0826df233d08919a566ec2c05990f734"},
+    };
+    int failed = 0;
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+    uint8_t key[VSE_AEGIS256_KEY_LEN] = {0x10, 0x01};
+    uint8_t nonce[VSE_AEGIS256_NONCE_LEN] = {0x10, 0x00, 0x02};
+
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++)
+    {
+        uint8_t ad[42], plain[40], buf[40], expect[40];
+        uint8_t tag[VSE_AEGIS256_TAG_LEN], expect_tag[VSE_AEGIS256_TAG_LEN];
+        size_t ad_nbytes = strlen(vectors[v].ad) / 2;
+        size_t nbytes = strlen(vectors[v].plain) / 2;
+        vse_aegis256_t st;
+
+        from_hex(vectors[v].ad, ad);
+        from_hex(vectors[v].plain, plain);
+        from_hex(vectors[v].cipher, expect);
+        from_hex(vectors[v].tag, expect_tag);
+
+        // Encrypt in two calls, the first ending inside a block.
+        size_t first = nbytes > 5 ? 5 : 0;
+        memcpy(buf, plain, nbytes);
+        vse_aegis256_init(&st, key, nonce, ad, ad_nbytes);
+        vse_aegis256_encrypt(&st, buf, first);
+        vse_aegis256_encrypt(&st, buf + first, nbytes - first);
+        vse_aegis256_final(&st, tag);
+        if (memcmp(buf, expect, nbytes) != 0 || memcmp(tag, expect_tag, sizeof(tag)) != 0)
+        {
+            printf("FAIL: aegis256 test vector %d, encrypt\n", (int)v + 1);
+            failed++;
+        }
+
+        // Decrypt a byte at a time.
+        vse_aegis256_init(&st, key, nonce, ad, ad_nbytes);
+        for (size_t i = 0; i < nbytes; i++)
+            vse_aegis256_decrypt(&st, buf + i, 1);
+        vse_aegis256_final(&st, tag);
+        if (memcmp(buf, plain, nbytes) != 0 || memcmp(tag, expect_tag, sizeof(tag)) != 0)
+        {
+            printf("FAIL: aegis256 test vector %d, decrypt\n", (int)v + 1);
+            failed++;
+        }
+    }
+
+    uint8_t a[37 * 16];
+    uint8_t b[37 * 16];
+    for (size_t i = 0; i < sizeof(a); i++)
+        a[i] = b[i] = (uint8_t)(i * 11);
+
+    vse_aegis256_t ref, fast;
+    vse_aegis256_init(&ref, key, nonce, NULL, 0);
+    fast = ref;
+    vse_aegis256_encrypt_blocks(&ref, a, sizeof(a) / 16);
+    dispatch->aegis256_encrypt_blocks(&fast, b, sizeof(b) / 16);
+    if (memcmp(a, b, sizeof(a)) != 0 || memcmp(ref.s, fast.s, sizeof(ref.s)) != 0)
+    {
+        printf("FAIL: aegis256 %s encrypt kernel\n", dispatch->impl[VSE_PRIM_AEGIS256]);
+        failed++;
+    }
+    vse_aegis256_decrypt_blocks(&ref, a, sizeof(a) / 16);
+    dispatch->aegis256_decrypt_blocks(&fast, b, sizeof(b) / 16);
+    if (memcmp(a, b, sizeof(a)) != 0 || memcmp(ref.s, fast.s, sizeof(ref.s)) != 0)
+    {
+        printf("FAIL: aegis256 %s decrypt kernel\n", dispatch->impl[VSE_PRIM_AEGIS256]);
+        failed++;
+    }
+
+    printf("%s: aegis256 (%s)\n", failed ? "FAIL" : "SUCCESS", dispatch->impl[VSE_PRIM_AEGIS256]);
+    return failed;
+}
+
+/*
+ * HChaCha20 and AEAD vectors of draft-irtf-cfrg-xchacha, the Poly1305 one
+ * of RFC 8439, then the dispatched Poly1305 kernel against the portable one.
+ */
+static int test_xchacha20poly1305(void)
+{
+    static const char *plain = "Ladies and Gentlemen of the class of '99: If I could offer you only one "
+                               "tip for the future, sunscreen would be it.";
+    static const char *poly_msg = "Cryptographic Forum Research Group";
+    int failed = 0;
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+    uint8_t key[32], nonce[VSE_XCHACHA20_NONCE_LEN], ad[12], buf[114], expect[114];
+    uint8_t subkey[32], expect_subkey[32];
+    uint8_t tag[VSE_XCHACHA20POLY1305_TAG_LEN], expect_tag[VSE_XCHACHA20POLY1305_TAG_LEN];
+    vse_xchacha20poly1305_t st;
+    vse_poly1305_t poly;
+    chacha_ctx_t chacha;
+
+    for (size_t i = 0; i < sizeof(key); i++)
+        key[i] = (uint8_t)i;
+    from_hex("000000090000004a0000000031415927", nonce);
+    from_hex("82413b4227b27bfed30e42508a877d73a0f9e4d58a74a853c12ec41326d3ecdc", expect_subkey);
+    vse_hchacha20(subkey, key, nonce);
+    if (memcmp(subkey, expect_subkey, sizeof(subkey)) != 0)
+    {
+        printf("FAIL: hchacha20 test vector\n");
+        failed++;
+    }
+
+    from_hex("808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f", key);
+    from_hex("404142434445464748494a4b4c4d4e4f5051525354555657", nonce);
+    from_hex("50515253c0c1c2c3c4c5c6c7", ad);
+    from_hex("bd6d179d3e83d43b9576579493c0e939572a1700252bfaccbed2902c21396cbb"
+             "731c7f1b0b4aa6440bf3a82f4eda7e39ae64c6708c54c216cb96b72e1213b452"
+             "2f8c9ba40db5d945b11b69b982c1bb9e3f3fac2bc369488f76b2383565d3fff9"
+             "21f9664c97637da9768812f615c68b13b52e",
+             expect);
+    from_hex("c0875924c1c7987947deafd8780acf49", expect_tag);
+
+    // Encrypt in two calls, the first of whole ChaCha20 blocks.
+    memcpy(buf, plain, sizeof(buf));
+    vse_xchacha20poly1305_init(&st, key, nonce, ad, sizeof(ad));
+    vse_xchacha20_init(&chacha, key, nonce);
+    vse_xchacha20poly1305_encrypt(&st, &chacha, buf, 64);
+    vse_xchacha20poly1305_encrypt(&st, &chacha, buf + 64, sizeof(buf) - 64);
+    vse_xchacha20poly1305_final(&st, tag);
+    if (memcmp(buf, expect, sizeof(buf)) != 0 || memcmp(tag, expect_tag, sizeof(tag)) != 0)
+    {
+        printf("FAIL: xchacha20poly1305 test vector, encrypt\n");
+        failed++;
+    }
+
+    // The tag alone, a byte at a time.
+    vse_xchacha20poly1305_init(&st, key, nonce, ad, sizeof(ad));
+    for (size_t i = 0; i < sizeof(expect); i++)
+        vse_xchacha20poly1305_update(&st, expect + i, 1);
+    vse_xchacha20poly1305_final(&st, tag);
+    if (memcmp(tag, expect_tag, sizeof(tag)) != 0)
+    {
+        printf("FAIL: xchacha20poly1305 test vector, tag\n");
+        failed++;
+    }
+
+    from_hex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b", key);
+    from_hex("a8061dc1305136c6c22b8baf0c0127a9", expect_tag);
+    vse_poly1305_init(&poly, key);
+    vse_poly1305_update(&poly, (const uint8_t *)poly_msg, strlen(poly_msg));
+    vse_poly1305_final(&poly, tag);
+    if (memcmp(tag, expect_tag, sizeof(tag)) != 0)
+    {
+        printf("FAIL: poly1305 test vector\n");
+        failed++;
+    }
+
+    // All ones: the largest limbs the kernels can see.
+    uint8_t a[37 * 16];
+    vse_poly1305_t ref, fast;
+    memset(key, 0xff, sizeof(key));
+    memset(a, 0xff, sizeof(a));
+    vse_poly1305_init(&ref, key);
+    fast = ref;
+    vse_poly1305_blocks(&ref, a, sizeof(a) / 16);
+    dispatch->poly1305_blocks(&fast, a, sizeof(a) / 16);
+    vse_poly1305_final(&ref, expect_tag);
+    vse_poly1305_final(&fast, tag);
+    if (memcmp(tag, expect_tag, sizeof(tag)) != 0)
+    {
+        printf("FAIL: poly1305 %s kernel\n", dispatch->impl[VSE_PRIM_POLY1305]);
+        failed++;
+    }
+
+    printf("%s: xchacha20poly1305 (%s, %s)\n", failed ? "FAIL" : "SUCCESS",
+           dispatch->impl[VSE_PRIM_CHACHA20], dispatch->impl[VSE_PRIM_POLY1305]);
+    return failed;
+}
+
+// Every lane must match its own stream run through the one-stream code.
+static int test_lane_kernels(void)
+{
+    int failed = 0;
+    const vse_dispatch_t *dispatch = vse_cpu_dispatch();
+    static const size_t lens[VSE_LANES_MAX] = {0, 1, 63, 64, 127, 128, 129, 1000};
+    uint8_t data[VSE_LANES_MAX][1000];
+    uint8_t lane[VSE_LANES_MAX][1000];
+    uint8_t key[VSE_LANES_MAX][32];
+    uint8_t hash[VSE_LANES_MAX][64];
+    uint8_t *bufs[VSE_LANES_MAX];
+    uint8_t *outs[VSE_LANES_MAX];
+    const uint8_t *keys[VSE_LANES_MAX];
+    const uint8_t *ins[VSE_LANES_MAX];
+    chacha_ctx_t chacha[VSE_LANES_MAX];
+    chacha_ctx_t *chachas[VSE_LANES_MAX];
+    salsa20_ctx_t salsa[VSE_LANES_MAX];
+    salsa20_ctx_t *salsas[VSE_LANES_MAX];
+
+    for (int k = 0; k < VSE_LANES_MAX; k++)
+    {
+        for (size_t i = 0; i < sizeof(data[k]); i++)
+            data[k][i] = (uint8_t)(i * 7 + k);
+        for (size_t i = 0; i < sizeof(key[k]); i++)
+            key[k][i] = (uint8_t)(i * 13 + k * 31 + 1);
+        bufs[k] = lane[k];
+        outs[k] = hash[k];
+        keys[k] = key[k];
+        ins[k] = lane[k];
+    }
+
+    for (int nlanes = 1; nlanes <= VSE_LANES_MAX; nlanes++)
+    {
+        // The counter is about to carry into its high word in lane 1.
+        uint8_t ctr[8] = {0xfe, 0xff, 0xff, 0xff, 0, 0, 0, 0};
+        for (int k = 0; k < nlanes; k++)
+        {
+            memcpy(lane[k], data[k], lens[k]);
+            chacha_keysetup(&chacha[k], key[k], 256);
+            chacha_ivsetup(&chacha[k], key[k] + 8, k == 1 ? ctr : NULL);
+            chachas[k] = &chacha[k];
+        }
+        dispatch->chacha20_xcrypt_lanes(chachas, bufs, lens, nlanes);
+        for (int k = 0; k < nlanes && !failed; k++)
+        {
+            chacha_ctx_t ref;
+            uint8_t expect[1000];
+            chacha_keysetup(&ref, key[k], 256);
+            chacha_ivsetup(&ref, key[k] + 8, k == 1 ? ctr : NULL);
+            chacha_xcrypt_bytes(&ref, data[k], expect, lens[k]);
+            if (memcmp(expect, lane[k], lens[k]) != 0 || memcmp(ref.input, chacha[k].input, sizeof(ref.input)) != 0)
+            {
+                printf("FAIL: chacha20 %s lanes, %d lanes, lane %d\n",
+                       dispatch->impl[VSE_PRIM_CHACHA20_LANES], nlanes, k);
+                failed++;
+            }
+        }
+
+        for (int k = 0; k < nlanes; k++)
+        {
+            memcpy(lane[k], data[k], lens[k]);
+            salsa20_keysetup(&salsa[k], key[k], 256, 64);
+            salsa20_ivsetup(&salsa[k], key[k] + 8);
+            salsas[k] = &salsa[k];
+        }
+        dispatch->salsa20_xcrypt_lanes(salsas, bufs, lens, nlanes);
+        for (int k = 0; k < nlanes && !failed; k++)
+        {
+            salsa20_ctx_t ref;
+            uint8_t expect[1000];
+            salsa20_keysetup(&ref, key[k], 256, 64);
+            salsa20_ivsetup(&ref, key[k] + 8);
+            salsa20_xcrypt_bytes(&ref, data[k], expect, lens[k]);
+            if (memcmp(expect, lane[k], lens[k]) != 0 || memcmp(ref.input, salsa[k].input, sizeof(ref.input)) != 0)
+            {
+                printf("FAIL: salsa20 %s lanes, %d lanes, lane %d\n",
+                       dispatch->impl[VSE_PRIM_SALSA20_LANES], nlanes, k);
+                failed++;
+            }
+        }
+
+        // Keyed as the file hash is, and unkeyed.
+        for (size_t keylen = 0; keylen <= 16 && !failed; keylen += 16)
+        {
+            for (int k = 0; k < nlanes; k++)
+                memcpy(lane[k], data[k], lens[k]);
+            dispatch->blake2b_lanes(outs, 16, keys, keylen, ins, lens, nlanes);
+            uint8_t expect[VSE_LANES_MAX][64];
+            uint8_t *expects[VSE_LANES_MAX];
+            for (int k = 0; k < nlanes; k++)
+                expects[k] = expect[k];
+            vse_blake2b_lanes(expects, 16, keys, keylen, ins, lens, nlanes);
+            for (int k = 0; k < nlanes && !failed; k++)
+            {
+                if (memcmp(expect[k], hash[k], 16) != 0)
+                {
+                    printf("FAIL: blake2b %s lanes, %d lanes, lane %d, key %d bytes\n",
+                           dispatch->impl[VSE_PRIM_BLAKE2B_LANES], nlanes, k, (int)keylen);
+                    failed++;
+                }
+            }
+        }
+    }
+
+    printf("%s: lane kernels (%s)\n", failed ? "FAIL" : "SUCCESS", dispatch->impl[VSE_PRIM_CHACHA20_LANES]);
+    return failed;
+}
+
+static int test_crypto_random(void)
+{
+    int failed = 0;
+    uint8_t a[32], b[32];
+    crypto_random(a, sizeof(a));
+    crypto_random(b, sizeof(b));
+    if (memcmp(a, b, sizeof(a)) == 0)
+    {
+        printf("FAIL: crypto_random repeated itself\n");
+        failed = 1;
+    }
+
+    // Buffered and direct requests, across a few reseeds: every byte value
+    // turns up about as often (256 times each, 16 standard deviation).
+    static uint8_t big[1 << 16];
+    size_t counts[256] = {0};
+    for (int round = 0; round < 3 * VSE_RANDOM_RESEED_BYTES / (int)sizeof(big); round++)
+    {
+        size_t off = 0;
+        for (size_t n = 1; off + n <= sizeof(big); n = n * 3 + 1)
+        {
+            crypto_random(big + off, n);
+            off += n;
+        }
+        crypto_random(big + off, sizeof(big) - off);
+        if (round == 0)
+        {
+            for (size_t i = 0; i < sizeof(big); i++)
+                counts[big[i]]++;
+        }
+    }
+    for (int v = 0; v < 256; v++)
+    {
+        if (counts[v] < 128 || counts[v] > 384)
+        {
+            printf("FAIL: crypto_random byte %d seen %d times in 64 KiB\n", v, (int)counts[v]);
+            failed = 1;
+            break;
+        }
+    }
+
+#if __linux
+    // A forked child must not hand out what the parent hands out next.
+    int fds[2];
+    if (pipe(fds) == 0)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            crypto_random(a, sizeof(a));
+            _exit(write(fds[1], a, sizeof(a)) == sizeof(a) ? 0 : 1);
+        }
+        crypto_random(b, sizeof(b));
+        if (pid < 0 || read(fds[0], a, sizeof(a)) != sizeof(a) || memcmp(a, b, sizeof(a)) == 0)
+        {
+            printf("FAIL: crypto_random after fork\n");
+            failed = 1;
+        }
+        if (pid > 0)
+            waitpid(pid, NULL, 0);
+        close(fds[0]);
+        close(fds[1]);
+    }
+#endif
+
+    printf("%s: crypto random\n", failed ? "FAIL" : "SUCCESS");
+    return failed;
+}
+
+#if __linux
+/*
+ * One xcrypt() call over a buffer past 4 GiB, a sparse file mapped at path:
+ * windows at the start, across 4 GiB and at the end must match the same
+ * bytes run from a seek. Slow, so only run by make test_large.
+ */
+static int test_large_buffer(const char *path)
+{
+    static const int ciphers[] = {CIPHER_CHACHA20, CIPHER_SALSA20, CIPHER_AES_256_CTR, CIPHER_AES_256_CTR_CHACHA20};
+    const size_t nbytes = (4ull << 30) + 100;
+    const size_t offsets[] = {0, (4ull << 30) - 128, (nbytes - 1) & ~(size_t)63};
+    uint8_t windows[3][256];
+    uint8_t key[KEY_LEN];
+    uint8_t iv[IV_LEN];
+    int failed = 0;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    uint8_t *buf = fd < 0 || ftruncate(fd, (off_t)nbytes) != 0
+                       ? MAP_FAILED
+                       : mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buf == MAP_FAILED)
+    {
+        printf("FAIL: cannot map %s\n", path);
+        return 1;
+    }
+    crypto_random(key, sizeof(key));
+    crypto_random(iv, sizeof(iv));
+    for (int w = 0; w < 3; w++)
+        crypto_random(buf + offsets[w], nbytes - offsets[w] < 256 ? nbytes - offsets[w] : 256);
+
+    for (size_t c = 0; c < sizeof(ciphers) / sizeof(ciphers[0]); c++)
+    {
+        const vse_cipher_t *desc = vse_cipher_find(ciphers[c]);
+        vse_cipher_ctx_t ctx;
+        for (int w = 0; w < 3; w++)
+            memcpy(windows[w], buf + offsets[w], nbytes - offsets[w] < 256 ? nbytes - offsets[w] : 256);
+
+        if (desc->setup(&ctx, iv, sizeof(iv), key, sizeof(key)) != 0)
+        {
+            printf("FAIL: %s, setup\n", desc->name);
+            failed++;
+            continue;
+        }
+        uint64_t t0 = vse_now_ns();
+        desc->xcrypt(&ctx, buf, nbytes);
+        uint64_t t1 = vse_now_ns();
+
+        for (int w = 0; w < 3; w++)
+        {
+            size_t n = nbytes - offsets[w] < 256 ? nbytes - offsets[w] : 256;
+            if (desc->setup(&ctx, iv, sizeof(iv), key, sizeof(key)) != 0)
+            {
+                printf("FAIL: %s, setup\n", desc->name);
+                failed++;
+                continue;
+            }
+            desc->seek(&ctx, offsets[w]);
+            desc->xcrypt(&ctx, windows[w], n);
+            if (memcmp(windows[w], buf + offsets[w], n) != 0)
+            {
+                printf("FAIL: %s, one call of %llu bytes, at %llu\n", desc->name,
+                       (unsigned long long)nbytes, (unsigned long long)offsets[w]);
+                failed++;
+            }
+        }
+        printf("%s: %s, one call of 4 GiB, %.1f MB/s\n", failed ? "FAIL" : "SUCCESS", desc->name,
+               nbytes / 1e6 / ((t1 - t0) / 1e9));
+    }
+
+    munmap(buf, nbytes);
+    close(fd);
+    unlink(path);
+    return failed;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+#if __linux
+    if (argc == 3 && strcmp(argv[1], "--large") == 0)
+        return test_large_buffer(argv[2]);
+#endif
+    (void)argc;
+    (void)argv;
+    return test_kernels() + test_gcm() + test_aegis256() + test_xchacha20poly1305() + test_lane_kernels() + test_crypto_random() + test_decrypt_existing_files() + test_round_trip() +
+           test_errors();
+}
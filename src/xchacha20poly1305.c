@@ -0,0 +1,404 @@
+#include <string.h>
+#include "xchacha20poly1305.h"
+#include "cpu_features.h"
+
+// Encrypted then authenticated a piece at a time, while it is in L1.
+#define VSE_XCHACHA_CHUNK 1024
+
+#define POLY1305_MASK 0x3ffffff
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+/*
+ * HChaCha20: the ChaCha20 rounds over constants, key and 16 nonce bytes,
+ * without the final addition; the subkey is words 0..3 and 12..15.
+ */
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define CHACHA_QR(a, b, c, d)         \
+    do                                \
+    {                                 \
+        a += b;                       \
+        d = ROTL32(d ^ a, 16);        \
+        c += d;                       \
+        b = ROTL32(b ^ c, 12);        \
+        a += b;                       \
+        d = ROTL32(d ^ a, 8);         \
+        c += d;                       \
+        b = ROTL32(b ^ c, 7);         \
+    } while (0)
+
+void vse_hchacha20(uint8_t *subkey, const uint8_t *key, const uint8_t *nonce)
+{
+    uint32_t x[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    for (int i = 0; i < 8; i++)
+        x[4 + i] = get_le32(key + 4 * i);
+    for (int i = 0; i < 4; i++)
+        x[12 + i] = get_le32(nonce + 4 * i);
+
+    for (int i = 0; i < 10; i++)
+    {
+        CHACHA_QR(x[0], x[4], x[8], x[12]);
+        CHACHA_QR(x[1], x[5], x[9], x[13]);
+        CHACHA_QR(x[2], x[6], x[10], x[14]);
+        CHACHA_QR(x[3], x[7], x[11], x[15]);
+        CHACHA_QR(x[0], x[5], x[10], x[15]);
+        CHACHA_QR(x[1], x[6], x[11], x[12]);
+        CHACHA_QR(x[2], x[7], x[8], x[13]);
+        CHACHA_QR(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        put_le32(subkey + 4 * i, x[i]);
+        put_le32(subkey + 16 + 4 * i, x[12 + i]);
+    }
+    memset(x, 0, sizeof(x));
+}
+
+/*
+ * Poly1305, 26-bit limbs.
+ */
+
+// Carry t, the limbs of a product, into h; h1 may stay a little over 26 bits.
+static void vse_poly1305_carry(uint32_t *h, uint64_t *t)
+{
+    t[1] += t[0] >> 26;
+    t[2] += t[1] >> 26;
+    t[3] += t[2] >> 26;
+    t[4] += t[3] >> 26;
+    uint64_t h0 = (t[0] & POLY1305_MASK) + (t[4] >> 26) * 5;
+    h[0] = (uint32_t)(h0 & POLY1305_MASK);
+    h[1] = (uint32_t)((t[1] & POLY1305_MASK) + (h0 >> 26));
+    h[2] = (uint32_t)(t[2] & POLY1305_MASK);
+    h[3] = (uint32_t)(t[3] & POLY1305_MASK);
+    h[4] = (uint32_t)(t[4] & POLY1305_MASK);
+}
+
+// h = h * r mod 2^130 - 5
+static void vse_poly1305_mul(uint32_t *h, const uint32_t *r)
+{
+    uint64_t s1 = (uint64_t)r[1] * 5;
+    uint64_t s2 = (uint64_t)r[2] * 5;
+    uint64_t s3 = (uint64_t)r[3] * 5;
+    uint64_t s4 = (uint64_t)r[4] * 5;
+    uint64_t t[5];
+
+    t[0] = (uint64_t)h[0] * r[0] + h[1] * s4 + h[2] * s3 + h[3] * s2 + h[4] * s1;
+    t[1] = (uint64_t)h[0] * r[1] + (uint64_t)h[1] * r[0] + h[2] * s4 + h[3] * s3 + h[4] * s2;
+    t[2] = (uint64_t)h[0] * r[2] + (uint64_t)h[1] * r[1] + (uint64_t)h[2] * r[0] + h[3] * s4 + h[4] * s3;
+    t[3] = (uint64_t)h[0] * r[3] + (uint64_t)h[1] * r[2] + (uint64_t)h[2] * r[1] + (uint64_t)h[3] * r[0] + h[4] * s4;
+    t[4] = (uint64_t)h[0] * r[4] + (uint64_t)h[1] * r[3] + (uint64_t)h[2] * r[2] + (uint64_t)h[3] * r[1] + (uint64_t)h[4] * r[0];
+    vse_poly1305_carry(h, t);
+}
+
+// h += block, hibit is the 2^128 bit of a whole block
+static void vse_poly1305_add(uint32_t *h, const uint8_t *block, uint32_t hibit)
+{
+    uint32_t t0 = get_le32(block);
+    uint32_t t1 = get_le32(block + 4);
+    uint32_t t2 = get_le32(block + 8);
+    uint32_t t3 = get_le32(block + 12);
+
+    h[0] += t0 & POLY1305_MASK;
+    h[1] += (uint32_t)((((uint64_t)t1 << 32) | t0) >> 26) & POLY1305_MASK;
+    h[2] += (uint32_t)((((uint64_t)t2 << 32) | t1) >> 20) & POLY1305_MASK;
+    h[3] += (uint32_t)((((uint64_t)t3 << 32) | t2) >> 14) & POLY1305_MASK;
+    h[4] += (t3 >> 8) | hibit;
+}
+
+void vse_poly1305_blocks(vse_poly1305_t *st, const uint8_t *in, size_t nblocks)
+{
+    for (; nblocks > 0; nblocks--, in += 16)
+    {
+        vse_poly1305_add(st->h, in, 1 << 24);
+        vse_poly1305_mul(st->h, st->r[0]);
+    }
+}
+
+void vse_poly1305_init(vse_poly1305_t *st, const uint8_t *key)
+{
+    uint32_t t0 = get_le32(key);
+    uint32_t t1 = get_le32(key + 4);
+    uint32_t t2 = get_le32(key + 8);
+    uint32_t t3 = get_le32(key + 12);
+
+    memset(st, 0, sizeof(vse_poly1305_t));
+    // clamped
+    st->r[0][0] = t0 & 0x3ffffff;
+    st->r[0][1] = ((t0 >> 26) | (t1 << 6)) & 0x3ffff03;
+    st->r[0][2] = ((t1 >> 20) | (t2 << 12)) & 0x3ffc0ff;
+    st->r[0][3] = ((t2 >> 14) | (t3 << 18)) & 0x3f03fff;
+    st->r[0][4] = (t3 >> 8) & 0x00fffff;
+    for (int k = 1; k < 4; k++)
+    {
+        memcpy(st->r[k], st->r[k - 1], sizeof(st->r[k]));
+        vse_poly1305_mul(st->r[k], st->r[0]);
+    }
+
+    for (int i = 0; i < 4; i++)
+        st->pad[i] = get_le32(key + 16 + 4 * i);
+}
+
+void vse_poly1305_update(vse_poly1305_t *st, const uint8_t *buf, size_t nbytes)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+
+    if (st->buf_len > 0)
+    {
+        size_t n = 16 - st->buf_len;
+        if (n > nbytes)
+            n = nbytes;
+        memcpy(st->buf + st->buf_len, buf, n);
+        st->buf_len += n;
+        buf += n;
+        nbytes -= n;
+        if (st->buf_len < 16)
+            return;
+        kern->poly1305_blocks(st, st->buf, 1);
+        st->buf_len = 0;
+    }
+
+    size_t nblocks = nbytes / 16;
+    kern->poly1305_blocks(st, buf, nblocks);
+    buf += nblocks * 16;
+    nbytes -= nblocks * 16;
+
+    memcpy(st->buf, buf, nbytes);
+    st->buf_len = nbytes;
+}
+
+void vse_poly1305_final(vse_poly1305_t *st, uint8_t *tag)
+{
+    uint32_t *h = st->h;
+    uint32_t g[5];
+    uint32_t c;
+
+    // A partial last block ends in a 1 byte instead of the 2^128 bit.
+    if (st->buf_len > 0)
+    {
+        st->buf[st->buf_len] = 1;
+        memset(st->buf + st->buf_len + 1, 0, 15 - st->buf_len);
+        vse_poly1305_add(h, st->buf, 0);
+        vse_poly1305_mul(h, st->r[0]);
+    }
+
+    // Fully carry h, then take h - p if h >= p.
+    c = h[1] >> 26;
+    h[1] &= POLY1305_MASK;
+    for (int i = 2; i < 5; i++)
+    {
+        h[i] += c;
+        c = h[i] >> 26;
+        h[i] &= POLY1305_MASK;
+    }
+    h[0] += c * 5;
+    c = h[0] >> 26;
+    h[0] &= POLY1305_MASK;
+    h[1] += c;
+
+    g[0] = h[0] + 5;
+    c = g[0] >> 26;
+    g[0] &= POLY1305_MASK;
+    for (int i = 1; i < 4; i++)
+    {
+        g[i] = h[i] + c;
+        c = g[i] >> 26;
+        g[i] &= POLY1305_MASK;
+    }
+    g[4] = h[4] + c - (1 << 26);
+
+    uint32_t mask = (g[4] >> 31) - 1; // all ones if h >= p
+    for (int i = 0; i < 5; i++)
+        h[i] = (h[i] & ~mask) | (g[i] & mask);
+
+    // h mod 2^128, plus s
+    uint64_t f;
+    f = (uint64_t)(h[0] | (h[1] << 26)) + st->pad[0];
+    put_le32(tag, (uint32_t)f);
+    f = (uint64_t)((h[1] >> 6) | (h[2] << 20)) + st->pad[1] + (f >> 32);
+    put_le32(tag + 4, (uint32_t)f);
+    f = (uint64_t)((h[2] >> 12) | (h[3] << 14)) + st->pad[2] + (f >> 32);
+    put_le32(tag + 8, (uint32_t)f);
+    f = (uint64_t)((h[3] >> 18) | (h[4] << 8)) + st->pad[3] + (f >> 32);
+    put_le32(tag + 12, (uint32_t)f);
+
+    memset(st, 0, sizeof(vse_poly1305_t));
+}
+
+/*
+ * XChaCha20-Poly1305.
+ */
+
+void vse_xchacha20_init(chacha_ctx_t *chacha, const uint8_t *key, const uint8_t *nonce)
+{
+    static const uint8_t one[CHACHA_CTRLEN] = {1};
+    uint8_t subkey[32];
+
+    vse_hchacha20(subkey, key, nonce);
+    chacha_keysetup(chacha, subkey, 256);
+    chacha_ivsetup(chacha, nonce + 16, one);
+    memset(subkey, 0, sizeof(subkey));
+}
+
+// Zero-pad what was authenticated so far to a whole block.
+static void vse_xchacha20poly1305_pad(vse_xchacha20poly1305_t *st, uint64_t nbytes)
+{
+    static const uint8_t zeros[16] = {0};
+    if (nbytes % 16 != 0)
+        vse_poly1305_update(&st->poly, zeros, 16 - nbytes % 16);
+}
+
+void vse_xchacha20poly1305_init(vse_xchacha20poly1305_t *st,
+                                const uint8_t *key,
+                                const uint8_t *nonce,
+                                const uint8_t *ad, size_t ad_nbytes)
+{
+    chacha_ctx_t chacha;
+    uint8_t subkey[32];
+    uint8_t block0[CHACHA_BLOCKLEN] = {0};
+
+    vse_hchacha20(subkey, key, nonce);
+    chacha_keysetup(&chacha, subkey, 256);
+    chacha_ivsetup(&chacha, nonce + 16, NULL);
+    chacha_xcrypt_bytes(&chacha, block0, block0, sizeof(block0));
+    vse_poly1305_init(&st->poly, block0);
+    memset(subkey, 0, sizeof(subkey));
+    memset(block0, 0, sizeof(block0));
+    memset(&chacha, 0, sizeof(chacha));
+
+    vse_poly1305_update(&st->poly, ad, ad_nbytes);
+    vse_xchacha20poly1305_pad(st, ad_nbytes);
+    st->ad_nbytes = ad_nbytes;
+    st->nbytes = 0;
+}
+
+void vse_xchacha20poly1305_update(vse_xchacha20poly1305_t *st, const uint8_t *buf, size_t nbytes)
+{
+    vse_poly1305_update(&st->poly, buf, nbytes);
+    st->nbytes += nbytes;
+}
+
+void vse_xchacha20poly1305_encrypt(vse_xchacha20poly1305_t *st, chacha_ctx_t *chacha,
+                                   uint8_t *buf, size_t nbytes)
+{
+    const vse_dispatch_t *kern = vse_cpu_dispatch();
+    while (nbytes > 0)
+    {
+        size_t len = nbytes < VSE_XCHACHA_CHUNK ? nbytes : VSE_XCHACHA_CHUNK;
+        kern->chacha20_xcrypt(chacha, buf, buf, len);
+        vse_xchacha20poly1305_update(st, buf, len);
+        buf += len;
+        nbytes -= len;
+    }
+}
+
+void vse_xchacha20poly1305_final(vse_xchacha20poly1305_t *st, uint8_t *tag)
+{
+    uint8_t lengths[16];
+
+    vse_xchacha20poly1305_pad(st, st->nbytes);
+    put_le64(lengths, st->ad_nbytes);
+    put_le64(lengths + 8, st->nbytes);
+    vse_poly1305_update(&st->poly, lengths, sizeof(lengths));
+    vse_poly1305_final(&st->poly, tag);
+    memset(st, 0, sizeof(vse_xchacha20poly1305_t));
+}
+
+/*
+ * AVX2: four blocks per step, lane j holding block j as 64-bit limbs, the
+ * accumulator added to lane 0:
+ *
+ *     h' = (h + m0) r^4 + m1 r^3 + m2 r^2 + m3 r
+ *
+ * The lanes are summed before the carry, which vse_poly1305_carry() does in
+ * 64 bits, so the products have room to spare.
+ */
+
+#if VSE_X86
+#include <immintrin.h>
+
+VSE_TARGET("avx2")
+static uint64_t vse_hsum_epi64(__m256i v)
+{
+    uint64_t w[2];
+    __m128i x = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128((__m128i *)w, x);
+    return w[0] + w[1];
+}
+
+#define MUL _mm256_mul_epu32
+#define ADD _mm256_add_epi64
+
+VSE_TARGET("avx2")
+void vse_poly1305_blocks_avx2(vse_poly1305_t *st, const uint8_t *in, size_t nblocks)
+{
+    if (nblocks >= 4)
+    {
+        const __m256i mask = _mm256_set1_epi64x(POLY1305_MASK);
+        const __m256i hibit = _mm256_set1_epi64x(1 << 24);
+        const __m256i five = _mm256_set1_epi64x(5);
+        __m256i r[5];
+        __m256i s[5];
+        for (int i = 0; i < 5; i++)
+        {
+            r[i] = _mm256_setr_epi64x(st->r[3][i], st->r[2][i], st->r[1][i], st->r[0][i]);
+            s[i] = MUL(r[i], five);
+        }
+
+        for (; nblocks >= 4; nblocks -= 4, in += 64)
+        {
+            __m256i v0 = _mm256_loadu_si256((const __m256i *)in);
+            __m256i v1 = _mm256_loadu_si256((const __m256i *)(in + 32));
+            __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(v0, v1), 0xd8);
+            __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(v0, v1), 0xd8);
+            __m256i a[5];
+            a[0] = _mm256_and_si256(lo, mask);
+            a[1] = _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask);
+            a[2] = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask);
+            a[3] = _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask);
+            a[4] = _mm256_or_si256(_mm256_srli_epi64(hi, 40), hibit);
+            for (int i = 0; i < 5; i++)
+                a[i] = ADD(a[i], _mm256_setr_epi64x(st->h[i], 0, 0, 0));
+
+            uint64_t t[5];
+            t[0] = vse_hsum_epi64(ADD(ADD(ADD(MUL(a[0], r[0]), MUL(a[1], s[4])), ADD(MUL(a[2], s[3]), MUL(a[3], s[2]))), MUL(a[4], s[1])));
+            t[1] = vse_hsum_epi64(ADD(ADD(ADD(MUL(a[0], r[1]), MUL(a[1], r[0])), ADD(MUL(a[2], s[4]), MUL(a[3], s[3]))), MUL(a[4], s[2])));
+            t[2] = vse_hsum_epi64(ADD(ADD(ADD(MUL(a[0], r[2]), MUL(a[1], r[1])), ADD(MUL(a[2], r[0]), MUL(a[3], s[4]))), MUL(a[4], s[3])));
+            t[3] = vse_hsum_epi64(ADD(ADD(ADD(MUL(a[0], r[3]), MUL(a[1], r[2])), ADD(MUL(a[2], r[1]), MUL(a[3], r[0]))), MUL(a[4], s[4])));
+            t[4] = vse_hsum_epi64(ADD(ADD(ADD(MUL(a[0], r[4]), MUL(a[1], r[3])), ADD(MUL(a[2], r[2]), MUL(a[3], r[1]))), MUL(a[4], r[0])));
+            vse_poly1305_carry(st->h, t);
+        }
+    }
+    vse_poly1305_blocks(st, in, nblocks);
+}
+
+#undef MUL
+#undef ADD
+
+#else
+
+void vse_poly1305_blocks_avx2(vse_poly1305_t *st, const uint8_t *in, size_t nblocks)
+{
+    vse_poly1305_blocks(st, in, nblocks);
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef XCHACHA20POLY1305_5E2B8D47_1F96_4C3A_B7E0_92D4A6C1F853_H
+#define XCHACHA20POLY1305_5E2B8D47_1F96_4C3A_B7E0_92D4A6C1F853_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chacha/chacha.h"
+
+/*
+ * XChaCha20-Poly1305 (draft-irtf-cfrg-xchacha), 192-bit nonce.
+ *
+ * HChaCha20 of the key and the first 16 nonce bytes gives a subkey, used
+ * with the last 8 nonce bytes by ChaCha20: block 0 keys Poly1305, the
+ * message starts at block 1. The tag is RFC 8439's, over the zero-padded
+ * ad and ciphertext and their lengths.
+ *
+ * The bundled ChaCha20 has a 64-bit counter where RFC 8439 has a 32-bit
+ * one next to 4 zero bytes of nonce: both agree for the first 2^32 - 1
+ * blocks, i.e. up to 256 GiB, the most the RFC allows for one nonce.
+ *
+ * Poly1305 keeps 26-bit limbs, as poly1305-donna; the AVX2 kernel takes 4
+ * blocks at a time, one per lane, multiplied by r^4, r^3, r^2 and r.
+ */
+
+#define VSE_XCHACHA20_NONCE_LEN 24
+#define VSE_XCHACHA20POLY1305_TAG_LEN 16
+
+typedef struct vse_poly1305
+{
+    uint32_t r[4][5]; // r^1..r^4
+    uint32_t h[5];    // accumulator
+    uint32_t pad[4];  // s, added at the end
+    uint8_t buf[16];  // partial block
+    size_t buf_len;
+} vse_poly1305_t;
+
+typedef struct vse_xchacha20poly1305
+{
+    vse_poly1305_t poly;
+    uint64_t ad_nbytes;
+    uint64_t nbytes; // ciphertext authenticated
+} vse_xchacha20poly1305_t;
+
+/**
+ * HChaCha20: 32-byte subkey of a 32-byte key and 16 bytes of nonce.
+ */
+void vse_hchacha20(uint8_t *subkey, const uint8_t *key, const uint8_t *nonce);
+
+/**
+ * Set chacha up with the subkey of key and nonce, its counter at block 1,
+ * where the message starts.
+ */
+void vse_xchacha20_init(chacha_ctx_t *chacha,
+                        const uint8_t *key,    // 32 bytes
+                        const uint8_t *nonce); // VSE_XCHACHA20_NONCE_LEN bytes
+
+/**
+ * Start a tag: Poly1305 keyed from block 0, ad authenticated.
+ */
+void vse_xchacha20poly1305_init(vse_xchacha20poly1305_t *st,
+                                const uint8_t *key,   // 32 bytes
+                                const uint8_t *nonce, // VSE_XCHACHA20_NONCE_LEN bytes
+                                const uint8_t *ad, size_t ad_nbytes);
+
+/**
+ * Add ciphertext to the tag. Any length, in as many calls as wanted.
+ */
+void vse_xchacha20poly1305_update(vse_xchacha20poly1305_t *st, const uint8_t *buf, size_t nbytes);
+
+/**
+ * Encrypt buf in place with chacha, from vse_xchacha20_init(), and add it
+ * to the tag, a cache-sized piece at a time. Every call but the last of a
+ * message must be a multiple of 64 bytes.
+ */
+void vse_xchacha20poly1305_encrypt(vse_xchacha20poly1305_t *st, chacha_ctx_t *chacha,
+                                   uint8_t *buf, size_t nbytes);
+
+/**
+ * Finish the message.
+ */
+void vse_xchacha20poly1305_final(vse_xchacha20poly1305_t *st, uint8_t *tag); // VSE_XCHACHA20POLY1305_TAG_LEN bytes
+
+/**
+ * Poly1305 of any number of update calls: key is r then s, 32 bytes.
+ */
+void vse_poly1305_init(vse_poly1305_t *st, const uint8_t *key);
+void vse_poly1305_update(vse_poly1305_t *st, const uint8_t *buf, size_t nbytes);
+void vse_poly1305_final(vse_poly1305_t *st, uint8_t *tag); // 16 bytes
+
+/*
+ * Kernel, picked by vse_cpu_dispatch(): whole 16-byte blocks.
+ */
+void vse_poly1305_blocks(vse_poly1305_t *st, const uint8_t *in, size_t nblocks);
+
+// Only call it when vse_cpu_features() has VSE_CPU_AVX2.
+void vse_poly1305_blocks_avx2(vse_poly1305_t *st, const uint8_t *in, size_t nblocks);
+
+#endif